@@ -0,0 +1,171 @@
+/*
+ * If not stated otherwise in this file or this component's license file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2018 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * @file SegmentTimelineIndex.h
+ * @brief Binary search index of DASH SegmentTimeline
+ */
+
+#ifndef SEGMENTTIMELINEINDEX_H
+#define SEGMENTTIMELINEINDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+#include "libdash/ISegmentTimeline.h"
+
+/**
+ * @class SegmentTimelineIndex
+ * @brief Start times and segment numbers of SegmentTimeline S elements
+ *
+ * Maps a media time to its S element by binary search instead of walking
+ * the timeline. Built once per timeline of a manifest.
+ */
+class SegmentTimelineIndex
+{
+public:
+	/**
+	 * @brief SegmentTimelineIndex Constructor
+	 */
+	SegmentTimelineIndex() : mTimeline(NULL), mGeneration(0), mEntries(), mSegmentCount(0)
+	{
+	}
+
+	/**
+	 * @brief Index timeline, if not already indexed
+	 * @param segmentTimeline timeline to index
+	 * @param generation manifest generation, timelines of different manifests may share an address
+	 */
+	void Update(const dash::mpd::ISegmentTimeline *segmentTimeline, uint32_t generation)
+	{
+		if (segmentTimeline == mTimeline && generation == mGeneration)
+		{
+			return;
+		}
+		std::vector<dash::mpd::ITimeline *>&timelines = segmentTimeline->GetTimelines();
+		Reset(timelines.size());
+		mTimeline = segmentTimeline;
+		mGeneration = generation;
+		for (int index = 0; index < timelines.size(); index++)
+		{
+			dash::mpd::ITimeline *timeline = timelines.at(index);
+			AddEntry(timeline->GetStartTime(), timeline->GetDuration(), timeline->GetRepeatCount());
+		}
+	}
+
+	/**
+	 * @brief Drop all S elements
+	 * @param capacity number of S elements to be added
+	 */
+	void Reset(size_t capacity = 0)
+	{
+		mTimeline = NULL;
+		mGeneration = 0;
+		mEntries.clear();
+		mEntries.reserve(capacity);
+		mSegmentCount = 0;
+	}
+
+	/**
+	 * @brief Append S element
+	 * @param startTime @t of S element, 0 if absent to continue from previous element
+	 * @param duration @d of S element
+	 * @param repeatCount @r of S element
+	 */
+	void AddEntry(uint64_t startTime, uint64_t duration, uint32_t repeatCount)
+	{
+		if (!startTime && !mEntries.empty())
+		{
+			startTime = mEntries.back().endTime;
+		}
+		uint32_t segmentCount = repeatCount + 1;
+		TimelineEntry entry;
+		entry.startTime = startTime;
+		entry.endTime = startTime + (uint64_t)segmentCount * duration;
+		entry.segmentOffset = mSegmentCount;
+		mEntries.push_back(entry);
+		mSegmentCount += segmentCount;
+	}
+
+	/**
+	 * @brief Get number of S elements
+	 */
+	int Size() const
+	{
+		return mEntries.size();
+	}
+
+	/**
+	 * @brief Get start time of S element, derived from preceding elements when it has no @t
+	 * @param index S element index
+	 */
+	uint64_t GetStartTime(int index) const
+	{
+		return mEntries[index].startTime;
+	}
+
+	/**
+	 * @brief Get number of segments preceding S element
+	 * @param index S element index, Size() for total number of segments
+	 */
+	uint64_t GetSegmentOffset(int index) const
+	{
+		return (index < mEntries.size()) ? mEntries[index].segmentOffset : mSegmentCount;
+	}
+
+	/**
+	 * @brief Find first S element from fromIndex that ends after time
+	 * @param time media time in timescale units
+	 * @param fromIndex S element to search from
+	 * @retval S element index, Size() if timeline ends at or before time
+	 */
+	int FindEntry(uint64_t time, int fromIndex) const
+	{
+		if (fromIndex < 0)
+		{
+			fromIndex = 0;
+		}
+		else if (fromIndex > mEntries.size())
+		{
+			fromIndex = mEntries.size();
+		}
+		return std::upper_bound(mEntries.begin() + fromIndex, mEntries.end(), time, EndsAfter) - mEntries.begin();
+	}
+
+private:
+	struct TimelineEntry
+	{
+		uint64_t startTime;
+		uint64_t endTime;
+		uint64_t segmentOffset;
+	};
+
+	static bool EndsAfter(uint64_t time, const TimelineEntry &entry)
+	{
+		return time < entry.endTime;
+	}
+
+	const dash::mpd::ISegmentTimeline *mTimeline;
+	uint32_t mGeneration;
+	std::vector<TimelineEntry> mEntries;
+	uint64_t mSegmentCount;
+};
+
+#endif // SEGMENTTIMELINEINDEX_H
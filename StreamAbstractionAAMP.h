@@ -27,6 +27,7 @@
 
 #include "priv_aamp.h"
 #include <map>
+#include <atomic>
 #include <iterator>
 #include <vector>
 
@@ -54,6 +55,7 @@ struct CachedFragment
 	double duration;            /**< Fragment duration */
 	bool discontinuity;         /**< PTS discontinuity status */
 	int profileIndex;           /**< Profile index; Updated internally */
+	size_t cachedBytes;         /**< Bytes accounted to buffer limits while fragment is cached; Updated internally */
 #ifdef AAMP_DEBUG_INJECT
 	char uri[MAX_URI_LENGTH];   /**< Fragment url */
 #endif
@@ -103,9 +105,10 @@ public:
 	/**
 	 * @brief Start fragment injector loop
 	 *
+	 * @param[in] keepInjectedDuration - Keep injected duration, for audio rendition switch which sets it in FlushFragments
 	 * @return void
 	 */
-	void StartInjectLoop();
+	void StartInjectLoop(bool keepInjectedDuration = false);
 
 	/**
 	 * @brief Stop fragment injector loop
@@ -183,9 +186,20 @@ public:
 	 * @brief Get buffer to store the downloaded fragment content
 	 *
 	 * @param[in] initialize - Buffer to to initialized or not
+	 * @param[in] offset - Number of free slots to skip, used to fetch ahead of the write position
 	 * @return Fragment cache buffer
 	 */
-	CachedFragment* GetFetchBuffer(bool initialize);
+	CachedFragment* GetFetchBuffer(bool initialize, int offset = 0);
+
+	/**
+	 * @brief Get number of fragments that can be cached without waiting
+	 *
+	 * Limited by ring depth, buffer-target-duration ahead of playhead and
+	 * max-track-buffer-size/max-player-buffer-size memory ceilings
+	 *
+	 * @return Number of fragments that can be fetched without waiting
+	 */
+	int GetFreeFragmentCount();
 
 	/**
 	 * @brief Set current bandwidth
@@ -226,6 +240,37 @@ public:
 	 * @return current buffer health status
 	 */
 	BufferHealthStatus GetBufferHealthStatus() { return bufferStatus; };
+
+	/**
+	 * @brief Drop fragments cached by track, injector loop should be stopped
+	 *
+	 * Fetched duration is rewound to the playback position, so that fetcher
+	 * can re-fetch from there.
+	 *
+	 * @return Duration in seconds of dropped fragments ahead of playback position
+	 */
+	double FlushFragments();
+
+	/**
+	 * @brief Request fetcher to re-point track to a new rendition
+	 *
+	 * @return false if fetcher of track is already done
+	 */
+	bool RequestRenditionSwitch();
+
+	/**
+	 * @brief Check and clear rendition switch request, called by fetcher
+	 *
+	 * @return true if rendition switch was requested
+	 */
+	bool TakeRenditionSwitchRequest();
+
+	/**
+	 * @brief Mark fetcher of track done, unless a rendition switch is requested
+	 *
+	 * @return true if fetcher can exit
+	 */
+	bool FinishFetching();
 protected:
 
 	/**
@@ -268,7 +313,7 @@ private:
 public:
 	bool eosReached;                    /**< set to true when a vod asset has been played to completion */
 	bool enabled;                       /**< set to true if track is enabled */
-	int numberOfFragmentsCached;        /**< Number of fragments cached in this track*/
+	std::atomic<int> numberOfFragmentsCached; /**< Number of fragments cached in this track, incremented by fetcher and decremented by injector only*/
 	const char* name;                   /**< Track name used for debugging*/
 	double fragmentDurationSeconds;     /**< duration in seconds for current fragment-of-interest */
 	int segDLFailCount;                 /**< Segment download fail count*/
@@ -278,12 +323,26 @@ public:
 protected:
 	PrivateInstanceAAMP* aamp;          /**< Pointer to the PrivateInstanceAAMP*/
 	CachedFragment *cachedFragment;     /**< storage for currently-downloaded fragment */
-	bool abort;                         /**< Abort all operations if flag is set*/
+	int maxCachedFragments;             /**< Depth of cachedFragment ring, fixed for lifetime of track*/
+	std::atomic<bool> abort;            /**< Abort all operations if flag is set, read without lock by fetcher and injector fast paths*/
 	pthread_mutex_t mutex;              /**< protection of track variables accessed from multiple threads */
 	bool ptsError;                      /**< flag to indicate if last injected fragment has ptsError */
 private:
-	pthread_cond_t fragmentFetched;     /**< Signaled after a fragment is fetched*/
-	pthread_cond_t fragmentInjected;    /**< Signaled after a fragment is injected*/
+	/**
+	 * @brief Get profile index of the fragment being fetched by this track
+	 *
+	 * Only video follows ABR profile of the context, other tracks keep their rendition.
+	 * @return profile index
+	 */
+	int GetFetchProfileIndex();
+
+	pthread_mutex_t ringMutex;          /**< Taken only by a thread blocking on empty/full ring and by the one waking it up*/
+	pthread_cond_t fragmentFetched;     /**< Signaled after a fragment is fetched, if injector is waiting*/
+	pthread_cond_t fragmentInjected;    /**< Signaled after a fragment is injected, if fetcher is waiting*/
+	std::atomic<bool> fetcherWaiting;   /**< Fetcher is about to block on a full ring*/
+	std::atomic<bool> injectorWaiting;  /**< Injector is about to block on an empty ring*/
+	std::atomic<long long> cachedFragmentBytes; /**< Bytes held by fragments in ring*/
+	std::atomic<int> cachedFragmentDurationMs;  /**< Duration of fragments in ring in milliseconds*/
 	pthread_t fragmentInjectorThreadID; /**< Fragment injector thread id*/
 	int totalFragmentsDownloaded;       /**< Total fragments downloaded since start by track*/
 	bool fragmentInjectorThreadStarted; /**< Fragment injector's thread started or not*/
@@ -295,7 +354,10 @@ private:
 	int bandwidthBytesPerSecond;        /**< Bandwidth of last selected profile*/
 	double totalFetchedDuration;        /**< Total fragment fetched duration*/
 	size_t fetchBufferPreAllocLen;      /** Buffer length to pre-allocate for next fetch buffer*/
+	std::map<int, size_t> mFragmentSizeByProfile; /**< Recent fragment size per profile, used to size fetch buffers*/
 	bool discontinuityProcessed;
+	bool renditionSwitchPending;        /**< Fetcher to re-point track to a new rendition*/
+	bool fetchDone;                     /**< Fetcher of track exited*/
 
 	BufferHealthStatus bufferStatus;     /**< Buffer status of the track*/
 	BufferHealthStatus prevBufferStatus; /**< Previous buffer status of the track*/
@@ -662,6 +724,21 @@ public:
 	 */
 	virtual std::vector<long> GetAudioBitrates(void) = 0;
 
+	/**
+	 *   @brief Switch audio track to rendition of current language, without retune.
+	 *          Video keeps playing, audio resumes at playback position.
+	 *
+	 *   @return true if switch is started, false if a retune is needed
+	 */
+	virtual bool SwitchAudioTrack() { return false; }
+
+	/**
+	 *   @brief Stop injection of audio track and release its waits, for a rendition switch.
+	 *
+	 *   @return void
+	 */
+	void StopAudioInjection();
+
 protected:
 	/**
 	 *   @brief Get stream information of a profile from subclass.
@@ -96,6 +96,21 @@ char *base64_Encode(const unsigned char *src, size_t len)
  * @note caller responsible for freeing returned data
  */
 unsigned char *base64_Decode(const char *src, size_t *len)
+{
+	return base64_Decode(src, len, strlen(src));
+}
+
+
+/**
+ * @brief decode base64 encoded data to binary equivalent
+ * @param src pointer to base64-encoded data, need not be NUL-terminated
+ * @param len receives byte length of returned pointer, or zero upon failure
+ * @param srcLen number of base64 characters at src
+ * @retval pointer to malloc'd memory containing decoded binary data
+ * @retval NULL if insufficient memory to allocate base64-decoded data
+ * @note caller responsible for freeing returned data
+ */
+unsigned char *base64_Decode(const char *src, size_t *len, size_t srcLen)
 {
 	static const signed char mBase64CharToIndex[256] =
 	{
@@ -131,7 +146,6 @@ unsigned char *base64_Decode(const char *src, size_t *len)
 		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
 		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
 	};
-	size_t srcLen = strlen(src); // 7384
 	size_t numChars = (srcLen / 4) * 3; // initially round up to nearest 4 bytes
 	unsigned char *outData = (unsigned char *)malloc(numChars); // 5538
 	if (outData)
@@ -139,7 +153,7 @@ unsigned char *base64_Decode(const char *src, size_t *len)
 		// memset(outData, 0x00, numChars); // not-needed
 		unsigned char *dst = outData;
 		const char *finish = src + srcLen;
-		while (src < finish)
+		while (src + 4 <= finish)
 		{ // aaaaaa aabbbb bbbbcc cccccc
 			int data0 = mBase64CharToIndex[(unsigned char)src[0]];
 			int data1 = mBase64CharToIndex[(unsigned char)src[1]];
@@ -0,0 +1,206 @@
+/*
+ * If not stated otherwise in this file or this component's license file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2018 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * @file aampbufferpool.cpp
+ * @brief Size classed pool recycling fragment buffers between download and inject
+ */
+
+#include "aampbufferpool.h"
+#include "priv_aamp.h"
+
+/**
+ * @brief AampBufferPool Constructor
+ * @param maxPooledBytes maximum bytes kept on free lists, excess blocks are freed
+ */
+AampBufferPool::AampBufferPool(size_t maxPooledBytes) : mRefCount(1), mMaxPooledBytes(maxPooledBytes), mPooledBytes(0),
+		mOutstandingBytes(0), mPeakBytes(0), mHits(0), mMisses(0)
+{
+	pthread_mutex_init(&mMutex, NULL);
+}
+
+
+/**
+ * @brief AampBufferPool Destructor
+ */
+AampBufferPool::~AampBufferPool()
+{
+	for (int i = 0; i < BUFFER_POOL_SIZE_CLASS_COUNT; i++)
+	{
+		for (std::vector<char *>::iterator it = mFreeList[i].begin(); it != mFreeList[i].end(); it++)
+		{
+			g_free(*it);
+		}
+		mFreeList[i].clear();
+	}
+	pthread_mutex_destroy(&mMutex);
+}
+
+
+/**
+ * @brief Get block size of a size class
+ * @param sizeClass index of size class
+ * @retval size in bytes
+ */
+size_t AampBufferPool::GetClassSize(int sizeClass)
+{
+	size_t base = ((size_t)BUFFER_POOL_MIN_BLOCK_SIZE) << (sizeClass / BUFFER_POOL_CLASSES_PER_DOUBLING);
+	return base + (base / BUFFER_POOL_CLASSES_PER_DOUBLING) * (sizeClass % BUFFER_POOL_CLASSES_PER_DOUBLING);
+}
+
+
+/**
+ * @brief Get smallest size class able to hold len bytes
+ * @param len length in bytes
+ * @retval index of size class, -1 if len exceeds the largest class
+ */
+int AampBufferPool::GetSizeClass(size_t len)
+{
+	if (len <= BUFFER_POOL_MIN_BLOCK_SIZE)
+	{
+		return 0;
+	}
+	int doubling = 0;
+	size_t base = BUFFER_POOL_MIN_BLOCK_SIZE;
+	while ((base << 1) < len)
+	{
+		base <<= 1;
+		doubling++;
+	}
+	// base < len <= 2 * base, round up to next step of the doubling
+	size_t step = base / BUFFER_POOL_CLASSES_PER_DOUBLING;
+	int sizeClass = doubling * BUFFER_POOL_CLASSES_PER_DOUBLING + (int)((len - base + step - 1) / step);
+	return (sizeClass < BUFFER_POOL_SIZE_CLASS_COUNT) ? sizeClass : -1;
+}
+
+
+/**
+ * @brief Allocate a block
+ * @param len minimum length required
+ * @param[out] avail actual length of the block, to be passed back on release
+ * @retval pointer to block
+ */
+char *AampBufferPool::Allocate(size_t len, size_t &avail)
+{
+	char *ptr = NULL;
+	int sizeClass = GetSizeClass(len);
+	avail = (sizeClass >= 0) ? GetClassSize(sizeClass) : len;
+	pthread_mutex_lock(&mMutex);
+	mRefCount++;
+	// exact class first, a slightly larger free block beats a heap allocation
+	for (int i = sizeClass; (sizeClass >= 0) && (i <= sizeClass + BUFFER_POOL_FALLBACK_CLASSES) && (i < BUFFER_POOL_SIZE_CLASS_COUNT); i++)
+	{
+		if (!mFreeList[i].empty())
+		{
+			ptr = mFreeList[i].back();
+			mFreeList[i].pop_back();
+			avail = GetClassSize(i);
+			mPooledBytes -= avail;
+			break;
+		}
+	}
+	if (ptr)
+	{
+		mHits++;
+	}
+	else
+	{
+		mMisses++;
+	}
+	mOutstandingBytes += avail;
+	if (mOutstandingBytes + mPooledBytes > mPeakBytes)
+	{
+		mPeakBytes = mOutstandingBytes + mPooledBytes;
+	}
+	pthread_mutex_unlock(&mMutex);
+	if (!ptr)
+	{
+		ptr = (char *)g_malloc(avail);
+	}
+	return ptr;
+}
+
+
+/**
+ * @brief Return a block to the pool
+ * @param ptr block returned by Allocate
+ * @param avail length of block as returned by Allocate
+ */
+void AampBufferPool::Release(char *ptr, size_t avail)
+{
+	bool destroy = false;
+	int sizeClass = GetSizeClass(avail);
+	pthread_mutex_lock(&mMutex);
+	mOutstandingBytes -= avail;
+	if (sizeClass >= 0 && GetClassSize(sizeClass) == avail && (mPooledBytes + avail) <= mMaxPooledBytes)
+	{
+		mFreeList[sizeClass].push_back(ptr);
+		mPooledBytes += avail;
+		ptr = NULL;
+	}
+	UnrefUnlocked(destroy);
+	pthread_mutex_unlock(&mMutex);
+	if (ptr)
+	{
+		g_free(ptr);
+	}
+	if (destroy)
+	{
+		delete this;
+	}
+}
+
+
+/**
+ * @brief Drop one reference, caller holds mMutex
+ * @param[out] destroy set if last reference is dropped
+ */
+void AampBufferPool::UnrefUnlocked(bool &destroy)
+{
+	mRefCount--;
+	destroy = (0 == mRefCount);
+}
+
+
+/**
+ * @brief Drop reference of the owner, pool is deleted once all blocks are released
+ */
+void AampBufferPool::Unref()
+{
+	bool destroy = false;
+	pthread_mutex_lock(&mMutex);
+	UnrefUnlocked(destroy);
+	pthread_mutex_unlock(&mMutex);
+	if (destroy)
+	{
+		delete this;
+	}
+}
+
+
+/**
+ * @brief Log hit/miss counters and memory usage
+ */
+void AampBufferPool::LogStats()
+{
+	pthread_mutex_lock(&mMutex);
+	logprintf("AampBufferPool: hits %llu misses %llu outstanding %u pooled %u peak %u bytes\n", mHits, mMisses,
+			(unsigned int)mOutstandingBytes, (unsigned int)mPooledBytes, (unsigned int)mPeakBytes);
+	pthread_mutex_unlock(&mMutex);
+}
@@ -0,0 +1,97 @@
+/*
+ * If not stated otherwise in this file or this component's license file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2018 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * @file aampbufferpool.h
+ * @brief Size classed pool recycling fragment buffers between download and inject
+ */
+
+#ifndef AAMPBUFFERPOOL_H
+#define AAMPBUFFERPOOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <vector>
+
+#define BUFFER_POOL_MIN_BLOCK_SIZE (64*1024)   /**< Size of smallest size class*/
+#define BUFFER_POOL_CLASSES_PER_DOUBLING 8      /**< Each doubling is split in equal steps, at most 12.5% slack per block*/
+#define BUFFER_POOL_SIZE_CLASS_COUNT 80         /**< Size classes from 64KB to 60MB*/
+#define BUFFER_POOL_FALLBACK_CLASSES 2          /**< Larger classes searched for a free block before going to the heap*/
+
+/**
+ * @class AampBufferPool
+ * @brief Recycles fragment memory of a player instance
+ *
+ * Blocks are rounded up to a size class and kept on a free list of that class
+ * once released, so that steady state fetch/inject cycles reuse the same memory
+ * instead of going to the heap. Every block handed out holds a reference on the
+ * pool, which lets GStreamer release memory after the owning player is gone.
+ */
+class AampBufferPool
+{
+public:
+	/**
+	 * @brief AampBufferPool Constructor
+	 * @param maxPooledBytes maximum bytes kept on free lists, excess blocks are freed
+	 */
+	AampBufferPool(size_t maxPooledBytes);
+
+	/**
+	 * @brief Allocate a block
+	 * @param len minimum length required
+	 * @param[out] avail actual length of the block, to be passed back on release
+	 * @retval pointer to block
+	 */
+	char *Allocate(size_t len, size_t &avail);
+
+	/**
+	 * @brief Return a block to the pool
+	 * @param ptr block returned by Allocate
+	 * @param avail length of block as returned by Allocate
+	 */
+	void Release(char *ptr, size_t avail);
+
+	/**
+	 * @brief Drop reference of the owner, pool is deleted once all blocks are released
+	 */
+	void Unref();
+
+	/**
+	 * @brief Log hit/miss counters and memory usage
+	 */
+	void LogStats();
+
+private:
+	~AampBufferPool();
+	static size_t GetClassSize(int sizeClass);
+	static int GetSizeClass(size_t len);
+	void UnrefUnlocked(bool &destroy);
+
+	pthread_mutex_t mMutex;
+	int mRefCount;
+	size_t mMaxPooledBytes;
+	size_t mPooledBytes;
+	size_t mOutstandingBytes;
+	size_t mPeakBytes;
+	unsigned long long mHits;
+	unsigned long long mMisses;
+	std::vector<char *> mFreeList[BUFFER_POOL_SIZE_CLASS_COUNT];
+};
+
+#endif // AAMPBUFFERPOOL_H
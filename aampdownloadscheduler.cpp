@@ -0,0 +1,541 @@
+/*
+ * If not stated otherwise in this file or this component's license file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2018 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * @file aampdownloadscheduler.cpp
+ * @brief curl_multi based download scheduler shared by all tracks of a player instance
+ */
+
+#include "aampdownloadscheduler.h"
+#include "priv_aamp.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <algorithm>
+
+#define DOWNLOAD_SCHEDULER_POLL_INTERVAL_MS 100     /**< Upper bound of curl_multi_wait, progress callbacks run at least this often*/
+#define DOWNLOAD_SCHEDULER_JOB_WORKERS 3            /**< Worker threads running blocking download jobs*/
+
+/**
+ * @brief AampDownloadScheduler Constructor
+ * @param maxConcurrentTransfers maximum transfers running at a time
+ * @param maxHostConnections maximum connections opened to a single host
+ */
+AampDownloadScheduler::AampDownloadScheduler(int maxConcurrentTransfers, int maxHostConnections) : mMulti(NULL), mThreadId(0),
+		mThreadStarted(false), mStop(false), mMaxConcurrentTransfers(maxConcurrentTransfers), mActive(), mJobs(), mJobWorkers()
+{
+	pthread_mutex_init(&mMutex, NULL);
+	pthread_cond_init(&mRequestQueued, NULL);
+	pthread_cond_init(&mRequestDone, NULL);
+	pthread_cond_init(&mJobQueued, NULL);
+	pthread_cond_init(&mJobDone, NULL);
+	mWakeupPipe[0] = mWakeupPipe[1] = -1;
+	if (mMaxConcurrentTransfers < 1)
+	{
+		mMaxConcurrentTransfers = 1;
+	}
+	mMulti = curl_multi_init();
+	if (mMulti)
+	{
+		// Connection cache of the multi handle is shared by every easy handle added to it
+		curl_multi_setopt(mMulti, CURLMOPT_MAXCONNECTS, (long)mMaxConcurrentTransfers);
+#if LIBCURL_VERSION_NUM >= 0x071e00
+		if (maxHostConnections > 0)
+		{
+			curl_multi_setopt(mMulti, CURLMOPT_MAX_HOST_CONNECTIONS, (long)maxHostConnections);
+		}
+		curl_multi_setopt(mMulti, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)mMaxConcurrentTransfers);
+#endif
+#ifdef CURLPIPE_MULTIPLEX
+		curl_multi_setopt(mMulti, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+	}
+}
+
+
+/**
+ * @brief AampDownloadScheduler Destructor
+ */
+AampDownloadScheduler::~AampDownloadScheduler()
+{
+	Stop();
+	if (mMulti)
+	{
+		curl_multi_cleanup(mMulti);
+		mMulti = NULL;
+	}
+	pthread_cond_destroy(&mJobDone);
+	pthread_cond_destroy(&mJobQueued);
+	pthread_cond_destroy(&mRequestDone);
+	pthread_cond_destroy(&mRequestQueued);
+	pthread_mutex_destroy(&mMutex);
+}
+
+
+/**
+ * @brief Scheduler thread entry
+ * @param arg AampDownloadScheduler pointer
+ * @retval NULL
+ */
+void *AampDownloadScheduler::SchedulerThread(void *arg)
+{
+	AampDownloadScheduler *scheduler = (AampDownloadScheduler *)arg;
+	if(aamp_pthread_setname(pthread_self(), "aampDLSched"))
+	{
+		logprintf("%s:%d: pthread_setname_np failed\n", __FUNCTION__, __LINE__);
+	}
+	scheduler->Run();
+	return NULL;
+}
+
+
+/**
+ * @brief Job worker thread entry
+ * @param arg AampDownloadScheduler pointer
+ * @retval NULL
+ */
+void *AampDownloadScheduler::JobWorkerThread(void *arg)
+{
+	AampDownloadScheduler *scheduler = (AampDownloadScheduler *)arg;
+	if(aamp_pthread_setname(pthread_self(), "aampDLJob"))
+	{
+		logprintf("%s:%d: pthread_setname_np failed\n", __FUNCTION__, __LINE__);
+	}
+	scheduler->RunJobs();
+	return NULL;
+}
+
+
+/**
+ * @brief Start scheduler thread
+ * @retval true on success
+ */
+bool AampDownloadScheduler::Start()
+{
+	bool ret = false;
+	pthread_mutex_lock(&mMutex);
+	if (mThreadStarted)
+	{
+		ret = true;
+	}
+	else if (mMulti)
+	{
+		if (pipe(mWakeupPipe) == 0)
+		{
+			fcntl(mWakeupPipe[0], F_SETFL, fcntl(mWakeupPipe[0], F_GETFL) | O_NONBLOCK);
+			fcntl(mWakeupPipe[1], F_SETFL, fcntl(mWakeupPipe[1], F_GETFL) | O_NONBLOCK);
+			mStop = false;
+			if (0 == pthread_create(&mThreadId, NULL, &SchedulerThread, this))
+			{
+				mThreadStarted = true;
+				ret = true;
+				for (int i = 0; i < DOWNLOAD_SCHEDULER_JOB_WORKERS; i++)
+				{
+					pthread_t workerId;
+					if (0 == pthread_create(&workerId, NULL, &JobWorkerThread, this))
+					{
+						mJobWorkers.push_back(workerId);
+					}
+					else
+					{
+						logprintf("%s:%d Failed to create job worker thread\n", __FUNCTION__, __LINE__);
+					}
+				}
+			}
+			else
+			{
+				logprintf("%s:%d Failed to create scheduler thread\n", __FUNCTION__, __LINE__);
+				close(mWakeupPipe[0]);
+				close(mWakeupPipe[1]);
+				mWakeupPipe[0] = mWakeupPipe[1] = -1;
+			}
+		}
+		else
+		{
+			logprintf("%s:%d Failed to create wakeup pipe errno %d\n", __FUNCTION__, __LINE__, errno);
+		}
+	}
+	pthread_mutex_unlock(&mMutex);
+	return ret;
+}
+
+
+/**
+ * @brief Stop scheduler thread, outstanding transfers are aborted
+ */
+void AampDownloadScheduler::Stop()
+{
+	pthread_mutex_lock(&mMutex);
+	if (!mThreadStarted)
+	{
+		pthread_mutex_unlock(&mMutex);
+		return;
+	}
+	mStop = true;
+	pthread_cond_signal(&mRequestQueued);
+	pthread_cond_broadcast(&mJobQueued);
+	pthread_mutex_unlock(&mMutex);
+	Wakeup();
+	pthread_join(mThreadId, NULL);
+	// transfers of running jobs are aborted by scheduler thread
+	for (std::vector<pthread_t>::iterator it = mJobWorkers.begin(); it != mJobWorkers.end(); it++)
+	{
+		pthread_join(*it, NULL);
+	}
+	mJobWorkers.clear();
+
+	pthread_mutex_lock(&mMutex);
+	while (!mJobs.empty())
+	{
+		mJobs.front()->done = true;
+		mJobs.pop_front();
+	}
+	pthread_cond_broadcast(&mJobDone);
+	mThreadStarted = false;
+	close(mWakeupPipe[0]);
+	close(mWakeupPipe[1]);
+	mWakeupPipe[0] = mWakeupPipe[1] = -1;
+	pthread_mutex_unlock(&mMutex);
+}
+
+
+/**
+ * @brief Perform a transfer, blocks until it is complete
+ * @param handle configured easy handle, must not be shared with another pending transfer
+ * @param priority priority of the transfer
+ * @param[out] queuedMs time spent waiting for a free transfer slot, optional
+ * @param observer hook to run on calling thread as data arrives, optional
+ * @retval result of the transfer
+ */
+CURLcode AampDownloadScheduler::Perform(CURL *handle, AampDownloadPriority priority, long long *queuedMs, AampTransferObserver *observer)
+{
+	DownloadRequest request;
+	request.handle = handle;
+	request.result = CURLE_OK;
+	request.done = false;
+	request.queuedTimeMs = aamp_GetCurrentTimeMS();
+	request.admittedTimeMs = request.queuedTimeMs;
+	request.observer = observer;
+
+	pthread_mutex_lock(&mMutex);
+	if (!mThreadStarted || mStop)
+	{
+		pthread_mutex_unlock(&mMutex);
+		if (queuedMs)
+		{
+			*queuedMs = 0;
+		}
+		CURLcode res = curl_easy_perform(handle);
+		if (observer && observer->dataPending.exchange(false))
+		{
+			observer->onData(observer->arg);
+		}
+		return res;
+	}
+	mPending[priority].push_back(&request);
+	pthread_cond_signal(&mRequestQueued);
+	pthread_mutex_unlock(&mMutex);
+	Wakeup();
+
+	pthread_mutex_lock(&mMutex);
+	while (!request.done)
+	{
+		if (observer && observer->dataPending.exchange(false))
+		{
+			pthread_mutex_unlock(&mMutex);
+			observer->onData(observer->arg);
+			pthread_mutex_lock(&mMutex);
+			continue;
+		}
+		pthread_cond_wait(&mRequestDone, &mMutex);
+	}
+	pthread_mutex_unlock(&mMutex);
+	if (observer && observer->dataPending.exchange(false))
+	{
+		observer->onData(observer->arg);
+	}
+	if (queuedMs)
+	{
+		*queuedMs = request.admittedTimeMs - request.queuedTimeMs;
+	}
+	return request.result;
+}
+
+
+/**
+ * @brief Queue a job to a worker thread
+ * @param job job to run, must stay valid till WaitForJob returns
+ * @retval false if no worker is running, caller is expected to run the job itself
+ */
+bool AampDownloadScheduler::SubmitJob(AampDownloadJob *job)
+{
+	bool ret = false;
+	pthread_mutex_lock(&mMutex);
+	job->done = false;
+	if (mThreadStarted && !mStop && !mJobWorkers.empty())
+	{
+		mJobs.push_back(job);
+		pthread_cond_signal(&mJobQueued);
+		ret = true;
+	}
+	pthread_mutex_unlock(&mMutex);
+	return ret;
+}
+
+
+/**
+ * @brief Wait for completion of a job queued by SubmitJob
+ * @param job queued job
+ */
+void AampDownloadScheduler::WaitForJob(AampDownloadJob *job)
+{
+	pthread_mutex_lock(&mMutex);
+	while (!job->done)
+	{
+		pthread_cond_wait(&mJobDone, &mMutex);
+	}
+	pthread_mutex_unlock(&mMutex);
+}
+
+
+/**
+ * @brief Job worker loop
+ */
+void AampDownloadScheduler::RunJobs()
+{
+	pthread_mutex_lock(&mMutex);
+	while (!mStop)
+	{
+		if (mJobs.empty())
+		{
+			pthread_cond_wait(&mJobQueued, &mMutex);
+			continue;
+		}
+		AampDownloadJob *job = mJobs.front();
+		mJobs.pop_front();
+		pthread_mutex_unlock(&mMutex);
+		job->run(job->arg);
+		pthread_mutex_lock(&mMutex);
+		job->done = true;
+		pthread_cond_broadcast(&mJobDone);
+	}
+	pthread_mutex_unlock(&mMutex);
+}
+
+
+/**
+ * @brief Fail queued transfers and wake up scheduler so running ones poll their abort state
+ */
+void AampDownloadScheduler::CancelPending()
+{
+	pthread_mutex_lock(&mMutex);
+	for (int i = 0; i < eDOWNLOAD_PRIORITY_COUNT; i++)
+	{
+		while (!mPending[i].empty())
+		{
+			DownloadRequest *request = mPending[i].front();
+			mPending[i].pop_front();
+			request->result = CURLE_ABORTED_BY_CALLBACK;
+			request->done = true;
+		}
+	}
+	pthread_cond_broadcast(&mRequestDone);
+	pthread_mutex_unlock(&mMutex);
+	Wakeup();
+}
+
+
+/**
+ * @brief Move queued transfers to multi handle in priority order, mMutex to be held by caller
+ */
+void AampDownloadScheduler::AdmitPendingUnlocked()
+{
+	for (int i = 0; i < eDOWNLOAD_PRIORITY_COUNT && mActive.size() < (size_t)mMaxConcurrentTransfers; i++)
+	{
+		while (!mPending[i].empty() && mActive.size() < (size_t)mMaxConcurrentTransfers)
+		{
+			DownloadRequest *request = mPending[i].front();
+			mPending[i].pop_front();
+			CURLMcode rc = curl_multi_add_handle(mMulti, request->handle);
+			if (rc == CURLM_OK)
+			{
+				request->admittedTimeMs = aamp_GetCurrentTimeMS();
+				mActive.push_back(request);
+			}
+			else
+			{
+				logprintf("%s:%d curl_multi_add_handle failed %d\n", __FUNCTION__, __LINE__, rc);
+				request->result = CURLE_FAILED_INIT;
+				request->done = true;
+				pthread_cond_broadcast(&mRequestDone);
+			}
+		}
+	}
+}
+
+
+/**
+ * @brief Collect transfers completed by multi handle and wake up their owners,
+ * also owners waiting for data of running transfers
+ */
+void AampDownloadScheduler::CompleteFinishedTransfers()
+{
+	CURLMsg *msg;
+	int msgsLeft = 0;
+	bool completed = false;
+	pthread_mutex_lock(&mMutex);
+	while ((msg = curl_multi_info_read(mMulti, &msgsLeft)) != NULL)
+	{
+		if (msg->msg != CURLMSG_DONE)
+		{
+			continue;
+		}
+		CURL *handle = msg->easy_handle;
+		CURLcode result = msg->data.result;
+		curl_multi_remove_handle(mMulti, handle);
+		for (std::vector<DownloadRequest *>::iterator it = mActive.begin(); it != mActive.end(); it++)
+		{
+			if ((*it)->handle == handle)
+			{
+				(*it)->result = result;
+				(*it)->done = true;
+				mActive.erase(it);
+				completed = true;
+				break;
+			}
+		}
+	}
+	if (completed)
+	{
+		pthread_cond_broadcast(&mRequestDone);
+	}
+	else
+	{
+		NotifyDataArrivedUnlocked();
+	}
+	pthread_mutex_unlock(&mMutex);
+}
+
+
+/**
+ * @brief Wake up owners of running transfers that received data, mMutex to be held by caller
+ */
+void AampDownloadScheduler::NotifyDataArrivedUnlocked()
+{
+	for (std::vector<DownloadRequest *>::iterator it = mActive.begin(); it != mActive.end(); it++)
+	{
+		if ((*it)->observer && (*it)->observer->dataPending)
+		{
+			pthread_cond_broadcast(&mRequestDone);
+			break;
+		}
+	}
+}
+
+
+/**
+ * @brief Abort queued and running transfers, mMutex to be held by caller
+ * @param result result to be reported to owners
+ */
+void AampDownloadScheduler::AbortAllUnlocked(CURLcode result)
+{
+	for (std::vector<DownloadRequest *>::iterator it = mActive.begin(); it != mActive.end(); it++)
+	{
+		curl_multi_remove_handle(mMulti, (*it)->handle);
+		(*it)->result = result;
+		(*it)->done = true;
+	}
+	mActive.clear();
+	for (int i = 0; i < eDOWNLOAD_PRIORITY_COUNT; i++)
+	{
+		while (!mPending[i].empty())
+		{
+			mPending[i].front()->result = result;
+			mPending[i].front()->done = true;
+			mPending[i].pop_front();
+		}
+	}
+	pthread_cond_broadcast(&mRequestDone);
+}
+
+
+/**
+ * @brief Interrupt curl_multi_wait of scheduler thread
+ */
+void AampDownloadScheduler::Wakeup()
+{
+	if (mWakeupPipe[1] >= 0)
+	{
+		char c = 0;
+		if (write(mWakeupPipe[1], &c, 1) < 0 && errno != EAGAIN)
+		{
+			logprintf("%s:%d write failed errno %d\n", __FUNCTION__, __LINE__, errno);
+		}
+	}
+}
+
+
+/**
+ * @brief Consume pending wakeup notifications
+ */
+void AampDownloadScheduler::DrainWakeupPipe()
+{
+	char buf[64];
+	while (read(mWakeupPipe[0], buf, sizeof(buf)) > 0);
+}
+
+
+/**
+ * @brief Scheduler loop, the only place where the multi handle is driven
+ */
+void AampDownloadScheduler::Run()
+{
+	struct curl_waitfd wakeupFd;
+	wakeupFd.fd = mWakeupPipe[0];
+	wakeupFd.events = CURL_WAIT_POLLIN;
+	wakeupFd.revents = 0;
+
+	pthread_mutex_lock(&mMutex);
+	while (!mStop)
+	{
+		AdmitPendingUnlocked();
+		if (mActive.empty())
+		{
+			pthread_cond_wait(&mRequestQueued, &mMutex);
+			continue;
+		}
+		pthread_mutex_unlock(&mMutex);
+
+		int running = 0;
+		CURLMcode rc = curl_multi_perform(mMulti, &running);
+		if (rc != CURLM_OK)
+		{
+			logprintf("%s:%d curl_multi_perform failed %d\n", __FUNCTION__, __LINE__, rc);
+		}
+		CompleteFinishedTransfers();
+		if (running > 0)
+		{
+			curl_multi_wait(mMulti, &wakeupFd, 1, DOWNLOAD_SCHEDULER_POLL_INTERVAL_MS, NULL);
+		}
+		DrainWakeupPipe();
+		pthread_mutex_lock(&mMutex);
+	}
+	AbortAllUnlocked(CURLE_ABORTED_BY_CALLBACK);
+	pthread_mutex_unlock(&mMutex);
+}
@@ -0,0 +1,180 @@
+/*
+ * If not stated otherwise in this file or this component's license file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2018 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * @file aampdownloadscheduler.h
+ * @brief curl_multi based download scheduler shared by all tracks of a player instance
+ */
+
+#ifndef AAMPDOWNLOADSCHEDULER_H
+#define AAMPDOWNLOADSCHEDULER_H
+
+#include <pthread.h>
+#include <curl/curl.h>
+#include <deque>
+#include <vector>
+#include <atomic>
+
+/**
+ * @brief Priority of a scheduled download, lower value is admitted first
+ */
+enum AampDownloadPriority
+{
+	eDOWNLOAD_PRIORITY_MANIFEST,    /**< Main manifest, playlist refresh and keys*/
+	eDOWNLOAD_PRIORITY_VIDEO,       /**< Video and iframe fragments*/
+	eDOWNLOAD_PRIORITY_AUDIO,       /**< Audio fragments*/
+	eDOWNLOAD_PRIORITY_PREFETCH,    /**< Speculative downloads ahead of playback*/
+	eDOWNLOAD_PRIORITY_COUNT        /**< Number of priority levels*/
+};
+
+/**
+ * @brief Blocking download job run by a worker thread of the scheduler
+ */
+struct AampDownloadJob
+{
+	void (*run)(void *arg);         /**< Job function, typically does one or more GetFile calls*/
+	void *arg;                      /**< Argument of job function*/
+	bool done;                      /**< Set once job function returned*/
+};
+
+/**
+ * @brief Hook run on the thread blocked in Perform() as data of its transfer arrives
+ *
+ * Write callback of the transfer only sets dataPending, onData is then called
+ * on the requesting thread so that per chunk work stays off the scheduler thread.
+ */
+struct AampTransferObserver
+{
+	void (*onData)(void *arg);      /**< Called without scheduler lock held*/
+	void *arg;                      /**< Argument of onData*/
+	std::atomic<bool> dataPending;  /**< Set by write callback, cleared before onData is called*/
+};
+
+/**
+ * @class AampDownloadScheduler
+ * @brief Runs easy handles of a player instance on one curl_multi handle
+ *
+ * Callers keep configuring their own easy handles and block in Perform() the
+ * same way they used to block in curl_easy_perform(). Transfers submitted from
+ * different threads overlap on the multi handle, share its connection cache
+ * and are admitted in priority order once the concurrency limit is reached.
+ * Abort is still driven by the progress callback of each easy handle.
+ * Write, header and progress callbacks of every transfer of the player run on
+ * the single scheduler thread, so they must not block or do heavy work such as
+ * decryption; a slow callback stalls the other tracks of the player.
+ * Worker threads started along with the scheduler run blocking download jobs,
+ * so a caller can overlap several GetFile calls without creating threads.
+ */
+class AampDownloadScheduler
+{
+public:
+	/**
+	 * @brief AampDownloadScheduler Constructor
+	 * @param maxConcurrentTransfers maximum transfers running at a time
+	 * @param maxHostConnections maximum connections opened to a single host
+	 */
+	AampDownloadScheduler(int maxConcurrentTransfers, int maxHostConnections);
+
+	/**
+	 * @brief AampDownloadScheduler Destructor
+	 */
+	~AampDownloadScheduler();
+
+	/**
+	 * @brief Start scheduler thread
+	 * @retval true on success
+	 */
+	bool Start();
+
+	/**
+	 * @brief Stop scheduler thread, outstanding transfers are aborted
+	 */
+	void Stop();
+
+	/**
+	 * @brief Perform a transfer, blocks until it is complete
+	 * @param handle configured easy handle, must not be shared with another pending transfer
+	 * @param priority priority of the transfer
+	 * @param[out] queuedMs time spent waiting for a free transfer slot, optional
+	 * @param observer hook to run on calling thread as data arrives, optional
+	 * @retval result of the transfer
+	 */
+	CURLcode Perform(CURL *handle, AampDownloadPriority priority, long long *queuedMs = NULL, AampTransferObserver *observer = NULL);
+
+	/**
+	 * @brief Fail queued transfers and wake up scheduler so running ones poll their abort state
+	 */
+	void CancelPending();
+
+	/**
+	 * @brief Queue a job to a worker thread
+	 * @param job job to run, must stay valid till WaitForJob returns
+	 * @retval false if no worker is running, caller is expected to run the job itself
+	 */
+	bool SubmitJob(AampDownloadJob *job);
+
+	/**
+	 * @brief Wait for completion of a job queued by SubmitJob
+	 * @param job queued job
+	 */
+	void WaitForJob(AampDownloadJob *job);
+
+private:
+	/**
+	 * @brief Transfer submitted to scheduler
+	 */
+	struct DownloadRequest
+	{
+		CURL *handle;                   /**< Easy handle of the transfer*/
+		CURLcode result;                /**< Result of the transfer*/
+		bool done;                      /**< Set once transfer is complete*/
+		long long queuedTimeMs;         /**< Time of submission*/
+		long long admittedTimeMs;       /**< Time at which transfer was added to multi handle*/
+		AampTransferObserver *observer; /**< Owner to wake up as data arrives, NULL if none*/
+	};
+
+	static void *SchedulerThread(void *arg);
+	static void *JobWorkerThread(void *arg);
+	void Run();
+	void RunJobs();
+	void AdmitPendingUnlocked();
+	void CompleteFinishedTransfers();
+	void NotifyDataArrivedUnlocked();
+	void AbortAllUnlocked(CURLcode result);
+	void Wakeup();
+	void DrainWakeupPipe();
+
+	CURLM *mMulti;
+	pthread_t mThreadId;
+	bool mThreadStarted;
+	bool mStop;
+	pthread_mutex_t mMutex;
+	pthread_cond_t mRequestQueued;
+	pthread_cond_t mRequestDone;
+	int mWakeupPipe[2];
+	int mMaxConcurrentTransfers;
+	std::deque<DownloadRequest *> mPending[eDOWNLOAD_PRIORITY_COUNT];
+	std::vector<DownloadRequest *> mActive;
+	pthread_cond_t mJobQueued;
+	pthread_cond_t mJobDone;
+	std::deque<AampDownloadJob *> mJobs;
+	std::vector<pthread_t> mJobWorkers;
+};
+
+#endif // AAMPDOWNLOADSCHEDULER_H
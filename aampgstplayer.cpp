@@ -99,6 +99,8 @@ struct media_stream
 	bool resetPosition;
 	bool bufferUnderrun;
 	bool eosReached;
+	GstClockTime segmentStart;
+	bool reuseSegmentStart;
 };
 
 /**
@@ -1632,6 +1634,15 @@ static void AAMPGstPlayer_SendPendingEvents(PrivateInstanceAAMP *aamp, AAMPGstPl
 		if (!ret) logprintf("%s: flush stop error\n", __FUNCTION__);
 		stream->flush = false;
 	}
+	if (stream->reuseSegmentStart)
+	{ // stream flushed alone; keep running time in line with other streams
+		pts = stream->segmentStart;
+		stream->reuseSegmentStart = false;
+	}
+	else
+	{
+		stream->segmentStart = pts;
+	}
 #ifdef USE_GST1
 	GstSegment segment;
 	gst_segment_init(&segment, GST_FORMAT_TIME);
@@ -1697,16 +1708,31 @@ static void AAMPGstPlayer_SendPendingEvents(PrivateInstanceAAMP *aamp, AAMPGstPl
 }
 
 
+#ifdef USE_GST1
 /**
- * @brief Inject buffer of a stream type to its pipeline
+ * @brief Destroy notify of GstMemory wrapping a shared fragment buffer
+ * @param[in] data SharedFragmentBuffer whose reference is held by the memory
+ */
+static void AAMPGstPlayer_ReleaseSharedBuffer(gpointer data)
+{
+	aamp_ReleaseSharedBuffer((SharedFragmentBuffer *)data);
+}
+#endif
+
+/**
+ * @brief Inject data of a stream type to its pipeline, split in slices if sink has a buffer size limit
+ * @param[in] aamp pointer to PrivateInstanceAAMP object associated with player
+ * @param[in] privateContext pointer to AAMPGstPlayerPriv object
  * @param[in] mediaType stream type
- * @param[in] ptr buffer pointer
- * @param[in] len0 length of buffer
+ * @param[in] ptr data pointer
+ * @param[in] sharedBuffer shared buffer holding data, wrapped without copy; NULL to copy data
+ * @param[in] len0 length of data
  * @param[in] fpts PTS of buffer (in sec)
  * @param[in] fdts DTS of buffer (in sec)
  * @param[in] fDuration duration of buffer (in sec)
  */
-void AAMPGstPlayer::Send(MediaType mediaType, const void *ptr, size_t len0, double fpts, double fdts, double fDuration)
+static void AAMPGstPlayer_SendSlices(PrivateInstanceAAMP *aamp, AAMPGstPlayerPriv *privateContext, MediaType mediaType,
+		const char *ptr, SharedFragmentBuffer *sharedBuffer, size_t len0, double fpts, double fdts, double fDuration)
 {
 #define MAX_BYTES_TO_SEND (128*1024)
 	GstClockTime pts = (GstClockTime)(fpts * GST_SECOND);
@@ -1729,8 +1755,8 @@ void AAMPGstPlayer::Send(MediaType mediaType, const void *ptr, size_t len0, doub
 #ifdef TRACE_VID_PTS
 	if (mediaType == eMEDIATYPE_VIDEO && privateContext->rate != 1.0)
 	{
-		logprintf("AAMPGstPlayer %s : rate %f fpts %f pts %llu pipeline->stream_time %lu ", (mediaType == eMEDIATYPE_VIDEO)?"vid":"aud", privateContext->rate, fpts, (unsigned long long)pts, GST_PIPELINE(this->privateContext->pipeline)->stream_time);
-		GstClock* clock = gst_pipeline_get_clock(GST_PIPELINE(this->privateContext->pipeline));
+		logprintf("AAMPGstPlayer %s : rate %f fpts %f pts %llu pipeline->stream_time %lu ", (mediaType == eMEDIATYPE_VIDEO)?"vid":"aud", privateContext->rate, fpts, (unsigned long long)pts, GST_PIPELINE(privateContext->pipeline)->stream_time);
+		GstClock* clock = gst_pipeline_get_clock(GST_PIPELINE(privateContext->pipeline));
 		if (clock)
 		{
 			GstClockTime curr = gst_clock_get_time(clock);
@@ -1762,25 +1788,36 @@ void AAMPGstPlayer::Send(MediaType mediaType, const void *ptr, size_t len0, doub
 		{
 			len = maxBytes;
 		}
-		GstBuffer *buffer = gst_buffer_new_and_alloc((guint)len);
-		if (discontinuity )
+		GstBuffer *buffer;
+#ifdef USE_GST1
+		if (sharedBuffer)
 		{
-			GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DISCONT);
-			discontinuity = FALSE;
+			// memory is shared by slices and may still be read by aamp, sink must not write to it
+			buffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, sharedBuffer->ptr, sharedBuffer->len, ptr - sharedBuffer->ptr, len,
+					aamp_RetainSharedBuffer(sharedBuffer), AAMPGstPlayer_ReleaseSharedBuffer);
+		}
+		else
+		{
+			buffer = gst_buffer_new_and_alloc((guint)len);
+			GstMapInfo map;
+			gst_buffer_map(buffer, &map, GST_MAP_WRITE);
+			memcpy(map.data, ptr, len);
+			gst_buffer_unmap(buffer, &map);
 		}
-#ifdef USE_GST1
-		GstMapInfo map;
-		gst_buffer_map(buffer, &map, GST_MAP_WRITE);
-		memcpy(map.data, ptr, len);
-		gst_buffer_unmap(buffer, &map);
 		GST_BUFFER_PTS(buffer) = pts;
 		GST_BUFFER_DTS(buffer) = dts;
 		//GST_BUFFER_DURATION(buffer) = duration;
 #else
+		buffer = gst_buffer_new_and_alloc((guint)len);
 		memcpy(GST_BUFFER_DATA(buffer), ptr, len);
 		GST_BUFFER_TIMESTAMP(buffer) = pts;
 		GST_BUFFER_DURATION(buffer) = duration;
 #endif
+		if (discontinuity )
+		{
+			GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DISCONT);
+			discontinuity = FALSE;
+		}
 		ret = gst_app_src_push_buffer(GST_APP_SRC(privateContext->stream[mediaType].source), buffer);
 		if (ret != GST_FLOW_OK)
 		{
@@ -1791,7 +1828,7 @@ void AAMPGstPlayer::Send(MediaType mediaType, const void *ptr, size_t len0, doub
 		{
 			privateContext->stream[mediaType].bufferUnderrun = false;
 		}
-		ptr = len + (unsigned char *)ptr;
+		ptr += len;
 		len0 -= len;
 		if (len0 == 0)
 		{
@@ -1801,6 +1838,21 @@ void AAMPGstPlayer::Send(MediaType mediaType, const void *ptr, size_t len0, doub
 }
 
 
+/**
+ * @brief Inject buffer of a stream type to its pipeline
+ * @param[in] mediaType stream type
+ * @param[in] ptr buffer pointer
+ * @param[in] len0 length of buffer
+ * @param[in] fpts PTS of buffer (in sec)
+ * @param[in] fdts DTS of buffer (in sec)
+ * @param[in] fDuration duration of buffer (in sec)
+ */
+void AAMPGstPlayer::Send(MediaType mediaType, const void *ptr, size_t len0, double fpts, double fdts, double fDuration)
+{
+	AAMPGstPlayer_SendSlices(aamp, privateContext, mediaType, (const char *)ptr, NULL, len0, fpts, fdts, fDuration);
+}
+
+
 /**
  * @brief Inject buffer of a stream type to its pipeline
  * @param[in] mediaType stream type
@@ -1873,6 +1925,24 @@ void AAMPGstPlayer::Send(MediaType mediaType, GrowableBuffer* pBuffer, double fp
 	memset(pBuffer, 0x00, sizeof(GrowableBuffer));
 }
 
+/**
+ * @brief Inject a slice of a shared fragment buffer to its pipeline
+ *
+ * GstMemory wraps the shared buffer directly and holds a reference on it, so
+ * the fragment downloaded by curl reaches appsrc without being copied.
+ * @param[in] mediaType stream type
+ * @param[in] sharedBuffer reference counted fragment buffer, caller keeps its reference
+ * @param[in] offset offset of slice in buffer
+ * @param[in] len0 length of slice
+ * @param[in] fpts PTS of buffer (in sec)
+ * @param[in] fdts DTS of buffer (in sec)
+ * @param[in] fDuration duration of buffer (in sec)
+ */
+void AAMPGstPlayer::Send(MediaType mediaType, SharedFragmentBuffer* sharedBuffer, size_t offset, size_t len0, double fpts, double fdts, double fDuration)
+{
+	AAMPGstPlayer_SendSlices(aamp, privateContext, mediaType, sharedBuffer->ptr + offset, sharedBuffer, len0, fpts, fdts, fDuration);
+}
+
 #ifdef STANDALONE_AAMP
 
 /**
@@ -1947,6 +2017,7 @@ void AAMPGstPlayer::Configure(StreamOutputFormat format, StreamOutputFormat audi
 		}
 
 		stream->resetPosition = true;
+		stream->reuseSegmentStart = false;
 		stream->eosReached = false;
 	}
 
@@ -2642,6 +2713,7 @@ void AAMPGstPlayer::Flush(double position, float rate)
 		{
 			privateContext->stream[i].resetPosition = true;
 			privateContext->stream[i].flush = true;
+			privateContext->stream[i].reuseSegmentStart = false;
 		}
 		AAMPLOG_INFO("TestStreamer::%s - pipeline flush seek - start = %f\n", __FUNCTION__, position);
 		if (!gst_element_seek(privateContext->pipeline, 1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET,
@@ -2679,6 +2751,48 @@ bool AAMPGstPlayer::Discontinuity(MediaType type)
 }
 
 
+/**
+ * @brief Flush a stream type alone, other streams keep playing
+ * @param type stream type
+ * @retval true if stream flushed
+ */
+bool AAMPGstPlayer::FlushTrack(MediaType type)
+{
+	media_stream *stream = &privateContext->stream[type];
+	if (stream->using_playersinkbin || !stream->source || stream->format == FORMAT_NONE)
+	{
+		logprintf("AAMPGstPlayer::%s type %d can't be flushed alone\n", __FUNCTION__, (int)type);
+		return false;
+	}
+	if (stream->resetPosition)
+	{
+		logprintf("AAMPGstPlayer::%s type %d nothing sent since last segment\n", __FUNCTION__, (int)type);
+		return true;
+	}
+	logprintf("AAMPGstPlayer::%s type %d segment start %" G_GUINT64_FORMAT "\n", __FUNCTION__, (int)type, stream->segmentStart);
+	/*Sent to element, so that buffers queued in appsrc are dropped too*/
+	if (!gst_element_send_event(stream->source, gst_event_new_flush_start()))
+	{
+		logprintf("%s: flush start error\n", __FUNCTION__);
+	}
+#ifdef USE_GST1
+	GstEvent* event = gst_event_new_flush_stop(FALSE);
+#else
+	GstEvent* event = gst_event_new_flush_stop();
+#endif
+	if (!gst_element_send_event(stream->source, event))
+	{
+		logprintf("%s: flush stop error\n", __FUNCTION__);
+	}
+	/*Next buffer starts a segment with start of flushed one, running time of stream continues*/
+	stream->resetPosition = true;
+	stream->reuseSegmentStart = true;
+	stream->bufferUnderrun = false;
+	stream->eosReached = false;
+	return true;
+}
+
+
 /**
  * @brief Check if cache empty for a media type
  * @param[in] mediaType stream type
@@ -45,6 +45,7 @@ public:
 	void Configure(StreamOutputFormat format, StreamOutputFormat audioFormat, bool bESChangeStatus);
 	void Send(MediaType mediaType, const void *ptr, size_t len, double fpts, double fdts, double duration);
 	void Send(MediaType mediaType, GrowableBuffer* buffer, double fpts, double fdts, double duration);
+	void Send(MediaType mediaType, SharedFragmentBuffer* buffer, size_t offset, size_t len, double fpts, double fdts, double duration);
 	void EndOfStreamReached(MediaType type);
 	void Stream(void);
 	void Stop(bool keepLastFrame);
@@ -56,6 +57,7 @@ public:
 	unsigned long getCCDecoderHandle(void);
 	void SetVideoRectangle(int x, int y, int w, int h);
 	bool Discontinuity( MediaType mediaType);
+	bool FlushTrack(MediaType mediaType);
 	void SetVideoZoom(VideoZoomMode zoom);
 	void SetVideoMute(bool muted);
 	void SetAudioVolume(int volume);
@@ -23,6 +23,8 @@
  */
 
 #include "priv_aamp.h"
+#include <errno.h>
+#include <string>
 
 #ifndef WIN32
 #ifdef USE_SYSLOG_HELPER_PRINT
@@ -342,3 +344,234 @@ void logprintf(const char *format, ...)
 #endif
 }
 
+
+/**
+ * @brief Trace lanes of tune profiler buckets, one chrome trace thread per lane
+ */
+enum ProfilerTraceLane
+{
+	eTRACE_LANE_MANIFEST,           /**< Main manifest*/
+	eTRACE_LANE_VIDEO,              /**< Video playlist, init and fragment*/
+	eTRACE_LANE_AUDIO,              /**< Audio playlist, init and fragment*/
+	eTRACE_LANE_DRM,                /**< License acquisition and decryption*/
+	eTRACE_LANE_PIPELINE,           /**< Gstreamer pipeline milestones*/
+	eTRACE_LANE_CRITICAL_PATH,      /**< Critical path and idle gaps on it*/
+	eTRACE_LANE_COUNT               /**< Lane count*/
+};
+
+/**
+ * @brief Maximum dependencies of a profiler bucket
+ */
+#define MAX_PROFILER_BUCKET_DEPENDENCIES 4
+
+/**
+ * @brief Trace description of a profiler bucket
+ */
+struct ProfilerBucketTraceInfo
+{
+	const char *name;               /**< Event name in trace*/
+	ProfilerTraceLane lane;         /**< Lane of event*/
+	ProfilerBucketType parent;      /**< Enclosing bucket, PROFILE_BUCKET_TYPE_COUNT if none*/
+	ProfilerBucketType dependencies[MAX_PROFILER_BUCKET_DEPENDENCIES]; /**< Buckets to complete before this one can start, terminated by PROFILE_BUCKET_TYPE_COUNT*/
+};
+
+/**
+ * @brief Marks absence of parent or end of dependency list
+ */
+#define NO_BUCKET PROFILE_BUCKET_TYPE_COUNT
+
+/**
+ * @brief Trace description of profiler buckets, indexed by ProfilerBucketType
+ *
+ * Dependency edges follow the tune sequence manifest -> playlist -> init -> license -> first fragment -> first frame
+ */
+static const ProfilerBucketTraceInfo gProfilerBucketTraceInfo[PROFILE_BUCKET_TYPE_COUNT] =
+{
+	{ "manifest", eTRACE_LANE_MANIFEST, NO_BUCKET, { NO_BUCKET } },
+	{ "playlist-video", eTRACE_LANE_VIDEO, NO_BUCKET, { PROFILE_BUCKET_MANIFEST, NO_BUCKET } },
+	{ "playlist-audio", eTRACE_LANE_AUDIO, NO_BUCKET, { PROFILE_BUCKET_MANIFEST, NO_BUCKET } },
+	{ "init-video", eTRACE_LANE_VIDEO, NO_BUCKET, { PROFILE_BUCKET_PLAYLIST_VIDEO, PROFILE_BUCKET_MANIFEST, NO_BUCKET } },
+	{ "init-audio", eTRACE_LANE_AUDIO, NO_BUCKET, { PROFILE_BUCKET_PLAYLIST_AUDIO, PROFILE_BUCKET_MANIFEST, NO_BUCKET } },
+	{ "fragment-video", eTRACE_LANE_VIDEO, NO_BUCKET, { PROFILE_BUCKET_INIT_VIDEO, PROFILE_BUCKET_PLAYLIST_VIDEO, PROFILE_BUCKET_MANIFEST, NO_BUCKET } },
+	{ "fragment-audio", eTRACE_LANE_AUDIO, NO_BUCKET, { PROFILE_BUCKET_INIT_AUDIO, PROFILE_BUCKET_PLAYLIST_AUDIO, PROFILE_BUCKET_MANIFEST, NO_BUCKET } },
+	{ "decrypt-video", eTRACE_LANE_DRM, NO_BUCKET, { PROFILE_BUCKET_FRAGMENT_VIDEO, PROFILE_BUCKET_LA_TOTAL, NO_BUCKET } },
+	{ "decrypt-audio", eTRACE_LANE_DRM, NO_BUCKET, { PROFILE_BUCKET_FRAGMENT_AUDIO, PROFILE_BUCKET_LA_TOTAL, NO_BUCKET } },
+	{ "license", eTRACE_LANE_DRM, NO_BUCKET, { PROFILE_BUCKET_PLAYLIST_VIDEO, PROFILE_BUCKET_MANIFEST, NO_BUCKET } },
+	{ "license-preproc", eTRACE_LANE_DRM, PROFILE_BUCKET_LA_TOTAL, { NO_BUCKET } },
+	{ "license-network", eTRACE_LANE_DRM, PROFILE_BUCKET_LA_TOTAL, { PROFILE_BUCKET_LA_PREPROC, NO_BUCKET } },
+	{ "license-postproc", eTRACE_LANE_DRM, PROFILE_BUCKET_LA_TOTAL, { PROFILE_BUCKET_LA_NETWORK, NO_BUCKET } },
+	{ "first-buffer", eTRACE_LANE_PIPELINE, NO_BUCKET, { PROFILE_BUCKET_DECRYPT_VIDEO, PROFILE_BUCKET_FRAGMENT_VIDEO, PROFILE_BUCKET_DECRYPT_AUDIO, PROFILE_BUCKET_FRAGMENT_AUDIO } },
+	{ "first-frame", eTRACE_LANE_PIPELINE, NO_BUCKET, { PROFILE_BUCKET_FIRST_BUFFER, PROFILE_BUCKET_LA_TOTAL, NO_BUCKET } },
+};
+
+/**
+ * @brief Names of trace lanes, indexed by ProfilerTraceLane
+ */
+static const char *gProfilerTraceLaneName[eTRACE_LANE_COUNT] =
+{
+	"manifest", "video", "audio", "drm", "pipeline", "critical-path"
+};
+
+/**
+ * @brief Find the completed dependency of a bucket which finished last, i.e. the one that gated its start
+ * @param[in] type - Bucket type
+ * @retval Gating bucket, PROFILE_BUCKET_TYPE_COUNT if bucket has no completed dependency
+ */
+ProfilerBucketType ProfileEventAAMP::GetCriticalDependency(ProfilerBucketType type)
+{
+	ProfilerBucketType critical = NO_BUCKET;
+	const ProfilerBucketTraceInfo &info = gProfilerBucketTraceInfo[type];
+	for (int i = 0; i < MAX_PROFILER_BUCKET_DEPENDENCIES && info.dependencies[i] != NO_BUCKET; i++)
+	{
+		ProfilerBucketType dep = info.dependencies[i];
+		// a dependency still running when this bucket finished did not gate it
+		if (buckets[dep].complete && buckets[dep].tFinish <= buckets[type].tFinish)
+		{
+			if (critical == NO_BUCKET || buckets[dep].tFinish > buckets[critical].tFinish)
+			{
+				critical = dep;
+			}
+		}
+	}
+	return critical;
+}
+
+/**
+ * @brief Walk dependency edges back from the last completed milestone of the tune
+ * @param[out] path - Buckets on critical path, in tune order
+ * @retval Number of buckets on critical path
+ */
+int ProfileEventAAMP::GetCriticalPath(ProfilerBucketType path[PROFILE_BUCKET_TYPE_COUNT])
+{
+	ProfilerBucketType last = NO_BUCKET;
+	if (buckets[PROFILE_BUCKET_FIRST_FRAME].complete)
+	{
+		last = PROFILE_BUCKET_FIRST_FRAME;
+	}
+	else
+	{ // tune did not reach first frame, end path at the bucket which completed last
+		for (int i = 0; i < PROFILE_BUCKET_TYPE_COUNT; i++)
+		{
+			if (buckets[i].complete && gProfilerBucketTraceInfo[i].parent == NO_BUCKET &&
+				(last == NO_BUCKET || buckets[i].tFinish > buckets[last].tFinish))
+			{
+				last = (ProfilerBucketType)i;
+			}
+		}
+	}
+	int count = 0;
+	for (ProfilerBucketType type = last; type != NO_BUCKET && count < PROFILE_BUCKET_TYPE_COUNT; type = GetCriticalDependency(type))
+	{
+		path[count++] = type;
+	}
+	for (int i = 0; i < count / 2; i++)
+	{
+		ProfilerBucketType tmp = path[i];
+		path[i] = path[count - 1 - i];
+		path[count - 1 - i] = tmp;
+	}
+	return count;
+}
+
+/**
+ * @brief Log critical path of the tune and write it along with all buckets as a chrome trace-event file
+ *
+ * Trace file is named aamp_tune_<tunestartUtcMs>.json and can be loaded in chrome://tracing or perfetto.
+ * Each completed bucket is a complete ("X") event, nested under its parent bucket on the same lane.
+ * Critical path edges are flow events and idle time between consecutive critical buckets is an "idle" event.
+ * @param[in] directory - Directory of trace file, NULL to only log critical path
+ * @param[in] success - Tune status
+ * @param[in] contentType - Content Type
+ * @param[in] streamType - Stream Type
+ */
+void ProfileEventAAMP::WriteTuneTrace(const char *directory, bool success, ContentType contentType, int streamType)
+{
+	ProfilerBucketType path[PROFILE_BUCKET_TYPE_COUNT];
+	int pathLength = GetCriticalPath(path);
+	bool onCriticalPath[PROFILE_BUCKET_TYPE_COUNT] = { false };
+	unsigned int idleTotal = 0;
+	std::string pathStr;
+	for (int i = 0; i < pathLength; i++)
+	{
+		char entry[64];
+		unsigned int idle = 0;
+		if (i > 0 && buckets[path[i]].tStart > buckets[path[i - 1]].tFinish)
+		{
+			idle = buckets[path[i]].tStart - buckets[path[i - 1]].tFinish;
+		}
+		idleTotal += idle;
+		onCriticalPath[path[i]] = true;
+		snprintf(entry, sizeof(entry), "%s%s(%u,%u,%u)", (i ? "," : ""), gProfilerBucketTraceInfo[path[i]].name,
+			idle, buckets[path[i]].tStart, bucketDuration(path[i]));
+		pathStr += entry;
+	}
+	unsigned int pathEnd = pathLength ? buckets[path[pathLength - 1]].tFinish : 0;
+	// name(idle before bucket, start, duration),...
+	logprintf("IP_AAMP_TUNE_CRITICAL_PATH:%u,%u,%s\n", pathEnd, idleTotal, pathStr.c_str());
+
+	if (!directory)
+	{
+		return;
+	}
+	char fileName[MAX_URI_LENGTH];
+	snprintf(fileName, sizeof(fileName), "%s/aamp_tune_%lld.json", directory, tuneStartBaseUTCMS);
+	FILE *f = fopen(fileName, "w");
+	if (!f)
+	{
+		logprintf("%s:%d Unable to open tune trace file %s: %s\n", __FUNCTION__, __LINE__, fileName, strerror(errno));
+		return;
+	}
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\n\"otherData\":{\"tuneStartUtcMs\":%lld,\"success\":%d,\"contentType\":%d,\"streamType\":%d,"
+		"\"criticalPathMs\":%u,\"criticalPathIdleMs\":%u,\"drmErrorCode\":%d},\n\"traceEvents\":[\n",
+		tuneStartBaseUTCMS, success, (int)contentType, streamType, pathEnd, idleTotal, drmErrorCode);
+	fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"aamp tune\"}}");
+	for (int lane = 0; lane < eTRACE_LANE_COUNT; lane++)
+	{
+		fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", lane, gProfilerTraceLaneName[lane]);
+		fprintf(f, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}", lane, lane);
+	}
+	for (int i = 0; i < PROFILE_BUCKET_TYPE_COUNT; i++)
+	{
+		const ProfilerBucketTraceInfo &info = gProfilerBucketTraceInfo[i];
+		if (!buckets[i].complete)
+		{
+			continue;
+		}
+		std::string deps;
+		for (int j = 0; j < MAX_PROFILER_BUCKET_DEPENDENCIES && info.dependencies[j] != NO_BUCKET; j++)
+		{
+			deps += (j ? ",\"" : "\"");
+			deps += gProfilerBucketTraceInfo[info.dependencies[j]].name;
+			deps += "\"";
+		}
+		ProfilerBucketType gate = GetCriticalDependency((ProfilerBucketType)i);
+		fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"tune\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%llu,\"dur\":%llu,"
+			"\"args\":{\"errorCount\":%d,\"parent\":\"%s\",\"dependencies\":[%s],\"gatedBy\":\"%s\",\"critical\":%s}}",
+			info.name, info.lane, buckets[i].tStart * 1000ULL, bucketDuration(i) * 1000ULL,
+			buckets[i].errorCount, (info.parent == NO_BUCKET) ? "" : gProfilerBucketTraceInfo[info.parent].name,
+			deps.c_str(), (gate == NO_BUCKET) ? "" : gProfilerBucketTraceInfo[gate].name,
+			onCriticalPath[i] ? "true" : "false");
+	}
+	for (int i = 0; i < pathLength; i++)
+	{
+		const ProfilerBucket &bucket = buckets[path[i]];
+		fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"critical\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%llu,\"dur\":%llu}",
+			gProfilerBucketTraceInfo[path[i]].name, eTRACE_LANE_CRITICAL_PATH, bucket.tStart * 1000ULL, bucketDuration(path[i]) * 1000ULL);
+		if (i > 0)
+		{
+			const ProfilerBucket &prev = buckets[path[i - 1]];
+			if (bucket.tStart > prev.tFinish)
+			{
+				fprintf(f, ",\n{\"name\":\"idle\",\"cat\":\"critical\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%llu,\"dur\":%llu}",
+					eTRACE_LANE_CRITICAL_PATH, prev.tFinish * 1000ULL, (bucket.tStart - prev.tFinish) * 1000ULL);
+			}
+			fprintf(f, ",\n{\"name\":\"critical\",\"cat\":\"dependency\",\"ph\":\"s\",\"id\":%d,\"pid\":1,\"tid\":%d,\"ts\":%llu}",
+				i, gProfilerBucketTraceInfo[path[i - 1]].lane, prev.tFinish * 1000ULL);
+			fprintf(f, ",\n{\"name\":\"critical\",\"cat\":\"dependency\",\"ph\":\"f\",\"bp\":\"e\",\"id\":%d,\"pid\":1,\"tid\":%d,\"ts\":%llu}",
+				i, gProfilerBucketTraceInfo[path[i]].lane, bucket.tStart * 1000ULL);
+		}
+	}
+	fprintf(f, "\n]}\n");
+	fclose(f);
+	logprintf("%s:%d Tune trace written to %s\n", __FUNCTION__, __LINE__, fileName);
+}
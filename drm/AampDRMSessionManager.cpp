@@ -28,6 +28,8 @@
 #include <pthread.h>
 #include "_base64.h"
 #include <iostream>
+#include <map>
+#include <vector>
 #include <uuid/uuid.h>
 
 //#define LOG_TRACE 1
@@ -47,18 +49,125 @@
 #define COMCAST_DRM_METADATA_TAG_END "</ckm:policy>"
 #define SESSION_TOKEN_URL "http://localhost:50050/authService/getSessionToken"
 #define MAX_LICENSE_REQUEST_ATTEMPTS 2
+#define MAX_IDLE_LICENSE_CLIENTS 2     /**< Idle curl handles kept alive per license server */
 
 static const char *sessionTypeName[] = {"video", "audio"};
-DrmSessionContext AampDRMSessionManager::drmSessionContexts[MAX_DRM_SESSIONS] = {{dataLength : 0, data : NULL, drmSession : NULL}																		,{dataLength : 0, data : NULL, drmSession : NULL}};
-KeyID AampDRMSessionManager::cachedKeyIDs[MAX_DRM_SESSIONS] = {{len : 0, data : NULL, creationTime : 0},{len : 0, data : NULL, creationTime : 0}};
+DrmSessionContext AampDRMSessionManager::drmSessionContexts[MAX_DRM_SESSIONS];
+KeyID AampDRMSessionManager::cachedKeyIDs[MAX_DRM_SESSIONS];
 
 char* AampDRMSessionManager::accessToken = NULL;
 int AampDRMSessionManager::accessTokenLen = 0;
 SessionMgrState AampDRMSessionManager::sessionMgrState = SessionMgrState::eSESSIONMGR_ACTIVE;
 
 static pthread_mutex_t accessTokenMutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t session_mutex[2] = {PTHREAD_MUTEX_INITIALIZER,PTHREAD_MUTEX_INITIALIZER};
+static pthread_mutex_t session_mutex[MAX_DRM_SESSIONS];
+static pthread_once_t sessionMutexInitOnce = PTHREAD_ONCE_INIT;
 static pthread_mutex_t initDataMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t licenseClientMutex = PTHREAD_MUTEX_INITIALIZER;
+static std::map<string, std::vector<CURL *> > licenseClients;
+
+/**
+ *  @brief		Get key identifying license server of a URL, scheme host and port
+ *
+ *  @param[in]	url - URL of license request.
+ *  @return		URL up to the path.
+ */
+static string getLicenseServerKey(const string &url)
+{
+	size_t start = url.find("://");
+	start = (start == string::npos) ? 0 : start + 3;
+	return url.substr(0, url.find('/', start));
+}
+
+/**
+ *  @brief		Take an idle curl handle of license server, or create one.
+ *  			Reused handle keeps its connection, so license requests to a
+ *  			server skip TCP and TLS handshake after the first one.
+ *
+ *  @param[in]	server - License server key from getLicenseServerKey.
+ *  @return		curl handle with default options, NULL on failure.
+ */
+static CURL *acquireLicenseClient(const string &server)
+{
+	CURL *curl = NULL;
+	pthread_mutex_lock(&licenseClientMutex);
+	std::vector<CURL *> &clients = licenseClients[server];
+	if (!clients.empty())
+	{
+		curl = clients.back();
+		clients.pop_back();
+	}
+	pthread_mutex_unlock(&licenseClientMutex);
+	if (curl)
+	{
+		curl_easy_reset(curl);
+	}
+	else
+	{
+		curl = curl_easy_init();
+	}
+	CURLSH *share = aamp_GetCurlShare();
+	if (curl && share)
+	{
+		curl_easy_setopt(curl, CURLOPT_SHARE, share);
+	}
+	return curl;
+}
+
+/**
+ *  @brief		Return curl handle of license server for reuse.
+ *
+ *  @param[in]	server - License server key from getLicenseServerKey.
+ *  @param[in]	curl - Handle taken by acquireLicenseClient.
+ *  @return		void.
+ */
+static void releaseLicenseClient(const string &server, CURL *curl)
+{
+	pthread_mutex_lock(&licenseClientMutex);
+	std::vector<CURL *> &clients = licenseClients[server];
+	if (clients.size() < MAX_IDLE_LICENSE_CLIENTS)
+	{
+		clients.push_back(curl);
+		curl = NULL;
+	}
+	pthread_mutex_unlock(&licenseClientMutex);
+	if (curl)
+	{
+		curl_easy_cleanup(curl);
+	}
+}
+
+/**
+ *  @brief		Initialize mutexes of DRM session cache slots
+ *
+ *  @return		void.
+ */
+static void initSessionMutexes(void)
+{
+	for (int i = 0; i < MAX_DRM_SESSIONS; i++)
+	{
+		pthread_mutex_init(&session_mutex[i], NULL);
+	}
+}
+
+/**
+ *  @brief		Get number of DRM session cache slots in use
+ *
+ *  @return		configured cache size, limited to MIN_DRM_SESSIONS..MAX_DRM_SESSIONS
+ */
+int AampDRMSessionManager::getSessionCacheSize()
+{
+	int cacheSize = gpGlobalConfig->drmSessionCacheSize;
+	if (cacheSize < MIN_DRM_SESSIONS)
+	{
+		cacheSize = MIN_DRM_SESSIONS;
+	}
+	else if (cacheSize > MAX_DRM_SESSIONS)
+	{
+		cacheSize = MAX_DRM_SESSIONS;
+	}
+	return cacheSize;
+}
 
 #ifdef USE_SECCLIENT
 /**
@@ -97,8 +206,11 @@ static string getFormattedLicenseServerURL(string url)
 
 /**
  *  @brief      AampDRMSessionManager constructor.
+ *
+ *  @param[in]	isPrefetch - true if sessions are created ahead of tune, such sessions
+ *  			only take free or other prefetched cache slots and are not profiled.
  */
-AampDRMSessionManager::AampDRMSessionManager()
+AampDRMSessionManager::AampDRMSessionManager(bool isPrefetch) : mIsPrefetch(isPrefetch)
 {
 }
 
@@ -131,6 +243,7 @@ void AampDRMSessionManager::clearSessionData()
 			cachedKeyIDs[i].data = NULL;
 			cachedKeyIDs[i].len = 0;
 		}
+		cachedKeyIDs[i].isPrefetched = false;
 	}
 }
 
@@ -330,6 +443,30 @@ static void mssleep(int milliseconds)
 	}
 }
 
+/**
+ *  @brief		Log timing breakdown of a license request, connect and
+ *  			appconnect are 0 when an existing connection was reused.
+ *  			Format: IP_AAMP_LICENSE_TIMING:attempt,connectionReused,namelookup,connect,appconnect,starttransfer,total
+ *  			with times in milliseconds.
+ *
+ *  @param[in]	curl - Handle of completed license request.
+ *  @param[in]	attempt - License request attempt.
+ *  @return		void.
+ */
+static void logLicenseTiming(CURL *curl, unsigned int attempt)
+{
+	double nameLookupTime = 0, connectTime = 0, appConnectTime = 0, startTransferTime = 0, totalTime = 0;
+	long connects = 0;
+	curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME, &nameLookupTime);
+	curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &connectTime);
+	curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME, &appConnectTime);
+	curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &startTransferTime);
+	curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &totalTime);
+	curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+	logprintf("IP_AAMP_LICENSE_TIMING:%u,%d,%.1f,%.1f,%.1f,%.1f,%.1f\n", attempt, (connects == 0),
+			nameLookupTime * 1000, connectTime * 1000, appConnectTime * 1000, startTransferTime * 1000, totalTime * 1000);
+}
+
 /**
  *  @brief		Get DRM license key from DRM server.
  *
@@ -354,7 +491,14 @@ DrmData * AampDRMSessionManager::getLicense(DrmData * keyChallenge,
 	DrmData * keyInfo = new DrmData();
 	const long challegeLength = keyChallenge->getDataLength();
 	char* destURL = new char[destinationURL.length() + 1];
-	curl = curl_easy_init();
+	string licenseServer = getLicenseServerKey(destinationURL);
+	curl = acquireLicenseClient(licenseServer);
+	if (!curl)
+	{
+		logprintf("%s:%d Failed to create curl handle for license request\n", __FUNCTION__, __LINE__);
+		delete[] destURL;
+		return keyInfo;
+	}
 	if(isComcastStream)
 	{
 		headers = curl_slist_append(headers, COMCAST_LICENCE_REQUEST_HEADER_ACCEPT);
@@ -392,6 +536,7 @@ DrmData * AampDRMSessionManager::getLicense(DrmData * keyChallenge,
 	{
 		attemptCount++;
 		res = curl_easy_perform(curl);
+		logLicenseTiming(curl, attemptCount);
 		if (res != CURLE_OK)
 		{
 			logprintf("%s:%d curl_easy_perform() failed: %s\n", __FUNCTION__, __LINE__, curl_easy_strerror(res));
@@ -431,7 +576,7 @@ DrmData * AampDRMSessionManager::getLicense(DrmData * keyChallenge,
 
 	delete destURL;
 	curl_slist_free_all(headers);
-	curl_easy_cleanup(curl);
+	releaseLicenseClient(licenseServer, curl);
 	return keyInfo;
 }
 
@@ -710,10 +855,12 @@ AampDrmSession * AampDRMSessionManager::createDrmSession(
 
 /**
  *  @brief		Creates and/or returns the DRM session corresponding to keyId (Present in initDataPtr)
- *  			AampDRMSession manager has two static AampDrmSession objects.
+ *  			AampDRMSession manager keeps a cache of drmSessionCacheSize static AampDrmSession objects.
  *  			This method will return the existing DRM session pointer if any one of these static
- *  			DRM session objects are created against requested keyId. Binds the oldest DRM Session
- *  			with new keyId if no matching keyId is found in existing sessions.
+ *  			DRM session objects are created against requested keyId and its license has not expired.
+ *  			Binds a free or the least recently used DRM Session with new keyId if no matching keyId
+ *  			is found in existing sessions. A prefetching session manager binds only free or
+ *  			prefetched sessions, so that sessions in use by a tune are never evicted.
  *
  *  @param[in]	systemId - UUID of the DRM system.
  *  @param[in]	initDataPtr - Pointer to PSSH data.
@@ -741,6 +888,12 @@ AampDrmSession * AampDRMSessionManager::createDrmSession(
 	int keyIdLen = 0;
 	string destinationURL;
 	DrmData * key = NULL;
+	ProfileEventAAMP prefetchProfiler;
+	ProfileEventAAMP &profiler = mIsPrefetch ? prefetchProfiler : aamp->profiler;
+	if (mIsPrefetch)
+	{
+		prefetchProfiler.TuneBegin();
+	}
 
 	if(gpGlobalConfig->logging.debug)
 	{
@@ -754,19 +907,12 @@ AampDrmSession * AampDRMSessionManager::createDrmSession(
 	e->data.dash_drmmetadata.accessStatus = "accessAttributeStatus";
         e->data.dash_drmmetadata.accessStatus_value = 3;
 
-	if(eMEDIATYPE_AUDIO == streamType)
-	{
-		sessionType = AUDIO_SESSION;
-	}
-	else if (eMEDIATYPE_VIDEO == streamType)
-	{
-		sessionType = VIDEO_SESSION;
-	}
-	else
+	if((eMEDIATYPE_AUDIO != streamType) && (eMEDIATYPE_VIDEO != streamType))
 	{
 		e->data.dash_drmmetadata.failure = AAMP_TUNE_UNSUPPORTED_STREAM_TYPE;
 		return NULL;
 	}
+	pthread_once(&sessionMutexInitOnce, initSessionMutexes);
 
 	const char *keySystem = NULL;
 	bool isWidevine = false;
@@ -814,49 +960,93 @@ AampDrmSession * AampDRMSessionManager::createDrmSession(
 		pthread_mutex_unlock(&initDataMutex);
 		return NULL;
 	}
-	/*Check if audio/video session for keyid already exists or is in progress of being created
-	*Else clear oldest session and create new one
+	/*Check if a session for keyid already exists or is in progress of being created
+	*Else bind a free or the least recently used session to it
 	*/
-	int otherSession = (sessionType + 1) % 2;
-	bool sessionFound = true;
-	if (keyIdLen == cachedKeyIDs[otherSession].len && 0 == memcmp(cachedKeyIDs[otherSession].data, keyId, keyIdLen))
+	int cacheSize = getSessionCacheSize();
+	long long now = aamp_GetCurrentTimeMS();
+	bool sessionFound = false;
+	bool licenseExpired = false;
+	bool prefetchedSession = false;
+	for (int i = 0; i < cacheSize; i++)
 	{
-		if(gpGlobalConfig->logging.debug)
+		if (keyIdLen == cachedKeyIDs[i].len && 0 == memcmp(cachedKeyIDs[i].data, keyId, keyIdLen))
 		{
-			logprintf("%s:%d %s session (created/inprogress) with same keyID %s, can reuse same for %s\n",
-					__FUNCTION__, __LINE__, sessionTypeName[otherSession], keyId, sessionTypeName[sessionType]);
+			if(gpGlobalConfig->logging.debug)
+			{
+				logprintf("%s:%d session %d (created/inprogress) with same keyID %s, can reuse same for %s\n",
+						__FUNCTION__, __LINE__, i, keyId, sessionTypeName[streamType]);
+			}
+			sessionType = i;
+			sessionFound = true;
+			prefetchedSession = cachedKeyIDs[i].isPrefetched;
+			if (!mIsPrefetch)
+			{
+				cachedKeyIDs[i].isPrefetched = false;
+			}
+			break;
 		}
-		sessionType = otherSession;
 	}
-	else if(!(keyIdLen == cachedKeyIDs[sessionType].len && 0 == memcmp(cachedKeyIDs[sessionType].data, keyId, keyIdLen)))
+	if (sessionFound && gpGlobalConfig->drmSessionCacheExpirySeconds > 0 && !cachedKeyIDs[sessionType].isFailedKeyId
+			&& (now - cachedKeyIDs[sessionType].creationTime) > (gpGlobalConfig->drmSessionCacheExpirySeconds * 1000LL))
 	{
-		logprintf("%s:%d No active session found with keyId %s, proceeding to create new session\n", __FUNCTION__, __LINE__, keyId);
+		logprintf("%s:%d License of keyId %s acquired %lld ms back has expired, proceeding to acquire again\n",
+				__FUNCTION__, __LINE__, keyId, now - cachedKeyIDs[sessionType].creationTime);
+		licenseExpired = true;
 		sessionFound = false;
+		cachedKeyIDs[sessionType].creationTime = now;
+	}
+	else if (!sessionFound)
+	{
+		logprintf("%s:%d No active session found with keyId %s, proceeding to create new session\n", __FUNCTION__, __LINE__, keyId);
 		/*
-		 * Check if both sessions have valid KeyIDs
-		 * if yes proceed to clear the oldest session
+		 * Pick a free session, else clear the least recently used session.
+		 * Prefetch may clear only sessions which were prefetched and not used by a tune yet
 		 */
-		if(cachedKeyIDs[otherSession].creationTime < cachedKeyIDs[sessionType].creationTime)
+		sessionType = -1;
+		for (int i = 0; i < cacheSize; i++)
+		{
+			if (cachedKeyIDs[i].data == NULL)
+			{
+				sessionType = i;
+				break;
+			}
+			if (mIsPrefetch && !cachedKeyIDs[i].isPrefetched)
+			{
+				continue;
+			}
+			if (sessionType < 0 || cachedKeyIDs[i].lastAccessTime < cachedKeyIDs[sessionType].lastAccessTime)
+			{
+				sessionType = i;
+			}
+		}
+		if (sessionType < 0)
 		{
-			sessionType = otherSession;
+			logprintf("%s:%d No session available for prefetch of keyId %s, skipping\n", __FUNCTION__, __LINE__, keyId);
+			free(keyId);
+			pthread_mutex_unlock(&initDataMutex);
+			return NULL;
 		}
 
 		if(cachedKeyIDs[sessionType].data != NULL)
 		{
+			logprintf("%s:%d Evicting session %d\n", __FUNCTION__, __LINE__, sessionType);
 			delete cachedKeyIDs[sessionType].data;
 		}
 		
 		cachedKeyIDs[sessionType].len = keyIdLen;
 		cachedKeyIDs[sessionType].isFailedKeyId = false;
+		cachedKeyIDs[sessionType].isPrefetched = mIsPrefetch;
 		cachedKeyIDs[sessionType].data = new unsigned char[keyIdLen];
 		memcpy(reinterpret_cast<void*>(cachedKeyIDs[sessionType].data),
         reinterpret_cast<const void*>(keyId), keyIdLen);
-		cachedKeyIDs[sessionType].creationTime = aamp_GetCurrentTimeMS();
+		cachedKeyIDs[sessionType].creationTime = now;
 	}
+	cachedKeyIDs[sessionType].lastAccessTime = now;
 	pthread_mutex_unlock(&initDataMutex);
 
 	pthread_mutex_lock(&session_mutex[sessionType]);
-	aamp->profiler.ProfileBegin(PROFILE_BUCKET_LA_PREPROC);
+	profiler.ProfileBegin(PROFILE_BUCKET_LA_PREPROC);
 	//logprintf("%s:%d Locked session mutex for %s\n", __FUNCTION__, __LINE__, sessionTypeName[sessionType]);
 	if(drmSessionContexts[sessionType].drmSession == NULL)
 	{
@@ -870,21 +1060,25 @@ AampDrmSession * AampDRMSessionManager::createDrmSession(
 	}
 	else
 	{
-			if(keyIdLen == drmSessionContexts[sessionType].dataLength)
+			if(!licenseExpired && keyIdLen == drmSessionContexts[sessionType].dataLength)
 			{
 				if ((0 == memcmp(drmSessionContexts[sessionType].data, keyId, keyIdLen))
 						&& (drmSessionContexts[sessionType].drmSession->getState()
 								== KEY_READY))
 				{
-					AAMPLOG_INFO("%s:%d Found drm session READY with same keyID %s - Reusing drm session for %s\n",
-								__FUNCTION__, __LINE__, keyId, sessionTypeName[streamType]);
+					AAMPLOG_INFO("%s:%d Found drm session READY with same keyID %s - Reusing %sdrm session for %s\n",
+								__FUNCTION__, __LINE__, keyId, prefetchedSession ? "prefetched " : "", sessionTypeName[streamType]);
+					profiler.ProfileDrmSessionLookup(true);
 					pthread_mutex_unlock(&session_mutex[sessionType]);
 					free(keyId);
 					return drmSessionContexts[sessionType].drmSession;
 				}
 			}
 
-			if(sessionFound && NULL == contentMetadataPtr)
+			/*
+			 * Failure of a prefetch is not held against the tune, it tries again
+			 */
+			if(sessionFound && !(prefetchedSession && !mIsPrefetch) && NULL == contentMetadataPtr)
 			{
 				AAMPLOG_INFO("%s:%d Aborting session creation for keyId %s: StreamType %s, since previous try failed\n",
 								__FUNCTION__, __LINE__, keyId, sessionTypeName[streamType]);
@@ -896,6 +1090,7 @@ AampDrmSession * AampDRMSessionManager::createDrmSession(
 			drmSessionContexts[sessionType].drmSession->clearDecryptContext();
 	}
 
+	profiler.ProfileDrmSessionLookup(false);
 	if(drmSessionContexts[sessionType].drmSession)
 	{
 		code = drmSessionContexts[sessionType].drmSession->getState();
@@ -926,7 +1121,7 @@ AampDrmSession * AampDRMSessionManager::createDrmSession(
 	code = drmSessionContexts[sessionType].drmSession->getState();
 	if (code == KEY_PENDING)
 	{
-		aamp->profiler.ProfileEnd(PROFILE_BUCKET_LA_PREPROC);
+		profiler.ProfileEnd(PROFILE_BUCKET_LA_PREPROC);
 		//license request logic here
 		if (gpGlobalConfig->logging.debug)
 		{
@@ -1058,7 +1253,7 @@ AampDrmSession * AampDRMSessionManager::createDrmSession(
 				}
 			}
 			isComcastStream = true;
-			aamp->profiler.ProfileBegin(PROFILE_BUCKET_LA_NETWORK);
+			profiler.ProfileBegin(PROFILE_BUCKET_LA_NETWORK);
 #ifdef USE_SECCLIENT
 			const char *mediaUsage = "stream";
 
@@ -1142,13 +1337,13 @@ AampDrmSession * AampDRMSessionManager::createDrmSession(
 				destinationURL = string(externLicenseServerURL);
 			}
 			logprintf("%s:%d License request ready for %s stream\n", __FUNCTION__, __LINE__, sessionTypeName[streamType]);
-			aamp->profiler.ProfileBegin(PROFILE_BUCKET_LA_NETWORK);
+			profiler.ProfileBegin(PROFILE_BUCKET_LA_NETWORK);
 			key = getLicense(licenceChallenge, destinationURL, &responseCode ,isComcastStream);
 		}
 
 		if(key != NULL && key->getDataLength() != 0)
 		{
-			aamp->profiler.ProfileEnd(PROFILE_BUCKET_LA_NETWORK);
+			profiler.ProfileEnd(PROFILE_BUCKET_LA_NETWORK);
 			if(isComcastStream)
 			{
 #ifndef USE_SECCLIENT
@@ -1176,13 +1371,13 @@ AampDrmSession * AampDRMSessionManager::createDrmSession(
 				cout << endl;
 #endif
 			}
-			aamp->profiler.ProfileBegin(PROFILE_BUCKET_LA_POSTPROC);
+			profiler.ProfileBegin(PROFILE_BUCKET_LA_POSTPROC);
 			drmSessionContexts[sessionType].drmSession->aampDRMProcessKey(key);
-			aamp->profiler.ProfileEnd(PROFILE_BUCKET_LA_POSTPROC);
+			profiler.ProfileEnd(PROFILE_BUCKET_LA_POSTPROC);
 		}
 		else
 		{
-			aamp->profiler.ProfileError(PROFILE_BUCKET_LA_NETWORK);
+			profiler.ProfileError(PROFILE_BUCKET_LA_NETWORK);
 			logprintf("%s:%d Could not get license from server for %s stream\n", __FUNCTION__, __LINE__, sessionTypeName[streamType]);
 			if(412 == responseCode)
 			{
@@ -1216,7 +1411,7 @@ AampDrmSession * AampDRMSessionManager::createDrmSession(
 	{
 		logprintf("%s:%d Error in getting license challenge for %s stream : Key State %d \n",
 					__FUNCTION__, __LINE__, sessionTypeName[streamType], code);
-		aamp->profiler.ProfileError(PROFILE_BUCKET_LA_PREPROC);
+		profiler.ProfileError(PROFILE_BUCKET_LA_PREPROC);
 		e->data.dash_drmmetadata.failure = AAMP_TUNE_DRM_CHALLENGE_FAILED;
 	}
 
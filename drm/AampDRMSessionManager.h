@@ -36,9 +36,8 @@
 #include "sec_client.h"
 #endif
 
-#define MAX_DRM_SESSIONS 2
-#define VIDEO_SESSION 0
-#define AUDIO_SESSION 1
+#define MAX_DRM_SESSIONS 16            /**< Capacity of DRM session cache, used size is drmSessionCacheSize */
+#define MIN_DRM_SESSIONS 2             /**< Sessions needed for audio and video of different key IDs */
 #define KEYID_TAG_START "<KID>"
 #define KEYID_TAG_END "</KID>"
 
@@ -63,7 +62,9 @@ struct KeyID
 	size_t len;
 	unsigned char* data;
 	long long creationTime;
+	long long lastAccessTime;
 	bool isFailedKeyId;
+	bool isPrefetched;             /**< Bound ahead of tune by license prefetch, not used by a tune yet */
 };
 
 /**
@@ -92,11 +93,12 @@ private:
 	static char* accessToken;
 	static int accessTokenLen;
 	static SessionMgrState sessionMgrState;
+	bool mIsPrefetch;
 public:
 
 	void initializeDrmSessions();
 
-	AampDRMSessionManager();
+	AampDRMSessionManager(bool isPrefetch = false);
 
 	~AampDRMSessionManager();
 
@@ -117,6 +119,8 @@ public:
 	static void setSessionMgrState(SessionMgrState state);
 
 	static const char* getAccessToken(int *tokenLength);
+
+	static int getSessionCacheSize();
 };
 
 unsigned char * _extractDataFromPssh(const char* psshData, int dataLength,
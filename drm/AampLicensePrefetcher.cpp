@@ -0,0 +1,396 @@
+/*
+ * If not stated otherwise in this file or this component's license file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2018 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+* @file AampLicensePrefetcher.cpp
+* @brief Acquires DRM licenses of DASH manifests likely to be tuned next
+*/
+
+#include "AampLicensePrefetcher.h"
+#include "AampDRMSessionManager.h"
+#include "priv_aamp.h"
+#include "_base64.h"
+#include <libxml/xmlreader.h>
+#include <algorithm>
+
+#define PREFETCH_PLAYREADY_SYSTEM_ID "9a04f079-9840-4286-ab92-e65be0885f95"
+#define PREFETCH_WIDEVINE_SYSTEM_ID "edef8ba9-79d6-4ace-a3c8-27dcd51d21ed"
+#define PREFETCH_COMCAST_DRM_INFO_ID "afbcb50e-bf74-3d13-be8f-13930c783962"
+
+/**
+ *  @struct	PrefetchPssh
+ *  @brief	PSSH data of a ContentProtection element
+ */
+struct PrefetchPssh
+{
+	std::string pssh;       /**< Base64 encoded PSSH */
+	bool isWidevine;        /**< true for Widevine, false for PlayReady */
+	MediaType mediaType;    /**< Type of adaptation set */
+};
+
+/**
+ *  @brief		Read an attribute of current element of reader
+ *
+ *  @param[in]	reader - XML reader positioned at an element.
+ *  @param[in]	name - Attribute name.
+ *  @return		attribute value, empty if not present.
+ */
+static std::string prefetch_GetAttribute(xmlTextReaderPtr reader, const char *name)
+{
+	std::string value;
+	xmlChar *attr = xmlTextReaderGetAttribute(reader, (const xmlChar *)name);
+	if (attr)
+	{
+		value = (const char *)attr;
+		xmlFree(attr);
+	}
+	return value;
+}
+
+/**
+ *  @brief      AampLicensePrefetcher constructor.
+ */
+AampLicensePrefetcher::AampLicensePrefetcher(PrivateInstanceAAMP *aamp, int maxConcurrentRequests) :
+		mAamp(aamp), mMutex(), mCond(), mPending(), mWorkers(), mMaxWorkers(std::min(maxConcurrentRequests, MAX_LICENSE_PREFETCH_CONCURRENCY)),
+		mWorkersStarted(0), mSessionsLeft(0), mStop(false)
+{
+	pthread_mutex_init(&mMutex, NULL);
+	pthread_cond_init(&mCond, NULL);
+}
+
+/**
+ *  @brief      AampLicensePrefetcher destructor.
+ */
+AampLicensePrefetcher::~AampLicensePrefetcher()
+{
+	Stop();
+	pthread_cond_destroy(&mCond);
+	pthread_mutex_destroy(&mMutex);
+}
+
+/**
+ *  @brief		Queue manifests for license acquisition.
+ *  			Number of manifests and of DRM sessions they create is limited to
+ *  			the DRM session cache slots left after reserving audio and video
+ *  			sessions of the current tune.
+ *
+ *  @param[in]	manifestUrls - URLs of manifests in order of likelihood.
+ *  @return		void.
+ */
+void AampLicensePrefetcher::Prefetch(const std::vector<std::string> &manifestUrls)
+{
+	size_t maxManifests = (size_t)(AampDRMSessionManager::getSessionCacheSize() - MIN_DRM_SESSIONS);
+
+	pthread_mutex_lock(&mMutex);
+	if (mStop)
+	{
+		pthread_mutex_unlock(&mMutex);
+		return;
+	}
+	mPending.clear();
+	mSessionsLeft = (int)maxManifests;
+	for (size_t i = 0; i < manifestUrls.size(); i++)
+	{
+		if (mPending.size() >= maxManifests)
+		{
+			logprintf("%s:%d Session cache allows %d manifests, ignoring %d\n", __FUNCTION__, __LINE__,
+					(int)maxManifests, (int)(manifestUrls.size() - i));
+			break;
+		}
+		if (!manifestUrls[i].empty() && std::find(mPending.begin(), mPending.end(), manifestUrls[i]) == mPending.end())
+		{
+			mPending.push_back(manifestUrls[i]);
+		}
+	}
+	while ((int)mWorkers.size() < mMaxWorkers && mWorkers.size() < mPending.size())
+	{
+		pthread_t worker;
+		if (0 != pthread_create(&worker, NULL, PrefetchThread, this))
+		{
+			logprintf("%s:%d pthread_create failed for license prefetch thread\n", __FUNCTION__, __LINE__);
+			break;
+		}
+		mWorkers.push_back(worker);
+	}
+	pthread_cond_broadcast(&mCond);
+	pthread_mutex_unlock(&mMutex);
+}
+
+/**
+ *  @brief		Drop queued manifests and join worker threads.
+ *
+ *  @return		void.
+ */
+void AampLicensePrefetcher::Stop()
+{
+	pthread_mutex_lock(&mMutex);
+	mStop = true;
+	mPending.clear();
+	pthread_cond_broadcast(&mCond);
+	pthread_mutex_unlock(&mMutex);
+	for (size_t i = 0; i < mWorkers.size(); i++)
+	{
+		pthread_join(mWorkers[i], NULL);
+	}
+	mWorkers.clear();
+}
+
+/**
+ *  @brief		Thread entry of prefetch workers.
+ *
+ *  @param[in]	arg - AampLicensePrefetcher instance.
+ *  @return		NULL.
+ */
+void *AampLicensePrefetcher::PrefetchThread(void *arg)
+{
+	if(aamp_pthread_setname(pthread_self(), "aampLicPrefetch"))
+	{
+		logprintf("%s:%d: pthread_setname_np failed\n", __FUNCTION__, __LINE__);
+	}
+	((AampLicensePrefetcher *)arg)->Run();
+	return NULL;
+}
+
+/**
+ *  @brief		Worker loop, processes queued manifests till stopped.
+ *
+ *  @return		void.
+ */
+void AampLicensePrefetcher::Run()
+{
+	pthread_mutex_lock(&mMutex);
+	unsigned int curlInstance = AAMP_LICENSE_PREFETCH_CURL_START + mWorkersStarted++;
+	pthread_mutex_unlock(&mMutex);
+	mAamp->CurlInit(curlInstance, 1);
+
+	pthread_mutex_lock(&mMutex);
+	while (!mStop)
+	{
+		if (mPending.empty())
+		{
+			pthread_cond_wait(&mCond, &mMutex);
+			continue;
+		}
+		std::string url = mPending.front();
+		mPending.pop_front();
+		pthread_mutex_unlock(&mMutex);
+
+		std::string manifest;
+		if (FetchManifest(url, curlInstance, manifest))
+		{
+			ProcessManifest(url, manifest);
+		}
+
+		pthread_mutex_lock(&mMutex);
+	}
+	pthread_mutex_unlock(&mMutex);
+	mAamp->CurlTerm(curlInstance, 1);
+}
+
+/**
+ *  @brief		Download a manifest the way the player downloads manifests, i.e.
+ *  			with its custom headers, cookies and proxy, on a curl instance of
+ *  			the worker so that transfers of the player are not disturbed.
+ *
+ *  @param[in]	url - Manifest URL.
+ *  @param[in]	curlInstance - Curl instance of the worker.
+ *  @param[out]	manifest - Downloaded manifest.
+ *  @return		true on success.
+ */
+bool AampLicensePrefetcher::FetchManifest(const std::string &url, unsigned int curlInstance, std::string &manifest)
+{
+	GrowableBuffer buffer;
+	char effectiveUrl[MAX_URI_LENGTH];
+	long httpCode = -1;
+	memset(&buffer, 0, sizeof(buffer));
+	bool ret = mAamp->GetFile(url.c_str(), &buffer, effectiveUrl, &httpCode, NULL, curlInstance, true, eMEDIATYPE_MANIFEST);
+	if (ret && buffer.len)
+	{
+		manifest.assign(buffer.ptr, buffer.len);
+	}
+	aamp_Free(&buffer.ptr);
+	if (!ret || manifest.empty())
+	{
+		logprintf("%s:%d Prefetch of manifest %s failed; http %ld\n", __FUNCTION__, __LINE__, url.c_str(), httpCode);
+		return false;
+	}
+	return true;
+}
+
+/**
+ *  @brief		Take a DRM session cache slot for a license of a manifest.
+ *  			Licenses beyond the slots left are not requested, they would
+ *  			evict each other before the manifest is tuned.
+ *
+ *  @param[in]	url - Manifest URL, for logging.
+ *  @return		true if license can be requested.
+ */
+bool AampLicensePrefetcher::ReserveSession(const std::string &url)
+{
+	bool reserved = false;
+	pthread_mutex_lock(&mMutex);
+	if (!mStop && mSessionsLeft > 0)
+	{
+		mSessionsLeft--;
+		reserved = true;
+	}
+	else if (!mStop)
+	{
+		logprintf("%s:%d DRM session cache of %d is full, skipping license of %s\n", __FUNCTION__, __LINE__,
+				AampDRMSessionManager::getSessionCacheSize(), url.c_str());
+	}
+	pthread_mutex_unlock(&mMutex);
+	return reserved;
+}
+
+/**
+ *  @brief		Extract PSSH data of a manifest and create DRM sessions for it.
+ *  			DRM system is selected the same way as tune does, preferring
+ *  			Widevine only if configured or if PlayReady is not signalled.
+ *
+ *  @param[in]	url - Manifest URL, for logging.
+ *  @param[in]	manifest - Manifest text.
+ *  @return		void.
+ */
+void AampLicensePrefetcher::ProcessManifest(const std::string &url, const std::string &manifest)
+{
+	std::vector<PrefetchPssh> psshList;
+	std::string contentMetadataPssh;
+	bool hasWidevine = false;
+	bool hasPlayready = false;
+
+	xmlTextReaderPtr reader = xmlReaderForMemory(manifest.data(), (int)manifest.size(), NULL, NULL, 0);
+	if (reader == NULL)
+	{
+		logprintf("%s:%d Failed to parse manifest %s\n", __FUNCTION__, __LINE__, url.c_str());
+		return;
+	}
+	MediaType mediaType = eMEDIATYPE_VIDEO;
+	std::string schemeIdUri;
+	int protectionDepth = -1;
+	while (xmlTextReaderRead(reader) == 1)
+	{
+		if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT)
+		{
+			continue;
+		}
+		const char *name = (const char *)xmlTextReaderConstLocalName(reader);
+		int depth = xmlTextReaderDepth(reader);
+		if (protectionDepth >= 0 && depth <= protectionDepth)
+		{
+			protectionDepth = -1;
+		}
+		if (!strcmp(name, "AdaptationSet"))
+		{
+			std::string type = prefetch_GetAttribute(reader, "contentType") + prefetch_GetAttribute(reader, "mimeType");
+			mediaType = (type.find("audio") != std::string::npos) ? eMEDIATYPE_AUDIO : eMEDIATYPE_VIDEO;
+		}
+		else if (!strcmp(name, "ContentProtection"))
+		{
+			schemeIdUri = prefetch_GetAttribute(reader, "schemeIdUri");
+			std::transform(schemeIdUri.begin(), schemeIdUri.end(), schemeIdUri.begin(), ::tolower);
+			protectionDepth = depth;
+		}
+		else if (protectionDepth >= 0 && !strcmp(name, "pssh"))
+		{
+			xmlChar *text = xmlTextReaderReadString(reader);
+			if (text)
+			{
+				std::string pssh = (const char *)text;
+				xmlFree(text);
+				if (schemeIdUri.find(PREFETCH_COMCAST_DRM_INFO_ID) != std::string::npos)
+				{
+					contentMetadataPssh = pssh;
+				}
+				else if (schemeIdUri.find(PREFETCH_WIDEVINE_SYSTEM_ID) != std::string::npos
+						|| schemeIdUri.find(PREFETCH_PLAYREADY_SYSTEM_ID) != std::string::npos)
+				{
+					PrefetchPssh entry;
+					entry.pssh = pssh;
+					entry.isWidevine = (schemeIdUri.find(PREFETCH_WIDEVINE_SYSTEM_ID) != std::string::npos);
+					entry.mediaType = mediaType;
+					hasWidevine |= entry.isWidevine;
+					hasPlayready |= !entry.isWidevine;
+					psshList.push_back(entry);
+				}
+			}
+			protectionDepth = -1;
+		}
+	}
+	xmlFreeTextReader(reader);
+
+	if (psshList.empty())
+	{
+		AAMPLOG_INFO("%s:%d No ContentProtection found in %s\n", __FUNCTION__, __LINE__, url.c_str());
+		return;
+	}
+
+	bool useWidevine = hasWidevine && ((DRMSystems)gpGlobalConfig->preferredDrm == eDRM_WideVine || !hasPlayready);
+	unsigned char *contentMetadata = NULL;
+	if (!contentMetadataPssh.empty())
+	{
+		size_t dataLength = 0;
+		unsigned char *data = base64_Decode(contentMetadataPssh.c_str(), &dataLength);
+		if (data && dataLength != 0)
+		{
+			int contentMetadataLen = 0;
+			contentMetadata = _extractWVContentMetadataFromPssh((const char*)data, dataLength, &contentMetadataLen);
+		}
+		free(data);
+	}
+
+	AampDRMSessionManager sessionManager(true);
+	std::vector<std::string> processed;
+	for (size_t i = 0; i < psshList.size(); i++)
+	{
+		if (psshList[i].isWidevine != useWidevine
+				|| std::find(processed.begin(), processed.end(), psshList[i].pssh) != processed.end())
+		{
+			continue;
+		}
+		if (!ReserveSession(url))
+		{
+			break;
+		}
+		processed.push_back(psshList[i].pssh);
+
+		size_t dataLength = 0;
+		unsigned char *data = base64_Decode(psshList[i].pssh.c_str(), &dataLength);
+		if (data == NULL || dataLength == 0 || dataLength > UINT16_MAX)
+		{
+			free(data);
+			continue;
+		}
+		AAMPEvent e;
+		e.type = AAMP_EVENT_DRM_METADATA;
+		e.data.dash_drmmetadata.failure = AAMP_TUNE_FAILURE_UNKNOWN;
+		long long startTime = aamp_GetCurrentTimeMS();
+		AampDrmSession *drmSession = sessionManager.createDrmSession(
+				useWidevine ? PREFETCH_WIDEVINE_SYSTEM_ID : PREFETCH_PLAYREADY_SYSTEM_ID,
+				data, (uint16_t)dataLength, psshList[i].mediaType, contentMetadata, mAamp, &e);
+		logprintf("%s:%d License prefetch for %s %s in %lld ms, failure %d\n", __FUNCTION__, __LINE__, url.c_str(),
+				drmSession ? "ready" : "failed", aamp_GetCurrentTimeMS() - startTime,
+				drmSession ? 0 : (int)e.data.dash_drmmetadata.failure);
+		free(data);
+	}
+	if (contentMetadata)
+	{
+		free(contentMetadata);
+	}
+}
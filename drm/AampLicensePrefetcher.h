@@ -0,0 +1,95 @@
+/*
+ * If not stated otherwise in this file or this component's license file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2018 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+* @file AampLicensePrefetcher.h
+* @brief Acquires DRM licenses of DASH manifests likely to be tuned next
+*/
+
+#ifndef AampLicensePrefetcher_h
+#define AampLicensePrefetcher_h
+
+#include <pthread.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+class PrivateInstanceAAMP;
+
+/**
+ *  @class	AampLicensePrefetcher
+ *  @brief	Warms DRM session cache with licenses of upcoming manifests.
+ *
+ *  Worker threads fetch queued manifests, extract PSSH data of their
+ *  ContentProtection elements and create DRM sessions through a prefetching
+ *  AampDRMSessionManager. A later tune of the same content finds the session
+ *  ready and skips license acquisition. Prefetched sessions never evict
+ *  sessions in use by a tune.
+ */
+class AampLicensePrefetcher
+{
+public:
+	/**
+	 * @brief AampLicensePrefetcher Constructor
+	 * @param aamp player instance on whose behalf licenses are requested
+	 * @param maxConcurrentRequests number of manifests processed in parallel
+	 */
+	AampLicensePrefetcher(PrivateInstanceAAMP *aamp, int maxConcurrentRequests);
+
+	/**
+	 * @brief AampLicensePrefetcher Destructor, stops worker threads
+	 */
+	~AampLicensePrefetcher();
+
+	/**
+	 * @brief Queue manifests for license acquisition, replaces manifests not yet picked up
+	 * @param manifestUrls URLs of manifests in order of likelihood
+	 */
+	void Prefetch(const std::vector<std::string> &manifestUrls);
+
+	/**
+	 * @brief Drop queued manifests and join worker threads
+	 *
+	 * Manifest transfers in progress complete or are aborted along with other
+	 * downloads of the player, a license request in progress is allowed to
+	 * complete.
+	 */
+	void Stop();
+
+private:
+	AampLicensePrefetcher(const AampLicensePrefetcher&) = delete;
+	AampLicensePrefetcher& operator=(const AampLicensePrefetcher&) = delete;
+	static void *PrefetchThread(void *arg);
+	void Run();
+	bool FetchManifest(const std::string &url, unsigned int curlInstance, std::string &manifest);
+	void ProcessManifest(const std::string &url, const std::string &manifest);
+	bool ReserveSession(const std::string &url);
+
+	PrivateInstanceAAMP *mAamp;
+	pthread_mutex_t mMutex;
+	pthread_cond_t mCond;
+	std::deque<std::string> mPending;
+	std::vector<pthread_t> mWorkers;
+	int mMaxWorkers;
+	int mWorkersStarted;       /**< Workers started so far, each worker owns a curl instance */
+	int mSessionsLeft;         /**< DRM sessions the current manifest list may still create */
+	bool mStop;
+};
+
+#endif
@@ -30,6 +30,8 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <errno.h>
+#include <list>
+#include <string>
 
 
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
@@ -38,35 +40,109 @@
 #define OPEN_SSL_CONTEXT &mOpensslCtx
 #endif
 #define AES_128_KEY_LEN_BYTES 16
+#define AES_128_BLOCK_LEN_BYTES 16
 
-static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+/**
+ * @struct AesKeyCacheEntry
+ * @brief Key of a key URI, shared by AesDec instances of a player
+ */
+struct AesKeyCacheEntry
+{
+	PrivateInstanceAAMP *aamp;                      /**< Player the key is acquired for*/
+	std::string uri;                                /**< Key URI from EXT-X-KEY*/
+	unsigned char key[AES_128_KEY_LEN_BYTES];       /**< Key, valid in eDRM_KEY_ACQUIRED state*/
+	DRMState state;                                 /**< eDRM_ACQUIRING_KEY, eDRM_KEY_ACQUIRED or eDRM_KEY_FAILED*/
+	long long lastUseMs;                            /**< Time of last use, for eviction*/
+};
+
+static pthread_mutex_t gKeyCacheMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gKeyCacheCond = PTHREAD_COND_INITIALIZER;
+static std::list<AesKeyCacheEntry> gKeyCache;
 
 
 /**
- * @brief Signal key acquired to listener
- * @param arg drm status listener
- * @retval 0
+ * @brief Find key cache entry of a key URI, gKeyCacheMutex to be held by caller
+ * @param aamp player the key is acquired for
+ * @param uri key URI
+ * @retval cache entry, NULL if not found
  */
-static int drmSignalKeyAquired(void * arg)
+static AesKeyCacheEntry* FindKeyUnlocked(PrivateInstanceAAMP *aamp, const char *uri)
 {
-	AesDec * aesDec = (AesDec*)arg;
-	aesDec->SignalKeyAcquired();
-	return 0;
+	for (std::list<AesKeyCacheEntry>::iterator it = gKeyCache.begin(); it != gKeyCache.end(); ++it)
+	{
+		if (it->aamp == aamp && it->uri == uri)
+		{
+			return &(*it);
+		}
+	}
+	return NULL;
 }
 
 
 /**
- * @brief Signal drm error to listener
- * @param arg drm status listener
- * @retval 0
+ * @brief Add key cache entry for a key URI, gKeyCacheMutex to be held by caller
+ *
+ * Least recently used key is evicted when cache is full, keys still being
+ * acquired are never evicted.
+ * @param aamp player the key is acquired for
+ * @param uri key URI
+ * @retval new cache entry
  */
-static int drmSignalError(void * arg)
+static AesKeyCacheEntry* AddKeyUnlocked(PrivateInstanceAAMP *aamp, const char *uri)
 {
-	AesDec * aesDec = (AesDec*)arg;
-	aesDec->SignalDrmError();
-	return 0;
+	if (gKeyCache.size() >= AES_KEY_CACHE_SIZE)
+	{
+		std::list<AesKeyCacheEntry>::iterator oldest = gKeyCache.end();
+		for (std::list<AesKeyCacheEntry>::iterator it = gKeyCache.begin(); it != gKeyCache.end(); ++it)
+		{
+			if ((it->state != eDRM_ACQUIRING_KEY) && ((oldest == gKeyCache.end()) || (it->lastUseMs < oldest->lastUseMs)))
+			{
+				oldest = it;
+			}
+		}
+		if (oldest != gKeyCache.end())
+		{
+			AAMPLOG_INFO("%s:%d evicting key of %s\n", __FUNCTION__, __LINE__, oldest->uri.c_str());
+			gKeyCache.erase(oldest);
+		}
+	}
+	AesKeyCacheEntry entry;
+	entry.aamp = aamp;
+	entry.uri = uri;
+	memset(entry.key, 0, sizeof(entry.key));
+	entry.state = eDRM_ACQUIRING_KEY;
+	entry.lastUseMs = NOW_STEADY_TS_MS;
+	gKeyCache.push_back(entry);
+	return &gKeyCache.back();
 }
 
+
+/**
+ * @brief Check and clear PKCS7 padding of a decrypted payload
+ *
+ * Padding is cleared so that payload is followed by zeros as before.
+ * @param data decrypted payload
+ * @param len length of data, multiple of cipher block size
+ * @param[out] padLen number of padding bytes
+ * @retval true if padding is valid
+ */
+static bool ClearPadding(unsigned char *data, size_t len, size_t &padLen)
+{
+	unsigned char lastByte = data[len - 1];
+	bool validPadding = (lastByte > 0) && (lastByte <= AES_128_BLOCK_LEN_BYTES);
+	for (int i = 1; validPadding && i <= lastByte; i++)
+	{
+		validPadding = (data[len - i] == lastByte);
+	}
+	if (validPadding)
+	{
+		padLen = lastByte;
+		memset(data + len - padLen, 0, padLen);
+	}
+	return validPadding;
+}
+
+
 /**
  * @brief key acquistion thread
  * @param arg AesDec pointer
@@ -97,40 +173,15 @@ void AesDec::NotifyDRMError(AAMPTuneFailure drmFailure)
 	{
 		mpAamp->SendErrorEvent(drmFailure);
 	}
-
-	PrivateInstanceAAMP::AddIdleTask(drmSignalError, this);
-	logprintf("AesDec::NotifyDRMError: drmState:%d\n", mDrmState );
+	logprintf("AesDec::NotifyDRMError: drmFailure:%d\n", (int)drmFailure);
 }
 
 
 /**
- * @brief Signal drm error
- */
-void AesDec::SignalDrmError()
-{
-	pthread_mutex_lock(&mMutex);
-	mDrmState = eDRM_KEY_FAILED;
-	pthread_cond_broadcast(&mCond);
-	pthread_mutex_unlock(&mMutex);
-}
-
-
-/**
- * @brief Signal key acquired event
- */
-void AesDec::SignalKeyAcquired()
-{
-	logprintf("aamp:AesDRMListener %s drmState:%d moving to KeyAcquired\n", __FUNCTION__, mDrmState);
-	pthread_mutex_lock(&mMutex);
-	mDrmState = eDRM_KEY_ACQUIRED;
-	pthread_cond_broadcast(&mCond);
-	pthread_mutex_unlock(&mMutex);
-	mpAamp->LogDrmInitComplete();
-}
-
-
-/**
- * @brief Acquire drm key from URI
+ * @brief Acquire drm keys of queued key URIs, runs in key acquisition thread
+ *
+ * Each result is published to the key cache, waking up decryptors of all tracks
+ * waiting for the key. Thread exits once no key request of this decryptor is left.
  */
 void AesDec::AcquireKey()
 {
@@ -140,34 +191,61 @@ void AesDec::AcquireKey()
 	{
 		logprintf("%s:%d: pthread_setname_np failed\n", __FUNCTION__, __LINE__);
 	}
-	logprintf("%s:%d: Key acquisition start uri = %s\n", __FUNCTION__, __LINE__, mDrmInfo.uri);
-	bool fetched = mpAamp->GetFile(mDrmInfo.uri, &mAesKeyBuf, tempEffectiveUrl, &http_error, NULL, mCurlInstance, true, eMEDIATYPE_LICENCE);
-	if (fetched)
+	pthread_mutex_lock(&gKeyCacheMutex);
+	while (!mKeyRequests.empty())
 	{
-		if (AES_128_KEY_LEN_BYTES == mAesKeyBuf.len)
+		std::string uri = mKeyRequests.front();
+		mKeyRequests.pop_front();
+		pthread_mutex_unlock(&gKeyCacheMutex);
+
+		GrowableBuffer aesKeyBuf;
+		bool keyAcquired = false;
+		memset(&aesKeyBuf, 0, sizeof(aesKeyBuf));
+		logprintf("%s:%d: Key acquisition start uri = %s\n", __FUNCTION__, __LINE__, uri.c_str());
+		bool fetched = mpAamp->GetFile(uri.c_str(), &aesKeyBuf, tempEffectiveUrl, &http_error, NULL, mCurlInstance, true, eMEDIATYPE_LICENCE);
+		if (fetched)
 		{
-			logprintf("%s:%d: Key fetch success len = %d\n", __FUNCTION__, __LINE__, (int)mAesKeyBuf.len);
-			mDrmState = eDRM_KEY_ACQUIRED;
-
-			PrivateInstanceAAMP::AddIdleTask(drmSignalKeyAquired, this);
+			if (AES_128_KEY_LEN_BYTES == aesKeyBuf.len)
+			{
+				logprintf("%s:%d: Key fetch success len = %d\n", __FUNCTION__, __LINE__, (int)aesKeyBuf.len);
+				keyAcquired = true;
+			}
+			else
+			{
+				logprintf("%s:%d: Error Key fetch - size %d\n", __FUNCTION__, __LINE__, (int)aesKeyBuf.len);
+			}
 		}
 		else
 		{
-			logprintf("%s:%d: Error Key fetch - size %d\n", __FUNCTION__, __LINE__, (int)mAesKeyBuf.len);
-			mDrmState = eDRM_KEY_FAILED;
-			aamp_Free(&mAesKeyBuf.ptr);
+			logprintf("%s:%d: Key fetch failed\n", __FUNCTION__, __LINE__);
 		}
+		pthread_mutex_lock(&gKeyCacheMutex);
+		AesKeyCacheEntry *entry = FindKeyUnlocked(mpAamp, uri.c_str());
+		if (entry)
+		{
+			if (keyAcquired)
+			{
+				memcpy(entry->key, aesKeyBuf.ptr, AES_128_KEY_LEN_BYTES);
+			}
+			entry->state = keyAcquired ? eDRM_KEY_ACQUIRED : eDRM_KEY_FAILED;
+			entry->lastUseMs = NOW_STEADY_TS_MS;
+		}
+		pthread_cond_broadcast(&gKeyCacheCond);
+		pthread_mutex_unlock(&gKeyCacheMutex);
+		aamp_Free(&aesKeyBuf.ptr);
+		if (keyAcquired)
+		{
+			mpAamp->LogDrmInitComplete();
+		}
+		else if (mpAamp->DownloadsAreEnabled())
+		{
+			NotifyDRMError(AAMP_TUNE_FAILED_TO_GET_KEYID);
+		}
+		pthread_mutex_lock(&gKeyCacheMutex);
 	}
-	else
-	{
-		mDrmState = eDRM_KEY_FAILED;
-		logprintf("%s:%d: Key fetch failed\n", __FUNCTION__, __LINE__);
-	}
-	if(eDRM_KEY_FAILED == mDrmState)
-	{
-		aamp_Free(&mAesKeyBuf.ptr);
-		NotifyDRMError(AAMP_TUNE_FAILED_TO_GET_KEYID);
-	}
+	// RequestKey starts a new thread from here on, this one is reaped by it or by Release
+	mKeyThreadRunning = false;
+	pthread_mutex_unlock(&gKeyCacheMutex);
 }
 
 
@@ -193,143 +271,294 @@ DrmReturn AesDec::SetMetaData( PrivateInstanceAAMP *aamp, void* metadata)
  */
 DrmReturn AesDec::SetDecryptInfo( PrivateInstanceAAMP *aamp, const struct DrmInfo *drmInfo)
 {
-	DrmReturn err = eDRM_ERROR;
-	pthread_t licenceAcquistionThreadId;
-	pthread_mutex_lock(&mMutex);
-	if (mDrmState == eDRM_ACQUIRING_KEY )
+	DrmReturn err = eDRM_SUCCESS;
+	if (!drmInfo->uri)
 	{
-		logprintf("AesDec::%s:%d acquiring key in progress\n",__FUNCTION__, __LINE__);
-		WaitForKeyAcquireCompleteUnlocked(20*1000, err);
+		logprintf("AesDec::%s:%d no key uri\n", __FUNCTION__, __LINE__);
+		return eDRM_ERROR;
 	}
+	pthread_mutex_lock(&mMutex);
 	mpAamp = aamp;
-	mDrmInfo = *drmInfo;
-
-	if (mDrmUrl)
+	if (drmInfo->iv)
+	{
+		memcpy(mIv, drmInfo->iv, AES_128_BLOCK_LEN_BYTES);
+	}
+	else
+	{
+		memset(mIv, 0, sizeof(mIv));
+	}
+	bool sameUrl = mDrmUrl && (0 == strcmp(mDrmUrl, drmInfo->uri));
+	if (!sameUrl)
 	{
-		if ((eDRM_KEY_ACQUIRED == mDrmState) && (0 == strcmp(mDrmUrl, drmInfo->uri)))
-		{
-			logprintf("AesDec::%s:%d same url:%s - not acquiring key\n",__FUNCTION__, __LINE__, mDrmUrl);
-			pthread_mutex_unlock(&mMutex);
-			return eDRM_SUCCESS;
-		}
 		free(mDrmUrl);
+		mDrmUrl = strdup(drmInfo->uri);
 	}
-	mDrmUrl = strdup(drmInfo->uri);
-	mDrmState = eDRM_ACQUIRING_KEY;
-	if (-1 == mCurlInstance)
+	pthread_mutex_unlock(&mMutex);
+	if (!sameUrl)
 	{
-		mCurlInstance = AAMP_TRACK_COUNT;
-		aamp->CurlInit(mCurlInstance, 1);
+		AAMPLOG_INFO("AesDec::%s:%d key uri changed to %s\n", __FUNCTION__, __LINE__, drmInfo->uri);
 	}
+	// cheap when key is cached, and re-requests a key whose acquisition failed
+	err = RequestKey(drmInfo->uri);
+	return err;
+}
 
-	int ret = pthread_create(&licenceAcquistionThreadId, NULL, acquire_key, this);
-	if(ret != 0)
+/**
+ * @brief Start acquisition of key of a key URI unless cache has it
+ *
+ * A key being acquired for another track is not requested again, a failed
+ * key is requested again. Never waits for an earlier key request: while the
+ * key thread of this decryptor is busy, uri is queued for it.
+ * @param uri key URI
+ * @retval eDRM_SUCCESS if key is cached, being acquired or acquisition is started
+ */
+DrmReturn AesDec::RequestKey(const char *uri)
+{
+	DrmReturn err = eDRM_SUCCESS;
+	pthread_mutex_lock(&gKeyCacheMutex);
+	AesKeyCacheEntry *entry = FindKeyUnlocked(mpAamp, uri);
+	if (entry && (eDRM_KEY_FAILED != entry->state))
 	{
-		logprintf("AesDec::%s:%d pthread_create failed for acquire_key with errno = %d, %s\n", __FUNCTION__, __LINE__, errno, strerror(errno));
-		mDrmState = eDRM_KEY_FAILED;
+		entry->lastUseMs = NOW_STEADY_TS_MS;
+		AAMPLOG_TRACE("AesDec::%s:%d key of %s %s\n", __FUNCTION__, __LINE__, uri,
+			(eDRM_KEY_ACQUIRED == entry->state) ? "cached" : "being acquired");
+		pthread_mutex_unlock(&gKeyCacheMutex);
+		return err;
 	}
-	else
+	if (!entry)
 	{
-		ret = pthread_detach(licenceAcquistionThreadId);
+		entry = AddKeyUnlocked(mpAamp, uri);
+	}
+	entry->state = eDRM_ACQUIRING_KEY;
+	mKeyRequests.push_back(uri);
+	bool queued = mKeyThreadRunning;
+	if (!mKeyThreadRunning)
+	{
+		if (mKeyThreadStarted)
+		{
+			// previous key thread has left its loop and only returns, join does not block
+			pthread_join(mKeyThreadId, NULL);
+			mKeyThreadStarted = false;
+		}
+		mpAamp->CurlInit(mCurlInstance, 1);
+		int ret = pthread_create(&mKeyThreadId, NULL, acquire_key, this);
 		if(ret != 0)
 		{
-			logprintf("AesDec::%s:%d pthread_detach failed for acquire_key with errno = %d, %s\n", __FUNCTION__, __LINE__, errno, strerror(errno));
+			logprintf("AesDec::%s:%d pthread_create failed for acquire_key with errno = %d, %s\n", __FUNCTION__, __LINE__, errno, strerror(errno));
+			mKeyRequests.clear();
+			entry->state = eDRM_KEY_FAILED;
+			pthread_cond_broadcast(&gKeyCacheCond);
+			err = eDRM_ERROR;
+		}
+		else
+		{
+			mKeyThreadStarted = true;
+			mKeyThreadRunning = true;
 		}
-		err = eDRM_SUCCESS;
 	}
-	pthread_mutex_unlock(&mMutex);
-	AAMPLOG_INFO("AesDec::%s:%d drmState:%d \n",__FUNCTION__, __LINE__, mDrmState);
+	pthread_mutex_unlock(&gKeyCacheMutex);
+	AAMPLOG_INFO("AesDec::%s:%d key acquisition of %s %s\n",__FUNCTION__, __LINE__, uri,
+		queued ? "queued" : ((eDRM_SUCCESS == err) ? "started" : "failed"));
 	return err;
 }
 
+
 /**
- * @brief Wait for key acquisition completion
- * @param[in] timeInMs timeout
- * @param[out] err error on failure
+ * @brief Get key of a key URI from key cache
+ * @param uri key URI
+ * @param[out] key 16 byte key
+ * @param timeInMs time to wait if key acquisition is in progress, 0 to not wait
+ * @retval eDRM_SUCCESS if key of uri is available
+ * @retval eDRM_KEY_ACQUSITION_TIMEOUT if key acquisition is still in progress
  */
-void AesDec::WaitForKeyAcquireCompleteUnlocked(int timeInMs, DrmReturn &err )
+DrmReturn AesDec::GetKey(const char *uri, unsigned char *key, int timeInMs)
 {
+	DrmReturn err = eDRM_ERROR;
 	struct timespec ts;
-	struct timeval tv;
-	AAMPLOG_INFO( "aamp:waiting for key acquisition to complete,wait time:%d\n",timeInMs );
-	gettimeofday(&tv, NULL);
-	ts.tv_sec = time(NULL) + timeInMs / 1000;
-	ts.tv_nsec = (long)(tv.tv_usec * 1000 + 1000 * 1000 * (timeInMs % 1000));
-	ts.tv_sec += ts.tv_nsec / (1000 * 1000 * 1000);
-	ts.tv_nsec %= (1000 * 1000 * 1000);
+	bool timedWait = false;
+	if (!uri)
+	{
+		return err;
+	}
+	pthread_mutex_lock(&gKeyCacheMutex);
+	while (true)
+	{
+		AesKeyCacheEntry *entry = FindKeyUnlocked(mpAamp, uri);
+		if (!entry || (eDRM_KEY_FAILED == entry->state) || mKeyWaitCancelled)
+		{
+			err = eDRM_ERROR;
+			break;
+		}
+		if (eDRM_KEY_ACQUIRED == entry->state)
+		{
+			memcpy(key, entry->key, AES_128_KEY_LEN_BYTES);
+			entry->lastUseMs = NOW_STEADY_TS_MS;
+			err = eDRM_SUCCESS;
+			break;
+		}
+		if (timeInMs <= 0)
+		{
+			err = eDRM_KEY_ACQUSITION_TIMEOUT;
+			break;
+		}
+		if (!timedWait)
+		{
+			struct timeval tv;
+			AAMPLOG_INFO( "aamp:waiting for key acquisition to complete,wait time:%d\n",timeInMs );
+			gettimeofday(&tv, NULL);
+			ts.tv_sec = time(NULL) + timeInMs / 1000;
+			ts.tv_nsec = (long)(tv.tv_usec * 1000 + 1000 * 1000 * (timeInMs % 1000));
+			ts.tv_sec += ts.tv_nsec / (1000 * 1000 * 1000);
+			ts.tv_nsec %= (1000 * 1000 * 1000);
+			timedWait = true;
+		}
+		if (0 != pthread_cond_timedwait(&gKeyCacheCond, &gKeyCacheMutex, &ts))
+		{
+			logprintf("AesDec::%s:%d wait for key acquisition timed out\n", __FUNCTION__, __LINE__);
+			err = eDRM_KEY_ACQUSITION_TIMEOUT;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&gKeyCacheMutex);
+	return err;
+}
+
+
+/**
+ * @brief Drop cached key of a key URI that failed to decrypt, so that it is acquired again
+ *
+ * Entry is kept if it no longer holds the failed key, e.g. key was acquired again meanwhile.
+ * @param uri key URI
+ * @param key key that failed to decrypt
+ */
+void AesDec::EvictKey(const char *uri, const unsigned char *key)
+{
+	if (!uri)
+	{
+		return;
+	}
+	pthread_mutex_lock(&gKeyCacheMutex);
+	for (std::list<AesKeyCacheEntry>::iterator it = gKeyCache.begin(); it != gKeyCache.end(); ++it)
+	{
+		if (it->aamp == mpAamp && it->uri == uri)
+		{
+			if ((eDRM_KEY_ACQUIRED == it->state) && (0 == memcmp(it->key, key, AES_128_KEY_LEN_BYTES)))
+			{
+				logprintf("AesDec::%s:%d evicting key of %s after decrypt failure\n", __FUNCTION__, __LINE__, uri);
+				gKeyCache.erase(it);
+			}
+			break;
+		}
+	}
+	pthread_mutex_unlock(&gKeyCacheMutex);
+}
+
 
-	if(0 != pthread_cond_timedwait(&mCond, &mMutex, &ts)) // block until drm ready
+/**
+ * @brief Drop all cached keys of a player, on stop
+ *
+ * Keys are kept across tunes of the player; a key that no longer decrypts,
+ * e.g. rotated or revoked, is evicted by the decryptor and acquired again.
+ *
+ * Key requests of the player are expected to be complete, i.e. its AesDec instances released.
+ * @param aamp player
+ */
+void AesDec::ClearKeyCache(PrivateInstanceAAMP *aamp)
+{
+	pthread_mutex_lock(&gKeyCacheMutex);
+	std::list<AesKeyCacheEntry>::iterator it = gKeyCache.begin();
+	while (it != gKeyCache.end())
 	{
-		logprintf("AesDec::%s:%d wait for key acquisition timed out\n", __FUNCTION__, __LINE__);
-		err = eDRM_KEY_ACQUSITION_TIMEOUT;
+		if (it->aamp == aamp)
+		{
+			it = gKeyCache.erase(it);
+		}
+		else
+		{
+			++it;
+		}
 	}
+	pthread_cond_broadcast(&gKeyCacheCond);
+	pthread_mutex_unlock(&gKeyCacheMutex);
 }
 
 
 /**
- * @brief Decrypts an encrypted buffer
+ * @brief Decrypts an encrypted buffer in place
+ *
+ * The cipher context of the decryptor is set up with the key once and only
+ * gets a new IV per fragment. EVP picks AES-NI/ARMv8 crypto extensions when
+ * the CPU has them. Padding is checked and cleared here, since EVP can
+ * decrypt in place only when it does not hold back the last block.
  * @param bucketType Type of bucket for profiling
- * @param encryptedDataPtr pointer to encyrpted payload
+ * @param encryptedDataPtr pointer to encyrpted payload, replaced by decrypted payload
  * @param encryptedDataLen length in bytes of data pointed to by encryptedDataPtr
  * @param timeInMs wait time
  */
 DrmReturn AesDec::Decrypt( ProfilerBucketType bucketType, void *encryptedDataPtr, size_t encryptedDataLen,int timeInMs)
 {
-	DrmReturn err = eDRM_ERROR;
-
+	unsigned char key[AES_128_KEY_LEN_BYTES];
 	pthread_mutex_lock(&mMutex);
-	if (mDrmState == eDRM_ACQUIRING_KEY )
+	DrmReturn err = GetKey(mDrmUrl, key, timeInMs);
+	if (eDRM_SUCCESS != err)
 	{
-		WaitForKeyAcquireCompleteUnlocked(timeInMs, err);
+		logprintf( "AesDec::%s:%d:key acquisition failure! err = %d\n",  __FUNCTION__, __LINE__, (int)err);
 	}
-	if (mDrmState == eDRM_KEY_ACQUIRED)
+	else
 	{
+		err = eDRM_ERROR;
 		AAMPLOG_INFO("AesDec::%s:%d Starting decrypt\n", __FUNCTION__, __LINE__);
-		unsigned char *decryptedDataBuf = (unsigned char *)malloc(encryptedDataLen);
-		int decryptedDataLen = 0;
-		if (decryptedDataBuf)
+		unsigned char *data = (unsigned char *)encryptedDataPtr;
+		int decLen = 0;
+		long long startTimeUs = NOW_STEADY_TS_US;
+		mpAamp->LogDrmDecryptBegin(bucketType);
+		bool keyChanged = !mCtxKeyValid || (0 != memcmp(mCtxKey, key, AES_128_KEY_LEN_BYTES));
+		if (keyChanged && !EVP_DecryptInit_ex(OPEN_SSL_CONTEXT, EVP_aes_128_cbc(), NULL, key, mIv))
+		{
+			logprintf( "AesDec::%s:%d: EVP_DecryptInit_ex failed\n",  __FUNCTION__, __LINE__);
+			mCtxKeyValid = false;
+		}
+		else if (!keyChanged && !EVP_DecryptInit_ex(OPEN_SSL_CONTEXT, NULL, NULL, NULL, mIv))
+		{
+			logprintf( "AesDec::%s:%d: EVP_DecryptInit_ex(iv) failed\n",  __FUNCTION__, __LINE__);
+			mCtxKeyValid = false;
+		}
+		else
 		{
-			int decLen = encryptedDataLen;
-			memset(decryptedDataBuf, 0, encryptedDataLen);
-			mpAamp->LogDrmDecryptBegin(bucketType);
-			if(!EVP_DecryptInit_ex(OPEN_SSL_CONTEXT, EVP_aes_128_cbc(), NULL, (unsigned char*)mAesKeyBuf.ptr, mDrmInfo.iv))
+			if (keyChanged)
 			{
-				logprintf( "AesDec::%s:%d: EVP_DecryptInit_ex failed mDrmState = %d\n",  __FUNCTION__, __LINE__, (int)mDrmState);
+				EVP_CIPHER_CTX_set_padding(OPEN_SSL_CONTEXT, 0);
+				memcpy(mCtxKey, key, AES_128_KEY_LEN_BYTES);
+				mCtxKeyValid = true;
+			}
+			if ((0 == encryptedDataLen) || (encryptedDataLen % AES_128_BLOCK_LEN_BYTES))
+			{
+				logprintf("AesDec::%s:%d: invalid encryptedDataLen %d\n", __FUNCTION__, __LINE__, (int) encryptedDataLen);
+			}
+			else if (!EVP_DecryptUpdate(OPEN_SSL_CONTEXT, data, &decLen, data, encryptedDataLen))
+			{
+				logprintf("AesDec::%s:%d: EVP_DecryptUpdate failed\n", __FUNCTION__, __LINE__);
 			}
 			else
 			{
-				if (!EVP_DecryptUpdate(OPEN_SSL_CONTEXT, decryptedDataBuf, &decLen, (const unsigned char*) encryptedDataPtr,
-				        encryptedDataLen))
+				size_t padLen = 0;
+				if (!ClearPadding(data, encryptedDataLen, padLen))
 				{
-					logprintf("AesDec::%s:%d: EVP_DecryptUpdate failed mDrmState = %d\n", __FUNCTION__, __LINE__, (int) mDrmState);
+					logprintf("AesDec::%s:%d: invalid padding\n", __FUNCTION__, __LINE__);
+					// likely a rotated or revoked key
+					EvictKey(mDrmUrl, key);
 				}
 				else
 				{
-					decryptedDataLen = decLen;
-					decLen = 0;
-					AAMPLOG_INFO("AesDec::%s:%d: EVP_DecryptUpdate success decryptedDataLen = %d encryptedDataLen %d\n", __FUNCTION__, __LINE__, (int) decryptedDataLen, (int)encryptedDataLen);
-					if (!EVP_DecryptFinal_ex(OPEN_SSL_CONTEXT, decryptedDataBuf + decryptedDataLen, &decLen))
-					{
-						logprintf("AesDec::%s:%d: EVP_DecryptFinal_ex failed mDrmState = %d\n", __FUNCTION__, __LINE__,
-						        (int) mDrmState);
-					}
-					else
-					{
-						decryptedDataLen += decLen;
-						AAMPLOG_INFO("AesDec::%s:%d decrypt success\n", __FUNCTION__, __LINE__);
-						err = eDRM_SUCCESS;
-					}
+					long long decryptTimeUs = NOW_STEADY_TS_US - startTimeUs;
+					AAMPLOG_INFO("AesDec::%s:%d decrypt success decryptedDataLen = %d encryptedDataLen %d in %lld us (%.1f MB/s)\n",
+						__FUNCTION__, __LINE__, (int) (encryptedDataLen - padLen), (int) encryptedDataLen, decryptTimeUs,
+						decryptTimeUs ? ((double)encryptedDataLen / decryptTimeUs) : 0.0);
+					err = eDRM_SUCCESS;
 				}
 			}
-			mpAamp->LogDrmDecryptEnd(bucketType);
-
-			memcpy(encryptedDataPtr, decryptedDataBuf, encryptedDataLen);
-			free(decryptedDataBuf);
 		}
-	}
-	else
-	{
-		logprintf( "AesDec::%s:%d:key acquisition failure! mDrmState = %d\n",  __FUNCTION__, __LINE__, (int)mDrmState);
+		mpAamp->LogDrmDecryptEnd(bucketType);
 	}
 	pthread_mutex_unlock(&mMutex);
 	return err;
@@ -337,18 +566,17 @@ DrmReturn AesDec::Decrypt( ProfilerBucketType bucketType, void *encryptedDataPtr
 
 
 /**
- * @brief Release drm session
+ * @brief Release drm session, waits for key requests of this decryptor to complete
+ *
+ * Called on teardown of the track, the key thread is reaped here.
  */
 void AesDec::Release()
 {
-	DrmReturn err = eDRM_ERROR;
-	pthread_mutex_lock(&mMutex);
-	if (mDrmState == eDRM_ACQUIRING_KEY )
+	if (mKeyThreadStarted)
 	{
-		WaitForKeyAcquireCompleteUnlocked(20*1000, err);
+		pthread_join(mKeyThreadId, NULL);
+		mKeyThreadStarted = false;
 	}
-	pthread_cond_broadcast(&mCond);
-	pthread_mutex_unlock(&mMutex);
 }
 
 
@@ -358,13 +586,10 @@ void AesDec::Release()
  */
 void AesDec::CancelKeyWait()
 {
-	pthread_mutex_lock(&mMutex);
-	//save the current state in case required to restore later.
-	mPrevDrmState = mDrmState;
-	//required for demuxed assets where the other track might be waiting on mMutex lock.
-	mDrmState = eDRM_KEY_FLUSH;
-	pthread_cond_broadcast(&mCond);
-	pthread_mutex_unlock(&mMutex);
+	pthread_mutex_lock(&gKeyCacheMutex);
+	mKeyWaitCancelled = true;
+	pthread_cond_broadcast(&gKeyCacheCond);
+	pthread_mutex_unlock(&gKeyCacheMutex);
 }
 
 
@@ -374,67 +599,240 @@ void AesDec::CancelKeyWait()
  */
 void AesDec::RestoreKeyState()
 {
-	pthread_mutex_lock(&mMutex);
-	//In case somebody overwritten mDrmState before restore operation, keep that state
-	if (mDrmState == eDRM_KEY_FLUSH)
-	{
-		mDrmState = mPrevDrmState;
-	}
-	pthread_mutex_unlock(&mMutex);
+	pthread_mutex_lock(&gKeyCacheMutex);
+	mKeyWaitCancelled = false;
+	pthread_mutex_unlock(&gKeyCacheMutex);
 }
 
 
-AesDec* AesDec::mInstance = nullptr;
-
+/**
+ * @brief AesDec Constructor
+ * @param curlInstance curl instance used to fetch keys
+ */
+AesDec::AesDec(int curlInstance) : mpAamp(nullptr), mCtxKeyValid(false), mDrmUrl(nullptr), mKeyRequests(),
+		mKeyThreadId(), mKeyThreadStarted(false), mKeyThreadRunning(false), mKeyWaitCancelled(false), mCurlInstance(curlInstance)
+{
+	pthread_mutex_init(&mMutex, NULL);
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	OPEN_SSL_CONTEXT = EVP_CIPHER_CTX_new();
+#else
+	EVP_CIPHER_CTX_init(OPEN_SSL_CONTEXT);
+#endif
+	memset(mCtxKey, 0, sizeof(mCtxKey));
+	memset(mIv, 0, sizeof(mIv));
+}
 
 
 /**
- * @brief Get singleton instance
+ * @brief AesDec Destructor
  */
-AesDec* AesDec::GetInstance()
+AesDec::~AesDec()
 {
-	pthread_mutex_lock(&mutex);
-	if (nullptr == mInstance)
+	Release();
+	if (mpAamp)
 	{
-		mInstance = new AesDec();
+		mpAamp->CurlTerm(mCurlInstance, 1);
 	}
-	pthread_mutex_unlock(&mutex);
-	return mInstance;
+	pthread_mutex_destroy(&mMutex);
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	EVP_CIPHER_CTX_free(OPEN_SSL_CONTEXT);
+#else
+	EVP_CIPHER_CTX_cleanup(OPEN_SSL_CONTEXT);
+#endif
+	free(mDrmUrl);
 }
 
+
 /**
- * @brief AesDec Constructor
- * @retval
+ * @brief AesStreamDecryptor Constructor
  */
-AesDec::AesDec() : mpAamp(nullptr), mDrmState(eDRM_INITIALIZED),
-		mPrevDrmState(eDRM_INITIALIZED), mDrmUrl(nullptr)
+AesStreamDecryptor::AesStreamDecryptor() : mpAamp(nullptr), mAesDec(nullptr), mUri(nullptr),
+		mKeyValid(false), mCipherStarted(false), mDecryptedLen(0), mDecryptTimeUs(0)
 {
-	pthread_cond_init(&mCond, NULL);
-	pthread_mutex_init(&mMutex, NULL);
-	memset( &mDrmInfo, 0 , sizeof(DrmInfo));
-	mCurlInstance = -1;
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
 	OPEN_SSL_CONTEXT = EVP_CIPHER_CTX_new();
 #else
 	EVP_CIPHER_CTX_init(OPEN_SSL_CONTEXT);
 #endif
+	memset(mIv, 0, sizeof(mIv));
+	memset(mKey, 0, sizeof(mKey));
 }
 
 
 /**
- * @brief AesDec Destructor
+ * @brief AesStreamDecryptor Destructor
  */
-AesDec::~AesDec()
+AesStreamDecryptor::~AesStreamDecryptor()
 {
-	if (mpAamp && (-1 != mCurlInstance))
-	{
-		mpAamp->CurlTerm(mCurlInstance, 1);
-	}
-	pthread_mutex_destroy(&mMutex);
-	pthread_cond_destroy(&mCond);
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
 	EVP_CIPHER_CTX_free(OPEN_SSL_CONTEXT);
 #else
 	EVP_CIPHER_CTX_cleanup(OPEN_SSL_CONTEXT);
 #endif
+	free(mUri);
+}
+
+
+/**
+ * @brief Prepare for decrypt of a fragment
+ * @param aamp AAMP instance
+ * @param aesDec decryptor acquiring key of the fragment
+ * @param drmInfo key URI and IV of the fragment
+ * @retval true on success
+ */
+bool AesStreamDecryptor::Init(PrivateInstanceAAMP *aamp, AesDec *aesDec, const struct DrmInfo *drmInfo)
+{
+	mpAamp = aamp;
+	mAesDec = aesDec;
+	if (!mUri || !drmInfo->uri || (0 != strcmp(mUri, drmInfo->uri)))
+	{
+		free(mUri);
+		mUri = drmInfo->uri ? strdup(drmInfo->uri) : nullptr;
+	}
+	if (drmInfo->iv)
+	{
+		memcpy(mIv, drmInfo->iv, AES_128_BLOCK_LEN_BYTES);
+	}
+	else
+	{
+		memset(mIv, 0, sizeof(mIv));
+	}
+	Restart();
+	return (nullptr != mUri);
+}
+
+
+/**
+ * @brief Discard progress, called before each download attempt
+ */
+void AesStreamDecryptor::Restart()
+{
+	mCipherStarted = false;
+	mDecryptedLen = 0;
+	mDecryptTimeUs = 0;
+}
+
+
+/**
+ * @brief Set up cipher context with key and IV of the fragment
+ *
+ * Full init is done only when key changes, else only IV is reset.
+ * @param timeInMs time to wait for key, 0 to not wait
+ * @param[out] err error on failure
+ * @retval true if cipher is ready
+ */
+bool AesStreamDecryptor::StartCipher(int timeInMs, DrmReturn &err)
+{
+	unsigned char key[AES_128_KEY_LEN_BYTES];
+	err = mAesDec ? mAesDec->GetKey(mUri, key, timeInMs) : eDRM_ERROR;
+	if (eDRM_SUCCESS == err)
+	{
+		bool keyChanged = !mKeyValid || (0 != memcmp(mKey, key, AES_128_KEY_LEN_BYTES));
+		if (keyChanged && !EVP_DecryptInit_ex(OPEN_SSL_CONTEXT, EVP_aes_128_cbc(), NULL, key, mIv))
+		{
+			logprintf("AesStreamDecryptor::%s:%d: EVP_DecryptInit_ex failed\n", __FUNCTION__, __LINE__);
+			mKeyValid = false;
+			err = eDRM_ERROR;
+		}
+		else if (!keyChanged && !EVP_DecryptInit_ex(OPEN_SSL_CONTEXT, NULL, NULL, NULL, mIv))
+		{
+			logprintf("AesStreamDecryptor::%s:%d: EVP_DecryptInit_ex(iv) failed\n", __FUNCTION__, __LINE__);
+			mKeyValid = false;
+			err = eDRM_ERROR;
+		}
+		else
+		{
+			if (keyChanged)
+			{
+				EVP_CIPHER_CTX_set_padding(OPEN_SSL_CONTEXT, 0);
+				memcpy(mKey, key, AES_128_KEY_LEN_BYTES);
+				mKeyValid = true;
+			}
+			mCipherStarted = true;
+		}
+	}
+	return mCipherStarted;
+}
+
+
+/**
+ * @brief Decrypt in place the whole cipher blocks received so far
+ *
+ * CBC chaining across calls is kept by the cipher context. Nothing is
+ * decrypted until key is acquired, the backlog is decrypted on the first
+ * call after that.
+ * @param data start of the downloaded data
+ * @param len bytes downloaded so far
+ * @retval number of bytes from start of data that are decrypted
+ */
+size_t AesStreamDecryptor::DecryptAvailable(unsigned char *data, size_t len)
+{
+	DrmReturn err;
+	if ((mCipherStarted || StartCipher(0, err)) && (len > mDecryptedLen))
+	{
+		size_t blockLen = (len - mDecryptedLen) - ((len - mDecryptedLen) % AES_128_BLOCK_LEN_BYTES);
+		if (blockLen)
+		{
+			int decLen = 0;
+			long long startTimeUs = NOW_STEADY_TS_US;
+			if (EVP_DecryptUpdate(OPEN_SSL_CONTEXT, data + mDecryptedLen, &decLen, data + mDecryptedLen, (int)blockLen) && (decLen == (int)blockLen))
+			{
+				mDecryptedLen += blockLen;
+			}
+			else
+			{
+				logprintf("AesStreamDecryptor::%s:%d: EVP_DecryptUpdate failed at offset %d\n", __FUNCTION__, __LINE__, (int)mDecryptedLen);
+			}
+			mDecryptTimeUs += NOW_STEADY_TS_US - startTimeUs;
+		}
+	}
+	return mDecryptedLen;
+}
+
+
+/**
+ * @brief Decrypt rest of a completely downloaded fragment and clear its padding
+ * @param bucketType Type of bucket for profiling
+ * @param data downloaded fragment
+ * @param len length of downloaded fragment
+ * @param timeInMs time to wait for key if it is not yet acquired
+ * @retval eDRM_SUCCESS if whole fragment is decrypted
+ */
+DrmReturn AesStreamDecryptor::Finish(ProfilerBucketType bucketType, unsigned char *data, size_t len, int timeInMs)
+{
+	DrmReturn err = eDRM_ERROR;
+	if (!mCipherStarted && !StartCipher(timeInMs, err))
+	{
+		return err;
+	}
+	err = eDRM_ERROR;
+	mpAamp->LogDrmDecryptBegin(bucketType);
+	size_t decryptedWhileDownloading = mDecryptedLen;
+	if ((0 == len) || (len % AES_128_BLOCK_LEN_BYTES) || (len < mDecryptedLen))
+	{
+		logprintf("AesStreamDecryptor::%s:%d: invalid encryptedDataLen %d\n", __FUNCTION__, __LINE__, (int) len);
+	}
+	else if (DecryptAvailable(data, len) != len)
+	{
+		logprintf("AesStreamDecryptor::%s:%d: decrypt failed\n", __FUNCTION__, __LINE__);
+	}
+	else
+	{
+		size_t padLen = 0;
+		if (!ClearPadding(data, len, padLen))
+		{
+			logprintf("AesStreamDecryptor::%s:%d: invalid padding\n", __FUNCTION__, __LINE__);
+			// likely a rotated or revoked key
+			mAesDec->EvictKey(mUri, mKey);
+		}
+		else
+		{
+			AAMPLOG_INFO("AesStreamDecryptor::%s:%d decrypt success decryptedDataLen = %d encryptedDataLen %d, %d bytes decrypted while downloading, in %lld us (%.1f MB/s)\n",
+				__FUNCTION__, __LINE__, (int) (len - padLen), (int) len, (int) decryptedWhileDownloading, mDecryptTimeUs,
+				mDecryptTimeUs ? ((double)len / mDecryptTimeUs) : 0.0);
+			err = eDRM_SUCCESS;
+		}
+	}
+	mpAamp->LogDrmDecryptEnd(bucketType);
+	return err;
 }
@@ -21,18 +21,30 @@
 #define _AAMP_AES_H_
 
 #include <stddef.h> // for size_t
+#include <list>
+#include <string>
 #include "HlsDrmBase.h"
 #include "drm.h"
 #include "openssl/evp.h"
 
+/**
+ * @brief Number of keys kept by the key cache shared by AesDec instances
+ */
+#define AES_KEY_CACHE_SIZE 8
+
 /**
  * @class AesDec
  * @brief Vanilla AES based DRM management
+ *
+ * Each HLS track owns its decryptor so that tracks and players decrypt in
+ * parallel. Only key acquisition is shared, through a cache keyed by player
+ * and key URI.
  */
 class AesDec : public HlsDrmBase
 {
 public:
-	static AesDec* GetInstance();
+	AesDec(int curlInstance);
+	~AesDec();
 	DrmReturn SetMetaData( PrivateInstanceAAMP *aamp, void* metadata);
 	DrmReturn SetDecryptInfo( PrivateInstanceAAMP *aamp, const struct DrmInfo *drmInfo);
 	DrmReturn Decrypt(ProfilerBucketType bucketType, void *encryptedDataPtr, size_t encryptedDataLen, int timeInMs);
@@ -42,30 +54,72 @@ public:
 
 	/*Functions to support internal operations*/
 	void AcquireKey();
-	void SignalKeyAcquired();
-	void NotifyDRMError(AAMPTuneFailure drmFailure);
-	void SignalDrmError();
-	void WaitForKeyAcquireCompleteUnlocked(int timeInMs, DrmReturn &err);
+	DrmReturn GetKey(const char *uri, unsigned char *key, int timeInMs);
+	void EvictKey(const char *uri, const unsigned char *key);
+	static void ClearKeyCache(PrivateInstanceAAMP *aamp);
 
 private:
+	AesDec(const AesDec&) = delete;
+	AesDec& operator=(const AesDec&) = delete;
+	DrmReturn RequestKey(const char *uri);
+	void NotifyDRMError(AAMPTuneFailure drmFailure);
 
-	AesDec();
-	~AesDec();
-	static AesDec *mInstance;
 	PrivateInstanceAAMP *mpAamp;
-	pthread_cond_t mCond;
 	pthread_mutex_t mMutex;
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
 	EVP_CIPHER_CTX *mOpensslCtx;
 #else
 	EVP_CIPHER_CTX mOpensslCtx;
 #endif
-	DrmInfo mDrmInfo ;
-	GrowableBuffer mAesKeyBuf;
-	DRMState mDrmState;
-	DRMState mPrevDrmState;
+	unsigned char mCtxKey[16];
+	bool mCtxKeyValid;
+	unsigned char mIv[16];
 	char* mDrmUrl;
+	std::list<std::string> mKeyRequests;
+	pthread_t mKeyThreadId;
+	bool mKeyThreadStarted;
+	bool mKeyThreadRunning;
+	bool mKeyWaitCancelled;
 	int mCurlInstance;
 };
 
+/**
+ * @class AesStreamDecryptor
+ * @brief Decrypts an AES-128 fragment block by block while it is downloaded
+ *
+ * Key is taken from AesDec once it is acquired, so a fragment fetched while
+ * the key is still on the way is caught up as soon as the key is available.
+ */
+class AesStreamDecryptor : public AampStreamDecryptor
+{
+public:
+	AesStreamDecryptor();
+	~AesStreamDecryptor();
+	bool Init(PrivateInstanceAAMP *aamp, AesDec *aesDec, const struct DrmInfo *drmInfo);
+	void Restart();
+	size_t DecryptAvailable(unsigned char *data, size_t len);
+	DrmReturn Finish(ProfilerBucketType bucketType, unsigned char *data, size_t len, int timeInMs);
+	size_t GetDecryptedLen() { return mDecryptedLen; }
+
+private:
+	AesStreamDecryptor(const AesStreamDecryptor&) = delete;
+	AesStreamDecryptor& operator=(const AesStreamDecryptor&) = delete;
+	bool StartCipher(int timeInMs, DrmReturn &err);
+
+	PrivateInstanceAAMP *mpAamp;
+	AesDec *mAesDec;
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	EVP_CIPHER_CTX *mOpensslCtx;
+#else
+	EVP_CIPHER_CTX mOpensslCtx;
+#endif
+	char *mUri;
+	unsigned char mIv[16];
+	unsigned char mKey[16];
+	bool mKeyValid;
+	bool mCipherStarted;
+	size_t mDecryptedLen;
+	long long mDecryptTimeUs;
+};
+
 #endif // _AAMP_AES_H_
@@ -64,6 +64,7 @@
 #define MIN_DELAY_BETWEEN_PLAYLIST_UPDATE_MS (500) // 500mSec
 #define DRM_IV_LEN 16
 #define MAX_LICENSE_ACQ_WAIT_TIME 10000  // 10 secs
+#define MAX_DELTA_UPDATE_FAILURES 3 // consecutive failed delta updates after which only full playlists are requested
 #define MAX_SEQ_NUMBER_LAG_COUNT 50 /* Configured sequence number max count to avoid continuous looping for an edge case scenario, which leads crash due to hung */
 
 pthread_mutex_t gDrmMutex = PTHREAD_MUTEX_INITIALIZER;
@@ -518,20 +519,29 @@ static void ParseAttrList(char *attrName, void(*cb)(char *attrName, char *delim,
 
 /***************************************************************************
 * @fn TrackPLDownloader
-* @brief Thread function for download 
+* @brief Download job function to fetch playlist of a track
 *		 
-* @param arg[in] void ptr , thread arguement
-* @return void ptr
+* @param arg[in] TrackState pointer
+* @return void
 ***************************************************************************/
-static void * TrackPLDownloader(void *arg)
+static void TrackPLDownloader(void *arg)
 {
 	TrackState* ts = (TrackState*)arg;
-	if(pthread_setname_np(pthread_self(), "aampAudPL"))
-	{
-		logprintf("%s:%d: pthread_setname_np failed\n", __FUNCTION__, __LINE__);
-	}
 	ts->FetchPlaylist();
-	return NULL;
+}
+
+/***************************************************************************
+* @fn IframePLDownloader
+* @brief Download job function to prefetch iframe playlist
+*		 
+* @param arg[in] IframePlaylistPrefetch pointer
+* @return void
+***************************************************************************/
+static void IframePLDownloader(void *arg)
+{
+	IframePlaylistPrefetch *prefetch = (IframePlaylistPrefetch *)arg;
+	traceprintf("%s:%d : Downloading iframe playlist\n", __FUNCTION__, __LINE__);
+	prefetch->aamp->GetFile(prefetch->url, &prefetch->playlist, prefetch->effectiveUrl, &prefetch->http_error, NULL, AAMP_PLAYLIST_PREFETCH_CURL);
 }
 
 /***************************************************************************
@@ -1054,6 +1064,12 @@ char *TrackState::GetNextFragmentUriFromPlaylist()
 				else if (startswith(&ptr, "-X-ADVERTISING"))
 				{ // placeholder for advertising zone for linear (soon to be deprecated)
 				}
+				else if (startswith(&ptr, "-X-PART") || startswith(&ptr, "-X-PRELOAD-HINT"))
+				{ // LL-HLS partial segments are handled by FetchPartialSegments
+				}
+				else if (startswith(&ptr, "-X-SERVER-CONTROL") || startswith(&ptr, "-X-RENDITION-REPORT"))
+				{ // server control is handled during indexing
+				}
 				else 
 				{
 					std::string unknowTag= ptr;
@@ -1195,27 +1211,7 @@ bool TrackState::FetchFragmentHelper(long &http_error, bool &decryption_error)
 		}
 		else
 		{// normal speed
-			fragmentURI = GetNextFragmentUriFromPlaylist();
-			if (fragmentURI != NULL)
-			{
-				playTarget = playlistPosition + fragmentDurationSeconds;
-				if (context->IsLive())
-				{
-					context->CheckForPlaybackStall(true);
-				}
-			}
-			else
-			{
-				if ((ePLAYLISTTYPE_VOD == context->playlistType || context->hasEndListTag) && (playlistPosition != -1))
-				{
-					logprintf("aamp play to end. playTarget %f fragmentURI %p hasEndListTag %d\n", playTarget, fragmentURI, context->hasEndListTag);
-					eosReached = true;
-				}
-				else if (context->IsLive() && type == eTRACK_VIDEO)
-				{
-					context->CheckForPlaybackStall(false);
-				}
-			}
+			AdvanceToNextFragment();
 		}
 
 		if (fragmentURI)
@@ -1248,21 +1244,11 @@ bool TrackState::FetchFragmentHelper(long &http_error, bool &decryption_error)
 			char tempEffectiveUrl[MAX_URI_LENGTH];
 			traceprintf("%s:%d Calling Getfile . buffer %p avail %d\n", __FUNCTION__, __LINE__, &cachedFragment->fragment, (int)cachedFragment->fragment.avail);
 
-			bool fetched = aamp->GetFile(fragmentUrl, &cachedFragment->fragment, tempEffectiveUrl, &http_error, range, type, false, (MediaType)(type));
+			AampStreamDecryptor *streamDecryptor = GetStreamDecryptor();
+			bool fetched = aamp->GetFile(fragmentUrl, &cachedFragment->fragment, tempEffectiveUrl, &http_error, range, type, false, (MediaType)(type), streamDecryptor);
 			if (!fetched)
 			{
-				//cleanup is done in aamp_GetFile itself
-
-				aamp->profiler.ProfileError(mediaTrackBucketTypes[type]);
-				segDLFailCount += 1;
-				logprintf("FetchFragmentHelper aamp_GetFile failed\n");
-				//Adding logic to report error if fragment downloads are failing continuously
-				if(MAX_SEG_DOWNLOAD_FAIL_COUNT <= segDLFailCount && aamp->DownloadsAreEnabled())
-				{
-					logprintf("Not able to download fragments; reached failure threshold sending tune failed event\n");
-					aamp->SendDownloadErrorEvent(AAMP_TUNE_FRAGMENT_DOWNLOAD_FAILURE, http_error);
-				}
-				aamp_Free(&cachedFragment->fragment.ptr);
+				FragmentDownloadFailed(cachedFragment, http_error);
 				return false;
 			}
 
@@ -1284,139 +1270,374 @@ bool TrackState::FetchFragmentHelper(long &http_error, bool &decryption_error)
 			aamp->profiler.ProfileEnd(mediaTrackBucketTypes[type]);
 			segDLFailCount = 0;
 
-			if (cachedFragment->fragment.len && fragmentEncrypted)
+			if (!ProcessFetchedFragment(cachedFragment, fragmentUrl, decryption_error, (NULL != streamDecryptor)))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			if (fragmentURI)
 			{
-				{	
-					traceprintf("%s:%d [%s] uri %s - calling  DrmDecrypt()\n", __FUNCTION__, __LINE__, name, fragmentURI);
-					DrmReturn drmReturn = DrmDecrypt(cachedFragment, mediaTrackDecryptBucketTypes[type]);
+				// null fragment URI technically not an error - live manifest may simply not have updated yet
+				// if real problem exists, underflow will eventually be detected/reported
+				logprintf("FetchFragmentHelper : fragmentURI %s playTarget(%f), playlistPosition(%f)\n", fragmentURI, playTarget, playlistPosition);
+			}
+			return false;
+		}
+		return true;
+}
+/***************************************************************************
+* @fn AdvanceToNextFragment
+* @brief Function to move playlist cursor to next fragment at normal play rate
+*
+* @return char * - fragment URI pointer, NULL if not available
+***************************************************************************/
+char *TrackState::AdvanceToNextFragment()
+{
+	fragmentURI = GetNextFragmentUriFromPlaylist();
+	if (fragmentURI != NULL)
+	{
+		playTarget = playlistPosition + fragmentDurationSeconds;
+		if (context->IsLive())
+		{
+			context->CheckForPlaybackStall(true);
+		}
+	}
+	else
+	{
+		if ((ePLAYLISTTYPE_VOD == context->playlistType || context->hasEndListTag) && (playlistPosition != -1))
+		{
+			logprintf("aamp play to end. playTarget %f fragmentURI %p hasEndListTag %d\n", playTarget, fragmentURI, context->hasEndListTag);
+			eosReached = true;
+		}
+		else if (context->IsLive() && type == eTRACK_VIDEO)
+		{
+			context->CheckForPlaybackStall(false);
+		}
+	}
+	return fragmentURI;
+}
+/***************************************************************************
+* @fn FragmentDownloadFailed
+* @brief Function to update error counters on fragment download failure
+*
+* @param cachedFragment[in] cache slot used for download
+* @param http_error[in] download error
+* @return void
+***************************************************************************/
+void TrackState::FragmentDownloadFailed(CachedFragment* cachedFragment, long http_error)
+{
+	//cleanup is done in aamp_GetFile itself
 
-					if(eDRM_SUCCESS != drmReturn)
-					{
-						logprintf("FetchFragmentHelper : drm_Decrypt failed. fragmentURI %s - RetryCount %d\n", fragmentURI, segDrmDecryptFailCount);
-						if (aamp->DownloadsAreEnabled())
-						{
-							if (eDRM_KEY_ACQUSITION_TIMEOUT == drmReturn)
-							{
-								decryption_error = true;
-								logprintf("FetchFragmentHelper : drm_Decrypt failed due to license acquisition timeout\n");
-								aamp->SendErrorEvent(AAMP_TUNE_LICENCE_TIMEOUT, NULL, false);
-							}
-							else
-							{
-								/* Added to send tune error when fragments decryption failed */
-								segDrmDecryptFailCount +=1;
+	aamp->profiler.ProfileError(mediaTrackBucketTypes[type]);
+	segDLFailCount += 1;
+	logprintf("FetchFragmentHelper aamp_GetFile failed\n");
+	//Adding logic to report error if fragment downloads are failing continuously
+	if(MAX_SEG_DOWNLOAD_FAIL_COUNT <= segDLFailCount && aamp->DownloadsAreEnabled())
+	{
+		logprintf("Not able to download fragments; reached failure threshold sending tune failed event\n");
+		aamp->SendDownloadErrorEvent(AAMP_TUNE_FRAGMENT_DOWNLOAD_FAILURE, http_error);
+	}
+	aamp_FreeBuffer(&cachedFragment->fragment);
+}
+/***************************************************************************
+* @fn ProcessFetchedFragment
+* @brief Function to decrypt downloaded fragment if required
+*
+* @param cachedFragment[in] cache slot holding downloaded fragment
+* @param fragmentUrl[in] url of the fragment
+* @param decryption_error[out] decryption error
+* @param streamDecrypt[in] true if fragment was fed to stream decryptor while downloaded
+* @return bool true on success else false
+***************************************************************************/
+bool TrackState::ProcessFetchedFragment(CachedFragment* cachedFragment, const char *fragmentUrl, bool &decryption_error, bool streamDecrypt)
+{
+	if (cachedFragment->fragment.len && fragmentEncrypted)
+	{
+		{	
+			traceprintf("%s:%d [%s] uri %s - calling  DrmDecrypt()\n", __FUNCTION__, __LINE__, name, fragmentURI);
+			DrmReturn drmReturn = DrmDecrypt(cachedFragment, mediaTrackDecryptBucketTypes[type], streamDecrypt);
 
-								if(MAX_SEG_DRM_DECRYPT_FAIL_COUNT <= segDrmDecryptFailCount)
-								{
-									decryption_error = true;
-									logprintf("FetchFragmentHelper : drm_Decrypt failed for fragments, reached failure threshold sending failure event\n");
-									aamp->SendErrorEvent(AAMP_TUNE_DRM_DECRYPT_FAILED);
-								}
-							}
-						}
-						aamp_Free(&cachedFragment->fragment.ptr);
-						return false;
+			if(eDRM_SUCCESS != drmReturn)
+			{
+				logprintf("FetchFragmentHelper : drm_Decrypt failed. fragmentURI %s - RetryCount %d\n", fragmentURI, segDrmDecryptFailCount);
+				if (aamp->DownloadsAreEnabled())
+				{
+					if (eDRM_KEY_ACQUSITION_TIMEOUT == drmReturn)
+					{
+						decryption_error = true;
+						logprintf("FetchFragmentHelper : drm_Decrypt failed due to license acquisition timeout\n");
+						aamp->SendErrorEvent(AAMP_TUNE_LICENCE_TIMEOUT, NULL, false);
 					}
-#ifdef TRACE
 					else
 					{
-						logprintf("aamp: hls - eMETHOD_AES_128 not set for %s\n", fragmentURI);
+						/* Added to send tune error when fragments decryption failed */
+						segDrmDecryptFailCount +=1;
+
+						if(MAX_SEG_DRM_DECRYPT_FAIL_COUNT <= segDrmDecryptFailCount)
+						{
+							decryption_error = true;
+							logprintf("FetchFragmentHelper : drm_Decrypt failed for fragments, reached failure threshold sending failure event\n");
+							aamp->SendErrorEvent(AAMP_TUNE_DRM_DECRYPT_FAILED);
+						}
 					}
-#endif
-					segDrmDecryptFailCount = 0; /* Resetting the retry count in the case of decryption success */
-				}
-#ifdef AAMP_HARVEST_SUPPORT_ENABLED
-				context->HarvestFile(fragmentUrl, &cachedFragment->fragment, true);
-#endif
-				if (!context->firstFragmentDecrypted)
-				{
-					aamp->NotifyFirstFragmentDecrypted();
-					context->firstFragmentDecrypted = true;
 				}
+				aamp_FreeBuffer(&cachedFragment->fragment);
+				return false;
 			}
-			else if(!cachedFragment->fragment.len)
-			{
-				logprintf("fragment. len zero for %s\n", fragmentURI);
-			}
-#ifdef AAMP_HARVEST_SUPPORT_ENABLED
+#ifdef TRACE
 			else
 			{
-				context->HarvestFile(fragmentUrl, &cachedFragment->fragment, true);
+				logprintf("aamp: hls - eMETHOD_AES_128 not set for %s\n", fragmentURI);
 			}
 #endif
+			segDrmDecryptFailCount = 0; /* Resetting the retry count in the case of decryption success */
 		}
-		else
+#ifdef AAMP_HARVEST_SUPPORT_ENABLED
+		context->HarvestFile(fragmentUrl, &cachedFragment->fragment, true);
+#endif
+		if (!context->firstFragmentDecrypted)
 		{
-			if (fragmentURI)
+			aamp->NotifyFirstFragmentDecrypted();
+			context->firstFragmentDecrypted = true;
+		}
+	}
+	else if(!cachedFragment->fragment.len)
+	{
+		logprintf("fragment. len zero for %s\n", fragmentURI);
+	}
+#ifdef AAMP_HARVEST_SUPPORT_ENABLED
+	else
+	{
+		context->HarvestFile(fragmentUrl, &cachedFragment->fragment, true);
+	}
+#endif
+	return true;
+}
+/***************************************************************************
+* @fn IsNextFragmentPrefetchable
+* @brief Function to check if fragment following current one can be fetched in the same batch
+*
+* Walks the playlist without modifying it. Key and discontinuity tags end a batch, as
+* decrypt context of a fragment is taken from the track when it is processed.
+* @return bool true if next fragment is available and shares decrypt context
+***************************************************************************/
+bool TrackState::IsNextFragmentPrefetchable()
+{
+	if (!fragmentURI || playlistPosition == -1)
+	{
+		return false;
+	}
+	const char *ptr = fragmentURI + strlen(fragmentURI) + 1;
+	const char *playlistEnd = playlist.ptr + playlist.len;
+	while (ptr && ptr < playlistEnd && *ptr)
+	{
+		if (*ptr == '#')
+		{
+			if (!strncmp(ptr, "#EXT-X-KEY", 10) || !strncmp(ptr, "#EXT-X-DISCONTINUITY", 20))
 			{
-				// null fragment URI technically not an error - live manifest may simply not have updated yet
-				// if real problem exists, underflow will eventually be detected/reported
-				logprintf("FetchFragmentHelper : fragmentURI %s playTarget(%f), playlistPosition(%f)\n", fragmentURI, playTarget, playlistPosition);
+				return false;
 			}
-			return false;
 		}
-		return true;
+		else if (*ptr != CHAR_CR && *ptr != CHAR_LF)
+		{ // URI
+			return true;
+		}
+		ptr = strchr(ptr, CHAR_LF);
+		if (ptr)
+		{
+			ptr++;
+		}
+	}
+	return false;
 }
 /***************************************************************************
-* @fn FetchFragment
-* @brief Function to fetch fragment  
-*		 
+* @fn PrefetchFragmentDownloader
+* @brief Download job function to download a fragment of a batch
+*
+* @param arg[in] PrefetchFragment pointer
 * @return void
 ***************************************************************************/
-void TrackState::FetchFragment()
+static void PrefetchFragmentDownloader(void *arg)
 {
-	int timeoutMs = -1;
-	long http_error = 0;
-	bool decryption_error = false;
-	if (context->IsLive())
+	PrefetchFragment *prefetchFragment = (PrefetchFragment *)arg;
+	prefetchFragment->track->DownloadFragmentAhead(prefetchFragment);
+}
+/***************************************************************************
+* @fn DownloadFragmentAhead
+* @brief Function to download a fragment resolved ahead of the write position
+*
+* @param prefetchFragment[in,out] fragment to download
+* @return void
+***************************************************************************/
+void TrackState::DownloadFragmentAhead(PrefetchFragment *prefetchFragment)
+{
+	prefetchFragment->fetched = aamp->GetFile(prefetchFragment->fragmentUrl, &prefetchFragment->cachedFragment->fragment,
+			prefetchFragment->effectiveUrl, &prefetchFragment->http_error, prefetchFragment->range[0] ? prefetchFragment->range : NULL,
+			prefetchFragment->curlInstance, false, (MediaType)(type));
+}
+/***************************************************************************
+* @fn FetchFragmentsAhead
+* @brief Function to fetch next fragments in parallel into free cache slots
+*
+* Fragments are resolved in playlist order and downloaded concurrently, the first
+* one by this thread and the rest by download jobs. Decryption and caching happen
+* one by one in playlist order, so injection order is unchanged.
+* @param maxCount[in] maximum fragments to fetch, not more than free cache slots
+* @return void
+***************************************************************************/
+void TrackState::FetchFragmentsAhead(int maxCount)
+{
+	PrefetchFragment prefetch[AAMP_MAX_PREFETCH_FRAGMENTS];
+	AampDownloadJob downloadJob[AAMP_MAX_PREFETCH_FRAGMENTS];
+	bool downloadJobQueued[AAMP_MAX_PREFETCH_FRAGMENTS];
+	int count = 0;
+
+	if (maxCount > AAMP_MAX_PREFETCH_FRAGMENTS)
 	{
-		timeoutMs = context->maxIntervalBtwPlaylistUpdateMs - (int) (aamp_GetCurrentTimeMS() - lastPlaylistDownloadTimeMS);
-		if(timeoutMs < 0)
+		maxCount = AAMP_MAX_PREFETCH_FRAGMENTS;
+	}
+	while (count < maxCount)
+	{
+		if (count > 0 && !IsNextFragmentPrefetchable())
 		{
-			timeoutMs = 0;
+			break;
+		}
+		if (NULL == AdvanceToNextFragment())
+		{
+			break;
+		}
+		PrefetchFragment *entry = &prefetch[count];
+		entry->track = this;
+		entry->cachedFragment = GetFetchBuffer(true, count);
+		entry->fragmentURI = fragmentURI;
+		entry->playTarget = playTarget;
+		entry->fragmentDurationSeconds = fragmentDurationSeconds;
+		entry->nextMediaSequenceNumber = nextMediaSequenceNumber;
+		entry->discontinuity = discontinuity;
+		entry->curlInstance = (0 == count) ? type : (AAMP_PREFETCH_CURL_START + type * (AAMP_MAX_PREFETCH_FRAGMENTS - 1) + count - 1);
+		aamp_ResolveURL(entry->fragmentUrl, effectiveUrl, fragmentURI);
+		entry->range[0] = 0;
+		if (byteRangeLength)
+		{
+			sprintf(entry->range, "%d-%d", byteRangeOffset, byteRangeOffset + byteRangeLength - 1);
 		}
+		entry->http_error = 0;
+		entry->fetched = false;
+		count++;
 	}
-	if (!WaitForFreeFragmentAvailable(timeoutMs))
+	if (0 == count)
 	{
+		AAMPLOG_TRACE("%s - NULL fragmentURI for %s track \n", __FUNCTION__, name);
 		return;
 	}
-	AAMPLOG_INFO("%s-", name);
-	if (false == FetchFragmentHelper(http_error, decryption_error))
+
+	// cursor to continue from once the batch is processed
+	char *lastFragmentURI = fragmentURI;
+	double lastPlaylistPosition = playlistPosition;
+	double lastPlayTarget = playTarget;
+	double lastFragmentDurationSeconds = fragmentDurationSeconds;
+	long long lastNextMediaSequenceNumber = nextMediaSequenceNumber;
+	bool lastDiscontinuity = discontinuity;
+
+	AAMPLOG_INFO("%s:%d [%s] fetching %d fragments in parallel\n", __FUNCTION__, __LINE__, name, count);
+	// fragment bucket covers the whole batch
+	aamp->profiler.ProfileBegin(mediaTrackBucketTypes[type]);
+	for (int i = 1; i < count; i++)
 	{
-		if (fragmentURI)
+		downloadJob[i].run = PrefetchFragmentDownloader;
+		downloadJob[i].arg = &prefetch[i];
+		downloadJobQueued[i] = aamp->SubmitDownloadJob(&downloadJob[i]);
+	}
+	DownloadFragmentAhead(&prefetch[0]);
+	bool anyFetched = prefetch[0].fetched;
+	for (int i = 1; i < count; i++)
+	{
+		if (downloadJobQueued[i])
+		{
+			aamp->WaitForDownloadJob(&downloadJob[i]);
+		}
+		else
+		{
+			DownloadFragmentAhead(&prefetch[i]);
+		}
+		anyFetched = anyFetched || prefetch[i].fetched;
+	}
+	if (anyFetched)
+	{
+		aamp->profiler.ProfileEnd(mediaTrackBucketTypes[type]);
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		PrefetchFragment *entry = &prefetch[i];
+		bool decryption_error = false;
+		fragmentURI = entry->fragmentURI;
+		playTarget = entry->playTarget;
+		fragmentDurationSeconds = entry->fragmentDurationSeconds;
+		discontinuity = entry->discontinuity;
+		if (!entry->fetched)
 		{
+			FragmentDownloadFailed(entry->cachedFragment, entry->http_error);
 			context->lastSelectedProfileIndex = context->currentProfileIndex;
-			if (context->CheckForRampDownProfile(http_error))
+			if (context->CheckForRampDownProfile(entry->http_error))
 			{
-				if (context->rate == 1.0)
-				{
-					playTarget -= fragmentDurationSeconds;
-				}
-				else
+				// playlist of new profile is indexed from this fragment, rest of the batch is dropped
+				for (int j = i + 1; j < count; j++)
 				{
-					playTarget -= context->rate / context->mTrickPlayFPS;
+					aamp_FreeBuffer(&prefetch[j].cachedFragment->fragment);
 				}
+				fragmentURI = lastFragmentURI;
+				playlistPosition = lastPlaylistPosition;
+				fragmentDurationSeconds = lastFragmentDurationSeconds;
+				discontinuity = lastDiscontinuity;
+				playTarget = entry->playTarget - entry->fragmentDurationSeconds;
+				nextMediaSequenceNumber = entry->nextMediaSequenceNumber;
 				logprintf("FetchFragment :: Error while fetching fragment:%s, failedCount:%d. decrementing profile\n", name, segDLFailCount);
+				return;
 			}
-			else if (decryption_error)
-			{
-				logprintf("FetchFragment :: Error while decrypting fragments\n");
-			}
-			else
+			logprintf("FetchFragment :: Error on fetching %s fragment\n", name);
+			continue;
+		}
+		if((eTRACK_VIDEO == type)  && (aamp->IsTSBSupported()))
+		{
+			char *bwStr = strstr(entry->effectiveUrl, FOG_FRAG_BW_IDENTIFIER);
+			if(bwStr)
 			{
-				logprintf("FetchFragment :: Error on fetching %s fragment\n", name);
+				bwStr += FOG_FRAG_BW_IDENTIFIER_LEN;
+				context->SetTsbBandwidth(atol(bwStr));
 			}
 		}
-		else
+		segDLFailCount = 0;
+		if (!ProcessFetchedFragment(entry->cachedFragment, entry->fragmentUrl, decryption_error))
 		{
-			// technically not an error - live manifest may simply not have updated yet
-			// if real problem exists, underflow will eventually be detected/reported
-			AAMPLOG_TRACE("%s - NULL fragmentURI for %s track \n", __FUNCTION__, name);
-			fflush(stdout); // needed?
-			//abort();
+			logprintf("FetchFragment :: Error while decrypting fragments\n");
+			continue;
 		}
-		return;
+		CachedFragment* writeSlot = GetFetchBuffer(false);
+		if (writeSlot != entry->cachedFragment)
+		{ // an earlier fragment of the batch was dropped, keep cached fragments contiguous
+			writeSlot->fragment = entry->cachedFragment->fragment;
+			memset(&entry->cachedFragment->fragment, 0x00, sizeof(GrowableBuffer));
+		}
+		CacheFetchedFragment();
 	}
+	fragmentURI = lastFragmentURI;
+	playlistPosition = lastPlaylistPosition;
+	playTarget = lastPlayTarget;
+	fragmentDurationSeconds = lastFragmentDurationSeconds;
+	nextMediaSequenceNumber = lastNextMediaSequenceNumber;
+	discontinuity = lastDiscontinuity;
+}
+/***************************************************************************
+* @fn CacheFetchedFragment
+* @brief Function to update position of fetched fragment and add it to cache
+*
+* @return void
+***************************************************************************/
+void TrackState::CacheFetchedFragment()
+{
 	CachedFragment* cachedFragment = GetFetchBuffer(false);
 	if (cachedFragment->fragment.ptr)
 	{
@@ -1455,33 +1676,116 @@ void TrackState::FetchFragment()
 	UpdateTSAfterFetch();
 }
 /***************************************************************************
-* @fn InjectFragmentInternal
-* @brief Injected decrypted fragment for playback 
+* @fn FetchFragment
+* @brief Function to fetch fragment  
 *		 
-* @param cachedFragment[in] CachedFragment structure 	
-* @param fragmentDiscarded[out] bool to indicate fragment successfully injected
 * @return void
 ***************************************************************************/
-void TrackState::InjectFragmentInternal(CachedFragment* cachedFragment, bool &fragmentDiscarded)
+void TrackState::FetchFragment()
 {
-#ifndef SUPRESS_DECODE
-#ifndef FOG_HAMMER_TEST // support aamp stress-tests of fog without video decoding/presentation
-			if (playContext)
+	int timeoutMs = -1;
+	long http_error = 0;
+	bool decryption_error = false;
+	if (context->IsLive())
+	{
+		timeoutMs = context->maxIntervalBtwPlaylistUpdateMs - (int) (aamp_GetCurrentTimeMS() - lastPlaylistDownloadTimeMS);
+		if(timeoutMs < 0)
+		{
+			timeoutMs = 0;
+		}
+	}
+	if (!WaitForFreeFragmentAvailable(timeoutMs))
+	{
+		return;
+	}
+	AAMPLOG_INFO("%s-", name);
+	if (gpGlobalConfig->hlsFragmentPrefetchCount > 1 && context->rate == 1.0 && !context->trickplayMode)
+	{
+		int count = GetFreeFragmentCount();
+		if (count > gpGlobalConfig->hlsFragmentPrefetchCount)
+		{
+			count = gpGlobalConfig->hlsFragmentPrefetchCount;
+		}
+		if (count > 1)
+		{
+			FetchFragmentsAhead(count);
+			return;
+		}
+	}
+	if (false == FetchFragmentHelper(http_error, decryption_error))
+	{
+		if (fragmentURI)
+		{
+			context->lastSelectedProfileIndex = context->currentProfileIndex;
+			if (context->CheckForRampDownProfile(http_error))
+			{
+				if (context->rate == 1.0)
+				{
+					playTarget -= fragmentDurationSeconds;
+				}
+				else
+				{
+					playTarget -= context->rate / context->mTrickPlayFPS;
+				}
+				logprintf("FetchFragment :: Error while fetching fragment:%s, failedCount:%d. decrementing profile\n", name, segDLFailCount);
+			}
+			else if (decryption_error)
+			{
+				logprintf("FetchFragment :: Error while decrypting fragments\n");
+			}
+			else
+			{
+				logprintf("FetchFragment :: Error on fetching %s fragment\n", name);
+			}
+		}
+		else
+		{
+			// technically not an error - live manifest may simply not have updated yet
+			// if real problem exists, underflow will eventually be detected/reported
+			AAMPLOG_TRACE("%s - NULL fragmentURI for %s track \n", __FUNCTION__, name);
+			fflush(stdout); // needed?
+			//abort();
+		}
+		return;
+	}
+	CacheFetchedFragment();
+}
+/***************************************************************************
+* @fn InjectFragmentInternal
+* @brief Injected decrypted fragment for playback 
+*		 
+* @param cachedFragment[in] CachedFragment structure 	
+* @param fragmentDiscarded[out] bool to indicate fragment successfully injected
+* @return void
+***************************************************************************/
+void TrackState::InjectFragmentInternal(CachedFragment* cachedFragment, bool &fragmentDiscarded)
+{
+#ifndef SUPRESS_DECODE
+#ifndef FOG_HAMMER_TEST // support aamp stress-tests of fog without video decoding/presentation
+			// Fragment memory written by curl is handed over as a shared buffer, sink buffers refer to it without copy
+			size_t fragmentLen = cachedFragment->fragment.len;
+			SharedFragmentBuffer *sharedFragment = aamp_CreateSharedBuffer(&cachedFragment->fragment);
+			if (!sharedFragment)
+			{
+				fragmentDiscarded = true;
+			}
+			else if (playContext)
 			{
 				double position = 0;
 				if(!context->mStartTimestampZero)
 				{
 					position = cachedFragment->position;
 				}
-				fragmentDiscarded = !playContext->sendSegment(cachedFragment->fragment.ptr, cachedFragment->fragment.len,
-						position, cachedFragment->duration, cachedFragment->discontinuity, ptsError);
+				fragmentDiscarded = !playContext->sendSegment(sharedFragment->ptr, fragmentLen,
+						position, cachedFragment->duration, cachedFragment->discontinuity, ptsError, sharedFragment);
 			}
 			else
 			{
 				fragmentDiscarded = false;
-				aamp->SendStream((MediaType)type, cachedFragment->fragment.ptr, cachedFragment->fragment.len,
+				aamp->SendStream((MediaType)type, sharedFragment, 0, fragmentLen,
 				        cachedFragment->position, cachedFragment->position, cachedFragment->duration);
 			}
+			aamp_ReleaseSharedBuffer(sharedFragment);
 #endif
 #endif
 } // InjectFragmentInternal
@@ -1645,313 +1949,1031 @@ void TrackState::StartDeferredDrmLicenseAcquisition()
 }
 
 
+/***************************************************************************
+* @fn IndexDrmMetadata
+* @brief Function to decode and index DRM metadata of a EXT-X-FAXS-CM tag
+*
+* @param base64Data[in] start of base64 encoded metadata
+* @param end[in] end of metadata, need not be NUL terminated
+* @return void
+***************************************************************************/
+void TrackState::IndexDrmMetadata(const char *base64Data, const char *end)
+{
+	DrmMetadataNode drmMetadataNode;
+	unsigned char hash[SHA_DIGEST_LENGTH] = {0};
+	traceprintf("aamp: #EXT-X-FAXS-CM:\n");
+	drmMetadataNode.metaData.metadataPtr = base64_Decode(base64Data, &drmMetadataNode.metaData.metadataSize, end - base64Data);
+	SHA1(drmMetadataNode.metaData.metadataPtr, drmMetadataNode.metaData.metadataSize, hash);
+	drmMetadataNode.sha1Hash = base16_Encode(hash, SHA_DIGEST_LENGTH);
+#ifdef TRACE
+	logprintf("%s:%d [%s] drmMetadataNode[%d].sha1Hash -- ", __FUNCTION__, __LINE__, name, mDrmMetaDataIndexCount);
+	for (int i = 0; i < DRM_SHA1_HASH_LEN; i++)
+	{
+		printf("%c", drmMetadataNode.sha1Hash[i]);
+	}
+	printf("\n");
+#endif
+	aamp_AppendBytes(&mDrmMetaDataIndex, &drmMetadataNode, sizeof(drmMetadataNode));
+	traceprintf("%s:%d mDrmMetaDataIndex.ptr %p\n", __FUNCTION__, __LINE__, mDrmMetaDataIndex.ptr);
+	mDrmMetaDataIndexCount++;
+}
+
+/***************************************************************************
+* @fn ProcessDeferredDrmTag
+* @brief Function to handle EXT-X-X1-LIN-CK tag, deferring license acquisition of new DRM metadata
+*
+* @param tag[in] start of tag
+* @param lineEnd[in] end of tag line
+* @return void
+***************************************************************************/
+void TrackState::ProcessDeferredDrmTag(const char *tag, const char *lineEnd)
+{
+	pthread_mutex_lock(&gDrmMutex);
+	if (!gDeferredDrmLicTagUnderProcessing )
+	{
+		logprintf("\n\n#############%s:%d  #EXT-X-X1-LIN-CK \n", __FUNCTION__, __LINE__);
+		const char *ptr = tag + 17;
+		if (ptr < lineEnd)
+		{
+			long time = strtol(ptr, NULL, 10);
+			logprintf("time %ld\n\n", time);
+			if (time != 0 )
+			{
+				if (mDrmMetaDataIndexCount > 1)
+				{
+					if (!firstIndexDone)
+					{
+						logprintf("%s:%d #EXT-X-X1-LIN-CK on first index - not deferring license acquisition\n", __FUNCTION__, __LINE__);
+						gDeferredDrmLicRequestPending = false;
+					}
+					else
+					{
+						logprintf("%s:%d: mDrmMetaDataIndexCount %d\n", __FUNCTION__, __LINE__, mDrmMetaDataIndexCount);
+						DrmMetadataNode* drmMetadataIdx = (DrmMetadataNode*)mDrmMetaDataIndex.ptr;
+						int deferredIdx = AveDrmManager::GetNewMetadataIndex( drmMetadataIdx, mDrmMetaDataIndexCount);
+						if ( deferredIdx != -1)
+						{
+							logprintf("%s:%d: deferredIdx %d\n", __FUNCTION__, __LINE__, deferredIdx);
+							char * sha1Hash = drmMetadataIdx[deferredIdx].sha1Hash;
+							assert(sha1Hash);
+							printf("%s:%d defer acquisition of meta-data with hash - ", __FUNCTION__, __LINE__);
+							AveDrmManager::PrintSha1Hash(sha1Hash);
+							memcpy(gDeferredDrmMetaDataSha1Hash, sha1Hash, DRM_SHA1_HASH_LEN);
+							gDeferredDrmTime = aamp_GetCurrentTimeMS() + GetDeferTimeMs(time);
+							gDeferredDrmLicRequestPending = true;
+						}
+						else
+						{
+							logprintf("%s:%d: GetNewMetadataIndex failed\n", __FUNCTION__, __LINE__);
+						}
+					}
+					gDeferredDrmLicTagUnderProcessing = true;
+				}
+				else
+				{
+					logprintf("%s:%d: ERROR mDrmMetaDataIndexCount %d\n", __FUNCTION__, __LINE__, mDrmMetaDataIndexCount);
+				}
+			}
+			else
+			{
+				logprintf("%s:%d: #EXT-X-X1-LIN-CK invalid time\n", __FUNCTION__, __LINE__);
+			}
+		}
+		else
+		{
+			logprintf("%s:%d: #EXT-X-X1-LIN-CK - parse error\n", __FUNCTION__, __LINE__);
+		}
+	}
+	pthread_mutex_unlock(&gDrmMutex);
+}
+
+/***************************************************************************
+* @fn ReportSubscribedTag
+* @brief Function to report tag as timed metadata if application subscribed to it
+*
+* @param tag[in] start of tag
+* @param lineEnd[in] end of tag line
+* @param position[in] position of tag in seconds
+* @return void
+***************************************************************************/
+void TrackState::ReportSubscribedTag(const char *tag, const char *lineEnd, double position)
+{
+	for (int i = 0; i < aamp->subscribedTags.size(); i++)
+	{
+		int len = aamp->subscribedTags.at(i).length();
+		const char* data = aamp->subscribedTags.at(i).data();
+		if (strncmp(tag + 4, data + 4, len - 4) == 0)
+		{
+			int nb = lineEnd - tag;
+			// logprintf("[AAMP_JS] Found subscribedTag[%d]: @%f '%.*s'\n", i, position, nb, tag);
+			aamp->ReportTimedMetadata(position * 1000, data, tag, nb);
+			break;
+		}
+	}
+}
+
+/***************************************************************************
+* @fn ParseServerControlAttributeCallback
+* @brief Callback function to decode EXT-X-SERVER-CONTROL attributes
+*
+* @param attrName[in] input string
+* @param delimEqual[in] delimiter string
+* @param fin[in] string end pointer
+* @param arg[out] TrackState pointer for storage
+* @return void
+***************************************************************************/
+static void ParseServerControlAttributeCallback(char *attrName, char *delimEqual, char *fin, void* arg)
+{
+	TrackState *ts = (TrackState *)arg;
+	char *valuePtr = delimEqual + 1;
+	if (AttributeNameMatch(attrName, "CAN-SKIP-UNTIL"))
+	{
+		ts->mCanSkipUntil = atof(valuePtr);
+	}
+	else if (AttributeNameMatch(attrName, "CAN-BLOCK-RELOAD"))
+	{
+		ts->mCanBlockReload = SubStringMatch(valuePtr, fin, "YES");
+	}
+	else if (AttributeNameMatch(attrName, "PART-HOLD-BACK"))
+	{
+		ts->mPartHoldBack = atof(valuePtr);
+	}
+}
+
+/**
+ * @brief LL-HLS partial segment or preload hint
+ */
+struct HlsPartialSegment
+{
+	double duration;	/**< DURATION of EXT-X-PART*/
+	std::string uri;	/**< URI of partial segment*/
+	bool byteRange;		/**< Partial segment is a byte range, not supported*/
+	bool typePart;		/**< EXT-X-PRELOAD-HINT of TYPE=PART*/
+};
+
+/***************************************************************************
+* @fn ParsePartialSegmentAttributeCallback
+* @brief Callback function to decode EXT-X-PART and EXT-X-PRELOAD-HINT attributes
+*
+* @param attrName[in] input string
+* @param delimEqual[in] delimiter string
+* @param fin[in] string end pointer
+* @param arg[out] HlsPartialSegment pointer for storage
+* @return void
+***************************************************************************/
+static void ParsePartialSegmentAttributeCallback(char *attrName, char *delimEqual, char *fin, void* arg)
+{
+	HlsPartialSegment *part = (HlsPartialSegment *)arg;
+	char *valuePtr = delimEqual + 1;
+	if (AttributeNameMatch(attrName, "DURATION"))
+	{
+		part->duration = atof(valuePtr);
+	}
+	else if (AttributeNameMatch(attrName, "URI"))
+	{
+		part->uri = GetAttributeValueString(valuePtr, fin);
+	}
+	else if (AttributeNameMatch(attrName, "BYTERANGE") || AttributeNameMatch(attrName, "BYTERANGE-START"))
+	{
+		part->byteRange = true;
+	}
+	else if (AttributeNameMatch(attrName, "TYPE"))
+	{
+		part->typePart = SubStringMatch(valuePtr, fin, "PART");
+	}
+}
+
+/***************************************************************************
+* @fn ParseServerControl
+* @brief Function to parse EXT-X-SERVER-CONTROL tag
+*
+* @param attrList[in] attribute list of the tag
+* @param lineEnd[in] end of tag line
+* @return void
+***************************************************************************/
+void TrackState::ParseServerControl(const char *attrList, const char *lineEnd)
+{
+	// attribute parsing writes NUL terminators, work on a copy of the attribute list only
+	std::string attributes(attrList, lineEnd - attrList);
+	mCanBlockReload = false;
+	mPartHoldBack = 0;
+	ParseAttrList(&attributes[0], ParseServerControlAttributeCallback, this);
+	AAMPLOG_INFO("%s:%d [%s] EXT-X-SERVER-CONTROL CAN-SKIP-UNTIL=%f CAN-BLOCK-RELOAD=%d PART-HOLD-BACK=%f\n", __FUNCTION__, __LINE__, name,
+			mCanSkipUntil, mCanBlockReload, mPartHoldBack);
+}
+
+/***************************************************************************
+* @fn IndexPlaylistLines
+* @brief Function to index playlist lines starting at ptr
+*
+* Lines are handled as ranges so the buffer is neither modified nor copied.
+*
+* @param ptr[in] start of first line to be indexed
+* @param state[in,out] indexing state carried from previous lines
+* @return void
+***************************************************************************/
+void TrackState::IndexPlaylistLines(const char *ptr, PlaylistIndexState &state)
+{
+	IndexNode node;
+	while (ptr && *ptr)
+	{
+		const char *next = strchr(ptr, CHAR_LF);
+		const char *lineEnd = next ? next : (ptr + strlen(ptr));
+		if (lineEnd > ptr && lineEnd[-1] == CHAR_CR)
+		{
+			lineEnd--;
+		}
+		if (strncmp(ptr, "#EXT", 4) == 0)
+		{
+			const char *tag = ptr + 4;
+			if (strncmp(tag, "INF:", 4) == 0)
+			{
+				node.pFragmentInfo = ptr;
+				indexCount++;
+				state.totalDuration += atof(tag + 4);
+				node.completionTimeSecondsFromStart = state.totalDuration;
+				node.drmMetadataIdx = state.drmMetadataIdx;
+				aamp_AppendBytes(&index, &node, sizeof(node));
+			}
+			else if (strncmp(tag, "-X-DISCONTINUITY", 16) == 0)
+			{
+				if (0 != state.totalDuration)
+				{
+					logprintf("%s:%d #EXT-X-DISCONTINUITY in track[%d] indexCount %d periodPosition %f\n", __FUNCTION__, __LINE__, type, indexCount, state.totalDuration);
+					mPeriodPositionIndex[indexCount] = state.totalDuration;
+				}
+			}
+			else if (strncmp(tag, "-X-KEY:", 7) == 0)
+			{
+				traceprintf("aamp: EXT-X-KEY\n");
+				// attribute parsing writes NUL terminators, work on a copy of the attribute list only
+				std::string keyAttributes(tag + 7, lineEnd - (tag + 7));
+				ParseAttrList(&keyAttributes[0], ParseKeyAttributeCallback, this);
+				state.drmMetadataIdx = mDrmMetaDataIndexPosition;
+				if(!fragmentEncrypted)
+				{
+					state.drmMetadataIdx = -1;
+					logprintf("%s:%d Not encrypted - fragmentEncrypted %d mCMSha1Hash %p\n", __FUNCTION__, __LINE__, fragmentEncrypted, mCMSha1Hash);
+				}
+			}
+			else if (strncmp(tag, "-X-FAXS-CM:", 11) == 0)
+			{
+				IndexDrmMetadata(tag + 11, lineEnd);
+			}
+			else if (strncmp(tag, "-X-X1-LIN-CK:", 13) == 0)
+			{
+				state.deferDrmTags.push_back(std::make_pair(ptr, state.totalDuration));
+			}
+			else if (!state.mediaSequenceFound && strncmp(tag, "-X-MEDIA-SEQUENCE:", 18) == 0)
+			{
+				indexFirstMediaSequenceNumber = atoll(tag + 18);
+				state.mediaSequenceFound = true;
+			}
+			else if (!state.targetDurationFound && strncmp(tag, "-X-TARGETDURATION:", 18) == 0)
+			{
+				targetDurationSeconds = atof(tag + 18);
+				state.targetDurationFound = true;
+				AAMPLOG_INFO("aamp: EXT-X-TARGETDURATION = %f\n", targetDurationSeconds);
+			}
+			else if (!state.playlistTypeFound && strncmp(tag, "-X-PLAYLIST-TYPE:", 17) == 0)
+			{
+				// EVENT or VOD (optional); VOD if playlist will never change
+				char *typeStr = (char *)tag + 17;
+				state.playlistTypeFound = true;
+				if (startswith(&typeStr, "VOD"))
+				{
+					logprintf("aamp: EXT-X-PLAYLIST-TYPE - VOD\n");
+					context->playlistType = ePLAYLISTTYPE_VOD;
+				}
+				else if (startswith(&typeStr, "EVENT"))
+				{
+					logprintf("aamp: EXT-X-PLAYLIST-TYPE = EVENT\n");
+					context->playlistType = ePLAYLISTTYPE_EVENT;
+				}
+				else
+				{
+					aamp_Error("unknown PLAYLIST-TYPE");
+				}
+			}
+			else if (strncmp(tag, "-X-ENDLIST", 10) == 0)
+			{
+				state.endListFound = true;
+			}
+			else if (strncmp(tag, "-X-SERVER-CONTROL:", 18) == 0)
+			{
+				ParseServerControl(tag + 18, lineEnd);
+			}
+			else if (strncmp(tag, "-X-PART-INF:", 12) == 0)
+			{
+				const char *partTarget = strstr(tag, "PART-TARGET=");
+				if (partTarget && partTarget < lineEnd)
+				{
+					mPartTargetDuration = atof(partTarget + 12);
+				}
+			}
+			if (state.reportSubscribedTags && (strncmp(tag, "INF:", 4) != 0) && (strncmp(tag, "-X-DISCONTINUITY", 16) != 0)
+					&& (strncmp(tag, "-X-KEY:", 7) != 0) && (strncmp(tag, "-X-X1-LIN-CK:", 13) != 0))
+			{
+				ReportSubscribedTag(ptr, lineEnd, state.totalDuration);
+			}
+		}
+		ptr = next ? (next + 1) : NULL;
+	}
+}
+
 /***************************************************************************
 * @fn IndexPlaylist
 * @brief Function to parse playlist 
+*
+* Playlist is indexed in a single sweep by IndexPlaylistLines
 *		 
 * @return double total duration from playlist
 ***************************************************************************/
 double TrackState::IndexPlaylist()
 {
-	double totalDuration = 0.0;
-	char * playlistBackup = NULL;
+	PlaylistIndexState state;
+	bool deferDrmTagPresent = false;
 	traceprintf("%s:%d Enter \n", __FUNCTION__, __LINE__);
 
 	FlushIndex();
 
+	state.totalDuration = 0.0;
+	state.drmMetadataIdx = -1;
+	state.mediaSequenceFound = false;
+	state.targetDurationFound = false;
+	state.playlistTypeFound = false;
+	state.endListFound = false;
+	state.reportSubscribedTags = (gpGlobalConfig->enableSubscribedTags && (eTRACK_VIDEO == type));
 	if (playlist.ptr )
 	{
-		char *ptr;
-
-		// TODO: may be more efficient to do the following scans as we walk the file
-
-		ptr = strstr(playlist.ptr, "#EXT-X-MEDIA-SEQUENCE:");
-		if (ptr)
-		{
-			ptr += 22;
-			indexFirstMediaSequenceNumber = atoll(ptr);
-		}
-		else
+		indexFirstMediaSequenceNumber = 0;
+		mCanSkipUntil = 0;
+		mCanBlockReload = false;
+		mPartHoldBack = 0;
+		mPartTargetDuration = 0;
+		IndexPlaylistLines(playlist.ptr, state);
+
+		if (!state.mediaSequenceFound)
 		{ // for Sling content
 			logprintf("warning: no EXT-X-MEDIA-SEQUENCE tag\n");
-			ptr = playlist.ptr;
-			indexFirstMediaSequenceNumber = 0;
 		}
-
-		ptr = strstr(playlist.ptr, "#EXT-X-TARGETDURATION:");
-		if( ptr )
+		if (mDrmMetaDataIndexCount > 1)
 		{
-			ptr += 22;
-			targetDurationSeconds = atof(ptr);
-			AAMPLOG_INFO("aamp: EXT-X-TARGETDURATION = %f\n", targetDurationSeconds);
+			traceprintf("%s:%d Indexed %d drm metadata\n", __FUNCTION__, __LINE__, mDrmMetaDataIndexCount);
 		}
-
-		DrmMetadataNode drmMetadataNode;
-		playlistBackup = (char*) malloc(playlist.len);
-		memcpy(playlistBackup, playlist.ptr, playlist.len);
-		ptr = playlist.ptr;
-		do
+		if (state.endListFound && context->playlistType != ePLAYLISTTYPE_VOD)
 		{
-			char *drmPtr = NULL;
-			ptr = strstr(ptr, "#EXT-X-FAXS-CM:");
-			if (ptr)
+			if (context->playlistType == ePLAYLISTTYPE_UNDEFINED)
 			{
-				drmPtr = ptr+strlen("#EXT-X-FAXS-CM:");
-				traceprintf("aamp: #EXT-X-FAXS-CM:\n");
+				logprintf("aamp: Found EXT-X-ENDLIST without EXT-X-PLAYLIST-TYPE\n");
+			}
+			else
+			{
+				logprintf("aamp: Found EXT-X-ENDLIST with ePLAYLISTTYPE_EVENT\n");
+			}
+			//required to avoid live adjust kicking in
+			logprintf("aamp: Changing playlist type to ePLAYLISTTYPE_VOD as ENDLIST tag present\n");
+			context->playlistType = ePLAYLISTTYPE_VOD;
+		}
 
-				char * delim = strchr(ptr, CHAR_LF);
-				if (delim)
-				{
-					if (delim > ptr && delim[-1] == CHAR_CR)
-					{
-						delim--;
-					}
-					*delim = '\0';
-					ptr = delim + 1;
-				}
-				else
+		// EXT-X-X1-LIN-CK needs the complete DRM metadata index and playlist type, handled after the sweep
+		for (std::vector<std::pair<const char *, double> >::iterator it = state.deferDrmTags.begin(); it != state.deferDrmTags.end(); it++)
+		{
+			const char *tag = it->first;
+			const char *lineEnd = strchr(tag, CHAR_LF);
+			if (!lineEnd)
+			{
+				lineEnd = tag + strlen(tag);
+			}
+			if ( context->IsLive() && (1.0 == context->rate)
+				&& ((eTUNETYPE_NEW_NORMAL == context->mTuneType) || (eTUNETYPE_SEEKTOLIVE == context->mTuneType)))
+			{
+				deferDrmTagPresent = true;
+				ProcessDeferredDrmTag(tag, lineEnd);
+			}
+			else if (state.reportSubscribedTags)
+			{
+				if (lineEnd > tag && lineEnd[-1] == CHAR_CR)
 				{
-					ptr = NULL;
+					lineEnd--;
 				}
-				unsigned char hash[SHA_DIGEST_LENGTH] = {0};
-				drmMetadataNode.metaData.metadataPtr =  base64_Decode(drmPtr, &drmMetadataNode.metaData.metadataSize);
-				SHA1(drmMetadataNode.metaData.metadataPtr, drmMetadataNode.metaData.metadataSize, hash);
-				drmMetadataNode.sha1Hash = base16_Encode(hash, SHA_DIGEST_LENGTH);
+				ReportSubscribedTag(tag, lineEnd, it->second);
+			}
+		}
+	}
+	if(eTRACK_VIDEO == type)
+	{
+		aamp->UpdateDuration(state.totalDuration);
+	}
+
+	if (gDeferredDrmLicTagUnderProcessing && !deferDrmTagPresent)
+	{
+		logprintf("%s:%d - reset gDeferredDrmLicTagUnderProcessing\n", __FUNCTION__, __LINE__);
+		gDeferredDrmLicTagUnderProcessing = false;
+	}
+
 #ifdef TRACE
-				logprintf("%s:%d [%s] drmMetadataNode[%d].sha1Hash -- ", __FUNCTION__, __LINE__, name, mDrmMetaDataIndexCount);
-				for (int i = 0; i < DRM_SHA1_HASH_LEN; i++)
-				{
-					printf("%c", drmMetadataNode.sha1Hash[i]);
-				}
-				printf("\n");
+	DumpIndex(this);
 #endif
+	if (!firstIndexDone || (NULL != mCMSha1Hash))
+	{
+		UpdateDrmMetadata();
+	}
+	firstIndexDone = true;
+	traceprintf("%s:%d Exit indexCount %d mDrmMetaDataIndexCount %d\n", __FUNCTION__, __LINE__, indexCount, mDrmMetaDataIndexCount);
+	return state.totalDuration;
+}
+
+/***************************************************************************
+* @fn PlaylistFragmentTagMatch
+* @brief Function to compare EXTINF line of previous playlist with refreshed playlist
+*
+* Line terminators of previous playlist may have been replaced with NUL while
+* walking it for fragment URIs.
+*
+* @param prevLine[in] EXTINF line in previous playlist
+* @param newLine[in] candidate line in refreshed playlist
+* @param newEnd[in] end of refreshed playlist
+* @return bool true if lines are same
+***************************************************************************/
+static bool PlaylistFragmentTagMatch(const char *prevLine, const char *newLine, const char *newEnd)
+{
+	for (;;)
+	{
+		if (newLine >= newEnd)
+		{
+			return false;
+		}
+		char c = *newLine++;
+		char p = *prevLine++;
+		if (c == CHAR_LF || c == CHAR_CR)
+		{
+			return (p == c || p == 0x00);
+		}
+		if (c != p)
+		{
+			return false;
+		}
+	}
+}
+
+/***************************************************************************
+* @fn IndexPlaylistDelta
+* @brief Function to update index with the tail of a refreshed live playlist
+*
+* Fragments of a sliding window playlist keep their text across refreshes, so
+* the fragments still present are located by media sequence number and rebased
+* to the new buffer, culled ones are dropped from the front and only lines after
+* the last known fragment are parsed. Falls back to full indexing (returns false)
+* whenever the overlap can't be verified.
+*
+* @param prevPlaylist[in] previous playlist buffer, index points into it
+* @return bool true if index is updated
+***************************************************************************/
+bool TrackState::IndexPlaylistDelta(const char *prevPlaylist)
+{
+	if (!prevPlaylist || !playlist.ptr || !firstIndexDone || indexCount <= 0 || ePLAYLISTTYPE_VOD == context->playlistType
+			|| mDrmMetaDataIndexCount || mCMSha1Hash || gDeferredDrmLicTagUnderProcessing
+			|| (gpGlobalConfig->enableSubscribedTags && (eTRACK_VIDEO == type) && !aamp->subscribedTags.empty()))
+	{ // DRM metadata and subscribed tags are reported against full playlist, needs full indexing
+		return false;
+	}
 
-				aamp_AppendBytes(&mDrmMetaDataIndex, &drmMetadataNode, sizeof(drmMetadataNode));
-				traceprintf("%s:%d mDrmMetaDataIndex.ptr %p\n", __FUNCTION__, __LINE__, mDrmMetaDataIndex.ptr);
-				mDrmMetaDataIndexCount++;
+	// Header up to first fragment gives media sequence number of first fragment
+	const char *newEnd = playlist.ptr + playlist.len;
+	const char *newFirst = NULL;
+	long long newFirstMediaSequenceNumber = -1;
+	const char *ptr = playlist.ptr;
+	double canSkipUntil = 0;
+	while (ptr && *ptr && !newFirst)
+	{
+		if (strncmp(ptr, "#EXTINF:", 8) == 0)
+		{
+			newFirst = ptr;
+		}
+		else if (strncmp(ptr, "#EXT-X-MEDIA-SEQUENCE:", 22) == 0)
+		{
+			newFirstMediaSequenceNumber = atoll(ptr + 22);
+		}
+		else if (strncmp(ptr, "#EXT-X-SERVER-CONTROL:", 22) == 0)
+		{
+			const char *lineEnd = strchr(ptr, CHAR_LF);
+			if (!lineEnd)
+			{
+				lineEnd = ptr + strlen(ptr);
+			}
+			else if (lineEnd > ptr && lineEnd[-1] == CHAR_CR)
+			{
+				lineEnd--;
 			}
+			mCanSkipUntil = 0;
+			ParseServerControl(ptr + 22, lineEnd);
+			canSkipUntil = mCanSkipUntil;
 		}
-		while (ptr);
-		if (mDrmMetaDataIndexCount > 1)
+		else if (strncmp(ptr, "#EXT-X-ENDLIST", 14) == 0 || strncmp(ptr, "#EXT-X-DISCONTINUITY", 20) == 0)
+		{
+			return false;
+		}
+		ptr = strchr(ptr, CHAR_LF);
+		if (ptr)
+		{
+			ptr++;
+		}
+	}
+	long long culledCount = newFirstMediaSequenceNumber - indexFirstMediaSequenceNumber;
+	if (!newFirst || newFirstMediaSequenceNumber < 0 || culledCount < 0 || culledCount >= indexCount)
+	{
+		return false;
+	}
+
+	mCanSkipUntil = canSkipUntil;
+
+	IndexNode *node = (IndexNode *)index.ptr;
+	int overlapCount = indexCount - (int)culledCount;
+	IndexNode *first = &node[culledCount];
+	IndexNode *last = &node[indexCount - 1];
+	// offset of a fragment relative to first surviving fragment is same in both buffers
+	const char *newLast = newFirst + (last->pFragmentInfo - first->pFragmentInfo);
+	if (newLast >= newEnd || (newLast > playlist.ptr && newLast[-1] != CHAR_LF)
+			|| !PlaylistFragmentTagMatch(first->pFragmentInfo, newFirst, newEnd)
+			|| !PlaylistFragmentTagMatch(last->pFragmentInfo, newLast, newEnd))
+	{
+		AAMPLOG_INFO("%s:%d [%s] playlist overlap changed, re-index\n", __FUNCTION__, __LINE__, name);
+		return false;
+	}
+
+	double culledSeconds = culledCount ? node[culledCount - 1].completionTimeSecondsFromStart : 0;
+	if (culledCount)
+	{
+		memmove(node, first, overlapCount * sizeof(IndexNode));
+	}
+	const char *prevFirst = node[0].pFragmentInfo;
+	for (int i = 0; i < overlapCount; i++)
+	{
+		node[i].pFragmentInfo = newFirst + (node[i].pFragmentInfo - prevFirst);
+	}
+	indexCount = overlapCount;
+	index.len = overlapCount * sizeof(IndexNode);
+	indexFirstMediaSequenceNumber = newFirstMediaSequenceNumber;
+
+	std::map<int, double> periodPositionIndex;
+	for (std::map<int, double>::iterator it = mPeriodPositionIndex.begin(); it != mPeriodPositionIndex.end(); it++)
+	{
+		if (it->first > culledCount)
+		{
+			periodPositionIndex[it->first - (int)culledCount] = it->second - culledSeconds;
+		}
+	}
+	mPeriodPositionIndex.swap(periodPositionIndex);
+
+	PlaylistIndexState state;
+	state.totalDuration = node[overlapCount - 1].completionTimeSecondsFromStart - culledSeconds;
+	state.drmMetadataIdx = node[overlapCount - 1].drmMetadataIdx;
+	state.mediaSequenceFound = true;
+	state.targetDurationFound = true;
+	state.playlistTypeFound = true;
+	state.endListFound = false;
+	state.reportSubscribedTags = false;
+	for (int i = 0; i < overlapCount; i++)
+	{
+		node[i].completionTimeSecondsFromStart -= culledSeconds;
+	}
+
+	// skip tags and URI of last known fragment, parse only what follows
+	ptr = newLast;
+	do
+	{
+		ptr = strchr(ptr, CHAR_LF);
+		if (ptr)
+		{
+			ptr++;
+		}
+	}
+	while (ptr && *ptr == '#');
+	if (ptr)
+	{
+		ptr = strchr(ptr, CHAR_LF);
+		if (ptr)
+		{
+			ptr++;
+		}
+	}
+	int prevIndexCount = indexCount;
+	IndexPlaylistLines(ptr, state);
+	for (std::vector<std::pair<const char *, double> >::iterator it = state.deferDrmTags.begin(); it != state.deferDrmTags.end(); it++)
+	{
+		const char *lineEnd = strchr(it->first, CHAR_LF);
+		if ( context->IsLive() && (1.0 == context->rate)
+			&& ((eTUNETYPE_NEW_NORMAL == context->mTuneType) || (eTUNETYPE_SEEKTOLIVE == context->mTuneType)))
+		{
+			ProcessDeferredDrmTag(it->first, lineEnd ? lineEnd : (it->first + strlen(it->first)));
+		}
+	}
+	if (state.endListFound)
+	{
+		logprintf("aamp: Changing playlist type to ePLAYLISTTYPE_VOD as ENDLIST tag present\n");
+		context->playlistType = ePLAYLISTTYPE_VOD;
+	}
+	if(eTRACK_VIDEO == type)
+	{
+		aamp->UpdateDuration(state.totalDuration);
+	}
+	AAMPLOG_INFO("%s:%d [%s] culled %lld fragments (%f sec), appended %d, indexCount %d\n", __FUNCTION__, __LINE__, name,
+			culledCount, culledSeconds, indexCount - prevIndexCount, indexCount);
+	return true;
+}
+
+/***************************************************************************
+* @fn NextPlaylistLine
+* @brief Function to get start of next line in a playlist walked by mystrpbrk
+*
+* @param ptr[in] current line
+* @param end[in] end of playlist content
+* @return const char * - start of next line, end if ptr is the last line
+***************************************************************************/
+static const char *NextPlaylistLine(const char *ptr, const char *end)
+{
+	while (ptr < end)
+	{
+		if (*ptr == CHAR_LF)
+		{
+			return ptr + 1;
+		}
+		if (*ptr == 0x00)
+		{ // line terminator replaced by mystrpbrk
+			return (ptr + 1 < end && ptr[1] == CHAR_LF) ? (ptr + 2) : (ptr + 1);
+		}
+		ptr++;
+	}
+	return end;
+}
+
+/***************************************************************************
+* @fn SkipFragmentLines
+* @brief Function to get end of a fragment's lines in a playlist
+*
+* @param extinf[in] EXTINF line of the fragment
+* @param end[in] end of playlist content
+* @return const char * - start of line following fragment URI
+***************************************************************************/
+static const char *SkipFragmentLines(const char *extinf, const char *end)
+{
+	const char *ptr = NextPlaylistLine(extinf, end);
+	while (ptr < end && (*ptr == '#' || *ptr == CHAR_LF || *ptr == CHAR_CR || *ptr == 0x00))
+	{
+		ptr = NextPlaylistLine(ptr, end);
+	}
+	return NextPlaylistLine(ptr, end);
+}
+
+/***************************************************************************
+* @fn MergeDeltaPlaylist
+* @brief Function to expand EXT-X-SKIP of a delta playlist update
+*
+* Skipped fragments are copied from the previous playlist so the rest of the
+* collector keeps working on a complete playlist. Line terminators replaced
+* with NUL while walking the previous playlist are restored.
+*
+* @param prevPlaylist[in] previous playlist, index points into it
+* @return bool true if playlist has no EXT-X-SKIP or it is expanded
+***************************************************************************/
+bool TrackState::MergeDeltaPlaylist(const GrowableBuffer &prevPlaylist)
+{
+	const char *newEnd = playlist.ptr + playlist.len;
+	const char *skipTag = NULL;
+	long long mediaSequenceNumber = 0;
+	const char *ptr = playlist.ptr;
+	while (ptr < newEnd && *ptr)
+	{
+		if (strncmp(ptr, "#EXTINF:", 8) == 0)
+		{
+			break;
+		}
+		else if (strncmp(ptr, "#EXT-X-MEDIA-SEQUENCE:", 22) == 0)
+		{
+			mediaSequenceNumber = atoll(ptr + 22);
+		}
+		else if (strncmp(ptr, "#EXT-X-SKIP:", 12) == 0)
+		{
+			skipTag = ptr;
+			break;
+		}
+		ptr = NextPlaylistLine(ptr, newEnd);
+	}
+	if (!skipTag)
+	{
+		return true;
+	}
+
+	const char *skipTagEnd = NextPlaylistLine(skipTag, newEnd);
+	const char *skippedAttr = strstr(skipTag, "SKIPPED-SEGMENTS=");
+	int skippedSegments = (skippedAttr && skippedAttr < skipTagEnd) ? atoi(skippedAttr + 17) : 0;
+	long long skipFirst = mediaSequenceNumber - indexFirstMediaSequenceNumber;
+	if (!prevPlaylist.ptr || skippedSegments <= 0 || skipFirst < 0 || (skipFirst + skippedSegments) > indexCount)
+	{
+		logprintf("%s:%d [%s] EXT-X-SKIP of %d fragments from %lld not in previous playlist (%lld-%lld)\n", __FUNCTION__, __LINE__,
+				name, skippedSegments, mediaSequenceNumber, indexFirstMediaSequenceNumber, indexFirstMediaSequenceNumber + indexCount - 1);
+		return false;
+	}
+
+	IndexNode *node = (IndexNode *)index.ptr;
+	const char *prevEnd = prevPlaylist.ptr + prevPlaylist.len;
+	const char *spanStart = skipFirst ? SkipFragmentLines(node[skipFirst - 1].pFragmentInfo, prevEnd) : node[0].pFragmentInfo;
+	const char *spanEnd = SkipFragmentLines(node[skipFirst + skippedSegments - 1].pFragmentInfo, prevEnd);
+
+	GrowableBuffer merged;
+	memset(&merged, 0, sizeof(merged));
+	aamp_Malloc(&merged, playlist.len + (spanEnd - spanStart));
+	aamp_AppendBytes(&merged, playlist.ptr, skipTag - playlist.ptr);
+	for (ptr = spanStart; ptr < spanEnd; )
+	{
+		if (strncmp(ptr, "#EXT-X-KEY:", 11) == 0)
+		{ // key attributes of previous playlist may be NUL terminated in place
+			logprintf("%s:%d [%s] EXT-X-KEY in skipped fragments\n", __FUNCTION__, __LINE__, name);
+			aamp_Free(&merged.ptr);
+			return false;
+		}
+		const char *next = NextPlaylistLine(ptr, spanEnd);
+		const char *lineEnd = (const char *)memchr(ptr, 0x00, next - ptr);
+		if (lineEnd)
+		{
+			aamp_AppendBytes(&merged, ptr, lineEnd - ptr);
+			aamp_AppendBytes(&merged, (lineEnd + 1 < next) ? "\r\n" : "\n", (lineEnd + 1 < next) ? 2 : 1);
+		}
+		else
+		{
+			aamp_AppendBytes(&merged, ptr, next - ptr);
+		}
+		ptr = next;
+	}
+	aamp_AppendBytes(&merged, skipTagEnd, newEnd - skipTagEnd);
+	AAMPLOG_INFO("%s:%d [%s] expanded EXT-X-SKIP of %d fragments, delta %d bytes, playlist %d bytes\n", __FUNCTION__, __LINE__, name,
+			skippedSegments, (int)playlist.len, (int)merged.len);
+	aamp_Free(&playlist.ptr);
+	playlist = merged;
+	return true;
+}
+
+/***************************************************************************
+* @fn IsLowLatencyActive
+* @brief Function to check if LL-HLS partial segments are fetched at live edge
+*
+* @return bool true if playlist advertises partial segments and they can be used
+***************************************************************************/
+bool TrackState::IsLowLatencyActive()
+{
+	// partial segments of AES-128 segments can't be decrypted independently
+	return (gpGlobalConfig->hlsLowLatency && (mPartTargetDuration > 0) && context->IsLive() && (1.0 == context->rate)
+			&& !context->trickplayMode && !fragmentEncrypted && (NULL == mCMSha1Hash));
+}
+
+/***************************************************************************
+* @fn DownloadPartialSegment
+* @brief Function to download a partial segment into the fetch slot of cache
+*
+* Partial segment stays in the fetch slot, not visible to injector, till it
+* is added to cache by CachePartialSegment.
+*
+* @param uri[in] URI of partial segment
+* @return bool true if partial segment is downloaded
+***************************************************************************/
+bool TrackState::DownloadPartialSegment(const char *uri)
+{
+	char partUrl[MAX_URI_LENGTH];
+	char tempEffectiveUrl[MAX_URI_LENGTH];
+	long http_error = 0;
+	bool decryption_error = false;
+
+	if (!WaitForFreeFragmentAvailable((int)(mPartTargetDuration * 1000)))
+	{
+		return false;
+	}
+	CachedFragment* cachedFragment = GetFetchBuffer(true);
+	aamp_ResolveURL(partUrl, effectiveUrl, uri);
+	aamp->profiler.ProfileBegin(mediaTrackBucketTypes[type]);
+	if (!aamp->GetFile(partUrl, &cachedFragment->fragment, tempEffectiveUrl, &http_error, NULL, type, false, (MediaType)(type)))
+	{
+		FragmentDownloadFailed(cachedFragment, http_error);
+		return false;
+	}
+	aamp->profiler.ProfileEnd(mediaTrackBucketTypes[type]);
+	segDLFailCount = 0;
+	return ProcessFetchedFragment(cachedFragment, partUrl, decryption_error);
+}
+
+/***************************************************************************
+* @fn CachePartialSegment
+* @brief Function to add partial segment downloaded to fetch slot to cache
+*
+* @param duration[in] duration of partial segment
+* @param discontinuity[in] discontinuity before partial segment
+* @return void
+***************************************************************************/
+void TrackState::CachePartialSegment(double duration, bool discontinuity)
+{
+	// cache position is taken from playTarget and fragment duration of the track
+	double segmentDuration = fragmentDurationSeconds;
+	double segmentPlayTarget = playTarget;
+	bool segmentDiscontinuity = this->discontinuity;
+	fragmentDurationSeconds = duration;
+	playTarget = mPartSegmentStart + mPartOffset + duration;
+	this->discontinuity = discontinuity;
+	CacheFetchedFragment();
+	fragmentDurationSeconds = segmentDuration;
+	playTarget = segmentPlayTarget;
+	this->discontinuity = segmentDiscontinuity;
+
+	mPartOffset += duration;
+	mNextPartIndex++;
+	AAMPLOG_INFO("%s:%d [%s] cached part %lld.%d duration %f\n", __FUNCTION__, __LINE__, name,
+			mPartMediaSequenceNumber, mNextPartIndex - 1, duration);
+}
+
+/***************************************************************************
+* @fn FetchPartialSegment
+* @brief Function to download a partial segment and add it to cache
+*
+* @param uri[in] URI of partial segment
+* @param duration[in] duration of partial segment
+* @param discontinuity[in] discontinuity before partial segment
+* @return bool true if partial segment is added to cache
+***************************************************************************/
+bool TrackState::FetchPartialSegment(const char *uri, double duration, bool discontinuity)
+{
+	if (!DownloadPartialSegment(uri))
+	{
+		return false;
+	}
+	CachePartialSegment(duration, discontinuity);
+	return true;
+}
+
+/***************************************************************************
+* @fn DiscardHintedPart
+* @brief Function to drop partial segment downloaded from EXT-X-PRELOAD-HINT and not yet cached
+*
+* @return void
+***************************************************************************/
+void TrackState::DiscardHintedPart()
+{
+	if (mHintedPartIndex >= 0)
+	{
+		AAMPLOG_INFO("%s:%d [%s] dropping hinted part %lld.%d %s\n", __FUNCTION__, __LINE__, name,
+				mPartMediaSequenceNumber, mHintedPartIndex, mHintedPartUri.c_str());
+		aamp_FreeBuffer(&GetFetchBuffer(false)->fragment);
+		mHintedPartIndex = -1;
+		mHintedPartUri.clear();
+	}
+}
+
+/***************************************************************************
+* @fn FetchPartialSegments
+* @brief Function to fetch partial segments of the segment following current one
+*
+* Segment following the current one is fetched part by part while it is being
+* produced. Once it is complete in the playlist and all its parts are cached,
+* playlist cursor is moved past it as if it was fetched as a whole. fragmentURI
+* is cleared if the segment is incomplete so playlist is reloaded.
+*
+* @return void
+***************************************************************************/
+void TrackState::FetchPartialSegments()
+{
+	long long mediaSequenceNumber = nextMediaSequenceNumber;
+	long long prevIdx = mediaSequenceNumber - 1 - indexFirstMediaSequenceNumber;
+	if (playlistPosition == -1 || prevIdx < 0 || prevIdx >= indexCount)
+	{ // segment preceding the parts isn't in playlist
+		fragmentURI = NULL;
+		return;
+	}
+	if (mPartMediaSequenceNumber != mediaSequenceNumber)
+	{
+		mPartMediaSequenceNumber = mediaSequenceNumber;
+		mNextPartIndex = 0;
+		mPartOffset = 0;
+		mPartSegmentStart = playlistPosition + fragmentDurationSeconds;
+		DiscardHintedPart();
+	}
+
+	// lines of the segment start after URI of the previous segment and end with its own URI
+	const char *end = playlist.ptr + playlist.len;
+	IndexNode *node = (IndexNode *)index.ptr;
+	const char *ptr = SkipFragmentLines(node[prevIdx].pFragmentInfo, end);
+	std::vector<HlsPartialSegment> parts;
+	HlsPartialSegment hint;
+	bool discontinuity = false;
+	bool segmentComplete = false;
+	hint.typePart = false;
+	while (ptr < end && *ptr != 0x00 && !segmentComplete)
+	{
+		const char *next = NextPlaylistLine(ptr, end);
+		const char *lineEnd = ptr;
+		while (lineEnd < next && *lineEnd != CHAR_LF && *lineEnd != CHAR_CR && *lineEnd != 0x00)
 		{
-			traceprintf("%s:%d Indexed %d drm metadata\n", __FUNCTION__, __LINE__, mDrmMetaDataIndexCount);
+			lineEnd++;
 		}
-		memcpy(playlist.ptr, playlistBackup, playlist.len);
-
-		ptr = strstr(playlist.ptr, "#EXT-X-PLAYLIST-TYPE:");
-		if (ptr)
+		if (strncmp(ptr, "#EXT-X-PART:", 12) == 0 || strncmp(ptr, "#EXT-X-PRELOAD-HINT:", 20) == 0)
 		{
-			ptr += 21;
-			// EVENT or VOD (optional); VOD if playlist will never change
-			if (startswith(&ptr, "VOD"))
+			bool isHint = (strncmp(ptr, "#EXT-X-PRELOAD-HINT:", 20) == 0);
+			const char *attrList = ptr + (isHint ? 20 : 12);
+			std::string attributes(attrList, lineEnd - attrList);
+			HlsPartialSegment part;
+			part.duration = 0;
+			part.byteRange = false;
+			part.typePart = false;
+			ParseAttrList(&attributes[0], ParsePartialSegmentAttributeCallback, &part);
+			if (part.byteRange || part.uri.empty())
 			{
-				logprintf("aamp: EXT-X-PLAYLIST-TYPE - VOD\n");
-				context->playlistType = ePLAYLISTTYPE_VOD;
+				AAMPLOG_INFO("%s:%d [%s] unsupported partial segment %.*s\n", __FUNCTION__, __LINE__, name, (int)(lineEnd - ptr), ptr);
+				break;
 			}
-			else if (startswith(&ptr, "EVENT"))
+			if (isHint)
 			{
-				logprintf("aamp: EXT-X-PLAYLIST-TYPE = EVENT\n");
-				context->playlistType = ePLAYLISTTYPE_EVENT;
+				hint = part;
 			}
 			else
 			{
-				aamp_Error("unknown PLAYLIST-TYPE");
+				parts.push_back(part);
 			}
 		}
-
-		if (context->playlistType != ePLAYLISTTYPE_VOD)
+		else if (strncmp(ptr, "#EXT-X-DISCONTINUITY", 20) == 0)
 		{
-			ptr = strstr(playlist.ptr, "#EXT-X-ENDLIST");
-			if (ptr)
-			{
-				if (context->playlistType == ePLAYLISTTYPE_UNDEFINED)
-				{
-					logprintf("aamp: Found EXT-X-ENDLIST without EXT-X-PLAYLIST-TYPE\n");
-				}
-				else
-				{
-					logprintf("aamp: Found EXT-X-ENDLIST with ePLAYLISTTYPE_EVENT\n");
-				}
-				//required to avoid live adjust kicking in
-				logprintf("aamp: Changing playlist type to ePLAYLISTTYPE_VOD as ENDLIST tag present\n");
-				context->playlistType = ePLAYLISTTYPE_VOD;
-			}
+			discontinuity = true;
 		}
+		else if (ptr != lineEnd && *ptr != '#')
+		{ // URI of the segment
+			segmentComplete = true;
+		}
+		ptr = next;
 	}
 
-	{ // build new index
-		IndexNode node;
-		node.completionTimeSecondsFromStart = 0.0;
-		node.pFragmentInfo = NULL;
-		char *ptr = playlist.ptr;
-		int drmMetadataIdx = -1;
-		bool deferDrmTagPresent = false;
-		while (ptr)
+	if (mHintedPartIndex >= 0 && mHintedPartIndex < (int)parts.size())
+	{ // hinted part is listed now, cache it with its actual duration
+		if (parts[mHintedPartIndex].uri == mHintedPartUri)
 		{
-			// If enableSubscribedTags is true, examine each '#EXT' tag.
-			ptr = strstr(ptr, "#EXT");
-			if(ptr)
-			{
-				if (strncmp(ptr + 4, "INF:", 4) == 0)
-				{
-					node.pFragmentInfo = ptr;
-					indexCount++;
-					ptr += 8; // skip #EXTINF:
-					totalDuration += atof(ptr);
-					node.completionTimeSecondsFromStart = totalDuration;
-					node.drmMetadataIdx = drmMetadataIdx;
-					aamp_AppendBytes(&index, &node, sizeof(node));
-				}
-				else if (strncmp(ptr + 4, "-X-DISCONTINUITY", 16) == 0)
-				{
-					if (0 != totalDuration)
-					{
-						logprintf("%s:%d #EXT-X-DISCONTINUITY in track[%d] indexCount %d periodPosition %f\n", __FUNCTION__, __LINE__, type, indexCount, totalDuration);
-						mPeriodPositionIndex[indexCount] = totalDuration;
-					}
-				}
-				else if (strncmp(ptr + 4, "-X-KEY:", 7) == 0)
-				{
-					traceprintf("aamp: EXT-X-KEY\n");
-					ptr += strlen("#EXT-X-KEY:");
-					char* delim = strchr(ptr, CHAR_LF);
-					if (delim)
-					{
-						*delim = '\0';
-					}
-					ParseAttrList(ptr, ParseKeyAttributeCallback, this);
-					//int prtOffset = ptr-
-					//TODO optimize this
-					memcpy(playlist.ptr, playlistBackup, playlist.len);
-					drmMetadataIdx = mDrmMetaDataIndexPosition;
-					if(!fragmentEncrypted)
-					{
-						drmMetadataIdx = -1;
-						logprintf("%s:%d Not encrypted - fragmentEncrypted %d mCMSha1Hash %p\n", __FUNCTION__, __LINE__, fragmentEncrypted, mCMSha1Hash);
-					}
-				}
-				else if ( context->IsLive() && (1.0 == context->rate)
-					&& ((eTUNETYPE_NEW_NORMAL == context->mTuneType) || (eTUNETYPE_SEEKTOLIVE == context->mTuneType))
-					&& (strncmp(ptr + 4, "-X-X1-LIN-CK:", 13) == 0))
-				{
-					deferDrmTagPresent = true;
-
-					pthread_mutex_lock(&gDrmMutex);
-					if (!gDeferredDrmLicTagUnderProcessing )
-					{
-						logprintf("\n\n#############%s:%d  #EXT-X-X1-LIN-CK \n", __FUNCTION__, __LINE__);
-						ptr += 17;
-						char* delim = strchr(ptr, CHAR_LF);
-						if (delim)
-						{
-							long time = strtol(ptr, NULL, 10);
-							logprintf("time %ld\n\n", time);
-							if (time != 0 )
-							{
-								if (mDrmMetaDataIndexCount > 1)
-								{
-									if (!firstIndexDone)
-									{
-										logprintf("%s:%d #EXT-X-X1-LIN-CK on first index - not deferring license acquisition\n", __FUNCTION__, __LINE__);
-										gDeferredDrmLicRequestPending = false;
-									}
-									else
-									{
-										logprintf("%s:%d: mDrmMetaDataIndexCount %d\n", __FUNCTION__, __LINE__, mDrmMetaDataIndexCount);
-										DrmMetadataNode* drmMetadataIdx = (DrmMetadataNode*)mDrmMetaDataIndex.ptr;
-										int deferredIdx = AveDrmManager::GetNewMetadataIndex( drmMetadataIdx, mDrmMetaDataIndexCount);
-										if ( deferredIdx != -1)
-										{
-											logprintf("%s:%d: deferredIdx %d\n", __FUNCTION__, __LINE__, deferredIdx);
-											char * sha1Hash = drmMetadataIdx[deferredIdx].sha1Hash;
-											assert(sha1Hash);
-											printf("%s:%d defer acquisition of meta-data with hash - ", __FUNCTION__, __LINE__);
-											AveDrmManager::PrintSha1Hash(sha1Hash);
-											memcpy(gDeferredDrmMetaDataSha1Hash, sha1Hash, DRM_SHA1_HASH_LEN);
-											gDeferredDrmTime = aamp_GetCurrentTimeMS() + GetDeferTimeMs(time);
-											gDeferredDrmLicRequestPending = true;
-										}
-										else
-										{
-											logprintf("%s:%d: GetNewMetadataIndex failed\n", __FUNCTION__, __LINE__);
-										}
-									}
-									gDeferredDrmLicTagUnderProcessing = true;
-								}
-								else
-								{
-									logprintf("%s:%d: ERROR mDrmMetaDataIndexCount %d\n", __FUNCTION__, __LINE__, mDrmMetaDataIndexCount);
-								}
-							}
-							else
-							{
-								logprintf("%s:%d: #EXT-X-X1-LIN-CK invalid time\n", __FUNCTION__, __LINE__);
-							}
-						}
-						else
-						{
-							logprintf("%s:%d: #EXT-X-X1-LIN-CK - parse error\n", __FUNCTION__, __LINE__);
-
-						}
-					}
-					pthread_mutex_unlock(&gDrmMutex);
-				}
-				else if (gpGlobalConfig->enableSubscribedTags && (eTRACK_VIDEO == type))
-				{
-					for (int i = 0; i < aamp->subscribedTags.size(); i++)
-					{
-						int len = aamp->subscribedTags.at(i).length();
-						const char* data = aamp->subscribedTags.at(i).data();
-						if (strncmp(ptr + 4, data + 4, len - 4) == 0)
-						{
-							char *fin = strchr(ptr, CHAR_LF);
-							if (fin)
-							{
-								if (fin > ptr && fin[-1] == CHAR_CR)
-								{
-									fin--;
-								}
-							}
-							else
-							{
-								fin = strchr(ptr, '\0');
-							}
-							int nb = fin - ptr;
-							// logprintf("[AAMP_JS] Found subscribedTag[%d]: @%f '%.*s'\n", i, totalDuration, nb, ptr);
-							aamp->ReportTimedMetadata(totalDuration * 1000, data, ptr, nb);
-							break;
-						}
-					}
-				}
-				ptr += 4; // skip #EXT
-		    }
+			double duration = parts[mHintedPartIndex].duration;
+			mHintedPartIndex = -1;
+			mHintedPartUri.clear();
+			CachePartialSegment(duration, discontinuity && (0 == mNextPartIndex));
 		}
-		if(eTRACK_VIDEO == type)
+		else
 		{
-			aamp->UpdateDuration(totalDuration);
+			logprintf("%s:%d [%s] part %d is %s, not hinted %s\n", __FUNCTION__, __LINE__, name, mHintedPartIndex,
+					parts[mHintedPartIndex].uri.c_str(), mHintedPartUri.c_str());
+			DiscardHintedPart();
 		}
-
-		if (gDeferredDrmLicTagUnderProcessing && !deferDrmTagPresent)
+	}
+	if (segmentComplete && (0 == mNextPartIndex))
+	{ // segment is complete before any of its parts are fetched, fetch it as a whole
+		mPartMediaSequenceNumber = -1;
+		if (NULL == fragmentURI)
 		{
-			logprintf("%s:%d - reset gDeferredDrmLicTagUnderProcessing\n", __FUNCTION__, __LINE__);
-			gDeferredDrmLicTagUnderProcessing = false;
+			fragmentURI = FindMediaForSequenceNumber();
 		}
+		return;
 	}
-
-	if(playlistBackup)
+	while ((mHintedPartIndex < 0) && mNextPartIndex < (int)parts.size() && aamp->DownloadsAreEnabled())
 	{
-		free(playlistBackup);
+		HlsPartialSegment &part = parts[mNextPartIndex];
+		if (!FetchPartialSegment(part.uri.c_str(), part.duration, discontinuity && (0 == mNextPartIndex)))
+		{
+			fragmentURI = NULL;
+			return;
+		}
 	}
-#ifdef TRACE
-	DumpIndex(this);
-#endif
-	if (!firstIndexDone || (NULL != mCMSha1Hash))
+	if (!segmentComplete && hint.typePart && (mNextPartIndex == (int)parts.size()) && (mHintedPartIndex < 0) && aamp->DownloadsAreEnabled())
+	{ // server responds to hinted part once it is available, it is cached once playlist lists it with its duration
+		if (DownloadPartialSegment(hint.uri.c_str()))
+		{
+			mHintedPartIndex = mNextPartIndex;
+			mHintedPartUri = hint.uri;
+		}
+	}
+
+	if (segmentComplete && (mNextPartIndex >= (int)parts.size()))
 	{
-		UpdateDrmMetadata();
+		// move cursor past the segment, its parts are in cache already
+		if (NULL == fragmentURI)
+		{
+			fragmentURI = FindMediaForSequenceNumber();
+		}
+		if (fragmentURI)
+		{
+			fragmentURI = GetNextFragmentUriFromPlaylist();
+		}
+		if (fragmentURI)
+		{
+			playTarget = playlistPosition + fragmentDurationSeconds;
+			AAMPLOG_INFO("%s:%d [%s] segment %lld complete, %d parts duration %f segment duration %f\n", __FUNCTION__, __LINE__, name,
+					mPartMediaSequenceNumber, mNextPartIndex, mPartOffset, fragmentDurationSeconds);
+		}
+		mPartMediaSequenceNumber = -1;
+		mNextPartIndex = 0;
+	}
+	else
+	{ // wait for playlist update
+		fragmentURI = NULL;
 	}
-	firstIndexDone = true;
-	traceprintf("%s:%d Exit indexCount %d mDrmMetaDataIndexCount %d\n", __FUNCTION__, __LINE__, indexCount, mDrmMetaDataIndexCount);
-	return totalDuration;
 }
 
 #ifdef AAMP_HARVEST_SUPPORT_ENABLED
@@ -2024,6 +3046,39 @@ void TrackState::ABRProfileChanged()
 	pthread_mutex_unlock(&mutex);
 }
 /***************************************************************************
+* @fn SwitchRendition
+* @brief Function to re-point track to playlist of current language
+*
+* Called from fetch loop on request of SwitchAudioTrack, once injector is
+* stopped and sink flushed. Fetch restarts from fragment being played.
+* @return void
+***************************************************************************/
+void TrackState::SwitchRendition()
+{
+	double aheadOfPlayback = FlushFragments();
+	int rewindCount = 1;
+	if (fragmentDurationSeconds > 0)
+	{
+		rewindCount += (int)(aheadOfPlayback / fragmentDurationSeconds);
+	}
+	double rewindSeconds = rewindCount * fragmentDurationSeconds;
+	aamp_ResolveURL(playlistUrl, aamp->GetManifestUrl(), context->GetPlaylistURI(type));
+	logprintf("%s:%d [%s] playlist %s rewind %d fragments\n", __FUNCTION__, __LINE__, name, playlistUrl, rewindCount);
+	pthread_mutex_lock(&mutex);
+	// VOD is positioned by playTarget, live by media sequence number
+	playTarget -= rewindSeconds;
+	if (playTarget < 0)
+	{
+		playTarget = 0;
+	}
+	playlistPosition -= rewindSeconds;
+	nextMediaSequenceNumber -= rewindCount;
+	eosReached = false;
+	refreshPlaylist = true;
+	pthread_mutex_unlock(&mutex);
+	StartInjectLoop(true);
+}
+/***************************************************************************
 * @fn RefreshPlaylist
 * @brief Function to redownload playlist after refresh interval .
 *		 
@@ -2038,11 +3093,49 @@ void TrackState::RefreshPlaylist(void)
 	double prevSecondsBeforePlayPoint = GetCompletionTimeForFragment(this, commonPlayPosition);
 	GrowableBuffer tempBuff;
 	long http_error = 0;
+	char deltaPlaylistUrl[MAX_URI_LENGTH];
+	const char *requestUrl = playlistUrl;
+	long long prevPlaylistDownloadTimeMS = lastPlaylistDownloadTimeMS;
+	std::string directives;
+	bool deltaUpdateRequested = false;
+	bool deltaUpdateHeldOff = false;
 
 	// note: this used to be updated only upon succesful playlist download
 	// this can lead to back-to-back playlist download retries
 	lastPlaylistDownloadTimeMS = aamp_GetCurrentTimeMS();
 
+	// Delta update can be requested only if the playlist being updated is younger than half of CAN-SKIP-UNTIL
+	if (gpGlobalConfig->hlsDeltaUpdate && (mDeltaUpdateFailCount < MAX_DELTA_UPDATE_FAILURES) && (mCanSkipUntil > 0) && playlist.ptr && !refreshPlaylist
+		&& (0 == manifestDLFailCount) && !context->mNetworkDownDetected && (ePLAYLISTTYPE_VOD != context->playlistType)
+		&& ((lastPlaylistDownloadTimeMS - prevPlaylistDownloadTimeMS) < (long long)(mCanSkipUntil * 1000 / 2)))
+	{
+		if (mDeltaUpdateHoldOff > 0)
+		{ // full playlists are requested for a while after a failed delta update
+			deltaUpdateHeldOff = true;
+		}
+		else
+		{
+			directives = "_HLS_skip=YES";
+			deltaUpdateRequested = true;
+		}
+	}
+	// Blocking reload at live edge, server responds once the part following the cached ones is available
+	if (mCanBlockReload && (NULL == fragmentURI) && !refreshPlaylist && playlist.ptr && IsLowLatencyActive())
+	{
+		char blockingReload[64];
+		snprintf(blockingReload, sizeof(blockingReload), "_HLS_msn=%lld&_HLS_part=%d", nextMediaSequenceNumber,
+				(mPartMediaSequenceNumber == nextMediaSequenceNumber) ? mNextPartIndex : 0);
+		directives = directives.empty() ? std::string(blockingReload) : (std::string(blockingReload) + "&" + directives);
+	}
+	if (!directives.empty())
+	{
+		int len = snprintf(deltaPlaylistUrl, MAX_URI_LENGTH, "%s%c%s", playlistUrl, strchr(playlistUrl, '?') ? '&' : '?', directives.c_str());
+		if (len > 0 && len < MAX_URI_LENGTH)
+		{
+			requestUrl = deltaPlaylistUrl;
+		}
+	}
+
 #ifdef WIN32
 	logprintf("\npre-refresh %fs before %lld\n", prevSecondsBeforePlayPoint, commonPlayPosition);
 #endif
@@ -2059,23 +3152,53 @@ void TrackState::RefreshPlaylist(void)
 		memset(&tempBuff, 0, sizeof(tempBuff));
 	}
 
-	aamp->GetFile(playlistUrl, &playlist, effectiveUrl, &http_error, NULL, type, true, eMEDIATYPE_MANIFEST);
+	aamp->GetFile(requestUrl, &playlist, effectiveUrl, &http_error, NULL, type, true, eMEDIATYPE_MANIFEST);
+	if (playlist.len && requestUrl != playlistUrl)
+	{
+		aamp_AppendNulTerminator(&playlist);
+		if (!MergeDeltaPlaylist(tempBuff))
+		{
+			mDeltaUpdateFailCount++;
+			mDeltaUpdateHoldOff = mDeltaUpdateFailCount;
+			logprintf("%s:%d [%s] Delta update can't be applied (%d in a row), fetch full playlist%s\n", __FUNCTION__, __LINE__, name,
+					mDeltaUpdateFailCount, (mDeltaUpdateFailCount < MAX_DELTA_UPDATE_FAILURES) ? "" : ", delta update disabled");
+			aamp_Free(&playlist.ptr);
+			memset(&playlist, 0, sizeof(playlist));
+			aamp->GetFile(playlistUrl, &playlist, effectiveUrl, &http_error, NULL, type, true, eMEDIATYPE_MANIFEST);
+		}
+		else
+		{ // terminator is appended again as for full playlists
+			playlist.len -= 2;
+			if (deltaUpdateRequested)
+			{
+				mDeltaUpdateFailCount = 0;
+			}
+		}
+	}
 
 	if (playlist.len)
 	{ // download successful
 		//lastPlaylistDownloadTimeMS = aamp_GetCurrentTimeMS();
+		if (deltaUpdateHeldOff)
+		{
+			mDeltaUpdateHoldOff--;
+		}
 		if (context->mNetworkDownDetected)
 		{
 			context->mNetworkDownDetected = false;
 		}
-		aamp_Free(&tempBuff.ptr);
 		aamp_AppendNulTerminator(&playlist); // hack: make safe for cstring operationsaamp_AppendNulTerminator(&this->mainManifest); // make safe for cstring operations
 		if (gpGlobalConfig->logging.trace )
 		{
 			logprintf("***New Playlist:**************\n\n%s\n*************\n", playlist.ptr);
 		}
 
-		IndexPlaylist();
+		// previous playlist is needed till index is rebased to the new one
+		if (refreshPlaylist || !IndexPlaylistDelta(tempBuff.ptr))
+		{
+			IndexPlaylist();
+		}
+		aamp_Free(&tempBuff.ptr);
 #ifdef AAMP_HARVEST_SUPPORT_ENABLED
 		const char* prefix = (type == eTRACK_AUDIO)?"aud-":(context->trickplayMode)?"ifr-":"vid-";
 		context->HarvestFile(playlistUrl, &playlist, false, prefix);
@@ -2635,9 +3758,33 @@ AAMPStatusType StreamAbstractionAAMP_HLS::Init(TuneType tuneType)
         }
 		aamp->profiler.SetBandwidthBitsPerSecondAudio(audio->GetCurrentBandWidth());
 
-		pthread_t trackPLDownloadThreadID;
-		bool trackPLDownloadThreadStarted = false;
+		// playlists are fetched concurrently by download jobs, video playlist is fetched by this thread
+		AampDownloadJob audioPlaylistJob;
+		bool audioPlaylistJobQueued = false;
+		AampDownloadJob iframePlaylistJob;
+		bool iframePlaylistJobQueued = false;
+		IframePlaylistPrefetch iframePlaylist;
 		bool insertPlaylistToCache[AAMP_TRACK_COUNT] = {false, false};
+		memset(&iframePlaylist.playlist, 0, sizeof(iframePlaylist.playlist));
+		iframePlaylist.http_error = 0;
+		bool iframePlaylistWanted = false;
+		if (newTune && gpGlobalConfig->prefetchIframePlaylist)
+		{
+			int iframeStreamIdx = GetIframeTrack();
+			if (0 <= iframeStreamIdx)
+			{
+				iframePlaylistWanted = true;
+				iframePlaylist.aamp = aamp;
+				aamp_ResolveURL(iframePlaylist.url, aamp->GetManifestUrl(), streamInfo[iframeStreamIdx].uri);
+				if (gpGlobalConfig->playlistsParallelFetch)
+				{
+					// not known to be VOD yet, playlist is discarded if stream turns out to be live
+					iframePlaylistJob.run = IframePLDownloader;
+					iframePlaylistJob.arg = &iframePlaylist;
+					iframePlaylistJobQueued = aamp->SubmitDownloadJob(&iframePlaylistJob);
+				}
+			}
+		}
 		if (audio->enabled)
 		{
 			if (retrievePlaylistFromCache)
@@ -2651,17 +3798,11 @@ AAMPStatusType StreamAbstractionAAMP_HLS::Init(TuneType tuneType)
 			{
 				if (gpGlobalConfig->playlistsParallelFetch)
 				{
-					int ret = pthread_create(&trackPLDownloadThreadID, NULL, TrackPLDownloader, audio);
-					if(ret != 0)
-					{
-						logprintf("StreamAbstractionAAMP_HLS::%s:%d pthread_create failed for TrackPLDownloader with errno = %d, %s\n", __FUNCTION__, __LINE__, errno, strerror(errno));
-					}
-					else
-					{
-						trackPLDownloadThreadStarted = true;
-					}
+					audioPlaylistJob.run = TrackPLDownloader;
+					audioPlaylistJob.arg = audio;
+					audioPlaylistJobQueued = aamp->SubmitDownloadJob(&audioPlaylistJob);
 				}
-				else
+				if (!audioPlaylistJobQueued)
 				{
 					audio->FetchPlaylist();
 				}
@@ -2683,13 +3824,18 @@ AAMPStatusType StreamAbstractionAAMP_HLS::Init(TuneType tuneType)
 				insertPlaylistToCache[eMEDIATYPE_VIDEO] = aamp->mEnableCache;
 			}
 		}
-		if (trackPLDownloadThreadStarted)
+		if (audioPlaylistJobQueued)
 		{
-			pthread_join(trackPLDownloadThreadID, NULL);
+			aamp->WaitForDownloadJob(&audioPlaylistJob);
+		}
+		if (iframePlaylistJobQueued)
+		{ // small compared to track playlists, typically done by now
+			aamp->WaitForDownloadJob(&iframePlaylistJob);
 		}
 		if ((video->enabled && !video->playlist.len) || (audio->enabled && !audio->playlist.len))
 		{
 			logprintf("StreamAbstractionAAMP_HLS::%s:%d Playlist download failed\n",__FUNCTION__,__LINE__);
+			aamp_Free(&iframePlaylist.playlist.ptr);
 			return eAAMPSTATUS_MANIFEST_DOWNLOAD_ERROR;
 		}
 
@@ -2700,6 +3846,13 @@ AAMPStatusType StreamAbstractionAAMP_HLS::Init(TuneType tuneType)
 			TrackState *ts = trackState[iTrack];
 
 			aamp->SetCurlTimeout(gpGlobalConfig->fragmentDLTimeout, iTrack);
+			if (gpGlobalConfig->hlsFragmentPrefetchCount > 1)
+			{
+				for (int i = 0; i < AAMP_MAX_PREFETCH_FRAGMENTS - 1; i++)
+				{
+					aamp->SetCurlTimeout(gpGlobalConfig->fragmentDLTimeout, AAMP_PREFETCH_CURL_START + iTrack * (AAMP_MAX_PREFETCH_FRAGMENTS - 1) + i);
+				}
+			}
 
 			if(ts->enabled)
 			{
@@ -2948,6 +4101,7 @@ AAMPStatusType StreamAbstractionAAMP_HLS::Init(TuneType tuneType)
 		if ((video->enabled && totalDuration[eMEDIATYPE_VIDEO] == 0.0f) || (audio->enabled && totalDuration[eMEDIATYPE_AUDIO] == 0.0f))
 		{
 			logprintf("StreamAbstractionAAMP_HLS::%s:%d Track Duration is 0. Cannot play this content\n", __FUNCTION__, __LINE__);
+			aamp_Free(&iframePlaylist.playlist.ptr);
 			return eAAMPSTATUS_MANIFEST_CONTENT_ERROR;
 		}
 
@@ -3017,6 +4171,7 @@ AAMPStatusType StreamAbstractionAAMP_HLS::Init(TuneType tuneType)
 					logprintf("StreamAbstractionAAMP_HLS::%s:%d seek target out of range, mark EOS. playTarget:%f End:%f. \n",
 							__FUNCTION__,__LINE__,video->playTarget, seekWindowEnd);
 
+					aamp_Free(&iframePlaylist.playlist.ptr);
 					return eAAMPSTATUS_SEEK_RANGE_ERROR;
 				}
 			}
@@ -3036,6 +4191,7 @@ AAMPStatusType StreamAbstractionAAMP_HLS::Init(TuneType tuneType)
 
                     if (eAAMPSTATUS_OK != retValue)
                     {
+                        aamp_Free(&iframePlaylist.playlist.ptr);
                         return retValue;
                     }
                 }
@@ -3044,6 +4200,12 @@ AAMPStatusType StreamAbstractionAAMP_HLS::Init(TuneType tuneType)
 		if (liveAdjust)
 		{
 			int offsetFromLive = aamp->mLiveOffset ; 
+			if (video->IsLowLatencyActive())
+			{ // first segment is fetched whole, following ones part by part as they are produced
+				offsetFromLive = gpGlobalConfig->lowLatencyLiveOffset;
+				logprintf("StreamAbstractionAAMP_HLS::%s:%d LL-HLS PART-TARGET %f PART-HOLD-BACK %f, live offset %d\n", __FUNCTION__, __LINE__,
+						video->mPartTargetDuration, video->mPartHoldBack, offsetFromLive);
+			}
 	
 			if ( totalDuration[eMEDIATYPE_VIDEO] > (offsetFromLive + video->playTargetOffset))
 			{
@@ -3091,29 +4253,24 @@ AAMPStatusType StreamAbstractionAAMP_HLS::Init(TuneType tuneType)
 		{
 			aamp->ClearPlaylistCache();
 		}
-		else if (newTune && gpGlobalConfig->prefetchIframePlaylist)
+		else if (iframePlaylistWanted)
 		{
-			int iframeStreamIdx = GetIframeTrack();
-			if (0 <= iframeStreamIdx)
+			if (!iframePlaylistJobQueued)
+			{ // fetched serially once known to be VOD
+				IframePLDownloader(&iframePlaylist);
+			}
+			if (iframePlaylist.playlist.len)
 			{
-				char defaultIframePlaylistUrl[MAX_URI_LENGTH];
-				char defaultIframePlaylistEffectiveUrl[MAX_URI_LENGTH];
-				GrowableBuffer defaultIframePlaylist;
-				aamp_ResolveURL(defaultIframePlaylistUrl, aamp->GetManifestUrl(), streamInfo[iframeStreamIdx].uri);
-				traceprintf("StreamAbstractionAAMP_HLS::%s:%d : Downloading iframe playlist\n", __FUNCTION__, __LINE__);
-				aamp->GetFile(defaultIframePlaylistUrl, &defaultIframePlaylist, defaultIframePlaylistEffectiveUrl, &http_error);
-				if (defaultIframePlaylist.len)
-				{
-					aamp->InsertToPlaylistCache(defaultIframePlaylistUrl, &defaultIframePlaylist, defaultIframePlaylistEffectiveUrl);
-					traceprintf("StreamAbstractionAAMP_HLS::%s:%d : Cached iframe playlist\n", __FUNCTION__, __LINE__);
-				}
-				else
-				{
-					logprintf("StreamAbstractionAAMP_HLS::%s:%d : Error Download iframe playlist. http_error %ld\n",
-					        __FUNCTION__, __LINE__, http_error);
-				}
+				aamp->InsertToPlaylistCache(iframePlaylist.url, &iframePlaylist.playlist, iframePlaylist.effectiveUrl);
+				traceprintf("StreamAbstractionAAMP_HLS::%s:%d : Cached iframe playlist\n", __FUNCTION__, __LINE__);
+			}
+			else
+			{
+				logprintf("StreamAbstractionAAMP_HLS::%s:%d : Error Download iframe playlist. http_error %ld\n",
+				        __FUNCTION__, __LINE__, iframePlaylist.http_error);
 			}
 		}
+		aamp_Free(&iframePlaylist.playlist.ptr);
 		retval = eAAMPSTATUS_OK;
 	}
 	return retval;
@@ -3150,7 +4307,15 @@ void TrackState::RunFetchLoop()
 	{
 		while (fragmentURI && aamp->DownloadsAreEnabled())
 		{
-			FetchFragment();
+			if ((mNextPartIndex > 0 || mHintedPartIndex >= 0) && (mPartMediaSequenceNumber == nextMediaSequenceNumber) && IsLowLatencyActive())
+			{ // segment is partially cached, continue with its parts
+				FetchPartialSegments();
+			}
+			else
+			{
+				DiscardHintedPart();
+				FetchFragment();
+			}
 
 			// FetchFragment involves multiple wait operations, so check download status again
 			if (!aamp->DownloadsAreEnabled())
@@ -3199,6 +4364,10 @@ void TrackState::RunFetchLoop()
 				}
 #endif
 			}
+			if (TakeRenditionSwitchRequest())
+			{
+				SwitchRendition();
+			}
 			pthread_mutex_lock(&mutex);
 			if(refreshPlaylist)
 			{
@@ -3210,12 +4379,42 @@ void TrackState::RunFetchLoop()
 		// reached end of vod stream
 		//teststreamer_EndOfStreamReached();
 
+		if (TakeRenditionSwitchRequest() && aamp->DownloadsAreEnabled())
+		{ // requested after last fragment of playlist was fetched
+			SwitchRendition();
+			pthread_mutex_lock(&mutex);
+			RefreshPlaylist();
+			refreshPlaylist = false;
+			pthread_mutex_unlock(&mutex);
+			continue;
+		}
 		if (eosReached || context->hasEndListTag || !context->aamp->DownloadsAreEnabled())
 		{
+			if (!FinishFetching())
+			{ // rendition switch requested meanwhile
+				continue;
+			}
 			AbortWaitForCachedFragment(false);
 			break;
 		}
-		if (lastPlaylistDownloadTimeMS)
+		if (IsLowLatencyActive())
+		{
+			// fetch parts of segment being produced, playlist reload blocks till next part is available
+			FetchPartialSegments();
+			if (aamp->DownloadsAreEnabled())
+			{
+				int delayMs = (int)(mPartTargetDuration * 1000);
+				if (mCanBlockReload)
+				{ // server may answer a blocking reload at once, e.g. with unchanged playlist; don't spin
+					delayMs = (int)(mPartTargetDuration * 1000 / 2) - (int)(aamp_GetCurrentTimeMS() - lastPlaylistDownloadTimeMS);
+				}
+				if (delayMs > 0)
+				{
+					aamp->InterruptableMsSleep(delayMs);
+				}
+			}
+		}
+		else if (lastPlaylistDownloadTimeMS)
 		{
 			// if not present, new playlist wih at least one additional segment will be available
 			// no earlier than 0.5*EXT-TARGETDURATION and no later than 1.5*EXT-TARGETDURATION
@@ -3348,6 +4547,14 @@ StreamAbstractionAAMP_HLS::StreamAbstractionAAMP_HLS(class PrivateInstanceAAMP *
 	memset(&trackState[0], 0x00, sizeof(trackState));
 	mStartTimestampZero = false;
 	aamp->CurlInit(0, AAMP_TRACK_COUNT);
+	if (gpGlobalConfig->hlsFragmentPrefetchCount > 1)
+	{
+		aamp->CurlInit(AAMP_PREFETCH_CURL_START, AAMP_PREFETCH_CURL_COUNT);
+	}
+	if (gpGlobalConfig->prefetchIframePlaylist)
+	{
+		aamp->CurlInit(AAMP_PLAYLIST_PREFETCH_CURL, 1);
+	}
 	lastSelectedProfileIndex = 0;
 }
 /***************************************************************************
@@ -3370,7 +4577,9 @@ TrackState::TrackState(TrackType type, StreamAbstractionAAMP_HLS* parent, Privat
 		refreshPlaylist(false), fragmentCollectorThreadID(0),
 		fragmentCollectorThreadStarted(false),
 		manifestDLFailCount(0),
-		mCMSha1Hash(NULL), mDrmTimeStamp(0), mDrmMetaDataIndexCount(0),firstIndexDone(false), mDrm(NULL)
+		mCMSha1Hash(NULL), mDrmTimeStamp(0), mDrmMetaDataIndexCount(0), mCanSkipUntil(0),
+		mCanBlockReload(false), mPartHoldBack(0), mPartTargetDuration(0), firstIndexDone(false), mDeltaUpdateFailCount(0), mDeltaUpdateHoldOff(0),
+		mPartMediaSequenceNumber(-1), mNextPartIndex(0), mPartSegmentStart(0), mPartOffset(0), mHintedPartIndex(-1), mHintedPartUri(), mDrm(NULL), mAesDec(NULL), mStreamDecryptor(NULL)
 {
 	this->context = parent;
 	targetDurationSeconds = 1; // avoid tight loop
@@ -3396,9 +4605,9 @@ TrackState::TrackState(TrackType type, StreamAbstractionAAMP_HLS* parent, Privat
 TrackState::~TrackState()
 {
 	aamp_Free(&playlist.ptr);
-	for (int j=0; j< gpGlobalConfig->maxCachedFragmentsPerTrack; j++)
+	for (int j=0; j< maxCachedFragments; j++)
 	{
-		aamp_Free(&cachedFragment[j].fragment.ptr);
+		aamp_FreeBuffer(&cachedFragment[j].fragment);
 	}
 	FlushIndex();
 	if (playContext)
@@ -3417,6 +4626,10 @@ TrackState::~TrackState()
 	{
 		free(mDrmInfo.uri);
 	}
+#ifdef AAMP_VANILLA_AES_SUPPORT
+	delete mStreamDecryptor;
+	delete mAesDec;
+#endif
 }
 /***************************************************************************
 * @fn Stop
@@ -3471,6 +4684,8 @@ StreamAbstractionAAMP_HLS::~StreamAbstractionAAMP_HLS()
 	aamp->SyncBegin();
 	aamp_Free(&this->mainManifest.ptr);
 	aamp->CurlTerm(0, AAMP_TRACK_COUNT);
+	aamp->CurlTerm(AAMP_PREFETCH_CURL_START, AAMP_PREFETCH_CURL_COUNT);
+	aamp->CurlTerm(AAMP_PLAYLIST_PREFETCH_CURL, 1);
 	aamp->SyncEnd();
 }
 /***************************************************************************
@@ -3553,6 +4768,53 @@ void StreamAbstractionAAMP_HLS::Stop(bool clearChannelData)
 	}
 }
 /***************************************************************************
+* @fn SwitchAudioTrack
+* @brief Function to switch audio track to rendition of current language
+*
+* Only audio track is stopped, flushed and re-pointed, video keeps playing.
+* Fetch loop of audio resumes from playback position with new playlist.
+* @return true if switch is started, false if a retune is needed
+***************************************************************************/
+bool StreamAbstractionAAMP_HLS::SwitchAudioTrack()
+{
+	TrackState *audio = trackState[eMEDIATYPE_AUDIO];
+	if (trickplayMode || rate != 1.0 || !audio || !audio->Enabled() || audio->eosReached
+		|| (FORMAT_NONE == audio->streamOutputFormat) || audio->IsLowLatencyActive())
+	{
+		logprintf("StreamAbstractionAAMP_HLS::%s:%d audio track can't be switched alone\n", __FUNCTION__, __LINE__);
+		return false;
+	}
+	const char *uri = GetPlaylistURI(eTRACK_AUDIO);
+	if (!uri)
+	{
+		logprintf("StreamAbstractionAAMP_HLS::%s:%d no audio playlist for language %s\n", __FUNCTION__, __LINE__, aamp->language);
+		return false;
+	}
+	char playlistUrl[MAX_URI_LENGTH];
+	aamp_ResolveURL(playlistUrl, aamp->GetManifestUrl(), uri);
+	if (0 == strcmp(playlistUrl, audio->playlistUrl))
+	{
+		logprintf("StreamAbstractionAAMP_HLS::%s:%d audio playlist unchanged\n", __FUNCTION__, __LINE__);
+		return true;
+	}
+	StopAudioInjection();
+	if (audio->playContext)
+	{ // push partial ES of old rendition, base PTS shared with video is kept
+		audio->playContext->flush();
+	}
+	if (!aamp->FlushTrack(eMEDIATYPE_AUDIO))
+	{
+		audio->StartInjectLoop(true);
+		return false;
+	}
+	if (!audio->RequestRenditionSwitch())
+	{
+		logprintf("StreamAbstractionAAMP_HLS::%s:%d audio fetch already done\n", __FUNCTION__, __LINE__);
+		return false;
+	}
+	return true;
+}
+/***************************************************************************
 * @fn DumpProfiles
 * @brief Function to log debug information on Stream/Media information
 *		 
@@ -3674,31 +4936,56 @@ std::vector<long> StreamAbstractionAAMP_HLS::GetAudioBitrates(void)
 *		 
 * @param cachedFragment[in] CachedFragment struction pointer 	
 * @param bucketTypeFragmentDecrypt[in] ProfilerBucketType enum
+* @param streamDecrypt[in] true if fragment was fed to stream decryptor while downloaded
 * @return bool true if successfully decrypted 
 ***************************************************************************/
-DrmReturn TrackState::DrmDecrypt( CachedFragment * cachedFragment, ProfilerBucketType bucketTypeFragmentDecrypt)
+DrmReturn TrackState::DrmDecrypt( CachedFragment * cachedFragment, ProfilerBucketType bucketTypeFragmentDecrypt, bool streamDecrypt)
 {
 		DrmReturn drmReturn = eDRM_ERROR;
-		if (aamp->DownloadsAreEnabled())
+#ifdef AAMP_VANILLA_AES_SUPPORT
+		if (streamDecrypt && aamp->DownloadsAreEnabled())
 		{
-			drmReturn = eDRM_ERROR;
-			pthread_mutex_lock(&gDrmMutex);
-			bool isVanilaAES = ((eMETHOD_AES_128 ==mDrmInfo.method ) && ( 0 == mDrmMetaDataIndexCount));
-			if (!mDrm || (mCMSha1Hash) || isVanilaAES)
+			drmReturn = mStreamDecryptor->Finish(bucketTypeFragmentDecrypt, (unsigned char *)cachedFragment->fragment.ptr,
+					cachedFragment->fragment.len, MAX_LICENSE_ACQ_WAIT_TIME);
+			if ((eDRM_ERROR == drmReturn) && (0 == mStreamDecryptor->GetDecryptedLen()))
 			{
-				SetDrmContextUnlocked();
+				// key of fragment was not available to stream decryptor and payload is untouched
+				AAMPLOG_WARN("%s:%d [%s] stream decrypt not possible, decrypting whole fragment\n", __FUNCTION__, __LINE__, name);
+				streamDecrypt = false;
 			}
-			else if ((eMETHOD_AES_128 ==mDrmInfo.method ) && ( 0 == mDrmMetaDataIndexCount))
+		}
+#else
+		streamDecrypt = false;
+#endif
+		if (!streamDecrypt && aamp->DownloadsAreEnabled())
+		{
+			drmReturn = eDRM_ERROR;
+			bool isVanilaAES = ((eMETHOD_AES_128 ==mDrmInfo.method ) && ( 0 == mDrmMetaDataIndexCount));
+			if (isVanilaAES)
 			{
+				// decryptor is owned by the track, no need to serialize with other tracks
 				SetDrmContextUnlocked();
+				if(mDrm)
+				{
+					drmReturn = mDrm->Decrypt(bucketTypeFragmentDecrypt, cachedFragment->fragment.ptr,
+							cachedFragment->fragment.len, MAX_LICENSE_ACQ_WAIT_TIME);
+				}
 			}
-			if(mDrm)
+			else
 			{
-				drmReturn = mDrm->Decrypt(bucketTypeFragmentDecrypt, cachedFragment->fragment.ptr,
-						cachedFragment->fragment.len, MAX_LICENSE_ACQ_WAIT_TIME);
+				pthread_mutex_lock(&gDrmMutex);
+				if (!mDrm || (mCMSha1Hash))
+				{
+					SetDrmContextUnlocked();
+				}
+				if(mDrm)
+				{
+					drmReturn = mDrm->Decrypt(bucketTypeFragmentDecrypt, cachedFragment->fragment.ptr,
+							cachedFragment->fragment.len, MAX_LICENSE_ACQ_WAIT_TIME);
 
+				}
+				pthread_mutex_unlock(&gDrmMutex);
 			}
-			pthread_mutex_unlock(&gDrmMutex);
 		}
 
 		if (drmReturn != eDRM_SUCCESS)
@@ -3708,6 +4995,36 @@ DrmReturn TrackState::DrmDecrypt( CachedFragment * cachedFragment, ProfilerBucke
 		return drmReturn;
 }
 /***************************************************************************
+* @fn GetStreamDecryptor
+* @brief Function to get decryptor to run on next fragment while it is downloaded
+*
+* Only vanilla AES-128 fragments are decrypted while downloading, key request
+* is kicked off here so that it overlaps with the fragment download.
+* Decryption runs on the fetcher thread also with download scheduler, whose
+* write callback only hands received data over to the fetcher.
+* @return decryptor to pass to GetFile, NULL if fragment is decrypted after download
+***************************************************************************/
+AampStreamDecryptor* TrackState::GetStreamDecryptor()
+{
+	AampStreamDecryptor* decryptor = NULL;
+#ifdef AAMP_VANILLA_AES_SUPPORT
+	if (gpGlobalConfig->hlsStreamingDecrypt && fragmentEncrypted && (eMETHOD_AES_128 == mDrmInfo.method)
+			&& (0 == mDrmMetaDataIndexCount) && mDrmInfo.uri && aamp->DownloadsAreEnabled())
+	{
+		SetDrmContextUnlocked();
+		if (!mStreamDecryptor)
+		{
+			mStreamDecryptor = new AesStreamDecryptor();
+		}
+		if (mStreamDecryptor->Init(aamp, mAesDec, &mDrmInfo))
+		{
+			decryptor = mStreamDecryptor;
+		}
+	}
+#endif
+	return decryptor;
+}
+/***************************************************************************
 * @fn GetContext
 * @brief Function to get current StreamAbstractionAAMP instance value 
 *		 
@@ -3771,8 +5088,12 @@ void TrackState::SetDrmContextUnlocked()
 	else
 	{
 #ifdef AAMP_VANILLA_AES_SUPPORT
-		AAMPLOG_INFO("StreamAbstractionAAMP_HLS::%s:%d Get AesDec\n", __FUNCTION__, __LINE__);
-		mDrm = AesDec::GetInstance();
+		if (!mAesDec)
+		{
+			AAMPLOG_INFO("StreamAbstractionAAMP_HLS::%s:%d [%s] Create AesDec\n", __FUNCTION__, __LINE__, name);
+			mAesDec = new AesDec(AAMP_TRACK_COUNT + type);
+		}
+		mDrm = mAesDec;
 		aamp->setCurrentDrm(eDRM_Vanilla_AES);
 #else
 		logprintf("StreamAbstractionAAMP_HLS::%s:%d AAMP_VANILLA_AES_SUPPORT not defined\n", __FUNCTION__, __LINE__);
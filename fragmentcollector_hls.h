@@ -106,6 +106,59 @@ struct IndexNode
 	int drmMetadataIdx;						/**< DRM Index for Fragment */
 };
 
+/**
+*	\struct	PlaylistIndexState
+* 	\brief	State carried from line to line while indexing a media playlist
+*/
+struct PlaylistIndexState
+{
+	double totalDuration;					/**< Completion time of last indexed fragment */
+	int drmMetadataIdx;						/**< DRM Index applied to following fragments */
+	bool mediaSequenceFound;				/**< EXT-X-MEDIA-SEQUENCE already parsed */
+	bool targetDurationFound;				/**< EXT-X-TARGETDURATION already parsed */
+	bool playlistTypeFound;					/**< EXT-X-PLAYLIST-TYPE already parsed */
+	bool endListFound;						/**< EXT-X-ENDLIST present */
+	bool reportSubscribedTags;				/**< Report tags subscribed by application */
+	std::vector<std::pair<const char *, double> > deferDrmTags; /**< EXT-X-X1-LIN-CK tags and their position */
+};
+
+/**
+*	\struct	IframePlaylistPrefetch
+* 	\brief	Iframe playlist downloaded along with track playlists at tune
+*/
+struct IframePlaylistPrefetch
+{
+	PrivateInstanceAAMP *aamp;				/**< Player instance */
+	char url[MAX_URI_LENGTH];				/**< Iframe playlist url */
+	char effectiveUrl[MAX_URI_LENGTH];		/**< Url after redirection */
+	GrowableBuffer playlist;				/**< Downloaded playlist */
+	long http_error;						/**< Download error */
+};
+
+/**
+*	\struct	PrefetchFragment
+* 	\brief	Fragment resolved from playlist and downloaded ahead of the write position
+*/
+struct PrefetchFragment
+{
+	class TrackState *track;				/**< Track owning the fragment */
+	CachedFragment *cachedFragment;			/**< Cache slot the fragment is downloaded to */
+	char *fragmentURI;						/**< Fragment URI line in playlist */
+	double playTarget;						/**< Play target after the fragment */
+	double fragmentDurationSeconds;			/**< Duration of the fragment */
+	long long nextMediaSequenceNumber;		/**< Media sequence number following the fragment */
+	bool discontinuity;						/**< Discontinuity before the fragment */
+	unsigned int curlInstance;				/**< Curl instance used for download */
+	char fragmentUrl[MAX_URI_LENGTH];		/**< Resolved fragment URL */
+	char effectiveUrl[MAX_URI_LENGTH];		/**< Effective URL after redirection */
+	char range[128];						/**< Byte range, empty if not applicable */
+	long http_error;						/**< Download error */
+	bool fetched;							/**< Download status */
+};
+
+class AesDec;
+class AesStreamDecryptor;
+
 /**
  * \class TrackState
  * \brief State Machine for each Media Track
@@ -138,7 +191,9 @@ public:
 	/// Function to set the DRM Metadata into Adobe DRM Layer 
 	void SetDrmContextUnlocked();
 	/// Function to decrypt the fragment data 
-	DrmReturn DrmDecrypt(CachedFragment* cachedFragment, ProfilerBucketType bucketType);
+	DrmReturn DrmDecrypt(CachedFragment* cachedFragment, ProfilerBucketType bucketType, bool streamDecrypt = false);
+	/// Function to get decryptor to run on next fragment while it is downloaded
+	AampStreamDecryptor* GetStreamDecryptor();
 	/// Function to fetch the Playlist file
 	void FetchPlaylist();
 	/// Process Drm Metadata after indexing
@@ -168,15 +223,56 @@ public:
 	 */
 	int GetNumberOfPeriods();
 
+	/// Function to download a fragment resolved ahead of the write position
+	void DownloadFragmentAhead(PrefetchFragment *prefetchFragment);
+	/// Function to check if LL-HLS partial segments are fetched at live edge
+	bool IsLowLatencyActive();
+
 private:
 	/// Function to get fragment URI based on Index 
 	char *GetFragmentUriFromIndex();
 	/// Function to flush all the downloads done 
 	void FlushIndex();
+	/// Function to index playlist lines starting at ptr
+	void IndexPlaylistLines(const char *ptr, PlaylistIndexState &state);
+	/// Function to update index with the tail of a refreshed live playlist
+	bool IndexPlaylistDelta(const char *prevPlaylist);
+	/// Function to expand EXT-X-SKIP of a delta playlist update
+	bool MergeDeltaPlaylist(const GrowableBuffer &prevPlaylist);
+	/// Function to parse EXT-X-SERVER-CONTROL tag
+	void ParseServerControl(const char *attrList, const char *lineEnd);
+	/// Function to fetch partial segments of the segment following current one
+	void FetchPartialSegments();
+	/// Function to download a partial segment and add it to cache
+	bool FetchPartialSegment(const char *uri, double duration, bool discontinuity);
+	/// Function to download a partial segment into the fetch slot of cache
+	bool DownloadPartialSegment(const char *uri);
+	/// Function to add partial segment downloaded to fetch slot to cache
+	void CachePartialSegment(double duration, bool discontinuity);
+	/// Function to drop partial segment downloaded from EXT-X-PRELOAD-HINT and not yet cached
+	void DiscardHintedPart();
+	/// Function to decode and index DRM metadata of a EXT-X-FAXS-CM tag
+	void IndexDrmMetadata(const char *base64Data, const char *end);
+	/// Function to handle EXT-X-X1-LIN-CK tag
+	void ProcessDeferredDrmTag(const char *tag, const char *lineEnd);
+	/// Function to report tag as timed metadata if subscribed
+	void ReportSubscribedTag(const char *tag, const char *lineEnd, double position);
 	/// Function to Fetch the fragment and inject for playback 
 	void FetchFragment();
 	/// Helper function fetch the fragments 
 	bool FetchFragmentHelper(long &http_error, bool &decryption_error);
+	/// Function to fetch next fragments in parallel into free cache slots
+	void FetchFragmentsAhead(int maxCount);
+	/// Function to move playlist cursor to next fragment at normal play rate
+	char *AdvanceToNextFragment();
+	/// Function to check if fragment following current one can be fetched in the same batch
+	bool IsNextFragmentPrefetchable();
+	/// Function to update error counters on fragment download failure
+	void FragmentDownloadFailed(CachedFragment* cachedFragment, long http_error);
+	/// Function to decrypt downloaded fragment if required
+	bool ProcessFetchedFragment(CachedFragment* cachedFragment, const char *fragmentUrl, bool &decryption_error, bool streamDecrypt = false);
+	/// Function to update position of fetched fragment and add it to cache
+	void CacheFetchedFragment();
 	/// Function to redownload playlist after refresh interval .
 	void RefreshPlaylist(void);
 	/// Function to get Context pointer
@@ -185,6 +281,8 @@ private:
 	void InjectFragmentInternal(CachedFragment* cachedFragment, bool &fragmentDiscarded);
 	/// Function to find the media sequence after refresh for continuity
 	char *FindMediaForSequenceNumber();
+	/// Function to re-point track to playlist of current language at playback position
+	void SwitchRendition();
 
 public:
 	char effectiveUrl[MAX_URI_LENGTH]; 		/**< uri associated with downloaded playlist (takes into account 302 redirect) */
@@ -221,6 +319,10 @@ public:
 	int mDrmMetaDataIndexPosition;	/**< Variable to store Drm Meta data Index position*/
 	GrowableBuffer mDrmMetaDataIndex;  /**< DrmMetadata records for associated playlist */
 	int mDrmMetaDataIndexCount; /**< number of DrmMetadata records in currently indexed playlist */
+	double mCanSkipUntil; /**< EXT-X-SERVER-CONTROL CAN-SKIP-UNTIL, 0 if delta updates aren't supported*/
+	bool mCanBlockReload; /**< EXT-X-SERVER-CONTROL CAN-BLOCK-RELOAD*/
+	double mPartHoldBack; /**< EXT-X-SERVER-CONTROL PART-HOLD-BACK*/
+	double mPartTargetDuration; /**< EXT-X-PART-INF PART-TARGET, 0 if playlist has no partial segments*/
 private:
 	bool refreshPlaylist;	/**< bool flag to indicate if playlist refresh required or not */
 	pthread_t fragmentCollectorThreadID;	/**< Thread Id for Fragment  collector Thread */
@@ -228,7 +330,17 @@ private:
 	int manifestDLFailCount;				/**< Manifest Download fail count for retry*/
 	std::map<int, double> mPeriodPositionIndex;  /**< period start position mapping of associated playlist */
 	bool firstIndexDone;                    /**< Indicates if first indexing is done*/
+	int mDeltaUpdateFailCount;              /**< Consecutive delta updates that couldn't be applied*/
+	int mDeltaUpdateHoldOff;                /**< Full playlist refreshes left before delta update is requested again*/
+	long long mPartMediaSequenceNumber;     /**< Media sequence number of segment fetched as partial segments*/
+	int mNextPartIndex;                     /**< Number of partial segments of mPartMediaSequenceNumber added to cache*/
+	double mPartSegmentStart;               /**< Playlist position of segment fetched as partial segments*/
+	double mPartOffset;                     /**< Duration of partial segments added to cache*/
+	int mHintedPartIndex;                   /**< Index of partial segment downloaded from EXT-X-PRELOAD-HINT and held in fetch slot till listed, -1 if none*/
+	std::string mHintedPartUri;             /**< URI of partial segment fetched from EXT-X-PRELOAD-HINT*/
 	HlsDrmBase* mDrm;                       /**< DRM decrypt context*/
+	AesDec* mAesDec;                        /**< Vanilla AES decryptor of the track*/
+	AesStreamDecryptor* mStreamDecryptor;   /**< Decrypts AES-128 fragments while they are downloaded*/
 };
 
 class StreamAbstractionAAMP_HLS;
@@ -274,6 +386,8 @@ public:
 	std::vector<long> GetVideoBitrates(void);
 	/// Function to get available audio bitrates.
 	std::vector<long> GetAudioBitrates(void);
+	/// Function to switch audio track to rendition of current language without retune
+	bool SwitchAudioTrack();
 //private:
 	// TODO: following really should be private, but need to be accessible from callbacks
 	
@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "_base64.h"
+#include "SegmentTimelineIndex.h"
 #include "libdash/IMPD.h"
 #include "libdash/INode.h"
 #include "libdash/IDASHManager.h"
@@ -39,10 +40,13 @@
 #include <assert.h>
 #include <unistd.h>
 #include <set>
+#include <algorithm>
 #include <iomanip>
 #include <ctime>
 #include <inttypes.h>
 #include <libxml/xmlreader.h>
+#include <libxml/parser.h>
+#include <libxml/parserInternals.h>
 #define DEBUG_TIMELINE
 #define AAMP_HARVEST_SUPPORT_ENABLED
 //#define AAMP_DISABLE_INJECT
@@ -62,6 +66,8 @@ using namespace dash::helpers;
 #define TIMELINE_START_RESET_DIFF 4000000000
 #define MAX_DELAY_BETWEEN_MPD_UPDATE_MS (6000)
 #define MIN_DELAY_BETWEEN_MPD_UPDATE_MS (500) // 500mSec
+#define MAX_SEGMENT_INDEX_DEPTH 4 // levels of hierarchical sidx followed
+#define MAX_URL_TEMPLATES_PER_REPRESENTATION 4 // media and initialization, with headroom
 
 //Comcast DRM Agnostic CENC for Content Metadata
 #define COMCAST_DRM_INFO_ID "afbcb50e-bf74-3d13-be8f-13930c783962"
@@ -82,6 +88,306 @@ struct FragmentDescriptor
 
 static const char *mMediaTypeName[] = { "video", "audio" };
 
+/**
+ * @struct SegmentIndexEntry
+ * @brief Subsegment referenced by segment index box
+ */
+struct SegmentIndexEntry
+{
+	uint64_t offset; // file offset of first byte
+	uint32_t size;
+	double startTime; // seconds from first subsegment
+	double duration;
+	uint8_t sapType; // SAP_type if subsegment starts with SAP, else 0
+	bool isIndex; // references a nested segment index box
+};
+
+/**
+ * @struct SegmentIndex
+ * @brief Subsegments of a SegmentBase representation, parsed once from its sidx boxes
+ */
+struct SegmentIndex
+{
+	std::vector<SegmentIndexEntry> entries;
+	double presentationTime; // media time of first subsegment in seconds, entry start times are relative to it
+
+	SegmentIndex() : entries(), presentationTime(0)
+	{
+	}
+
+	/**
+	 * @brief Find subsegment playing at time
+	 * @param time seconds from first subsegment
+	 * @retval first subsegment ending after time, entries.size() if none
+	 */
+	int Find(double time) const
+	{
+		int low = 0;
+		int high = entries.size();
+		while (low < high)
+		{
+			int mid = low + (high - low) / 2;
+			if (entries[mid].startTime + entries[mid].duration <= time)
+			{
+				low = mid + 1;
+			}
+			else
+			{
+				high = mid;
+			}
+		}
+		return low;
+	}
+};
+
+/**
+ * @class SegmentUrlTemplate
+ * @brief BaseURL and SegmentTemplate string compiled into literal spans and identifier substitutions
+ *
+ * Fragment urls are then rendered in a single pass into a fixed buffer,
+ * against manifest url prefixes resolved at compile time.
+ */
+class SegmentUrlTemplate
+{
+public:
+	/**
+	 * @brief SegmentUrlTemplate Constructor
+	 */
+	SegmentUrlTemplate() : mBaseUrls(NULL), mMedia(), mManifestUrl(), mText(), mTokens(), mDirectoryPrefix(), mEndpointPrefix(), mParams()
+	{
+	}
+
+	/**
+	 * @brief Compile BaseURL of fragment descriptor followed by media string
+	 * @param fragmentDescriptor descriptor holding base urls and manifest url
+	 * @param media SegmentTemplate media or initialization string
+	 */
+	void Compile(const FragmentDescriptor *fragmentDescriptor, const std::string &media)
+	{
+		std::string text;
+		mBaseUrls = fragmentDescriptor->baseUrls;
+		mMedia = media;
+		mManifestUrl = fragmentDescriptor->manifestUrl ? fragmentDescriptor->manifestUrl : "";
+		if (mBaseUrls && mBaseUrls->size() > 0)
+		{
+			text = mBaseUrls->at(0)->GetUrl();
+			if(gpGlobalConfig->dashIgnoreBaseURLIfSlash)
+			{
+				if (text == "/")
+				{
+					logprintf("%s:%d ignoring baseurl /\n", __FUNCTION__, __LINE__);
+					text.clear();
+				}
+			}
+
+			//Add '/' to BaseURL if not already available.
+			if( text.compare(0, 7, "http://")==0 || text.compare(0, 8, "https://")==0 )
+			{
+				if( text.back() != '/' )
+				{
+					text += '/';
+				}
+			}
+		}
+		else
+		{
+			traceprintf("%s:%d BaseURL not available\n", __FUNCTION__, __LINE__);
+		}
+		text += media;
+		Parse(text);
+
+		// prefixes applied by aamp_ResolveURL for absolute and relative paths
+		size_t endpointEnd = std::string::npos;
+		size_t scheme = mManifestUrl.find("://");
+		if (scheme != std::string::npos)
+		{
+			endpointEnd = mManifestUrl.find('/', scheme + 3);
+		}
+		mEndpointPrefix = mManifestUrl.substr(0, endpointEnd);
+		size_t directoryEnd = mManifestUrl.rfind('/');
+		mDirectoryPrefix = mManifestUrl.substr(0, (directoryEnd == std::string::npos) ? 0 : directoryEnd + 1);
+		size_t params = mManifestUrl.find('?');
+		mParams = (params == std::string::npos) ? "" : mManifestUrl.substr(params);
+	}
+
+	/**
+	 * @brief Check if template was compiled for base urls and media string
+	 * @param fragmentDescriptor descriptor holding base urls and manifest url
+	 * @param media SegmentTemplate media or initialization string
+	 */
+	bool IsCompiledFor(const FragmentDescriptor *fragmentDescriptor, const std::string &media) const
+	{
+		return (mBaseUrls == fragmentDescriptor->baseUrls && mMedia == media &&
+				0 == mManifestUrl.compare(fragmentDescriptor->manifestUrl ? fragmentDescriptor->manifestUrl : ""));
+	}
+
+	/**
+	 * @brief Split text into literal spans and $identifier$ substitutions
+	 * @param text template text
+	 */
+	void Parse(const std::string &text)
+	{
+		mText = text;
+		mTokens.clear();
+		size_t literalStart = 0;
+		size_t pos = 0;
+		while ((pos = mText.find('$', pos)) != std::string::npos)
+		{
+			size_t next = mText.find('$', pos + 1);
+			if (next == std::string::npos)
+			{
+				break;
+			}
+			Token token;
+			token.type = eTOKEN_LITERAL;
+			token.width = 0;
+			if (next == pos + 1)
+			{ // $$ escapes $
+				AddLiteral(literalStart, pos + 1 - literalStart);
+				literalStart = pos = next + 1;
+				continue;
+			}
+			size_t formatStart = mText.find('%', pos + 1);
+			if (formatStart == std::string::npos || formatStart > next)
+			{
+				formatStart = next;
+			}
+			std::string identifier = mText.substr(pos + 1, formatStart - pos - 1);
+			if (identifier == "Bandwidth")
+			{
+				token.type = eTOKEN_BANDWIDTH;
+			}
+			else if (identifier == "RepresentationID")
+			{
+				token.type = eTOKEN_REPRESENTATIONID;
+			}
+			else if (identifier == "Number")
+			{
+				token.type = eTOKEN_NUMBER;
+			}
+			else if (identifier == "Time")
+			{
+				token.type = eTOKEN_TIME;
+			}
+			if (token.type == eTOKEN_LITERAL)
+			{ // not an identifier, keep as is
+				pos = next + 1;
+				continue;
+			}
+			if (formatStart < next)
+			{ // %0<width>d
+				token.width = atoi(mText.c_str() + formatStart + 1 + ((mText[formatStart + 1] == '0') ? 1 : 0));
+			}
+			AddLiteral(literalStart, pos - literalStart);
+			token.offset = 0;
+			token.length = 0;
+			mTokens.push_back(token);
+			literalStart = pos = next + 1;
+		}
+		AddLiteral(literalStart, mText.size() - literalStart);
+	}
+
+	/**
+	 * @brief Substitute identifiers of fragment
+	 * @param[out] dst output buffer
+	 * @param size size of output buffer
+	 * @param fragmentDescriptor fragment to substitute
+	 * @retval length of output
+	 */
+	size_t Expand(char *dst, size_t size, const FragmentDescriptor *fragmentDescriptor) const
+	{
+		size_t len = 0;
+		for (std::vector<Token>::const_iterator it = mTokens.begin(); it != mTokens.end() && len + 1 < size; it++)
+		{
+			int written = 0;
+			switch (it->type)
+			{
+			case eTOKEN_LITERAL:
+				written = std::min(it->length, size - 1 - len);
+				memcpy(dst + len, mText.data() + it->offset, written);
+				break;
+			case eTOKEN_BANDWIDTH:
+				written = snprintf(dst + len, size - len, "%0*" PRIu64 "", it->width, (uint64_t)fragmentDescriptor->Bandwidth);
+				break;
+			case eTOKEN_REPRESENTATIONID:
+				written = snprintf(dst + len, size - len, "%s", fragmentDescriptor->RepresentationID);
+				break;
+			case eTOKEN_NUMBER:
+				written = snprintf(dst + len, size - len, "%0*" PRIu64 "", it->width, fragmentDescriptor->Number);
+				break;
+			case eTOKEN_TIME:
+				written = snprintf(dst + len, size - len, "%0*" PRIu64 "", it->width, fragmentDescriptor->Time);
+				break;
+			}
+			len = std::min(len + written, size - 1);
+		}
+		dst[len] = 0;
+		return len;
+	}
+
+	/**
+	 * @brief Generate fragment url, resolved against manifest url as aamp_ResolveURL does
+	 * @param[out] fragmentUrl fragment url
+	 * @param fragmentDescriptor fragment to substitute
+	 */
+	void Render(char fragmentUrl[MAX_URI_LENGTH], const FragmentDescriptor *fragmentDescriptor) const
+	{
+		char uri[MAX_URI_LENGTH];
+		size_t uriLength = Expand(uri, sizeof(uri), fragmentDescriptor);
+		if (0 == strncmp(uri, "http://", 7) || 0 == strncmp(uri, "https://", 8))
+		{
+			memcpy(fragmentUrl, uri, uriLength + 1);
+		}
+		else
+		{
+			const std::string &prefix = (uri[0] == '/') ? mEndpointPrefix : mDirectoryPrefix;
+			const char *params = strchr(uri, '?') ? "" : mParams.c_str();
+			snprintf(fragmentUrl, MAX_URI_LENGTH, "%s%s%s", prefix.c_str(), uri, params);
+		}
+	}
+
+private:
+	enum TokenType
+	{
+		eTOKEN_LITERAL,
+		eTOKEN_BANDWIDTH,
+		eTOKEN_REPRESENTATIONID,
+		eTOKEN_NUMBER,
+		eTOKEN_TIME
+	};
+
+	struct Token
+	{
+		TokenType type;
+		size_t offset; // literal span in mText
+		size_t length;
+		int width; // minimum width of zero padded number
+	};
+
+	void AddLiteral(size_t offset, size_t length)
+	{
+		if (length > 0)
+		{
+			Token token;
+			token.type = eTOKEN_LITERAL;
+			token.offset = offset;
+			token.length = length;
+			token.width = 0;
+			mTokens.push_back(token);
+		}
+	}
+
+	const std::vector<IBaseUrl *> *mBaseUrls;
+	std::string mMedia;
+	std::string mManifestUrl;
+	std::string mText;
+	std::vector<Token> mTokens;
+	std::string mDirectoryPrefix;
+	std::string mEndpointPrefix;
+	std::string mParams;
+};
+
+
 /**
  * @class MediaStreamContext
  * @brief MPD media track
@@ -101,7 +407,7 @@ public:
 			MediaTrack(type, aamp, name),
 			mediaType((MediaType)type), adaptationSet(NULL), representation(NULL),
 			fragmentIndex(0), timeLineIndex(0), fragmentRepeatCount(0), fragmentOffset(0),
-			eos(false), endTimeReached(false), fragmentTime(0),targetDnldPosition(0), index_ptr(NULL), index_len(0),
+			eos(false), endTimeReached(false), fragmentTime(0),targetDnldPosition(0), segmentIndexes(), urlTemplates(), representationCacheGeneration(0),
 			lastSegmentTime(0), lastSegmentNumber(0), adaptationSetIdx(0), representationIndex(0), profileChanged(true),
 			adaptationSetId(0)
 	{
@@ -165,7 +471,7 @@ public:
 
 		if (!ret)
 		{
-			aamp_Free(&cachedFragment->fragment.ptr);
+			aamp_FreeBuffer(&cachedFragment->fragment);
 			if( aamp->DownloadsAreEnabled())
 			{
 				logprintf("%s:%d LoadFragment failed\n", __FUNCTION__, __LINE__);
@@ -259,8 +565,9 @@ public:
 
 	double fragmentTime;
 	double targetDnldPosition;
-	char *index_ptr;
-	size_t index_len;
+	std::map<IRepresentation *, SegmentIndex> segmentIndexes; // sidx tables of SegmentBase representations
+	std::map<IRepresentation *, std::vector<SegmentUrlTemplate> > urlTemplates; // compiled media and initialization urls of representations
+	uint32_t representationCacheGeneration; // manifest generation of segmentIndexes and urlTemplates
 	uint64_t lastSegmentTime;
 	uint64_t lastSegmentDuration;
 	uint64_t lastSegmentNumber;
@@ -269,6 +576,7 @@ public:
 	StreamAbstractionAAMP_MPD* mContext;
 	std::string initialization;
 	uint32_t adaptationSetId;
+	SegmentTimelineIndex timelineIndex;
 };
 
 /**
@@ -311,6 +619,18 @@ struct DrmSessionParams
 	unsigned char *contentMetadata;
 };
 
+/**
+ * @struct PeriodTimelineDuration
+ * @brief Summed SegmentTimeline duration of a period, with the timeline shape it was summed from
+ */
+struct PeriodTimelineDuration
+{
+	uint64_t firstStartTime; // S@t of first S element, advances when live window trims timeline
+	size_t entryCount; // number of S elements
+	uint32_t lastRepeatCount; // S@r of last S element
+	uint64_t durationMs;
+};
+
 static bool IsIframeTrack(IAdaptationSet *adaptationSet);
 
 /**
@@ -338,7 +658,7 @@ public:
 
 	void FetcherLoop();
 	bool PushNextFragment( MediaStreamContext *pMediaStreamContext, unsigned int curlInstance = 0);
-	bool FetchFragment(MediaStreamContext *pMediaStreamContext, std::string media, double fragmentDuration, bool isInitializationSegment, unsigned int curlInstance = 0, bool discontinuity = false );
+	bool FetchFragment(MediaStreamContext *pMediaStreamContext, const std::string &media, double fragmentDuration, bool isInitializationSegment, unsigned int curlInstance = 0, bool discontinuity = false );
 	uint64_t GetPeriodEndTime();
 	int GetProfileCount();
 	StreamInfo* GetStreamInfo(int idx);
@@ -354,6 +674,7 @@ public:
 	int GetBWIndex(long bitrate);
 	std::vector<long> GetVideoBitrates(void);
 	std::vector<long> GetAudioBitrates(void);
+	bool SwitchAudioTrack();
 
 private:
 	bool UpdateMPD(bool retrievePlaylistFromCache = false);
@@ -376,6 +697,16 @@ private:
 	uint64_t GetDurationFromRepresentation();
 	void UpdateCullingState();
 	void UpdateLanguageList();
+	int SelectAudioAdaptationSet(IPeriod *period, int &selRepresentationIndex, AudioType &selectedRepType, std::string &selectedLanguage, bool &otherLanguageSelected);
+	void SetFragmentBaseUrls(MediaStreamContext *pMediaStreamContext);
+	void SwitchAudioAdaptationSet();
+	bool IsProfileListUnchanged(IAdaptationSet *adaptationSet);
+	int FindPeriodIndex(const std::string &periodId);
+	const SegmentTimelineIndex& GetTimelineIndex(MediaStreamContext *pMediaStreamContext, const ISegmentTimeline *segmentTimeline);
+	bool ParseSegmentIndex(MediaStreamContext *pMediaStreamContext, const char *fragmentUrl, const char *buffer, size_t bufferSize, uint64_t bufferOffset, uint64_t boxOffset, int depth, unsigned int curlInstance, SegmentIndex &segmentIndex);
+	const SegmentIndex* GetSegmentIndex(MediaStreamContext *pMediaStreamContext, ISegmentBase *segmentBase, const char *fragmentUrl, unsigned int curlInstance);
+	void ValidateRepresentationCaches(MediaStreamContext *pMediaStreamContext);
+	void GetTrackFragmentUrl(MediaStreamContext *pMediaStreamContext, char fragmentUrl[MAX_URI_LENGTH], const std::string &media);
 
 	bool fragmentCollectorThreadStarted;
 	std::set<std::string> mLangList;
@@ -409,6 +740,8 @@ private:
 	std::unordered_map<long, int> mBitrateIndexMap;
 	bool mIsFogTSB;
 	bool mIsIframeTrackPresent;
+	std::map<std::string, PeriodTimelineDuration> mPeriodTimelineDurations; // timeline duration of periods preceding last period, by Period@id and start
+	uint32_t mManifestGeneration; // incremented on each manifest update
 };
 
 
@@ -451,6 +784,7 @@ PrivateStreamAbstractionMPD::PrivateStreamAbstractionMPD( StreamAbstractionAAMP_
 	mPrevAdaptationSetCount = 0;
 	mIsFogTSB = false;
 	mIsIframeTrackPresent = false;
+	mManifestGeneration = 0;
 };
 
 
@@ -612,129 +946,125 @@ static unsigned int Read32( const char **pptr)
 
 
 /**
- * @brief Parse segment index box
- * @note The SegmentBase indexRange attribute points to Segment Index Box location with segments and random access points.
- * @param start start of box
- * @param size size of box
- * @param segmentIndex segment index
- * @param[out] referenced_size referenced size
- * @param[out] referenced_duration referenced duration
- * @retval true on success
+ * @brief read unsigned 64 bit value and update buffer pointer
+ * @param[in][out] pptr buffer
+ * @retval 64 bit value
  */
-static bool ParseSegmentIndexBox( const char *start, size_t size, int segmentIndex, unsigned int *referenced_size, float *referenced_duration )
+static uint64_t Read64( const char **pptr)
 {
-	const char **f = &start;
-	unsigned int len = Read32(f);
-	assert(len == size);
-	unsigned int type = Read32(f);
-	assert(type == 'sidx');
-	unsigned int version = Read32(f);
-	unsigned int reference_ID = Read32(f);
-	unsigned int timescale = Read32(f);
-	unsigned int earliest_presentation_time = Read32(f);
-	unsigned int first_offset = Read32(f);
-	unsigned int count = Read32(f);
-	for (unsigned int i = 0; i < count; i++)
-	{
-		*referenced_size = Read32(f);
-		*referenced_duration = Read32(f)/(float)timescale;
-		unsigned int flags = Read32(f);
-		if (i == segmentIndex) return true;
-	}
-	return false;
+	uint64_t rc = Read32(pptr);
+	rc <<= 32;
+	rc |= Read32(pptr);
+	return rc;
 }
 
 
 /**
- * @brief Replace matching token with given number
- * @param str String in which operation to be performed
- * @param from token
- * @param toNumber number to replace token
- * @retval position
+ * @brief Read size of an ISO BMFF box from its header
+ * @param start start of box
+ * @param size number of bytes available at start
+ * @param[out] boxSize size of box, from largesize field when size field is 1
+ * @retval true if header is complete and size is valid
  */
-static int replace(std::string& str, const std::string& from, uint64_t toNumber )
+static bool ReadBoxSize(const char *start, size_t size, uint64_t &boxSize)
 {
-	int rc = 0;
-	size_t tokenLength = from.length();
-
-	for (;;)
+	const char *ptr = start;
+	if (size < 8)
 	{
-		bool done = true;
-		size_t pos = 0;
-		for (;;)
+		return false;
+	}
+	boxSize = Read32(&ptr);
+	ptr += 4; // type
+	if (boxSize == 1)
+	{
+		if (size < 16)
 		{
-			pos = str.find('$', pos);
-			if (pos == std::string::npos)
-			{
-				break;
-			}
-			size_t next = str.find('$', pos + 1);
-			if (str.substr(pos + 1, tokenLength) == from)
-			{
-				size_t formatLen = next - pos - tokenLength - 1;
-				char buf[256];
-				if (formatLen > 0)
-				{
-					std::string format = str.substr(pos + tokenLength + 1, formatLen);
-					sprintf(buf, format.c_str(), toNumber);
-					tokenLength += formatLen;
-				}
-				else
-				{
-					sprintf(buf, "%" PRIu64 "", toNumber);
-				}
-				str.replace(pos, tokenLength + 2, buf);
-				done = false;
-				rc++;
-				break;
-			}
-			pos = next + 1;
+			return false;
 		}
-		if (done) break;
+		boxSize = Read64(&ptr);
 	}
-
-	return rc;
+	return boxSize >= (uint64_t)(ptr - start);
 }
 
 
 /**
- * @brief Replace matching token with given string
- * @param str String in which operation to be performed
- * @param from token
- * @param toString string to replace token
- * @retval position
+ * @brief Parse segment index box
+ * @note The SegmentBase indexRange attribute points to Segment Index Box location with segments and random access points.
+ * @param start start of box
+ * @param size size of buffer holding box
+ * @param boxOffset file offset of box
+ * @param[out] references subsegments and nested segment index boxes, in presentation order
+ * @param[out] presentationTime earliest presentation time of first subsegment, in seconds
+ * @retval true on success
  */
-static int replace(std::string& str, const std::string& from, const std::string& toString )
+static bool ParseSegmentIndexBox( const char *start, size_t size, uint64_t boxOffset, std::vector<SegmentIndexEntry> &references, double &presentationTime)
 {
-	int rc = 0;
-	size_t tokenLength = from.length();
-
-	for (;;)
+	const char *ptr = start;
+	if (size < 8)
 	{
-		bool done = true;
-		size_t pos = 0;
-		for (;;)
+		return false;
+	}
+	uint64_t boxSize = Read32(&ptr);
+	unsigned int type = Read32(&ptr);
+	if (type != 'sidx')
+	{
+		return false;
+	}
+	if (boxSize == 1)
+	{
+		if (size < 16)
 		{
-			pos = str.find('$', pos);
-			if (pos == std::string::npos)
-			{
-				break;
-			}
-			size_t next = str.find('$', pos + 1);
-			if (str.substr(pos + 1, tokenLength) == from)
-			{
-				str.replace(pos, tokenLength + 2, toString);
-				done = false;
-				rc++;
-				break;
-			}
-			pos = next + 1;
+			return false;
 		}
-
-		if (done) break;
+		boxSize = Read64(&ptr);
 	}
-
-	return rc;
+	if (boxSize > size || boxSize < (ptr - start) + 24)
+	{
+		return false;
+	}
+	const char *end = start + boxSize;
+	unsigned int version = Read32(&ptr) >> 24;
+	unsigned int reference_ID = Read32(&ptr);
+	unsigned int timescale = Read32(&ptr);
+	uint64_t earliest_presentation_time;
+	uint64_t first_offset;
+	if (version == 0)
+	{
+		earliest_presentation_time = Read32(&ptr);
+		first_offset = Read32(&ptr);
+	}
+	else
+	{
+		if (end - ptr < 20)
+		{
+			return false;
+		}
+		earliest_presentation_time = Read64(&ptr);
+		first_offset = Read64(&ptr);
+	}
+	unsigned int count = Read32(&ptr) & 0xFFFF; // reserved, reference_count
+	if (0 == timescale || (end - ptr) / 12 < count)
+	{
+		return false;
+	}
+	presentationTime = earliest_presentation_time / (double)timescale;
+	uint64_t offset = boxOffset + boxSize + first_offset;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int referenced_size = Read32(&ptr);
+		unsigned int subsegment_duration = Read32(&ptr);
+		unsigned int sap = Read32(&ptr);
+		SegmentIndexEntry entry;
+		entry.offset = offset;
+		entry.size = referenced_size & 0x7FFFFFFF;
+		entry.startTime = 0;
+		entry.duration = subsegment_duration / (double)timescale;
+		entry.sapType = (sap >> 31) ? ((sap >> 28) & 0x7) : 0;
+		entry.isIndex = (referenced_size >> 31);
+		references.push_back(entry);
+		offset += entry.size;
+	}
+	return true;
 }
 
 
@@ -744,42 +1074,11 @@ static int replace(std::string& str, const std::string& from, const std::string&
  * @param fragmentDescriptor descriptor
  * @param media media information string
  */
-static void GetFragmentUrl( char fragmentUrl[MAX_URI_LENGTH], const FragmentDescriptor *fragmentDescriptor, std::string media)
+static void GetFragmentUrl( char fragmentUrl[MAX_URI_LENGTH], const FragmentDescriptor *fragmentDescriptor, const std::string &media)
 {
-	std::string constructedUri;
-	if (fragmentDescriptor->baseUrls->size() > 0)
-	{
-		constructedUri = fragmentDescriptor->baseUrls->at(0)->GetUrl();
-		if(gpGlobalConfig->dashIgnoreBaseURLIfSlash)
-		{
-			if (constructedUri == "/")
-			{
-				logprintf("%s:%d ignoring baseurl /\n", __FUNCTION__, __LINE__);
-				constructedUri.clear();
-			}
-		}
-
-		//Add '/' to BaseURL if not already available.
-		if( constructedUri.compare(0, 7, "http://")==0 || constructedUri.compare(0, 8, "https://")==0 )
-		{
-			if( constructedUri.back() != '/' )
-			{
-				constructedUri += '/';
-			}
-		}
-	}
-	else
-	{
-		traceprintf("%s:%d BaseURL not available\n", __FUNCTION__, __LINE__);
-	}
-	constructedUri += media;
-
-	replace(constructedUri, "Bandwidth", fragmentDescriptor->Bandwidth);
-	replace(constructedUri, "RepresentationID", fragmentDescriptor->RepresentationID);
-	replace(constructedUri, "Number", fragmentDescriptor->Number);
-	replace(constructedUri, "Time", fragmentDescriptor->Time );
-
-	aamp_ResolveURL(fragmentUrl, fragmentDescriptor->manifestUrl, constructedUri.c_str());
+	SegmentUrlTemplate urlTemplate;
+	urlTemplate.Compile(fragmentDescriptor, media);
+	urlTemplate.Render(fragmentUrl, fragmentDescriptor);
 }
 
 #ifdef AAMP_HARVEST_SUPPORT_ENABLED
@@ -801,13 +1100,9 @@ static void GetFragmentUrl( char fragmentUrl[MAX_URI_LENGTH], const FragmentDesc
  */
 static void GetFilePath(char filePath[MAX_URI_LENGTH], const FragmentDescriptor *fragmentDescriptor, const std::string& media)
 {
-	std::string constructedUri = HARVEST_BASE_PATH;
-	constructedUri += media;
-	replace(constructedUri, "Bandwidth", fragmentDescriptor->Bandwidth);
-	replace(constructedUri, "RepresentationID", fragmentDescriptor->RepresentationID);
-	replace(constructedUri, "Number", fragmentDescriptor->Number);
-	replace(constructedUri, "Time", fragmentDescriptor->Time);
-	strcpy(filePath, constructedUri.c_str());
+	SegmentUrlTemplate pathTemplate;
+	pathTemplate.Parse(HARVEST_BASE_PATH + media);
+	pathTemplate.Expand(filePath, MAX_URI_LENGTH, fragmentDescriptor);
 }
 
 
@@ -1000,11 +1295,11 @@ void PrivateStreamAbstractionMPD::HarvestLoop()
  * @param discontinuity true if fragment is discontinuous
  * @retval true on fetch success
  */
-bool PrivateStreamAbstractionMPD::FetchFragment(MediaStreamContext *pMediaStreamContext, std::string media, double fragmentDuration, bool isInitializationSegment, unsigned int curlInstance, bool discontinuity)
+bool PrivateStreamAbstractionMPD::FetchFragment(MediaStreamContext *pMediaStreamContext, const std::string &media, double fragmentDuration, bool isInitializationSegment, unsigned int curlInstance, bool discontinuity)
 { // given url, synchronously download and transmit associated fragment
 	bool retval = true;
 	char fragmentUrl[MAX_URI_LENGTH];
-	GetFragmentUrl(fragmentUrl, &pMediaStreamContext->fragmentDescriptor, media);
+	GetTrackFragmentUrl(pMediaStreamContext, fragmentUrl, media);
 	size_t len = 0;
 	float position;
 	if(isInitializationSegment)
@@ -1117,22 +1412,12 @@ bool PrivateStreamAbstractionMPD::PushNextFragment( struct MediaStreamContext *p
 						// After mpd refresh , Time will be 0. Need to traverse to the right fragment for playback
 						if(0 == pMediaStreamContext->fragmentDescriptor.Time)
 						{
+							const SegmentTimelineIndex &timelineIndex = GetTimelineIndex(pMediaStreamContext, segmentTimeline);
 							uint32_t duration =0;
 							uint32_t repeatCount =0;
-							int index=pMediaStreamContext->timeLineIndex;
-							// This for loop is to go to the right index based on LastSegmentTime
-							for(;index<timelines.size();index++)
-							{
-								timeline = timelines.at(index);
-								startTime = timeline->GetStartTime();
-								duration = timeline->GetDuration();
-								repeatCount = timeline->GetRepeatCount();
-								if(pMediaStreamContext->lastSegmentTime < (startTime+((repeatCount+1)*duration)))
-								{
-									break;
-								}
-								pMediaStreamContext->fragmentDescriptor.Number += (repeatCount+1);	
-							}// end of for 
+							// Go to the right index based on LastSegmentTime
+							int index = timelineIndex.FindEntry(pMediaStreamContext->lastSegmentTime, pMediaStreamContext->timeLineIndex);
+							pMediaStreamContext->fragmentDescriptor.Number += timelineIndex.GetSegmentOffset(index) - timelineIndex.GetSegmentOffset(pMediaStreamContext->timeLineIndex);
 
 							/*
 							*  Boundary check added to handle the edge case leading to crash,
@@ -1140,12 +1425,22 @@ bool PrivateStreamAbstractionMPD::PushNextFragment( struct MediaStreamContext *p
 							*/
 							if(index == timelines.size())
 							{
-								logprintf("%s:%d Type[%d] Boundary Condition !!! Index(%d) reached Max.Start=%" PRIu64 " Last=%" PRIu64 " \n",__FUNCTION__, __LINE__, 
-									pMediaStreamContext->type,index,startTime,pMediaStreamContext->lastSegmentTime);
 								index--;
+								timeline = timelines.at(index);
+								duration = timeline->GetDuration();
+								repeatCount = timeline->GetRepeatCount();
+								logprintf("%s:%d Type[%d] Boundary Condition !!! Index(%d) reached Max.Start=%" PRIu64 " Last=%" PRIu64 " \n",__FUNCTION__, __LINE__, 
+									pMediaStreamContext->type,index + 1,timelineIndex.GetStartTime(index),pMediaStreamContext->lastSegmentTime);
 								startTime = pMediaStreamContext->lastSegmentTime;
 								pMediaStreamContext->fragmentRepeatCount = repeatCount+1;
 							}
+							else
+							{
+								timeline = timelines.at(index);
+								duration = timeline->GetDuration();
+								repeatCount = timeline->GetRepeatCount();
+								startTime = timelineIndex.GetStartTime(index);
+							}
 
 #ifdef DEBUG_TIMELINE
 							logprintf("%s:%d Type[%d] t=%" PRIu64 " L=%" PRIu64 " d=%d r=%d Index=%d Num=%" PRIu64 " FTime=%f\n",__FUNCTION__, __LINE__, pMediaStreamContext->type,
@@ -1153,13 +1448,14 @@ bool PrivateStreamAbstractionMPD::PushNextFragment( struct MediaStreamContext *p
 							pMediaStreamContext->fragmentDescriptor.Number,pMediaStreamContext->fragmentTime);
 #endif		
 							pMediaStreamContext->timeLineIndex = index;
-							// Now we reached the right row , need to traverse the repeat index to reach right node
-							while(startTime < pMediaStreamContext->lastSegmentTime && 
+							// Now we reached the right row , need to skip repeats to reach right node
+							if(startTime < pMediaStreamContext->lastSegmentTime && duration &&
 								pMediaStreamContext->fragmentRepeatCount < repeatCount )
 							{
-								startTime += duration;
-								pMediaStreamContext->fragmentDescriptor.Number++;
-								pMediaStreamContext->fragmentRepeatCount++;
+								uint64_t count = std::min<uint64_t>((pMediaStreamContext->lastSegmentTime - startTime + duration - 1) / duration, repeatCount);
+								startTime += count * duration;
+								pMediaStreamContext->fragmentDescriptor.Number += count;
+								pMediaStreamContext->fragmentRepeatCount += count;
 							}
 #ifdef DEBUG_TIMELINE
 							logprintf("%s:%d Type[%d] t=%" PRIu64 " L=%" PRIu64 " d=%d r=%d fragRep=%d Index=%d Num=%" PRIu64 " FTime=%f\n",__FUNCTION__, __LINE__, pMediaStreamContext->type,
@@ -1394,57 +1690,21 @@ bool PrivateStreamAbstractionMPD::PushNextFragment( struct MediaStreamContext *p
 		{ // single-segment
 			char fragmentUrl[MAX_URI_LENGTH];
 			GetFragmentUrl(fragmentUrl, &pMediaStreamContext->fragmentDescriptor, "");
-			if (!pMediaStreamContext->index_ptr)
-			{ // lazily load index
-				std::string range = segmentBase->GetIndexRange();
-				int start;
-				sscanf(range.c_str(), "%d-%d", &start, &pMediaStreamContext->fragmentOffset);
-
-				ProfilerBucketType bucketType = aamp->GetProfilerBucketForMedia(pMediaStreamContext->mediaType, true);
-				pMediaStreamContext->index_ptr = aamp->LoadFragment(bucketType, fragmentUrl, &pMediaStreamContext->index_len, curlInstance, range.c_str(),pMediaStreamContext->mediaType);
-
-				pMediaStreamContext->fragmentOffset++; // first byte following packed index
-
-				if (pMediaStreamContext->fragmentIndex != 0)
-				{
-					unsigned int referenced_size;
-					float fragmentDuration;
-					AAMPLOG_INFO("%s:%d current fragmentIndex = %d\n", __FUNCTION__, __LINE__, pMediaStreamContext->fragmentIndex);
-					//Find the offset of previous fragment in new representation
-					for (int i = 0; i < pMediaStreamContext->fragmentIndex; i++)
-					{
-						if (ParseSegmentIndexBox(pMediaStreamContext->index_ptr, pMediaStreamContext->index_len, i,
-							&referenced_size, &fragmentDuration))
-						{
-							pMediaStreamContext->fragmentOffset += referenced_size;
-						}
-					}
-				}
-			}
-			if (pMediaStreamContext->index_ptr)
+			const SegmentIndex *segmentIndex = GetSegmentIndex(pMediaStreamContext, segmentBase, fragmentUrl, curlInstance);
+			if (segmentIndex && pMediaStreamContext->fragmentIndex >= 0 && pMediaStreamContext->fragmentIndex < segmentIndex->entries.size())
 			{
-				unsigned int referenced_size;
-				float fragmentDuration;
-				if (ParseSegmentIndexBox(pMediaStreamContext->index_ptr, pMediaStreamContext->index_len, pMediaStreamContext->fragmentIndex++, &referenced_size, &fragmentDuration))
+				const SegmentIndexEntry &subsegment = segmentIndex->entries[pMediaStreamContext->fragmentIndex++];
+				char range[128];
+				sprintf(range, "%" PRIu64 "-%" PRIu64 "", subsegment.offset, subsegment.offset + subsegment.size - 1);
+				AAMPLOG_INFO("%s:%d %s [%s]\n", __FUNCTION__, __LINE__,mMediaTypeName[pMediaStreamContext->mediaType], range);
+				if(!pMediaStreamContext->CacheFragment(fragmentUrl, curlInstance, pMediaStreamContext->fragmentTime, 0.0, range ))
 				{
-					char range[128];
-					sprintf(range, "%d-%d", pMediaStreamContext->fragmentOffset, pMediaStreamContext->fragmentOffset + referenced_size - 1);
-					AAMPLOG_INFO("%s:%d %s [%s]\n", __FUNCTION__, __LINE__,mMediaTypeName[pMediaStreamContext->mediaType], range);
-					if(!pMediaStreamContext->CacheFragment(fragmentUrl, curlInstance, pMediaStreamContext->fragmentTime, 0.0, range ))
-					{
-						logprintf("PrivateStreamAbstractionMPD::%s:%d failed. fragmentUrl %s fragmentTime %f\n", __FUNCTION__, __LINE__, fragmentUrl, pMediaStreamContext->fragmentTime);
-					}
-					pMediaStreamContext->fragmentTime += fragmentDuration;
-					pMediaStreamContext->fragmentOffset += referenced_size;
-				}
-				else
-				{ // done with index
-					aamp_Free(&pMediaStreamContext->index_ptr);
-					pMediaStreamContext->eos = true;
+					logprintf("PrivateStreamAbstractionMPD::%s:%d failed. fragmentUrl %s fragmentTime %f\n", __FUNCTION__, __LINE__, fragmentUrl, pMediaStreamContext->fragmentTime);
 				}
+				pMediaStreamContext->fragmentTime += subsegment.duration;
 			}
 			else
-			{
+			{ // done with index
 				pMediaStreamContext->eos = true;
 			}
 		}
@@ -1689,6 +1949,7 @@ double PrivateStreamAbstractionMPD::SkipFragments( MediaStreamContext *pMediaStr
 
 		std::string media = segmentTemplate->Getmedia();
 		const ISegmentTimeline *segmentTimeline = segmentTemplate->GetSegmentTimeline();
+		bool timelineIndexUsed = false;
 		do
 		{
 			if (segmentTimeline)
@@ -1714,6 +1975,46 @@ double PrivateStreamAbstractionMPD::SkipFragments( MediaStreamContext *pMediaStr
 						}
 					}
 					uint32_t duration = timeline->GetDuration();
+					if (skipTime > 0 && !timelineIndexUsed)
+					{ // jump over whole fragments via index, remainder is skipped below
+						timelineIndexUsed = true;
+						const SegmentTimelineIndex &timelineIndex = GetTimelineIndex(pMediaStreamContext, segmentTimeline);
+						uint64_t currentTime = pMediaStreamContext->fragmentDescriptor.Time;
+						int index = pMediaStreamContext->timeLineIndex;
+						uint64_t limitTime = currentTime + (uint64_t)(skipTime * timeScale);
+						if (pMediaStreamContext->type == eTRACK_AUDIO)
+						{ // audio is skipped up to first PTS only
+							limitTime = std::min<uint64_t>(limitTime, (uint64_t)(mFirstPTS * timeScale));
+						}
+						if (limitTime > currentTime && currentTime == timelineIndex.GetStartTime(index) + (uint64_t)pMediaStreamContext->fragmentRepeatCount * duration)
+						{
+							int newIndex = timelineIndex.FindEntry(limitTime, index);
+							if (newIndex == timelineIndex.Size())
+							{
+								newIndex--;
+							}
+							ITimeline *newTimeline = timelines.at(newIndex);
+							uint64_t newStartTime = timelineIndex.GetStartTime(newIndex);
+							uint64_t count = 0;
+							if (limitTime > newStartTime && newTimeline->GetDuration())
+							{
+								count = std::min<uint64_t>((limitTime - newStartTime) / newTimeline->GetDuration(), newTimeline->GetRepeatCount());
+							}
+							uint64_t newTime = newStartTime + count * newTimeline->GetDuration();
+							if (newTime > currentTime)
+							{
+								double skippedTime = ((double)(newTime - currentTime)) / timeScale;
+								skipTime -= skippedTime;
+								pMediaStreamContext->fragmentTime += skippedTime;
+								pMediaStreamContext->fragmentDescriptor.Time = newTime;
+								pMediaStreamContext->fragmentDescriptor.Number += (timelineIndex.GetSegmentOffset(newIndex) + count) -
+									(timelineIndex.GetSegmentOffset(index) + pMediaStreamContext->fragmentRepeatCount);
+								pMediaStreamContext->timeLineIndex = newIndex;
+								pMediaStreamContext->fragmentRepeatCount = count;
+								continue;
+							}
+						}
+					}
 					float fragmentDuration = ((double)duration)/timeScale;
 					double nextPTS = (double)(pMediaStreamContext->fragmentDescriptor.Time + duration)/timeScale;
 					bool skipFlag = (pMediaStreamContext->type == eTRACK_VIDEO)?true:(pMediaStreamContext->type == eTRACK_AUDIO)?(nextPTS<=mFirstPTS):true;
@@ -1899,6 +2200,51 @@ double PrivateStreamAbstractionMPD::SkipFragments( MediaStreamContext *pMediaStr
 			AAMPLOG_INFO("%s:%d Exit : fragmentIndex %d segmentDuration %f\n", __FUNCTION__, __LINE__,
 					pMediaStreamContext->fragmentIndex, segmentDuration);
 		}
+		else if (pMediaStreamContext->representation->GetSegmentBase())
+		{
+			char fragmentUrl[MAX_URI_LENGTH];
+			GetFragmentUrl(fragmentUrl, &pMediaStreamContext->fragmentDescriptor, "");
+			const SegmentIndex *segmentIndex = GetSegmentIndex(pMediaStreamContext, pMediaStreamContext->representation->GetSegmentBase(), fragmentUrl, pMediaStreamContext->mediaType);
+			if (segmentIndex)
+			{
+				AAMPLOG_INFO("%s:%d Enter : fragmentIndex %d skipTime %f\n", __FUNCTION__, __LINE__,
+						pMediaStreamContext->fragmentIndex, skipTime);
+				double targetTime = pMediaStreamContext->fragmentTime + skipTime;
+				if (pMediaStreamContext->type == eTRACK_AUDIO)
+				{ // audio is skipped up to first PTS only, to subsegment playing at start of video
+					targetTime = std::min(targetTime, mFirstPTS - segmentIndex->presentationTime);
+				}
+				int index = segmentIndex->Find(targetTime);
+				if (index >= segmentIndex->entries.size())
+				{
+					pMediaStreamContext->eos = true;
+				}
+				else
+				{
+					double startTime = segmentIndex->entries[index].startTime;
+					pMediaStreamContext->fragmentTime = startTime;
+					pMediaStreamContext->fragmentIndex = index;
+					skipTime = 0;
+					if (updateFirstPTS)
+					{
+						double firstPTS = segmentIndex->presentationTime + startTime;
+						AAMPLOG_INFO("%s:%d [%s] newPTS %f\n", __FUNCTION__, __LINE__, pMediaStreamContext->name, firstPTS);
+						/*Keep the lower PTS */
+						if ((mFirstPTS == 0) || ((firstPTS < mFirstPTS) && (pMediaStreamContext->type == eTRACK_VIDEO)))
+						{
+							AAMPLOG_INFO("%s:%d [%s] mFirstPTS %f -> %f\n", __FUNCTION__, __LINE__, pMediaStreamContext->name, mFirstPTS, firstPTS);
+							mFirstPTS = firstPTS;
+						}
+					}
+				}
+				AAMPLOG_INFO("%s:%d Exit : fragmentIndex %d fragmentTime %f\n", __FUNCTION__, __LINE__,
+						pMediaStreamContext->fragmentIndex, pMediaStreamContext->fragmentTime);
+			}
+			else
+			{
+				pMediaStreamContext->eos = true;
+			}
+		}
 		else
 		{
 			aamp_Error("not-yet-supported mpd format");
@@ -1909,96 +2255,222 @@ double PrivateStreamAbstractionMPD::SkipFragments( MediaStreamContext *pMediaStr
 
 
 /**
- * @brief Add attriblutes to xml node
- * @param reader xmlTextReaderPtr
- * @param node xml Node
+ * @brief State of single pass MPD parse
+ *
+ * libxml2 SAX2 callbacks build libdash node tree directly, without the
+ * intermediate tree and per node name lookups of xmlTextReader. Element and
+ * attribute names are interned once per parse, keyed by the dictionary
+ * pointers handed out by libxml2.
+ */
+struct MPDParseContext
+{
+	std::string mpdPath;
+	std::vector<Node *> openNodes;
+	Node *root;
+	std::string text;
+	std::map<std::pair<const xmlChar *, const xmlChar *>, std::string> names;
+	int nodeCount;
+	bool error;
+};
+
+
+/**
+ * @brief Get interned qualified name
+ * @param context parse context
+ * @param prefix namespace prefix, may be NULL
+ * @param localname local name
+ * @retval prefix:localname as reported by xmlTextReaderConstName
  */
-static void AddAttributesToNode(xmlTextReaderPtr *reader, Node *node)
+static const std::string& GetInternedName(MPDParseContext *context, const xmlChar *prefix, const xmlChar *localname)
 {
-	if (xmlTextReaderHasAttributes(*reader))
+	std::pair<const xmlChar *, const xmlChar *> key(prefix, localname);
+	std::map<std::pair<const xmlChar *, const xmlChar *>, std::string>::iterator it = context->names.find(key);
+	if (it == context->names.end())
 	{
-		while (xmlTextReaderMoveToNextAttribute(*reader))
+		std::string name;
+		if (prefix)
 		{
-			std::string key = (const char *)xmlTextReaderConstName(*reader);
-			std::string value = (const char *)xmlTextReaderConstValue(*reader);
-			node->AddAttribute(key, value);
+			name = (const char *)prefix;
+			name += ':';
 		}
+		name += (const char *)localname;
+		it = context->names.insert(std::make_pair(key, name)).first;
 	}
+	return it->second;
 }
 
 
 /**
- * @brief Get xml node form reader
- * @param reader pointer to reader object
- * @param url manifest url
- * @retval xml node
+ * @brief Add text collected since last element boundary to open node
+ * @param context parse context
  */
-static Node* ProcessNode(xmlTextReaderPtr *reader, char *url)
+static void FlushNodeText(MPDParseContext *context)
 {
-	int type = xmlTextReaderNodeType(*reader);
-
-	if (type != WhiteSpace && type != Text)
+	if (!context->text.empty())
 	{
-		while (type == Comment || type == WhiteSpace)
+		if (!context->openNodes.empty() && context->text.find_first_not_of(" \t\r\n") != std::string::npos)
 		{
-			xmlTextReaderRead(*reader);
-			type = xmlTextReaderNodeType(*reader);
+			Node *node = new Node();
+			node->SetType(XML_READER_TYPE_TEXT);
+			node->SetText(context->text);
+			context->openNodes.back()->AddSubNode(node);
+			context->nodeCount++;
 		}
+		context->text.clear();
+	}
+}
 
-		Node *node = new Node();
-		node->SetType(type);
-		node->SetMPDPath(Path::GetDirectoryPath(url));
 
-		if (xmlTextReaderConstName(*reader) == NULL)
-		{
-			delete node;
-			return NULL;
-		}
+/**
+ * @brief SAX2 start element callback
+ */
+static void MPDStartElement(void *ctx, const xmlChar *localname, const xmlChar *prefix, const xmlChar *URI,
+		int nb_namespaces, const xmlChar **namespaces, int nb_attributes, int nb_defaulted, const xmlChar **attributes)
+{
+	MPDParseContext *context = (MPDParseContext *)ctx;
+	FlushNodeText(context);
+	if (context->root && context->openNodes.empty())
+	{
+		return;
+	}
+	Node *node = new Node();
+	node->SetType(XML_READER_TYPE_ELEMENT);
+	node->SetMPDPath(context->mpdPath);
+	node->SetName(GetInternedName(context, prefix, localname));
+	for (int i = 0; i < nb_namespaces; i++)
+	{ // namespace declarations were listed as attributes by reader
+		const xmlChar *nsPrefix = namespaces[2 * i];
+		const xmlChar *nsURI = namespaces[2 * i + 1];
+		node->AddAttribute(GetInternedName(context, nsPrefix ? BAD_CAST "xmlns" : NULL, nsPrefix ? nsPrefix : BAD_CAST "xmlns"),
+				std::string(nsURI ? (const char *)nsURI : ""));
+	}
+	for (int i = 0; i < nb_attributes; i++)
+	{ // localname, prefix, URI, value, end
+		const xmlChar **attribute = &attributes[5 * i];
+		node->AddAttribute(GetInternedName(context, attribute[1], attribute[0]),
+				std::string((const char *)attribute[3], attribute[4] - attribute[3]));
+	}
+	if (context->openNodes.empty())
+	{
+		context->root = node;
+	}
+	else
+	{
+		context->openNodes.back()->AddSubNode(node);
+	}
+	context->openNodes.push_back(node);
+	context->nodeCount++;
+}
 
-		std::string name = (const char *)xmlTextReaderConstName(*reader);
-		int         isEmpty = xmlTextReaderIsEmptyElement(*reader);
 
-		node->SetName(name);
+/**
+ * @brief SAX2 end element callback
+ */
+static void MPDEndElement(void *ctx, const xmlChar *localname, const xmlChar *prefix, const xmlChar *URI)
+{
+	MPDParseContext *context = (MPDParseContext *)ctx;
+	FlushNodeText(context);
+	if (!context->openNodes.empty())
+	{
+		context->openNodes.pop_back();
+	}
+}
 
-		AddAttributesToNode(reader, node);
 
-		if (isEmpty)
-			return node;
+/**
+ * @brief SAX2 character data callback, also used for CDATA
+ */
+static void MPDCharacters(void *ctx, const xmlChar *ch, int len)
+{
+	MPDParseContext *context = (MPDParseContext *)ctx;
+	if (!context->openNodes.empty())
+	{
+		context->text.append((const char *)ch, len);
+	}
+}
 
-		Node    *subnode = NULL;
-		int     ret = xmlTextReaderRead(*reader);
 
-		while (ret == 1)
+/**
+ * @brief libxml2 structured error callback
+ */
+static void MPDParseError(void *ctx, xmlErrorPtr error)
+{
+	MPDParseContext *context = (MPDParseContext *)ctx;
+	if (error && error->level >= XML_ERR_ERROR)
+	{
+		if (!context->error)
 		{
-			if (!strcmp(name.c_str(), (const char *)xmlTextReaderConstName(*reader)))
-			{
-				return node;
-			}
-
-			subnode = ProcessNode(reader, url);
-
-			if (subnode != NULL)
-				node->AddSubNode(subnode);
-
-			ret = xmlTextReaderRead(*reader);
+			logprintf("%s:%d MPD parse error %d line %d: %s", __FUNCTION__, __LINE__, error->code, error->line, error->message ? error->message : "\n");
 		}
-
-		return node;
+		context->error = true;
 	}
-	else if (type == Text)
-	{
-		xmlChar * text = xmlTextReaderReadString(*reader);
+}
+
 
-		if (text != NULL)
+/**
+ * @brief Parse manifest into libdash node tree in a single pass
+ * @param manifest manifest buffer
+ * @param len manifest length
+ * @param url manifest url
+ * @param[out] nodeCount number of nodes created
+ * @retval root node, NULL if document is incomplete or malformed
+ */
+static Node* ParseMPD(const char *manifest, size_t len, const char *url, int &nodeCount)
+{
+	MPDParseContext context;
+	context.mpdPath = Path::GetDirectoryPath(url);
+	context.root = NULL;
+	context.nodeCount = 0;
+	context.error = false;
+
+	xmlSAXHandler handler;
+	memset(&handler, 0, sizeof(handler));
+	handler.initialized = XML_SAX2_MAGIC;
+	handler.startElementNs = MPDStartElement;
+	handler.endElementNs = MPDEndElement;
+	handler.characters = MPDCharacters;
+	handler.cdataBlock = MPDCharacters;
+	handler.serror = MPDParseError;
+
+	xmlParserCtxtPtr ctxt = xmlCreateMemoryParserCtxt(manifest, (int)len);
+	xmlSAXHandlerPtr sax = ctxt ? (xmlSAXHandlerPtr)xmlMalloc(sizeof(xmlSAXHandler)) : NULL;
+	if (!sax)
+	{
+		logprintf("%s:%d failed to create MPD parser context\n", __FUNCTION__, __LINE__);
+		if (ctxt)
 		{
-			Node *node = new Node();
-			node->SetType(type);
-			node->SetText((const char*)text);
-			xmlFree(text);
-			return node;
+			xmlFreeParserCtxt(ctxt);
 		}
+		return NULL;
 	}
-	return NULL;
+	memcpy(sax, &handler, sizeof(handler));
+	if (ctxt->sax)
+	{
+		xmlFree(ctxt->sax);
+	}
+	ctxt->sax = sax; // freed along with ctxt
+	ctxt->userData = &context;
+	// attribute values decoded as by xmlTextReader, '&' stays "&#38;" otherwise.
+	// No getEntity callback, so only predefined and character references are replaced
+	xmlCtxtUseOptions(ctxt, XML_PARSE_NOENT | XML_PARSE_NONET);
+	xmlParseDocument(ctxt);
+	bool wellFormed = ctxt->wellFormed;
+	xmlFreeParserCtxt(ctxt);
+
+	nodeCount = context.nodeCount;
+	if (context.root && !context.openNodes.empty())
+	{ // truncated document
+		logprintf("%s:%d MPD incomplete, %d elements not closed\n", __FUNCTION__, __LINE__, (int)context.openNodes.size());
+		delete context.root;
+		context.root = NULL;
+	}
+	else if (context.root && (context.error || !wellFormed))
+	{
+		logprintf("%s:%d MPD malformed, discarding parsed tree\n", __FUNCTION__, __LINE__);
+		delete context.root;
+		context.root = NULL;
+	}
+	return context.root;
 }
 
 
@@ -2648,10 +3120,18 @@ uint64_t PrivateStreamAbstractionMPD::GetDurationFromRepresentation()
 {
 	uint64_t durationMs = 0;
 	size_t numPeriods = mpd->GetPeriods().size();
+	std::map<std::string, PeriodTimelineDuration> periodTimelineDurations;
 
 	for (unsigned iPeriod = 0; iPeriod < numPeriods; iPeriod++)
 	{
 		IPeriod *period = mpd->GetPeriods().at(iPeriod);
+		// only last period of live manifest grows, timelines of earlier periods are summed once
+		// as long as live window does not trim them
+		std::string periodKey;
+		if (iPeriod + 1 < numPeriods && !period->GetId().empty())
+		{
+			periodKey = period->GetId() + "@" + period->GetStart();
+		}
 		const std::vector<IAdaptationSet *> adaptationSets = period->GetAdaptationSets();
 		if (adaptationSets.size() > 0)
 		{
@@ -2673,15 +3153,34 @@ uint64_t PrivateStreamAbstractionMPD::GetDurationFromRepresentation()
 				{
 					std::vector<ITimeline *>&timelines = segmentTimeline->GetTimelines();
 					uint32_t timeScale = segmentTemplate->GetTimescale();
-					int timeLineIndex = 0;
-					while (timeLineIndex < timelines.size())
+					PeriodTimelineDuration summed;
+					summed.firstStartTime = timelines.empty() ? 0 : timelines.front()->GetStartTime();
+					summed.entryCount = timelines.size();
+					summed.lastRepeatCount = timelines.empty() ? 0 : timelines.back()->GetRepeatCount();
+					summed.durationMs = 0;
+					std::map<std::string, PeriodTimelineDuration>::iterator it = periodKey.empty() ? mPeriodTimelineDurations.end() : mPeriodTimelineDurations.find(periodKey);
+					if (it != mPeriodTimelineDurations.end() && it->second.firstStartTime == summed.firstStartTime &&
+						it->second.entryCount == summed.entryCount && it->second.lastRepeatCount == summed.lastRepeatCount)
 					{
-						ITimeline *timeline = timelines.at(timeLineIndex);
-						uint32_t repeatCount = timeline->GetRepeatCount();
-						uint32_t timelineDurationMs = timeline->GetDuration() * 1000 / timeScale;
-						durationMs += ((repeatCount + 1) * timelineDurationMs);
-						traceprintf("%s period[%d] timeLineIndex[%d] size [%lu] updated durationMs[%" PRIu64 "]\n", __FUNCTION__, iPeriod, timeLineIndex, timelines.size(), durationMs);
-						timeLineIndex++;
+						summed.durationMs = it->second.durationMs;
+					}
+					else
+					{
+						int timeLineIndex = 0;
+						while (timeLineIndex < timelines.size())
+						{
+							ITimeline *timeline = timelines.at(timeLineIndex);
+							uint32_t repeatCount = timeline->GetRepeatCount();
+							uint32_t timelineDurationMs = timeline->GetDuration() * 1000 / timeScale;
+							summed.durationMs += ((repeatCount + 1) * timelineDurationMs);
+							traceprintf("%s period[%d] timeLineIndex[%d] size [%lu] updated durationMs[%" PRIu64 "]\n", __FUNCTION__, iPeriod, timeLineIndex, timelines.size(), durationMs + summed.durationMs);
+							timeLineIndex++;
+						}
+					}
+					durationMs += summed.durationMs;
+					if (!periodKey.empty())
+					{
+						periodTimelineDurations[periodKey] = summed;
 					}
 				}
 				else
@@ -2709,6 +3208,8 @@ uint64_t PrivateStreamAbstractionMPD::GetDurationFromRepresentation()
 			}
 		}
 	}
+	// drop periods no longer in manifest
+	mPeriodTimelineDurations.swap(periodTimelineDurations);
 	return durationMs;
 }
 
@@ -2787,9 +3288,6 @@ bool PrivateStreamAbstractionMPD::UpdateMPD(bool retrievePlaylistFromCache)
 		strcat(fileName, "manifest.mpd");
 		WriteFile( fileName, manifest.ptr, manifest.len);
 #endif
-			// parse xml
-			xmlTextReaderPtr reader = xmlReaderForMemory(manifest.ptr, (int) manifest.len, NULL, NULL, 0);
-
 //Enable to harvest MPD file
 //Save the last 3 MPDs
 #ifdef HARVEST_MPD
@@ -2803,44 +3301,45 @@ bool PrivateStreamAbstractionMPD::UpdateMPD(bool retrievePlaylistFromCache)
 			fprintf(outputFile,"\n\n\nEndofManifest\n\n\n");
 			fclose(outputFile);
 #endif
-			if (reader != NULL)
+			// parse xml
+			int nodeCount = 0;
+			long long parseStartTime = aamp_GetCurrentTimeMS();
+			Node *root = ParseMPD(manifest.ptr, manifest.len, manifestUrl, nodeCount);
+			if(root != NULL)
 			{
-				if (xmlTextReaderRead(reader))
+				uint32_t fetchTime = Time::GetCurrentUTCTimeInSec();
+				long long nodeTreeTime = aamp_GetCurrentTimeMS();
+				MPD* mpd = root->ToMPD();
+				AAMPLOG_INFO("PrivateStreamAbstractionMPD::%s MPD parse: %d bytes, %d nodes, parse %lld ms, model %lld ms\n", __FUNCTION__,
+						(int)manifest.len, nodeCount, nodeTreeTime - parseStartTime, aamp_GetCurrentTimeMS() - nodeTreeTime);
+				if (mpd)
 				{
-					Node *root = ProcessNode(&reader, manifestUrl);
-					if(root != NULL)
-					{
-						uint32_t fetchTime = Time::GetCurrentUTCTimeInSec();
-						MPD* mpd = root->ToMPD();
-						if (mpd)
-						{
-							mpd->SetFetchTime(fetchTime);
-							FindTimedMetadata(mpd, root);
-							if (this->mpd)
-							{
-								delete this->mpd;
-							}
-							this->mpd = mpd;
-						}
-						delete root;
-						aamp->mEnableCache = (mpd->GetType() == "static");
-						if (aamp->mEnableCache && !retrievedPlaylistFromCache)
-						{
-							aamp->InsertToPlaylistCache(aamp->GetManifestUrl(), &manifest, aamp->GetManifestUrl());
-						}
-					}
-					else
+					mpd->SetFetchTime(fetchTime);
+					FindTimedMetadata(mpd, root);
+					if (this->mpd)
 					{
-						logprintf("Error while processing MPD, Process Node returned NULL\n");
-						if(downloadAttempt < 2)
-						{
-							retrievedPlaylistFromCache = false;
-							continue;
-						}
-						ret = false;
+						delete this->mpd;
 					}
+					this->mpd = mpd;
+					mManifestGeneration++;
+				}
+				delete root;
+				aamp->mEnableCache = (mpd->GetType() == "static");
+				if (aamp->mEnableCache && !retrievedPlaylistFromCache)
+				{
+					aamp->InsertToPlaylistCache(aamp->GetManifestUrl(), &manifest, aamp->GetManifestUrl());
+				}
+			}
+			else
+			{
+				logprintf("Error while processing MPD, Process Node returned NULL\n");
+				if(downloadAttempt < 2)
+				{
+					aamp_Free(&manifest.ptr);
+					retrievedPlaylistFromCache = false;
+					continue;
 				}
-				xmlFreeTextReader(reader);
+				ret = false;
 			}
 
 			if (gpGlobalConfig->logging.trace)
@@ -3412,6 +3911,70 @@ void PrivateStreamAbstractionMPD::UpdateLanguageList()
 }
 
 
+/**
+ * @brief Select audio adaptation set of a period, preferring current language
+ * @param period Period to select from
+ * @param[out] selRepresentationIndex Representation of preferred codec in selected adaptation set
+ * @param[in,out] selectedRepType Audio type of selected representation, eAUDIO_UNKNOWN initially
+ * @param[out] selectedLanguage Language of selected adaptation set, if current language is not found
+ * @param[in,out] otherLanguageSelected true if current language is not found, false initially
+ * @retval Index of selected adaptation set, -1 if period has no audio
+ */
+int PrivateStreamAbstractionMPD::SelectAudioAdaptationSet(IPeriod *period, int &selRepresentationIndex, AudioType &selectedRepType, std::string &selectedLanguage, bool &otherLanguageSelected)
+{
+	int selAdaptationSetIndex = -1;
+	AudioType internalSelRepType;
+	int desiredCodecIdx = -1;
+	size_t numAdaptationSets = period->GetAdaptationSets().size();
+	for (unsigned iAdaptationSet = 0; iAdaptationSet < numAdaptationSets; iAdaptationSet++)
+	{
+		IAdaptationSet *adaptationSet = period->GetAdaptationSets().at(iAdaptationSet);
+		if (IsContentType(adaptationSet, eMEDIATYPE_AUDIO))
+		{
+			std::string lang = adaptationSet->GetLang();
+			internalSelRepType = selectedRepType;
+			// found my language configured
+			if(strncmp(aamp->language, lang.c_str(), MAX_LANGUAGE_TAG_LENGTH) == 0)
+			{
+				// check if already other lang adap is selected, if so start fresh
+				if (otherLanguageSelected)
+				{
+					internalSelRepType = eAUDIO_UNKNOWN;
+				}
+				desiredCodecIdx = GetDesiredCodecIndex(adaptationSet, internalSelRepType);
+				if(desiredCodecIdx != -1 )
+				{
+					otherLanguageSelected = false;
+					selectedRepType	= internalSelRepType;
+					selAdaptationSetIndex = iAdaptationSet;
+					selRepresentationIndex = desiredCodecIdx;
+					mAudioType = selectedRepType;
+				}
+				logprintf("PrivateStreamAbstractionMPD::%s %d > Got the matching lang[%s] AdapInx[%d] RepIndx[%d] AudioType[%d]\n",
+					__FUNCTION__, __LINE__, lang.c_str(), selAdaptationSetIndex, selRepresentationIndex, selectedRepType);
+			}
+			else if(internalSelRepType == eAUDIO_UNKNOWN || otherLanguageSelected)
+			{
+				// Got first Adap with diff language , store it now until we find another matching lang adaptation
+				desiredCodecIdx = GetDesiredCodecIndex(adaptationSet, internalSelRepType);
+				if(desiredCodecIdx != -1)
+				{
+					otherLanguageSelected = true;
+					selectedLanguage = lang;
+					selectedRepType	= internalSelRepType;
+					selAdaptationSetIndex = iAdaptationSet;
+					selRepresentationIndex = desiredCodecIdx;
+					mAudioType = selectedRepType;
+				}
+				logprintf("PrivateStreamAbstractionMPD::%s %d > Got a non-matching lang[%s] AdapInx[%d] RepIndx[%d] AudioType[%d]\n",
+					__FUNCTION__, __LINE__, lang.c_str(), selAdaptationSetIndex, selRepresentationIndex, selectedRepType);
+			}
+		}
+	}
+	return selAdaptationSetIndex;
+}
+
+
 /**
  * @brief Does stream selection
  * @param newTune true if this is a new tune
@@ -3435,8 +3998,7 @@ void PrivateStreamAbstractionMPD::StreamSelection( bool newTune)
 		size_t numAdaptationSets = period->GetAdaptationSets().size();
 		int  selAdaptationSetIndex = -1;
 		int selRepresentationIndex = -1;
-		AudioType selectedRepType = eAUDIO_UNKNOWN, internalSelRepType ;
-		int desiredCodecIdx = -1;
+		AudioType selectedRepType = eAUDIO_UNKNOWN;
 		bool otherLanguageSelected = false;
 		mMediaStreamContext[i]->enabled = false;
 		std::string selectedLanguage;
@@ -3452,44 +4014,9 @@ void PrivateStreamAbstractionMPD::StreamSelection( bool newTune)
 				{
 					if (eMEDIATYPE_AUDIO == i)
 					{
-						std::string lang = adaptationSet->GetLang();
-						internalSelRepType = selectedRepType;
-						// found my language configured
-						if(strncmp(aamp->language, lang.c_str(), MAX_LANGUAGE_TAG_LENGTH) == 0)
-						{
-							// check if already other lang adap is selected, if so start fresh
-							if (otherLanguageSelected)
-							{
-								internalSelRepType = eAUDIO_UNKNOWN;
-							}
-							desiredCodecIdx = GetDesiredCodecIndex(adaptationSet, internalSelRepType);
-							if(desiredCodecIdx != -1 )
-							{
-								otherLanguageSelected = false;
-								selectedRepType	= internalSelRepType;
-								selAdaptationSetIndex = iAdaptationSet;
-								selRepresentationIndex = desiredCodecIdx;
-								mAudioType = selectedRepType;
-							}
-							logprintf("PrivateStreamAbstractionMPD::%s %d > Got the matching lang[%s] AdapInx[%d] RepIndx[%d] AudioType[%d]\n",
-								__FUNCTION__, __LINE__, lang.c_str(), selAdaptationSetIndex, selRepresentationIndex, selectedRepType);
-						}
-						else if(internalSelRepType == eAUDIO_UNKNOWN || otherLanguageSelected)
-						{
-							// Got first Adap with diff language , store it now until we find another matching lang adaptation
-							desiredCodecIdx = GetDesiredCodecIndex(adaptationSet, internalSelRepType);
-							if(desiredCodecIdx != -1)
-							{
-								otherLanguageSelected = true;
-								selectedLanguage = lang;
-								selectedRepType	= internalSelRepType;
-								selAdaptationSetIndex = iAdaptationSet;
-								selRepresentationIndex = desiredCodecIdx;
-								mAudioType = selectedRepType;
-							}
-							logprintf("PrivateStreamAbstractionMPD::%s %d > Got a non-matching lang[%s] AdapInx[%d] RepIndx[%d] AudioType[%d]\n",
-								__FUNCTION__, __LINE__, lang.c_str(), selAdaptationSetIndex, selRepresentationIndex, selectedRepType);
-						}
+						// all audio adaptation sets of period are checked at once
+						selAdaptationSetIndex = SelectAudioAdaptationSet(period, selRepresentationIndex, selectedRepType, selectedLanguage, otherLanguageSelected);
+						break;
 					}
 					else if (!gpGlobalConfig->bAudioOnlyPlayback)
 					{
@@ -3660,6 +4187,276 @@ static void GetBitrateInfoFromCustomMpd(IAdaptationSet *adaptationSet, std::vect
 }
 
 
+/**
+ * @brief Set base URLs of fragments from the innermost level defining them
+ * @param pMediaStreamContext Track object, representation to be set
+ */
+void PrivateStreamAbstractionMPD::SetFragmentBaseUrls(MediaStreamContext *pMediaStreamContext)
+{
+	pMediaStreamContext->fragmentDescriptor.baseUrls = &pMediaStreamContext->representation->GetBaseURLs();
+	if (pMediaStreamContext->fragmentDescriptor.baseUrls->size() == 0)
+	{
+		pMediaStreamContext->fragmentDescriptor.baseUrls = &pMediaStreamContext->adaptationSet->GetBaseURLs();
+		if (pMediaStreamContext->fragmentDescriptor.baseUrls->size() == 0)
+		{
+			pMediaStreamContext->fragmentDescriptor.baseUrls = &mpd->GetPeriods().at(mCurrentPeriodIdx)->GetBaseURLs();
+			if (pMediaStreamContext->fragmentDescriptor.baseUrls->size() == 0)
+			{
+				pMediaStreamContext->fragmentDescriptor.baseUrls = &mpd->GetBaseUrls();
+			}
+		}
+	}
+}
+
+
+/**
+ * @brief Drop per representation data of track if it belongs to a previous manifest
+ * @param pMediaStreamContext track
+ */
+void PrivateStreamAbstractionMPD::ValidateRepresentationCaches(MediaStreamContext *pMediaStreamContext)
+{
+	if (pMediaStreamContext->representationCacheGeneration != mManifestGeneration)
+	{ // representations of previous manifest are freed, their addresses may be reused
+		pMediaStreamContext->segmentIndexes.clear();
+		pMediaStreamContext->urlTemplates.clear();
+		pMediaStreamContext->representationCacheGeneration = mManifestGeneration;
+	}
+}
+
+
+/**
+ * @brief Generates fragment url of track's representation, compiling template on first use
+ * @param pMediaStreamContext track
+ * @param[out] fragmentUrl fragment url
+ * @param media media or initialization string of representation
+ */
+void PrivateStreamAbstractionMPD::GetTrackFragmentUrl(MediaStreamContext *pMediaStreamContext, char fragmentUrl[MAX_URI_LENGTH], const std::string &media)
+{
+	if (!pMediaStreamContext->representation || std::string::npos == media.find('$'))
+	{ // nothing to substitute, eg SegmentList media
+		GetFragmentUrl(fragmentUrl, &pMediaStreamContext->fragmentDescriptor, media);
+		return;
+	}
+	ValidateRepresentationCaches(pMediaStreamContext);
+	std::vector<SegmentUrlTemplate> &urlTemplates = pMediaStreamContext->urlTemplates[pMediaStreamContext->representation];
+	size_t index = 0;
+	while (index < urlTemplates.size() && !urlTemplates[index].IsCompiledFor(&pMediaStreamContext->fragmentDescriptor, media))
+	{
+		index++;
+	}
+	if (index == urlTemplates.size())
+	{
+		if (urlTemplates.size() >= MAX_URL_TEMPLATES_PER_REPRESENTATION)
+		{
+			urlTemplates.clear();
+			index = 0;
+		}
+		urlTemplates.push_back(SegmentUrlTemplate());
+		urlTemplates[index].Compile(&pMediaStreamContext->fragmentDescriptor, media);
+	}
+	urlTemplates[index].Render(fragmentUrl, &pMediaStreamContext->fragmentDescriptor);
+}
+
+
+/**
+ * @brief Add subsegments of segment index box to table, following nested segment index boxes
+ * @param pMediaStreamContext track
+ * @param fragmentUrl url of media file
+ * @param buffer loaded part of media file
+ * @param bufferSize size of buffer
+ * @param bufferOffset file offset of buffer
+ * @param boxOffset file offset of segment index box
+ * @param depth nesting level of box
+ * @param curlInstance curl instance for loading nested boxes outside buffer
+ * @param[out] segmentIndex subsegment table
+ * @retval true on success
+ */
+bool PrivateStreamAbstractionMPD::ParseSegmentIndex(MediaStreamContext *pMediaStreamContext, const char *fragmentUrl, const char *buffer, size_t bufferSize, uint64_t bufferOffset,
+		uint64_t boxOffset, int depth, unsigned int curlInstance, SegmentIndex &segmentIndex)
+{
+	std::vector<SegmentIndexEntry> references;
+	double presentationTime = 0;
+	if (depth > MAX_SEGMENT_INDEX_DEPTH || boxOffset < bufferOffset || (boxOffset - bufferOffset) >= bufferSize ||
+		!ParseSegmentIndexBox(buffer + (boxOffset - bufferOffset), bufferSize - (boxOffset - bufferOffset), boxOffset, references, presentationTime))
+	{
+		logprintf("PrivateStreamAbstractionMPD::%s:%d invalid segment index box at %" PRIu64 " depth %d\n", __FUNCTION__, __LINE__, boxOffset, depth);
+		return false;
+	}
+	if (0 == depth)
+	{
+		segmentIndex.presentationTime = presentationTime;
+	}
+	for (int i = 0; i < references.size(); i++)
+	{
+		const SegmentIndexEntry &reference = references[i];
+		if (!reference.isIndex)
+		{
+			segmentIndex.entries.push_back(reference);
+		}
+		else
+		{
+			uint64_t boxSize = 0;
+			if (reference.offset >= bufferOffset && reference.offset < (bufferOffset + bufferSize) &&
+				ReadBoxSize(buffer + (reference.offset - bufferOffset), bufferSize - (reference.offset - bufferOffset), boxSize) &&
+				(reference.offset + boxSize) <= (bufferOffset + bufferSize))
+			{ // nested box within buffer, media it indexes need not be
+				if (!ParseSegmentIndex(pMediaStreamContext, fragmentUrl, buffer, bufferSize, bufferOffset, reference.offset, depth + 1, curlInstance, segmentIndex))
+				{
+					return false;
+				}
+			}
+			else
+			{ // nested index not covered by indexRange, referenced_size includes the media it indexes, so load just the box
+				char range[128];
+				size_t len = 0;
+				ProfilerBucketType bucketType = aamp->GetProfilerBucketForMedia(pMediaStreamContext->mediaType, true);
+				if (reference.size < 8)
+				{
+					logprintf("PrivateStreamAbstractionMPD::%s:%d invalid nested segment index size %u\n", __FUNCTION__, __LINE__, reference.size);
+					return false;
+				}
+				// header with room for largesize
+				uint64_t headerSize = (reference.size < 16) ? reference.size : 16;
+				sprintf(range, "%" PRIu64 "-%" PRIu64 "", reference.offset, reference.offset + headerSize - 1);
+				char *header = aamp->LoadFragment(bucketType, fragmentUrl, &len, curlInstance, range, pMediaStreamContext->mediaType);
+				if (!header)
+				{
+					return false;
+				}
+				bool validHeader = ReadBoxSize(header, len, boxSize) && (boxSize <= reference.size);
+				aamp_Free(&header);
+				if (!validHeader)
+				{
+					logprintf("PrivateStreamAbstractionMPD::%s:%d invalid nested segment index box header at %" PRIu64 "\n", __FUNCTION__, __LINE__, reference.offset);
+					return false;
+				}
+				sprintf(range, "%" PRIu64 "-%" PRIu64 "", reference.offset, reference.offset + boxSize - 1);
+				char *nestedBuffer = aamp->LoadFragment(bucketType, fragmentUrl, &len, curlInstance, range, pMediaStreamContext->mediaType);
+				if (!nestedBuffer)
+				{
+					return false;
+				}
+				bool ret = ParseSegmentIndex(pMediaStreamContext, fragmentUrl, nestedBuffer, len, reference.offset, reference.offset, depth + 1, curlInstance, segmentIndex);
+				aamp_Free(&nestedBuffer);
+				if (!ret)
+				{
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+
+/**
+ * @brief Get subsegment table of track's representation, loading its segment index on first use
+ * @param pMediaStreamContext track
+ * @param segmentBase SegmentBase of representation
+ * @param fragmentUrl url of media file
+ * @param curlInstance curl instance to load index
+ * @retval subsegment table, NULL if index can't be loaded
+ */
+const SegmentIndex* PrivateStreamAbstractionMPD::GetSegmentIndex(MediaStreamContext *pMediaStreamContext, ISegmentBase *segmentBase, const char *fragmentUrl, unsigned int curlInstance)
+{
+	ValidateRepresentationCaches(pMediaStreamContext);
+	std::map<IRepresentation *, SegmentIndex>::iterator it = pMediaStreamContext->segmentIndexes.find(pMediaStreamContext->representation);
+	if (it == pMediaStreamContext->segmentIndexes.end())
+	{ // lazily load index
+		std::string range = segmentBase->GetIndexRange();
+		uint64_t start = 0;
+		uint64_t fin = 0;
+		sscanf(range.c_str(), "%" SCNu64 "-%" SCNu64 "", &start, &fin);
+		size_t len = 0;
+		ProfilerBucketType bucketType = aamp->GetProfilerBucketForMedia(pMediaStreamContext->mediaType, true);
+		char *buffer = aamp->LoadFragment(bucketType, fragmentUrl, &len, curlInstance, range.c_str(),pMediaStreamContext->mediaType);
+		if (!buffer)
+		{
+			return NULL;
+		}
+		SegmentIndex segmentIndex;
+		bool ret = ParseSegmentIndex(pMediaStreamContext, fragmentUrl, buffer, len, start, start, 0, curlInstance, segmentIndex);
+		aamp_Free(&buffer);
+		if (!ret)
+		{
+			return NULL;
+		}
+		double startTime = 0;
+		for (int i = 0; i < segmentIndex.entries.size(); i++)
+		{
+			segmentIndex.entries[i].startTime = startTime;
+			startTime += segmentIndex.entries[i].duration;
+		}
+		AAMPLOG_INFO("PrivateStreamAbstractionMPD::%s:%d %s representation %s: %d subsegments, %f seconds\n", __FUNCTION__, __LINE__,
+				mMediaTypeName[pMediaStreamContext->mediaType], pMediaStreamContext->representation->GetId().c_str(), (int)segmentIndex.entries.size(), startTime);
+		it = pMediaStreamContext->segmentIndexes.insert(std::make_pair(pMediaStreamContext->representation, segmentIndex)).first;
+	}
+	return &it->second;
+}
+
+
+/**
+ * @brief Get index of track's segment timeline, building it on first use in a manifest
+ * @param pMediaStreamContext track
+ * @param segmentTimeline timeline of track's segment template
+ * @retval timeline index
+ */
+const SegmentTimelineIndex& PrivateStreamAbstractionMPD::GetTimelineIndex(MediaStreamContext *pMediaStreamContext, const ISegmentTimeline *segmentTimeline)
+{
+	pMediaStreamContext->timelineIndex.Update(segmentTimeline, mManifestGeneration);
+	return pMediaStreamContext->timelineIndex;
+}
+
+
+/**
+ * @brief Check if representations of video adaptation set match ABR profiles in use
+ * @param adaptationSet video adaptation set of refreshed manifest
+ * @retval true if profiles need not be rebuilt
+ */
+bool PrivateStreamAbstractionMPD::IsProfileListUnchanged(IAdaptationSet *adaptationSet)
+{
+	const std::vector<IRepresentation *> &representations = adaptationSet->GetRepresentation();
+	int representationCount = representations.size();
+	if (!mStreamInfo || representationCount != GetProfileCount())
+	{
+		return false;
+	}
+	for (int idx = 0; idx < representationCount; idx++)
+	{
+		IRepresentation *representation = representations.at(idx);
+		if (mStreamInfo[idx].bandwidthBitsPerSecond != representation->GetBandwidth() ||
+			mStreamInfo[idx].resolution.height != representation->GetHeight() ||
+			mStreamInfo[idx].resolution.width != representation->GetWidth())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+/**
+ * @brief Find period in current manifest
+ * @param periodId Period@id
+ * @retval index of period, -1 if not present
+ */
+int PrivateStreamAbstractionMPD::FindPeriodIndex(const std::string &periodId)
+{
+	if (!periodId.empty())
+	{
+		const std::vector<IPeriod *> &periods = mpd->GetPeriods();
+		for (int iPeriod = 0; iPeriod < periods.size(); iPeriod++)
+		{
+			if (periods.at(iPeriod)->GetId() == periodId)
+			{
+				return iPeriod;
+			}
+		}
+	}
+	return -1;
+}
+
+
 /**
  * @brief Updates track information based on current state
  */
@@ -3709,7 +4506,7 @@ void PrivateStreamAbstractionMPD::UpdateTrackInfo(bool modifyDefaultBW, bool per
 					aamp->profiler.SetBandwidthBitsPerSecondVideo(bandwidth);
 					mContext->profileIdxForBandwidthNotification = mBitrateIndexMap[bandwidth];
 				}
-				else if(!mIsFogTSB)
+				else if(!mIsFogTSB && (periodChanged || -1 == pMediaStreamContext->representationIndex || !IsProfileListUnchanged(pMediaStreamContext->adaptationSet)))
 				{
 					int representationCount = pMediaStreamContext->adaptationSet->GetRepresentation().size();
 					if ((representationCount != GetProfileCount()) && mStreamInfo)
@@ -3800,20 +4597,7 @@ void PrivateStreamAbstractionMPD::UpdateTrackInfo(bool modifyDefaultBW, bool per
 				}
 			}
 			pMediaStreamContext->representation = pMediaStreamContext->adaptationSet->GetRepresentation().at(pMediaStreamContext->representationIndex);
-
-			pMediaStreamContext->fragmentDescriptor.baseUrls = &pMediaStreamContext->representation->GetBaseURLs();
-			if (pMediaStreamContext->fragmentDescriptor.baseUrls->size() == 0)
-			{
-				pMediaStreamContext->fragmentDescriptor.baseUrls = &pMediaStreamContext->adaptationSet->GetBaseURLs();
-				if (pMediaStreamContext->fragmentDescriptor.baseUrls->size() == 0)
-				{
-					pMediaStreamContext->fragmentDescriptor.baseUrls = &mpd->GetPeriods().at(mCurrentPeriodIdx)->GetBaseURLs();
-					if (pMediaStreamContext->fragmentDescriptor.baseUrls->size() == 0)
-					{
-						pMediaStreamContext->fragmentDescriptor.baseUrls = &mpd->GetBaseUrls();
-					}
-				}
-			}
+			SetFragmentBaseUrls(pMediaStreamContext);
 			pMediaStreamContext->fragmentIndex = 0;
 			if(resetTimeLineIndex)
 				pMediaStreamContext->timeLineIndex = 0;
@@ -3846,6 +4630,210 @@ void PrivateStreamAbstractionMPD::UpdateTrackInfo(bool modifyDefaultBW, bool per
 }
 
 
+/**
+ * @brief Switch audio track to adaptation set of current language without retune
+ * @retval true if switch is started, false if a retune is needed
+ */
+bool PrivateStreamAbstractionMPD::SwitchAudioTrack()
+{
+	MediaStreamContext *pMediaStreamContext = mMediaStreamContext[eMEDIATYPE_AUDIO];
+	if (rate != 1.0 || !fragmentCollectorThreadStarted || !pMediaStreamContext || !pMediaStreamContext->enabled || pMediaStreamContext->eosReached)
+	{
+		logprintf("PrivateStreamAbstractionMPD::%s:%d audio track can't be switched alone\n", __FUNCTION__, __LINE__);
+		return false;
+	}
+	// mpd is owned by fetcher thread, adaptation set is selected there
+	mContext->StopAudioInjection();
+	if (!aamp->FlushTrack(eMEDIATYPE_AUDIO))
+	{
+		pMediaStreamContext->StartInjectLoop(true);
+		return false;
+	}
+	if (!pMediaStreamContext->RequestRenditionSwitch())
+	{
+		logprintf("PrivateStreamAbstractionMPD::%s:%d audio fetch already done\n", __FUNCTION__, __LINE__);
+		return false;
+	}
+	return true;
+}
+
+
+/**
+ * @brief Re-point audio track to adaptation set of current language at playback position
+ *
+ * Called from fetcher loop on request of SwitchAudioTrack, once audio injector
+ * is stopped and sink is flushed. Position is carried over in time relative to
+ * period, since adaptation sets may differ in timescale and segmentation.
+ */
+void PrivateStreamAbstractionMPD::SwitchAudioAdaptationSet()
+{
+	MediaStreamContext *pMediaStreamContext = mMediaStreamContext[eMEDIATYPE_AUDIO];
+	IPeriod *period = mpd->GetPeriods().at(mCurrentPeriodIdx);
+	double aheadOfPlayback = pMediaStreamContext->FlushFragments();
+
+	// playback position relative to period start
+	double periodPosition = pMediaStreamContext->fragmentTime - aheadOfPlayback;
+	double averageFragmentDuration = 0;
+	ISegmentTemplate *segmentTemplate = pMediaStreamContext->adaptationSet->GetSegmentTemplate();
+	if (!segmentTemplate)
+	{
+		segmentTemplate = pMediaStreamContext->representation->GetSegmentTemplate();
+	}
+	if (segmentTemplate)
+	{
+		uint32_t timeScale = segmentTemplate->GetTimescale();
+		if (segmentTemplate->GetSegmentTimeline())
+		{
+			uint64_t nextSegmentTime = pMediaStreamContext->lastSegmentTime + pMediaStreamContext->lastSegmentDuration;
+			periodPosition = ((double)nextSegmentTime - (double)segmentTemplate->GetPresentationTimeOffset()) / timeScale - aheadOfPlayback;
+		}
+		else if (segmentTemplate->GetDuration())
+		{
+			double fragmentDuration = ((double)segmentTemplate->GetDuration()) / timeScale;
+			periodPosition = ((double)pMediaStreamContext->fragmentDescriptor.Number - segmentTemplate->GetStartNumber()) * fragmentDuration - aheadOfPlayback;
+		}
+	}
+	else if (pMediaStreamContext->fragmentIndex > 0)
+	{
+		averageFragmentDuration = pMediaStreamContext->fragmentTime / pMediaStreamContext->fragmentIndex;
+	}
+	if (periodPosition < 0)
+	{
+		periodPosition = 0;
+	}
+
+	int selRepresentationIndex = -1;
+	AudioType selectedRepType = eAUDIO_UNKNOWN;
+	std::string selectedLanguage;
+	bool otherLanguageSelected = false;
+	int selAdaptationSetIndex = SelectAudioAdaptationSet(period, selRepresentationIndex, selectedRepType, selectedLanguage, otherLanguageSelected);
+	if (selAdaptationSetIndex >= 0)
+	{
+		if (otherLanguageSelected && (mLangList.end() == mLangList.find(aamp->language)))
+		{
+			logprintf("PrivateStreamAbstractionMPD::%s %d > update language [%s]->[%s]\n",
+							__FUNCTION__, __LINE__, aamp->language, selectedLanguage.c_str());
+			aamp->UpdateAudioLanguageSelection(selectedLanguage.c_str());
+		}
+		if (aamp->previousAudioType != selectedRepType)
+		{
+			// previousAudioType is left as is, so that retune configures pipeline for new type
+			logprintf("PrivateStreamAbstractionMPD::%s %d > AudioType Changed %d -> %d\n",
+					__FUNCTION__, __LINE__, aamp->previousAudioType, selectedRepType);
+			aamp->ScheduleRetune(eDASH_ERROR_AUDIO_CODEC_CHANGE, eMEDIATYPE_AUDIO);
+		}
+		pMediaStreamContext->adaptationSetIdx = selAdaptationSetIndex;
+		pMediaStreamContext->representationIndex = selRepresentationIndex;
+	}
+	pMediaStreamContext->adaptationSet = period->GetAdaptationSets().at(pMediaStreamContext->adaptationSetIdx);
+	pMediaStreamContext->adaptationSetId = pMediaStreamContext->adaptationSet->GetId();
+	pMediaStreamContext->representation = pMediaStreamContext->adaptationSet->GetRepresentation().at(pMediaStreamContext->representationIndex);
+	SetFragmentBaseUrls(pMediaStreamContext);
+	pMediaStreamContext->fragmentDescriptor.Bandwidth = pMediaStreamContext->representation->GetBandwidth();
+	strcpy(pMediaStreamContext->fragmentDescriptor.RepresentationID, pMediaStreamContext->representation->GetId().c_str());
+	aamp->profiler.SetBandwidthBitsPerSecondAudio(pMediaStreamContext->fragmentDescriptor.Bandwidth);
+	ProcessContentProtection(pMediaStreamContext->adaptationSet, eMEDIATYPE_AUDIO);
+
+	// position new adaptation set at fragment being played
+	pMediaStreamContext->fragmentIndex = 0;
+	pMediaStreamContext->timeLineIndex = 0;
+	pMediaStreamContext->fragmentRepeatCount = 0;
+	pMediaStreamContext->fragmentOffset = 0;
+	pMediaStreamContext->fragmentTime = 0;
+	pMediaStreamContext->fragmentDescriptor.Time = 0;
+	segmentTemplate = pMediaStreamContext->adaptationSet->GetSegmentTemplate();
+	if (!segmentTemplate)
+	{
+		segmentTemplate = pMediaStreamContext->representation->GetSegmentTemplate();
+	}
+	if (segmentTemplate)
+	{
+		uint32_t timeScale = segmentTemplate->GetTimescale();
+		const ISegmentTimeline *segmentTimeline = segmentTemplate->GetSegmentTimeline();
+		pMediaStreamContext->fragmentDescriptor.Number = segmentTemplate->GetStartNumber();
+		if (segmentTimeline)
+		{
+			std::vector<ITimeline *>&timelines = segmentTimeline->GetTimelines();
+			const SegmentTimelineIndex &timelineIndex = GetTimelineIndex(pMediaStreamContext, segmentTimeline);
+			uint64_t targetTime = segmentTemplate->GetPresentationTimeOffset() + (uint64_t)(periodPosition * timeScale);
+			uint64_t startTime = 0;
+			uint64_t firstStartTime = 0;
+			uint32_t duration = 0;
+			int index = timelineIndex.FindEntry(targetTime, 0);
+			if (index == timelineIndex.Size() && index > 0)
+			{
+				index--;
+			}
+			if (index < timelineIndex.Size())
+			{
+				ITimeline *timeline = timelines.at(index);
+				uint64_t count = 0;
+				firstStartTime = timelineIndex.GetStartTime(0);
+				startTime = timelineIndex.GetStartTime(index);
+				duration = timeline->GetDuration();
+				if (targetTime > startTime && duration)
+				{
+					count = std::min<uint64_t>((targetTime - startTime) / duration, timeline->GetRepeatCount());
+				}
+				pMediaStreamContext->fragmentRepeatCount = (int)count;
+				pMediaStreamContext->fragmentDescriptor.Number += timelineIndex.GetSegmentOffset(index) + count;
+				startTime += count * duration;
+			}
+			pMediaStreamContext->timeLineIndex = index;
+			pMediaStreamContext->fragmentDescriptor.Time = startTime;
+			pMediaStreamContext->fragmentTime = ((double)(startTime - firstStartTime)) / timeScale;
+			// PushNextFragment fetches fragments after lastSegmentTime, and derives start of entries without @t from it
+			uint64_t previousDuration = std::min<uint64_t>(duration, startTime);
+			pMediaStreamContext->lastSegmentDuration = previousDuration;
+			pMediaStreamContext->lastSegmentTime = startTime - previousDuration;
+		}
+		else
+		{
+			double fragmentDuration = ((double)segmentTemplate->GetDuration()) / timeScale;
+			uint64_t count = 0;
+			if (fragmentDuration > 0)
+			{
+				count = (uint64_t)(periodPosition / fragmentDuration);
+			}
+			pMediaStreamContext->fragmentDescriptor.Number += count;
+			pMediaStreamContext->fragmentTime = count * fragmentDuration;
+			// live derives time from lastSegmentNumber
+			pMediaStreamContext->lastSegmentNumber = pMediaStreamContext->fragmentDescriptor.Number;
+			if (!mIsLive)
+			{
+				pMediaStreamContext->fragmentDescriptor.Time = mPeriodStartTime + pMediaStreamContext->fragmentTime;
+			}
+		}
+	}
+	else if (pMediaStreamContext->representation->GetSegmentBase())
+	{
+		char fragmentUrl[MAX_URI_LENGTH];
+		GetFragmentUrl(fragmentUrl, &pMediaStreamContext->fragmentDescriptor, "");
+		const SegmentIndex *segmentIndex = GetSegmentIndex(pMediaStreamContext, pMediaStreamContext->representation->GetSegmentBase(), fragmentUrl, eMEDIATYPE_AUDIO);
+		if (segmentIndex)
+		{
+			pMediaStreamContext->fragmentIndex = segmentIndex->Find(periodPosition);
+			if (pMediaStreamContext->fragmentIndex < segmentIndex->entries.size())
+			{
+				pMediaStreamContext->fragmentTime = segmentIndex->entries[pMediaStreamContext->fragmentIndex].startTime;
+			}
+		}
+	}
+	else if (averageFragmentDuration > 0)
+	{
+		pMediaStreamContext->fragmentIndex = (int)(periodPosition / averageFragmentDuration);
+		pMediaStreamContext->fragmentTime = pMediaStreamContext->fragmentIndex * averageFragmentDuration;
+	}
+	logprintf("PrivateStreamAbstractionMPD::%s:%d audio AdapInx[%d] RepIndx[%d] position in period %f\n", __FUNCTION__, __LINE__,
+		pMediaStreamContext->adaptationSetIdx, pMediaStreamContext->representationIndex, periodPosition);
+	pMediaStreamContext->eos = false;
+	pMediaStreamContext->eosReached = false;
+	// initialization of new representation is fetched before its fragments
+	pMediaStreamContext->profileChanged = true;
+	pMediaStreamContext->StartInjectLoop(true);
+}
+
+
 /**
  * @brief Update culling state for live manifests
  */
@@ -4089,10 +5077,6 @@ void PrivateStreamAbstractionMPD::FetchAndInjectInitialization(bool discontinuit
 					if (segmentBase)
 					{
 						pMediaStreamContext->fragmentOffset = 0;
-						if (pMediaStreamContext->index_ptr)
-						{
-							aamp_Free(&pMediaStreamContext->index_ptr);
-						}
 						const IURLType *urlType = segmentBase->GetInitialization();
 						if (urlType)
 						{
@@ -4506,12 +5490,16 @@ void PrivateStreamAbstractionMPD::FetcherLoop()
 				while (!exitFetchLoop && !liveMPDRefresh)
 				{
 					bool bCacheFullState = true;
+					if (mMediaStreamContext[eMEDIATYPE_AUDIO] && mMediaStreamContext[eMEDIATYPE_AUDIO]->TakeRenditionSwitchRequest())
+					{
+						SwitchAudioAdaptationSet();
+					}
 					for (int i = mNumberOfTracks-1; i >= 0; i--)
 					{
 						struct MediaStreamContext *pMediaStreamContext = mMediaStreamContext[i];
 						if (pMediaStreamContext->adaptationSet )
 						{
-							if((pMediaStreamContext->numberOfFragmentsCached != gpGlobalConfig->maxCachedFragmentsPerTrack) && !(pMediaStreamContext->profileChanged))
+							if((pMediaStreamContext->GetFreeFragmentCount() > 0) && !(pMediaStreamContext->profileChanged))
 							{	// profile not changed and Cache not full scenario
 								if (!pMediaStreamContext->eos)
 								{
@@ -4555,7 +5543,7 @@ void PrivateStreamAbstractionMPD::FetcherLoop()
 								FetchAndInjectInitialization();
 							}
 			
-							if(pMediaStreamContext->numberOfFragmentsCached != gpGlobalConfig->maxCachedFragmentsPerTrack)
+							if(pMediaStreamContext->GetFreeFragmentCount() > 0)
 							{
 								bCacheFullState = false;
 							}
@@ -4750,12 +5738,25 @@ void PrivateStreamAbstractionMPD::FetcherLoop()
 			// sleep before next manifest update
 			aamp->InterruptableMsSleep(minDelayBetweenPlaylistUpdates);
 		}
+		std::string currentPeriodId;
+		if (mpd && mCurrentPeriodIdx < mpd->GetPeriods().size())
+		{
+			currentPeriodId = mpd->GetPeriods().at(mCurrentPeriodIdx)->GetId();
+		}
 		if (!UpdateMPD())
 		{
 			break;
 		}
 		
 		{
+			// Periods before current one may have been removed from live window,
+			// keep playing same period instead of the one now at its index
+			int periodIdx = FindPeriodIndex(currentPeriodId);
+			if (periodIdx >= 0 && periodIdx != mCurrentPeriodIdx)
+			{
+				logprintf("MPD Fragment Collector period %s moved (currentIdx:%d->%d)\n", currentPeriodId.c_str(), mCurrentPeriodIdx, periodIdx);
+				mCurrentPeriodIdx = periodIdx;
+			}
 			// DELIA-31750 - looping of cdvr video - Issue happens with multiperiod content only
 			// When playback is near live position (last period) or after eos in period 
 			// mCurrentPeriodIdx was resetted to 0 . This caused fetch loop to continue from Period 0/fragement 1
@@ -4771,6 +5772,15 @@ void PrivateStreamAbstractionMPD::FetcherLoop()
 		mpdChanged = true;
 	}
 	while (!exitFetchLoop);
+	MediaStreamContext *audio = mMediaStreamContext[eMEDIATYPE_AUDIO];
+	if (audio && !audio->FinishFetching())
+	{ // audio switch requested as fetcher exits, resume injection of audio already fetched
+		audio->TakeRenditionSwitchRequest();
+		if (aamp->DownloadsAreEnabled())
+		{
+			audio->StartInjectLoop(true);
+		}
+	}
 	logprintf("MPD fragment collector done\n");
 }
 
@@ -5198,3 +6208,13 @@ std::vector<long> StreamAbstractionAAMP_MPD::GetAudioBitrates(void)
 {
 	return mPriv->GetAudioBitrates();
 }
+
+
+/**
+ * @brief Switch audio track to adaptation set of current language without retune
+ * @retval true if switch is started, false if a retune is needed
+ */
+bool StreamAbstractionAAMP_MPD::SwitchAudioTrack()
+{
+	return mPriv->SwitchAudioTrack();
+}
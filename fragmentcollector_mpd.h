@@ -49,6 +49,7 @@ public:
 	bool checkForRampdown;
 	std::vector<long> GetVideoBitrates(void);
 	std::vector<long> GetAudioBitrates(void);
+	bool SwitchAudioTrack();
 protected:
 	StreamInfo* GetStreamInfo(int idx);
 private:
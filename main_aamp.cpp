@@ -54,6 +54,12 @@
 #include "cc_util.h"
 #include "vlGfxScreen.h"
 #endif
+#ifdef AAMP_MPD_DRM
+#include "AampLicensePrefetcher.h"
+#endif
+#ifdef AAMP_VANILLA_AES_SUPPORT
+#include "aamp_aes.h"
+#endif
 #include <uuid/uuid.h>
 static const char* strAAMPPipeName = "/tmp/ipc_aamp";
 #ifdef WIN32
@@ -162,6 +168,12 @@ GlobalConfigAAMP *gpGlobalConfig;
 #define AAMP_MAX_SIMULTANEOUS_INSTANCES 2
 #define AAMP_MAX_TIME_BW_UNDERFLOWS_TO_TRIGGER_RETUNE_MS (20*1000LL)
 
+#ifdef __APPLE__
+#define NEED_DATA_WAIT_CLOCK CLOCK_REALTIME     /**< Clock of need-data condition, no pthread_condattr_setclock on OSX */
+#else
+#define NEED_DATA_WAIT_CLOCK CLOCK_MONOTONIC    /**< Clock of need-data condition */
+#endif
+
 #define VALIDATE_INT(param_name, param_value, default_value)        \
     if ((param_value <= 0) || (param_value > INT_MAX))  { \
         logprintf("%s(): Parameter '%s' not within INTEGER limit. Using default value instead.\n", __FUNCTION__, param_name); \
@@ -1015,7 +1027,7 @@ void PrivateInstanceAAMP::LogTuneComplete(void)
 {
 	bool success = true; // TODO
 	int streamType = getStreamType();
-	profiler.TuneEnd(success, mContentType, streamType, mFirstTune);
+	profiler.TuneEnd(success, mContentType, streamType, mFirstTune, gpGlobalConfig->tuneTraceDirectory);
 
 	if (!mTuneCompleted)
 	{
@@ -1112,9 +1124,9 @@ void PrivateInstanceAAMP::StopDownloads()
 	traceprintf ("PrivateInstanceAAMP::%s\n", __FUNCTION__);
 	if (!mbDownloadsBlocked)
 	{
-		pthread_mutex_lock(&mLock);
+		pthread_mutex_lock(&mNeedDataMutex);
 		mbDownloadsBlocked = true;
-		pthread_mutex_unlock(&mLock);
+		pthread_mutex_unlock(&mNeedDataMutex);
 	}
 }
 
@@ -1128,10 +1140,14 @@ void PrivateInstanceAAMP::ResumeDownloads()
 	traceprintf ("PrivateInstanceAAMP::%s\n", __FUNCTION__);
 	if (mbDownloadsBlocked)
 	{
-		pthread_mutex_lock(&mLock);
+		pthread_mutex_lock(&mNeedDataMutex);
 		mbDownloadsBlocked = false;
 		//log_current_time("gstreamer-needs-data");
-		pthread_mutex_unlock(&mLock);
+		for (int i = 0; i < AAMP_TRACK_COUNT; i++)
+		{
+			pthread_cond_broadcast(&mGstreamerWantsData[i]);
+		}
+		pthread_mutex_unlock(&mNeedDataMutex);
 	}
 }
 
@@ -1152,9 +1168,9 @@ void PrivateInstanceAAMP::StopTrackDownloads(MediaType type)
 	if (!mbTrackDownloadsBlocked[type])
 	{
 		AAMPLOG_TRACE("gstreamer-enough-data from %s source\n", (type == eMEDIATYPE_AUDIO) ? "audio" : "video");
-		pthread_mutex_lock(&mLock);
+		pthread_mutex_lock(&mNeedDataMutex);
 		mbTrackDownloadsBlocked[type] = true;
-		pthread_mutex_unlock(&mLock);
+		pthread_mutex_unlock(&mNeedDataMutex);
 	}
 	traceprintf ("PrivateInstanceAAMP::%s Enter. type = %d\n", __FUNCTION__, (int) type);
 }
@@ -1176,10 +1192,11 @@ void PrivateInstanceAAMP::ResumeTrackDownloads(MediaType type)
 	if (mbTrackDownloadsBlocked[type])
 	{
 		AAMPLOG_TRACE("gstreamer-needs-data from %s source\n", (type == eMEDIATYPE_AUDIO) ? "audio" : "video");
-		pthread_mutex_lock(&mLock);
+		pthread_mutex_lock(&mNeedDataMutex);
 		mbTrackDownloadsBlocked[type] = false;
 		//log_current_time("gstreamer-needs-data");
-		pthread_mutex_unlock(&mLock);
+		pthread_cond_broadcast(&mGstreamerWantsData[type]);
+		pthread_mutex_unlock(&mNeedDataMutex);
 	}
 	traceprintf ("PrivateInstanceAAMP::%s Exit. type = %d\n", __FUNCTION__, (int) type);
 }
@@ -1193,7 +1210,9 @@ void PrivateInstanceAAMP::ResumeTrackDownloads(MediaType type)
 void PrivateInstanceAAMP::BlockUntilGstreamerWantsData(void(*cb)(void), int periodMs, int track)
 { // called from FragmentCollector thread; blocks until gstreamer wants data
 	traceprintf( "PrivateInstanceAAMP::%s Enter. type = %d\n", __FUNCTION__, track);
-	int elapsedMs = 0;
+	long long blockStartMs = 0;
+	// not mLock, which is recursive and may be held by caller; cond wait would release only one level of it
+	pthread_mutex_lock(&mNeedDataMutex);
 	while (mbDownloadsBlocked || mbTrackDownloadsBlocked[track])
 	{
 		if (!mDownloadsEnabled)
@@ -1201,21 +1220,84 @@ void PrivateInstanceAAMP::BlockUntilGstreamerWantsData(void(*cb)(void), int peri
 			logprintf("PrivateInstanceAAMP::%s interrupted\n", __FUNCTION__);
 			break;
 		}
+		if (!blockStartMs)
+		{
+			blockStartMs = NOW_STEADY_TS_MS;
+		}
 		if (cb && periodMs)
 		{ // support for background tasks, i.e. refreshing manifest while gstreamer doesn't need additional data
-			if (elapsedMs >= periodMs)
-			{
+			struct timespec ts;
+			// monotonic clock, wall clock changes don't stretch or cut the period
+			clock_gettime(NEED_DATA_WAIT_CLOCK, &ts);
+			ts.tv_sec += periodMs / 1000;
+			ts.tv_nsec += (long)(1000 * 1000 * (periodMs % 1000));
+			ts.tv_sec += ts.tv_nsec / (1000 * 1000 * 1000);
+			ts.tv_nsec %= (1000 * 1000 * 1000);
+			if (ETIMEDOUT == pthread_cond_timedwait(&mGstreamerWantsData[track], &mNeedDataMutex, &ts))
+			{
+				pthread_mutex_unlock(&mNeedDataMutex);
 				cb();
-				elapsedMs -= periodMs;
+				pthread_mutex_lock(&mNeedDataMutex);
 			}
-			elapsedMs += 10;
 		}
-		InterruptableMsSleep(10);
+		else
+		{ // woken up by need-data of the track, need-data of all tracks or DisableDownloads
+			pthread_cond_wait(&mGstreamerWantsData[track], &mNeedDataMutex);
+		}
 	}
+	if (blockStartMs)
+	{
+		long long blockedMs = NOW_STEADY_TS_MS - blockStartMs;
+		mBackpressureBlockedMs[track] += blockedMs;
+		mBackpressureBlockCount[track]++;
+		if (blockedMs > mBackpressureMaxBlockedMs[track])
+		{
+			mBackpressureMaxBlockedMs[track] = blockedMs;
+		}
+	}
+	pthread_mutex_unlock(&mNeedDataMutex);
 	traceprintf ("PrivateInstanceAAMP::%s Exit. type = %d\n", __FUNCTION__, track);
 }
 
 
+/**
+ * @brief Get time injector of a track spent waiting for gstreamer to need data
+ * @param track track index
+ * @param[out] blockedMs total time blocked in milliseconds
+ * @param[out] blockCount number of times injector blocked
+ * @param[out] maxBlockedMs longest single wait in milliseconds
+ */
+void PrivateInstanceAAMP::GetBackpressureStats(int track, long long *blockedMs, int *blockCount, long long *maxBlockedMs)
+{
+	pthread_mutex_lock(&mNeedDataMutex);
+	*blockedMs = mBackpressureBlockedMs[track];
+	*blockCount = mBackpressureBlockCount[track];
+	*maxBlockedMs = mBackpressureMaxBlockedMs[track];
+	pthread_mutex_unlock(&mNeedDataMutex);
+}
+
+
+/**
+ * @brief Log and reset backpressure statistics of all tracks
+ */
+void PrivateInstanceAAMP::LogBackpressureStats(void)
+{
+	pthread_mutex_lock(&mNeedDataMutex);
+	for (int i = 0; i < AAMP_TRACK_COUNT; i++)
+	{
+		if (mBackpressureBlockCount[i])
+		{
+			logprintf("PrivateInstanceAAMP::%s track %d blocked %lld ms in %d waits, longest %lld ms\n", __FUNCTION__,
+				i, mBackpressureBlockedMs[i], mBackpressureBlockCount[i], mBackpressureMaxBlockedMs[i]);
+		}
+		mBackpressureBlockedMs[i] = 0;
+		mBackpressureBlockCount[i] = 0;
+		mBackpressureMaxBlockedMs[i] = 0;
+	}
+	pthread_mutex_unlock(&mNeedDataMutex);
+}
+
+
 /**
  * @brief Allocate memory to growable buffer
  * @param buffer growable buffer
@@ -1229,6 +1311,103 @@ void aamp_Malloc(struct GrowableBuffer *buffer, size_t len)
 }
 
 
+/**
+ * @brief Allocate memory to growable buffer from a buffer pool
+ * @param pool buffer pool, heap is used if NULL
+ * @param buffer growable buffer
+ * @param len size of memory to be allocated
+ */
+void aamp_PoolMalloc(AampBufferPool *pool, struct GrowableBuffer *buffer, size_t len)
+{
+	if (pool)
+	{
+		assert(!buffer->ptr && !buffer->avail );
+		buffer->ptr = pool->Allocate(len, buffer->avail);
+		buffer->pool = pool;
+	}
+	else
+	{
+		aamp_Malloc(buffer, len);
+	}
+}
+
+
+/**
+ * @brief Free memory of growable buffer, returning it to its pool if pooled
+ * @param buffer growable buffer, reset on return
+ */
+void aamp_FreeBuffer(struct GrowableBuffer *buffer)
+{
+	if (buffer->ptr)
+	{
+		if (buffer->pool)
+		{
+			buffer->pool->Release(buffer->ptr, buffer->avail);
+		}
+		else
+		{
+			g_free(buffer->ptr);
+		}
+	}
+	memset(buffer, 0x00, sizeof(*buffer));
+}
+
+
+/**
+ * @brief Move memory of a GrowableBuffer to a new reference counted buffer
+ * @param buffer growable buffer, reset on return
+ * @retval shared buffer holding one reference, NULL if buffer is empty
+ */
+struct SharedFragmentBuffer *aamp_CreateSharedBuffer(struct GrowableBuffer *buffer)
+{
+	struct SharedFragmentBuffer *shared = NULL;
+	if (buffer->ptr)
+	{
+		shared = g_new(struct SharedFragmentBuffer, 1);
+		shared->ptr = buffer->ptr;
+		shared->len = buffer->len;
+		shared->avail = buffer->avail;
+		shared->pool = buffer->pool;
+		shared->refCount = 1;
+		memset(buffer, 0x00, sizeof(*buffer));
+	}
+	return shared;
+}
+
+
+/**
+ * @brief Take an additional reference on a shared buffer
+ * @param buffer shared buffer
+ * @retval buffer
+ */
+struct SharedFragmentBuffer *aamp_RetainSharedBuffer(struct SharedFragmentBuffer *buffer)
+{
+	g_atomic_int_inc(&buffer->refCount);
+	return buffer;
+}
+
+
+/**
+ * @brief Drop a reference on a shared buffer, memory is freed with the last reference
+ * @param buffer shared buffer
+ */
+void aamp_ReleaseSharedBuffer(struct SharedFragmentBuffer *buffer)
+{
+	if (buffer && g_atomic_int_dec_and_test(&buffer->refCount))
+	{
+		if (buffer->pool)
+		{
+			buffer->pool->Release(buffer->ptr, buffer->avail);
+		}
+		else
+		{
+			g_free(buffer->ptr);
+		}
+		g_free(buffer);
+	}
+}
+
+
 /**
  * @brief Append data to buffer
  * @param buffer Growable buffer object pointer
@@ -1244,15 +1423,28 @@ void aamp_AppendBytes(struct GrowableBuffer *buffer, const void *ptr, size_t len
 		{
 			AAMPLOG_INFO("%s:%d realloc. buf %p avail %d required %d\n", __FUNCTION__, __LINE__, buffer, (int)buffer->avail, (int)required);
 		}
-		buffer->avail = required * 2; // grow generously to minimize realloc overhead
-		char *ptr = (char *)g_realloc(buffer->ptr, buffer->avail);
-		assert(ptr);
-		if (ptr)
+		if (buffer->pool)
 		{
-			if (buffer->ptr == NULL)
-			{ // first alloc (not a realloc)
-			}
+			// size classes of the pool already leave room to grow
+			size_t avail;
+			char *ptr = buffer->pool->Allocate(required, avail);
+			memcpy(ptr, buffer->ptr, buffer->len);
+			buffer->pool->Release(buffer->ptr, buffer->avail);
 			buffer->ptr = ptr;
+			buffer->avail = avail;
+		}
+		else
+		{
+			buffer->avail = required * 2; // grow generously to minimize realloc overhead
+			char *ptr = (char *)g_realloc(buffer->ptr, buffer->avail);
+			assert(ptr);
+			if (ptr)
+			{
+				if (buffer->ptr == NULL)
+				{ // first alloc (not a realloc)
+				}
+				buffer->ptr = ptr;
+			}
 		}
 	}
 	if (buffer->ptr)
@@ -1270,8 +1462,35 @@ struct WriteContext
 {
 	PrivateInstanceAAMP *aamp;
 	GrowableBuffer *buffer;
+	CURL *curl;
+	AampStreamDecryptor *decryptor;
+	struct StreamDecryptContext *streamDecrypt;
+};
+
+/**
+ * @struct StreamDecryptContext
+ * @brief Hands data received on scheduler thread to decryptor run on the requesting thread
+ */
+struct StreamDecryptContext
+{
+	pthread_mutex_t mutex;          /**< Serializes append on scheduler thread with decryption of buffer*/
+	GrowableBuffer *buffer;
+	AampStreamDecryptor *decryptor;
+	AampTransferObserver observer;
 };
 
+/**
+ * @brief Decrypt data received so far, called on the thread blocked in download scheduler
+ * @param arg StreamDecryptContext pointer
+ */
+static void DecryptReceivedData(void *arg)
+{
+	struct StreamDecryptContext *context = (struct StreamDecryptContext *)arg;
+	pthread_mutex_lock(&context->mutex);
+	context->decryptor->DecryptAvailable((unsigned char *)context->buffer->ptr, context->buffer->len);
+	pthread_mutex_unlock(&context->mutex);
+}
+
 /**
  * @brief write callback to be used by CURL
  * @param ptr pointer to buffer containing the data
@@ -1284,10 +1503,38 @@ static size_t write_callback(char *ptr, size_t size, size_t nmemb, void *userdat
 {
 	size_t ret = 0;
 	struct WriteContext *context = (struct WriteContext *)userdata;
-	pthread_mutex_lock(&context->aamp->mLock);
+	// with download scheduler this runs on the one scheduler thread of the player, shared by all its tracks;
+	// keep it to appending the chunk, no mLock and no per chunk processing here
+	if (context->streamDecrypt)
+	{
+		// buffer may be reallocated below, not while owner is decrypting it
+		pthread_mutex_lock(&context->streamDecrypt->mutex);
+	}
 	if (context->aamp->mDownloadsEnabled)
 	{
 		size_t numBytesForBlock = size*nmemb;
+		if (!context->buffer->len && context->curl)
+		{
+			// Size the buffer once from Content-Length so that the body lands in its final memory
+			// without intermediate reallocs; slack is kept for the NUL terminator of playlists
+			double contentLength = 0;
+			if (CURLE_OK == curl_easy_getinfo(context->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &contentLength) && contentLength > numBytesForBlock
+					&& (size_t)contentLength + 2 > context->buffer->avail)
+			{
+				if (context->buffer->pool)
+				{
+					AampBufferPool *pool = context->buffer->pool;
+					aamp_FreeBuffer(context->buffer);
+					aamp_PoolMalloc(pool, context->buffer, (size_t)contentLength + 2);
+				}
+				else
+				{
+					aamp_Free(&context->buffer->ptr);
+					memset(context->buffer, 0x00, sizeof(*context->buffer));
+					aamp_Malloc(context->buffer, (size_t)contentLength + 2);
+				}
+			}
+		}
 		aamp_AppendBytes(context->buffer, ptr, numBytesForBlock);
 		ret = numBytesForBlock;
 	}
@@ -1295,7 +1542,20 @@ static size_t write_callback(char *ptr, size_t size, size_t nmemb, void *userdat
 	{
 		logprintf("write_callback - interrupted\n");
 	}
-	pthread_mutex_unlock(&context->aamp->mLock);
+	if (context->streamDecrypt)
+	{
+		pthread_mutex_unlock(&context->streamDecrypt->mutex);
+		if (ret)
+		{
+			// decrypted by DecryptReceivedData on the thread waiting for the transfer
+			context->streamDecrypt->observer.dataPending = true;
+		}
+	}
+	else if (ret && context->decryptor)
+	{
+		// transfer runs on the requesting thread
+		context->decryptor->DecryptAvailable((unsigned char *)context->buffer->ptr, context->buffer->len);
+	}
 	return ret;
 }
 
@@ -1353,6 +1613,72 @@ static size_t header_callback(void *ptr, size_t size, size_t nmemb, void *user_d
 	return len;
 }
 
+static CURLSH *gCurlShare = NULL;
+static pthread_mutex_t gCurlShareMutex[CURL_LOCK_DATA_LAST];
+static pthread_once_t gCurlShareInitOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Lock callback of curl share object
+ * @param handle easy handle accessing shared data
+ * @param data type of shared data
+ * @param access type of access
+ * @param userptr unused
+ */
+static void curl_share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr)
+{
+	pthread_mutex_lock(&gCurlShareMutex[data]);
+}
+
+/**
+ * @brief Unlock callback of curl share object
+ * @param handle easy handle accessing shared data
+ * @param data type of shared data
+ * @param userptr unused
+ */
+static void curl_share_unlock(CURL *handle, curl_lock_data data, void *userptr)
+{
+	pthread_mutex_unlock(&gCurlShareMutex[data]);
+}
+
+/**
+ * @brief Create curl share object, DNS cache and TLS sessions are shared.
+ * Connection cache is not shared as libcurl does not support using a shared
+ * connection cache from several threads; license handles are kept alive instead.
+ */
+static void curl_share_init_once(void)
+{
+	for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+	{
+		pthread_mutex_init(&gCurlShareMutex[i], NULL);
+	}
+	gCurlShare = curl_share_init();
+	if (gCurlShare)
+	{
+		curl_share_setopt(gCurlShare, CURLSHOPT_LOCKFUNC, curl_share_lock);
+		curl_share_setopt(gCurlShare, CURLSHOPT_UNLOCKFUNC, curl_share_unlock);
+		curl_share_setopt(gCurlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+		curl_share_setopt(gCurlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	}
+	else
+	{
+		logprintf("%s:%d curl_share_init failed, DNS and TLS sessions are not shared\n", __FUNCTION__, __LINE__);
+	}
+}
+
+/**
+ * @brief Get curl share object holding DNS and TLS session caches of all curl handles
+ * @retval share object, NULL if sharing is disabled or not available
+ */
+CURLSH *aamp_GetCurlShare(void)
+{
+	if (!gpGlobalConfig->useCurlShare)
+	{
+		return NULL;
+	}
+	pthread_once(&gCurlShareInitOnce, curl_share_init_once);
+	return gCurlShare;
+}
+
 /**
  * @brief
  * @param clientp app-specific as optionally set with CURLOPT_PROGRESSDATA
@@ -1372,12 +1698,10 @@ static int progress_callback(
 {
 	PrivateInstanceAAMP *context = (PrivateInstanceAAMP *)clientp;
 	int rc = 0;
-	pthread_mutex_lock(&context->mLock);
 	if (!context->mDownloadsEnabled)
 	{
 		rc = -1; // CURLE_ABORTED_BY_CALLBACK
 	}
-	pthread_mutex_unlock(&context->mLock);
 	return rc;
 }
 
@@ -1443,6 +1767,11 @@ void PrivateInstanceAAMP::CurlInit(int startIdx, unsigned int instanceCount)
 			curl_easy_setopt(curl[i], CURLOPT_NOPROGRESS, 0L); // enable progress meter (off by default)
 			curl_easy_setopt(curl[i], CURLOPT_USERAGENT, "AAMP/1.0.0");
 			curl_easy_setopt(curl[i], CURLOPT_ACCEPT_ENCODING, "");//Enable all the encoding formats supported by client
+			CURLSH *share = aamp_GetCurlShare();
+			if (share)
+			{
+				curl_easy_setopt(curl[i], CURLOPT_SHARE, share);
+			}
 			if (gpGlobalConfig->httpProxy)
 			{
 				char proxyStr[STR_PROXY_BUFF_SIZE];
@@ -1698,9 +2027,10 @@ const char* PrivateInstanceAAMP::MediaTypeString(MediaType fileType)
  * @param curlInstance instance to be used to fetch
  * @param resetBuffer true to reset buffer before fetch
  * @param fileType media type of the file
+ * @param decryptor decryptor to run on data as it is received, NULL for none; always called on the calling thread
  * @retval true if success
  */
-bool PrivateInstanceAAMP::GetFile(const char *remoteUrl, struct GrowableBuffer *buffer, char effectiveUrl[MAX_URI_LENGTH], long * http_error, const char *range, unsigned int curlInstance, bool resetBuffer, MediaType fileType)
+bool PrivateInstanceAAMP::GetFile(const char *remoteUrl, struct GrowableBuffer *buffer, char effectiveUrl[MAX_URI_LENGTH], long * http_error, const char *range, unsigned int curlInstance, bool resetBuffer, MediaType fileType, AampStreamDecryptor *decryptor)
 {
 	long http_code = -1;
 	bool ret = false;
@@ -1708,6 +2038,21 @@ bool PrivateInstanceAAMP::GetFile(const char *remoteUrl, struct GrowableBuffer *
 	CURL* curl = this->curl[curlInstance];
 	struct curl_slist* httpHeaders = NULL;
 	CURLcode res = CURLE_OK;
+	struct StreamDecryptContext streamDecrypt;
+	streamDecrypt.decryptor = NULL;
+	AampDownloadPriority priority = eDOWNLOAD_PRIORITY_MANIFEST;
+	if (curlInstance >= AAMP_PREFETCH_CURL_START)
+	{
+		priority = eDOWNLOAD_PRIORITY_PREFETCH;
+	}
+	else if (fileType == eMEDIATYPE_VIDEO || fileType == eMEDIATYPE_IFRAME)
+	{
+		priority = eDOWNLOAD_PRIORITY_VIDEO;
+	}
+	else if (fileType == eMEDIATYPE_AUDIO)
+	{
+		priority = eDOWNLOAD_PRIORITY_AUDIO;
+	}
 
 	// temporarily increase timeout for manifest download - these files (especially for VOD) can be large and slow to download
 	//bool modifyDownloadTimeout = (!mIsLocalPlayback && fileType == eMEDIATYPE_MANIFEST);
@@ -1733,6 +2078,19 @@ bool PrivateInstanceAAMP::GetFile(const char *remoteUrl, struct GrowableBuffer *
 			struct WriteContext context;
 			context.aamp = this;
 			context.buffer = buffer;
+			context.curl = curl;
+			context.decryptor = decryptor;
+			context.streamDecrypt = NULL;
+			if (decryptor && mDownloadScheduler)
+			{
+				pthread_mutex_init(&streamDecrypt.mutex, NULL);
+				streamDecrypt.buffer = buffer;
+				streamDecrypt.decryptor = decryptor;
+				streamDecrypt.observer.onData = DecryptReceivedData;
+				streamDecrypt.observer.arg = &streamDecrypt;
+				streamDecrypt.observer.dataPending = false;
+				context.streamDecrypt = &streamDecrypt;
+			}
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &context);
 			curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
 
@@ -1804,13 +2162,26 @@ bool PrivateInstanceAAMP::GetFile(const char *remoteUrl, struct GrowableBuffer *
 					traceprintf("%s:%d reset length. buffer %p avail %d\n", __FUNCTION__, __LINE__, buffer, (int)buffer->avail);
 					buffer->len = 0;
 				}
+				if (decryptor)
+				{
+					decryptor->Restart();
+				}
 
+				long long queuedTimeMS = 0;
 				std::chrono::steady_clock::time_point tStartTime = std::chrono::steady_clock::now();
-				res = curl_easy_perform(curl); // synchronous; callbacks allow interruption
+				if (mDownloadScheduler)
+				{
+					res = mDownloadScheduler->Perform(curl, priority, &queuedTimeMS, context.streamDecrypt ? &streamDecrypt.observer : NULL); // blocks till done; callbacks allow interruption
+				}
+				else
+				{
+					res = curl_easy_perform(curl); // synchronous; callbacks allow interruption
+				}
 				std::chrono::steady_clock::time_point tEndTime = std::chrono::steady_clock::now();
 				downloadAttempt++;
 
-				downloadTimeMS = static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(tEndTime - tStartTime).count());
+				// time spent waiting for a transfer slot is not network time, keep it out of ABR samples
+				downloadTimeMS = static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(tEndTime - tStartTime).count()) - queuedTimeMS;
 
 				if (res == CURLE_OK)
 				{ // all data collected
@@ -1960,15 +2331,11 @@ bool PrivateInstanceAAMP::GetFile(const char *remoteUrl, struct GrowableBuffer *
 				logprintf("AAMP content length mismatch expected %d got %d\n",(int)expectedContentLength, (int)buffer->len);
 				http_code       =       416; // Range Not Satisfiable
 				ret             =       false; // redundant, but harmless
-				if (buffer->ptr)
-				{
-					aamp_Free(&buffer->ptr);
-				}
-				memset(buffer, 0x00, sizeof(*buffer));
+				aamp_FreeBuffer(buffer);
 			}
 			else
 			{
-				if(fileType == eMEDIATYPE_MANIFEST)
+				if(fileType == eMEDIATYPE_MANIFEST && curlInstance < AAMP_TRACK_COUNT)
 				{
 					fileType = (MediaType)curlInstance;
 				}
@@ -1980,7 +2347,7 @@ bool PrivateInstanceAAMP::GetFile(const char *remoteUrl, struct GrowableBuffer *
 				if((downloadTimeMS > FRAGMENT_DOWNLOAD_WARNING_THRESHOLD) || (gpGlobalConfig->logging.latencyLogging[fileType] == true))
 				{
 					long long SequenceNo = GetSeqenceNumberfromURL(remoteUrl);
-					logprintf("aampabr#T:%s,s:%lld,d:%lld,sz:%d,r:%ld,cerr:%d,hcode:%ld,n:%lld,estr:%ld,url:%s",MediaTypeString(fileType),(aamp_GetCurrentTimeMS()-downloadTimeMS),downloadTimeMS,int(buffer->len),mpStreamAbstractionAAMP->GetCurProfIdxBW(),res,http_code,SequenceNo,GetCurrentlyAvailableBandwidth(),remoteUrl);
+					logprintf("aampabr#T:%s,s:%lld,d:%lld,sz:%d,r:%ld,cerr:%d,hcode:%ld,n:%lld,estr:%ld,url:%s",MediaTypeString(fileType),(aamp_GetCurrentTimeMS()-downloadTimeMS),downloadTimeMS,int(buffer->len),mpStreamAbstractionAAMP ? mpStreamAbstractionAAMP->GetCurProfIdxBW() : 0,res,http_code,SequenceNo,GetCurrentlyAvailableBandwidth(),remoteUrl);
 				}
 				ret             =       true;
 			}
@@ -1988,11 +2355,7 @@ bool PrivateInstanceAAMP::GetFile(const char *remoteUrl, struct GrowableBuffer *
 		else
 		{
 			logprintf("BAD URL:%s\n", remoteUrl);
-			if (buffer->ptr)
-			{
-				aamp_Free(&buffer->ptr);
-			}
-			memset(buffer, 0x00, sizeof(*buffer));
+			aamp_FreeBuffer(buffer);
 
 			if ( (httpRespHeaders[curlInstance].type == eHTTPHEADERTYPE_XREASON) && (httpRespHeaders[curlInstance].data.length() > 0) )
 			{
@@ -2015,6 +2378,10 @@ bool PrivateInstanceAAMP::GetFile(const char *remoteUrl, struct GrowableBuffer *
 	{
 		curl_slist_free_all(httpHeaders);
 	}
+	if (streamDecrypt.decryptor)
+	{
+		pthread_mutex_destroy(&streamDecrypt.mutex);
+	}
 	if (mIsFirstRequestToFOG)
 	{
 		mIsFirstRequestToFOG = false;
@@ -2971,6 +3338,127 @@ void ProcessCommand(char *cmd, bool usingCLI)
 				VALIDATE_INT("fragment-cache-length", gpGlobalConfig->maxCachedFragmentsPerTrack, DEFAULT_CACHED_FRAGMENTS_PER_TRACK)
 				logprintf("aamp fragment cache length: %d\n", gpGlobalConfig->maxCachedFragmentsPerTrack);
 			}
+			else if (sscanf(cmd, "download-scheduler=%d", &value) == 1)
+			{
+				gpGlobalConfig->useDownloadScheduler = (value != 0);
+				logprintf("download-scheduler=%d\n", value);
+			}
+			else if (sscanf(cmd, "max-concurrent-downloads=%d", &gpGlobalConfig->maxConcurrentDownloads) == 1)
+			{
+				VALIDATE_INT("max-concurrent-downloads", gpGlobalConfig->maxConcurrentDownloads, DEFAULT_MAX_CONCURRENT_DOWNLOADS)
+				logprintf("aamp max-concurrent-downloads: %d\n", gpGlobalConfig->maxConcurrentDownloads);
+			}
+			else if (sscanf(cmd, "max-host-connections=%d", &gpGlobalConfig->maxHostConnections) == 1)
+			{
+				VALIDATE_INT("max-host-connections", gpGlobalConfig->maxHostConnections, DEFAULT_MAX_HOST_CONNECTIONS)
+				logprintf("aamp max-host-connections: %d\n", gpGlobalConfig->maxHostConnections);
+			}
+			else if (sscanf(cmd, "hls-fragment-prefetch=%d", &gpGlobalConfig->hlsFragmentPrefetchCount) == 1)
+			{
+				VALIDATE_INT("hls-fragment-prefetch", gpGlobalConfig->hlsFragmentPrefetchCount, 1)
+				if (gpGlobalConfig->hlsFragmentPrefetchCount > AAMP_MAX_PREFETCH_FRAGMENTS)
+				{
+					gpGlobalConfig->hlsFragmentPrefetchCount = AAMP_MAX_PREFETCH_FRAGMENTS;
+				}
+				logprintf("aamp hls-fragment-prefetch: %d\n", gpGlobalConfig->hlsFragmentPrefetchCount);
+			}
+			else if (sscanf(cmd, "fragment-buffer-pool-size=%d", &gpGlobalConfig->fragmentBufferPoolSizeMB) == 1)
+			{
+				if (gpGlobalConfig->fragmentBufferPoolSizeMB < 0)
+				{
+					gpGlobalConfig->fragmentBufferPoolSizeMB = DEFAULT_FRAGMENT_BUFFER_POOL_SIZE_MB;
+				}
+				logprintf("aamp fragment-buffer-pool-size: %d MB\n", gpGlobalConfig->fragmentBufferPoolSizeMB);
+			}
+			else if (sscanf(cmd, "hls-delta-update=%d", &value) == 1)
+			{
+				gpGlobalConfig->hlsDeltaUpdate = (value != 0);
+				logprintf("hls-delta-update=%d\n", value);
+			}
+			else if (sscanf(cmd, "low-latency-hls=%d", &value) == 1)
+			{
+				gpGlobalConfig->hlsLowLatency = (value != 0);
+				logprintf("low-latency-hls=%d\n", value);
+			}
+			else if (sscanf(cmd, "low-latency-live-offset=%d", &gpGlobalConfig->lowLatencyLiveOffset) == 1)
+			{
+				VALIDATE_INT("low-latency-live-offset", gpGlobalConfig->lowLatencyLiveOffset, DEFAULT_LOW_LATENCY_LIVE_OFFSET)
+				logprintf("low-latency-live-offset=%d\n", gpGlobalConfig->lowLatencyLiveOffset);
+			}
+			else if (ReadConfigStringHelper(cmd, "tune-trace-dir=", &gpGlobalConfig->tuneTraceDirectory))
+			{
+				logprintf("tune-trace-dir=%s\n", gpGlobalConfig->tuneTraceDirectory);
+			}
+			else if (sscanf(cmd, "buffer-target-duration=%d", &gpGlobalConfig->bufferTargetSeconds) == 1)
+			{
+				VALIDATE_INT("buffer-target-duration", gpGlobalConfig->bufferTargetSeconds, 0)
+				if (gpGlobalConfig->bufferTargetSeconds > MAX_BUFFER_TARGET_SECONDS)
+				{
+					logprintf("buffer-target-duration limited to %d\n", MAX_BUFFER_TARGET_SECONDS);
+					gpGlobalConfig->bufferTargetSeconds = MAX_BUFFER_TARGET_SECONDS;
+				}
+				logprintf("buffer-target-duration=%d\n", gpGlobalConfig->bufferTargetSeconds);
+			}
+			else if (sscanf(cmd, "max-track-buffer-size=%d", &gpGlobalConfig->maxTrackBufferMB) == 1)
+			{
+				VALIDATE_INT("max-track-buffer-size", gpGlobalConfig->maxTrackBufferMB, 0)
+				if (gpGlobalConfig->maxTrackBufferMB > MAX_FRAGMENT_BUFFER_SIZE_MB)
+				{
+					logprintf("max-track-buffer-size limited to %d MB\n", MAX_FRAGMENT_BUFFER_SIZE_MB);
+					gpGlobalConfig->maxTrackBufferMB = MAX_FRAGMENT_BUFFER_SIZE_MB;
+				}
+				logprintf("max-track-buffer-size=%d MB\n", gpGlobalConfig->maxTrackBufferMB);
+			}
+			else if (sscanf(cmd, "max-player-buffer-size=%d", &gpGlobalConfig->maxPlayerBufferMB) == 1)
+			{
+				VALIDATE_INT("max-player-buffer-size", gpGlobalConfig->maxPlayerBufferMB, 0)
+				if (gpGlobalConfig->maxPlayerBufferMB > MAX_FRAGMENT_BUFFER_SIZE_MB)
+				{
+					logprintf("max-player-buffer-size limited to %d MB\n", MAX_FRAGMENT_BUFFER_SIZE_MB);
+					gpGlobalConfig->maxPlayerBufferMB = MAX_FRAGMENT_BUFFER_SIZE_MB;
+				}
+				logprintf("max-player-buffer-size=%d MB\n", gpGlobalConfig->maxPlayerBufferMB);
+			}
+			else if (sscanf(cmd, "hls-streaming-decrypt=%d", &value) == 1)
+			{
+				gpGlobalConfig->hlsStreamingDecrypt = (value != 0);
+				logprintf("hls-streaming-decrypt=%d\n", value);
+			}
+			else if (sscanf(cmd, "drm-session-cache-size=%d", &gpGlobalConfig->drmSessionCacheSize) == 1)
+			{
+				VALIDATE_INT("drm-session-cache-size", gpGlobalConfig->drmSessionCacheSize, DEFAULT_DRM_SESSION_CACHE_SIZE)
+				logprintf("drm-session-cache-size=%d\n", gpGlobalConfig->drmSessionCacheSize);
+			}
+			else if (sscanf(cmd, "drm-session-cache-expiry=%d", &gpGlobalConfig->drmSessionCacheExpirySeconds) == 1)
+			{
+				if (gpGlobalConfig->drmSessionCacheExpirySeconds < 0)
+				{
+					gpGlobalConfig->drmSessionCacheExpirySeconds = 0;
+				}
+				logprintf("drm-session-cache-expiry=%d\n", gpGlobalConfig->drmSessionCacheExpirySeconds);
+			}
+			else if (sscanf(cmd, "license-prefetch-concurrency=%d", &gpGlobalConfig->licensePrefetchConcurrency) == 1)
+			{
+				if (gpGlobalConfig->licensePrefetchConcurrency < 0)
+				{
+					gpGlobalConfig->licensePrefetchConcurrency = 0;
+				}
+				else if (gpGlobalConfig->licensePrefetchConcurrency > MAX_LICENSE_PREFETCH_CONCURRENCY)
+				{
+					gpGlobalConfig->licensePrefetchConcurrency = MAX_LICENSE_PREFETCH_CONCURRENCY;
+				}
+				logprintf("license-prefetch-concurrency=%d\n", gpGlobalConfig->licensePrefetchConcurrency);
+			}
+			else if (sscanf(cmd, "curl-share=%d", &value) == 1)
+			{
+				gpGlobalConfig->useCurlShare = (value != 0);
+				logprintf("curl-share=%d\n", value);
+			}
+			else if (sscanf(cmd, "seamless-audio-switch=%d", &value) == 1)
+			{
+				gpGlobalConfig->seamlessAudioSwitch = (value != 0);
+				logprintf("seamless-audio-switch=%d\n", value);
+			}
 			else if (sscanf(cmd, "pts-error-threshold=%d", &gpGlobalConfig->ptsErrorThreshold) == 1)
 			{
 				VALIDATE_INT("pts-error-threshold", gpGlobalConfig->ptsErrorThreshold, MAX_PTS_ERRORS_THRESHOLD)
@@ -3342,7 +3830,6 @@ void PrivateInstanceAAMP::TeardownStream(bool newTune)
 		delete mpStreamAbstractionAAMP;
 		mpStreamAbstractionAAMP = NULL;
 	}
-
 	pthread_mutex_lock(&mLock);
 	mFormat = FORMAT_INVALID;
 	pthread_mutex_unlock(&mLock);
@@ -3370,10 +3857,12 @@ void PrivateInstanceAAMP::TeardownStream(bool newTune)
 	}
 	else
 	{
+		pthread_mutex_lock(&mNeedDataMutex);
 		for (int iTrack = 0; iTrack < AAMP_TRACK_COUNT; iTrack++)
 		{
 			mbTrackDownloadsBlocked[iTrack] = true;
 		}
+		pthread_mutex_unlock(&mNeedDataMutex);
 		streamerIsActive = true;
 	}
 }
@@ -4500,7 +4989,11 @@ void PlayerInstanceAAMP::SetLanguage(const char* language)
 	{
 		aamp->UpdateAudioLanguageSelection(language);
 		logprintf("aamp_SetLanguage(%s) Language set\n", language);
-		if (aamp->mpStreamAbstractionAAMP)
+		if (aamp->mpStreamAbstractionAAMP && gpGlobalConfig->seamlessAudioSwitch && aamp->mpStreamAbstractionAAMP->SwitchAudioTrack())
+		{
+			logprintf("aamp_SetLanguage(%s) switching audio track\n", language);
+		}
+		else if (aamp->mpStreamAbstractionAAMP)
 		{
 			logprintf("aamp_SetLanguage(%s) retuning\n", language);
 
@@ -4933,6 +5426,17 @@ void PlayerInstanceAAMP::SetPreferredDRM(DRMSystems drmType)
 }
 
 
+/**
+ *   @brief Acquire DRM licenses of manifests likely to be tuned next.
+ *
+ *   @param[in] manifestUrls - URLs of DASH manifests in order of likelihood
+ */
+void PlayerInstanceAAMP::PreacquireLicenses(std::vector<std::string> manifestUrls)
+{
+	aamp->PreacquireLicenses(manifestUrls);
+}
+
+
 /**
  *   @brief Set video rectangle.
  *
@@ -4990,6 +5494,17 @@ void PrivateInstanceAAMP::DisableDownloads(void)
 	mDownloadsEnabled = false;
 	pthread_cond_broadcast(&mDownloadsDisabled);
 	pthread_mutex_unlock(&mLock);
+	pthread_mutex_lock(&mNeedDataMutex);
+	for (int i = 0; i < AAMP_TRACK_COUNT; i++)
+	{
+		pthread_cond_broadcast(&mGstreamerWantsData[i]);
+	}
+	pthread_mutex_unlock(&mNeedDataMutex);
+	if (mDownloadScheduler)
+	{
+		// queued transfers fail right away, running ones abort from progress_callback
+		mDownloadScheduler->CancelPending();
+	}
 }
 
 
@@ -4999,7 +5514,7 @@ void PrivateInstanceAAMP::DisableDownloads(void)
  */
 bool PrivateInstanceAAMP::DownloadsAreEnabled(void)
 {
-	return mDownloadsEnabled; // needs mutex protection?
+	return mDownloadsEnabled;
 }
 
 
@@ -5153,7 +5668,51 @@ void PrivateInstanceAAMP::SendStream(MediaType mediaType, const void *ptr, size_
 void PrivateInstanceAAMP::SendStream(MediaType mediaType, GrowableBuffer* buffer, double fpts, double fdts, double fDuration)
 {
 	profiler.ProfilePerformed(PROFILE_BUCKET_FIRST_BUFFER);
-	mStreamSink->Send(mediaType, buffer, fpts, fdts, fDuration);
+	if (buffer->pool)
+	{
+		// Pooled memory has to go back to its pool, sink frees GrowableBuffer memory with g_free
+		size_t len = buffer->len;
+		SharedFragmentBuffer *sharedBuffer = aamp_CreateSharedBuffer(buffer);
+		mStreamSink->Send(mediaType, sharedBuffer, 0, len, fpts, fdts, fDuration);
+		aamp_ReleaseSharedBuffer(sharedBuffer);
+	}
+	else
+	{
+		mStreamSink->Send(mediaType, buffer, fpts, fdts, fDuration);
+	}
+}
+
+
+/**
+ * @brief Sends a slice of a shared fragment buffer to sink without copying
+ * @param mediaType type of media
+ * @param buffer shared buffer, caller keeps its reference
+ * @param offset offset of slice in buffer
+ * @param len length of slice
+ * @param fpts pts in seconds
+ * @param fdts dts in seconds
+ * @param fDuration duration of buffer
+ */
+void PrivateInstanceAAMP::SendStream(MediaType mediaType, SharedFragmentBuffer* buffer, size_t offset, size_t len, double fpts, double fdts, double fDuration)
+{
+	profiler.ProfilePerformed(PROFILE_BUCKET_FIRST_BUFFER);
+	mStreamSink->Send(mediaType, buffer, offset, len, fpts, fdts, fDuration);
+}
+
+
+/**
+ * @brief Default implementation for sinks which can't wrap external memory, slice is copied
+ * @param mediaType type of media
+ * @param buffer shared buffer, caller keeps its reference
+ * @param offset offset of slice in buffer
+ * @param len length of slice
+ * @param fpts pts in seconds
+ * @param fdts dts in seconds
+ * @param duration duration of buffer
+ */
+void StreamSink::Send(MediaType mediaType, struct SharedFragmentBuffer* buffer, size_t offset, size_t len, double fpts, double fdts, double duration)
+{
+	Send(mediaType, buffer->ptr + offset, len, fpts, fdts, duration);
 }
 
 
@@ -5195,6 +5754,15 @@ void PrivateInstanceAAMP::Stop()
 	}
 
 	TeardownStream(true);
+#ifdef AAMP_VANILLA_AES_SUPPORT
+	// keys are kept across tunes, key requests ended along with collector
+	AesDec::ClearKeyCache(this);
+#endif
+	if (mFragmentBufferPool)
+	{
+		mFragmentBufferPool->LogStats();
+	}
+	LogBackpressureStats();
 	pthread_mutex_lock(&mLock);
 	if (mPendingAsyncEvents.size() > 0)
 	{
@@ -5371,6 +5939,22 @@ bool PrivateInstanceAAMP::Discontinuity(MediaType track)
 }
 
 
+/**
+ * @brief Flush data of a track already sent to sink, other tracks keep playing.
+ * Called from StreamAbstractionAAMP to replace data of a track mid stream
+ * @param track MediaType of the track
+ * @retval true if sink flushed the track
+ */
+bool PrivateInstanceAAMP::FlushTrack(MediaType track)
+{
+	bool ret;
+	SyncBegin();
+	ret = mStreamSink->FlushTrack(track);
+	SyncEnd();
+	return ret;
+}
+
+
 /**
  * @brief
  * @param ptr
@@ -5509,6 +6093,12 @@ void PrivateInstanceAAMP::ScheduleRetune(PlaybackErrorType errorType, MediaType
 						gActivePrivAAMPs[i].reTune = true;
 						g_idle_add(PrivateInstanceAAMP_Retune, (gpointer) this);
 					}
+					else if(eDASH_ERROR_AUDIO_CODEC_CHANGE == errorType)
+					{
+						logprintf("PrivateInstanceAAMP::%s : Schedule Retune to configure audio codec of new language.\n", __FUNCTION__);
+						gActivePrivAAMPs[i].reTune = true;
+						g_idle_add(PrivateInstanceAAMP_Retune, (gpointer) this);
+					}
 				}
 				activeAAMPFound = true;
 				break;
@@ -5574,6 +6164,12 @@ PrivateInstanceAAMP::PrivateInstanceAAMP()
 	pthread_mutexattr_init(&mMutexAttr);
 	pthread_mutexattr_settype(&mMutexAttr, PTHREAD_MUTEX_RECURSIVE);
 	pthread_mutex_init(&mLock, &mMutexAttr);
+	pthread_mutex_init(&mNeedDataMutex, NULL);
+	pthread_condattr_t needDataCondAttr;
+	pthread_condattr_init(&needDataCondAttr);
+#ifndef __APPLE__
+	pthread_condattr_setclock(&needDataCondAttr, NEED_DATA_WAIT_CLOCK);
+#endif
 
 	for (int i = 0; i < MAX_CURL_INSTANCE_COUNT; i++)
 	{
@@ -5591,7 +6187,12 @@ PrivateInstanceAAMP::PrivateInstanceAAMP()
 	for (int i = 0; i < AAMP_TRACK_COUNT; i++)
 	{
 		mbTrackDownloadsBlocked[i] = false;
+		pthread_cond_init(&mGstreamerWantsData[i], &needDataCondAttr);
+		mBackpressureBlockedMs[i] = 0;
+		mBackpressureBlockCount[i] = 0;
+		mBackpressureMaxBlockedMs[i] = 0;
 	}
+	pthread_condattr_destroy(&needDataCondAttr);
 
 	pthread_mutex_lock(&gMutex);
 	for (int i = 0; i < AAMP_MAX_SIMULTANEOUS_INSTANCES; i++)
@@ -5626,6 +6227,24 @@ PrivateInstanceAAMP::PrivateInstanceAAMP()
 
 	mIsLocalPlayback = false;
 	previousAudioType = eAUDIO_UNKNOWN;
+	mDownloadScheduler = NULL;
+	if (gpGlobalConfig->useDownloadScheduler)
+	{
+		mDownloadScheduler = new AampDownloadScheduler(gpGlobalConfig->maxConcurrentDownloads, gpGlobalConfig->maxHostConnections);
+		if (!mDownloadScheduler->Start())
+		{
+			logprintf("%s:%d Download scheduler not available, using blocking transfers\n", __FUNCTION__, __LINE__);
+			delete mDownloadScheduler;
+			mDownloadScheduler = NULL;
+		}
+	}
+	mFragmentBufferPool = NULL;
+	mCachedFragmentBytes = 0;
+	mLicensePrefetcher = NULL;
+	if (gpGlobalConfig->fragmentBufferPoolSizeMB > 0)
+	{
+		mFragmentBufferPool = new AampBufferPool((size_t)gpGlobalConfig->fragmentBufferPoolSizeMB * 1024 * 1024);
+	}
 }
 
 
@@ -5643,7 +6262,18 @@ PrivateInstanceAAMP::~PrivateInstanceAAMP()
 		}
 	}
 	pthread_mutex_unlock(&gMutex);
+#ifdef AAMP_VANILLA_AES_SUPPORT
+	// entries are keyed by player, none may outlive it
+	AesDec::ClearKeyCache(this);
+#endif
 
+#ifdef AAMP_MPD_DRM
+	if (mLicensePrefetcher)
+	{
+		delete mLicensePrefetcher;
+		mLicensePrefetcher = NULL;
+	}
+#endif
 	for (int i = 0; i < AAMP_MAX_NUM_EVENTS; i++)
 	{
 		while (mEventListeners[i] != NULL)
@@ -5653,8 +6283,25 @@ PrivateInstanceAAMP::~PrivateInstanceAAMP()
 			delete pListener;
 		}
 	}
+	if (mDownloadScheduler)
+	{
+		delete mDownloadScheduler;
+		mDownloadScheduler = NULL;
+	}
+	if (mFragmentBufferPool)
+	{
+		// Pool stays alive till GStreamer releases buffers still referring to it
+		mFragmentBufferPool->LogStats();
+		mFragmentBufferPool->Unref();
+		mFragmentBufferPool = NULL;
+	}
 	pthread_cond_destroy(&mDownloadsDisabled);
+	for (int i = 0; i < AAMP_TRACK_COUNT; i++)
+	{
+		pthread_cond_destroy(&mGstreamerWantsData[i]);
+	}
 	pthread_cond_destroy(&mCondDiscontinuity);
+	pthread_mutex_destroy(&mNeedDataMutex);
 	pthread_mutex_destroy(&mLock);
 }
 
@@ -6438,3 +7085,28 @@ void PrivateInstanceAAMP::SetPreferredDRM(DRMSystems drmType)
 	AAMPLOG_INFO("%s:%d set preferred drm: %d\n", __FUNCTION__, __LINE__, drmType);
 	gpGlobalConfig->preferredDrm = drmType;
 }
+
+
+/**
+ *   @brief Acquire licenses of manifests likely to be tuned next, in background
+ *
+ *   @param[in] manifestUrls - URLs of DASH manifests in order of likelihood
+ */
+void PrivateInstanceAAMP::PreacquireLicenses(const std::vector<std::string> &manifestUrls)
+{
+#ifdef AAMP_MPD_DRM
+	if (gpGlobalConfig->licensePrefetchConcurrency <= 0)
+	{
+		logprintf("%s:%d License prefetch disabled, ignoring %d manifests\n", __FUNCTION__, __LINE__, (int)manifestUrls.size());
+		return;
+	}
+	if (!mLicensePrefetcher)
+	{
+		mLicensePrefetcher = new AampLicensePrefetcher(this, gpGlobalConfig->licensePrefetchConcurrency);
+	}
+	logprintf("%s:%d Prefetching licenses of %d manifests\n", __FUNCTION__, __LINE__, (int)manifestUrls.size());
+	mLicensePrefetcher->Prefetch(manifestUrls);
+#else
+	logprintf("%s:%d MPD DRM not enabled, ignoring license prefetch\n", __FUNCTION__, __LINE__);
+#endif
+}
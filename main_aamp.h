@@ -460,6 +460,23 @@ public:
 	 */
 	virtual void Send( MediaType mediaType, struct GrowableBuffer* buffer, double fpts, double fdts, double duration)= 0;
 
+	/**
+	 *   @brief  API to send a slice of a reference counted fragment buffer into the sink.
+	 *
+	 *   Sinks able to wrap external memory should take their own reference on buffer
+	 *   instead of copying. Default implementation copies the slice.
+	 *
+	 *   @param[in]  mediaType - Type of the media.
+	 *   @param[in]  buffer - Shared fragment buffer; caller keeps its reference
+	 *   @param[in]  offset - Offset of slice in buffer
+	 *   @param[in]  len - Length of slice
+	 *   @param[in]  fpts - Presentation Time Stamp.
+	 *   @param[in]  fdts - Decode Time Stamp
+	 *   @param[in]  duration - Buffer duration.
+	 *   @return void
+	 */
+	virtual void Send( MediaType mediaType, struct SharedFragmentBuffer* buffer, size_t offset, size_t len, double fpts, double fdts, double duration);
+
 	/**
 	 *   @brief  Notifies EOS to sink
 	 *
@@ -499,6 +516,16 @@ public:
 	 */
 	virtual void Flush(double position = 0, float rate = 1.0){}
 
+	/**
+	 *   @brief Flush data of a single stream, other streams keep playing
+	 *
+	 *   Data sent after the flush continues on the running time of the flushed data.
+	 *
+	 *   @param[in]  mediaType - Media Type
+	 *   @return true if stream is flushed, false if sink can't flush stream alone
+	 */
+	virtual bool FlushTrack(MediaType mediaType){ return false; }
+
 	/**
 	 *   @brief Select audio track
 	 *
@@ -829,6 +856,17 @@ public:
 	 */
 	void SetPreferredDRM(DRMSystems drmType);
 
+	/**
+	 *   @brief Acquire DRM licenses of manifests likely to be tuned next, e.g. adjacent channels.
+	 *
+	 *   Licenses are kept in DRM session cache, so that a later tune to one of the
+	 *   manifests skips license acquisition. A new call replaces manifests not yet processed.
+	 *
+	 *   @param[in] manifestUrls - URLs of DASH manifests in order of likelihood
+	 *   @return void
+	 */
+	void PreacquireLicenses(std::vector<std::string> manifestUrls);
+
 	/**
 	 *   @brief Indicates if session token has to be used with license request or not.
 	 *
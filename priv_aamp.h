@@ -29,15 +29,20 @@
 #include <signal.h>
 #include <semaphore.h>
 #include "main_aamp.h"
+#include "aampdownloadscheduler.h"
+#include "aampbufferpool.h"
 #include <curl/curl.h>
 #include <string.h> // for memset
 #include <glib.h>
 #include <vector>
 #include <unordered_map>
 #include <chrono>
+#include <atomic>
 #include <map>
 #include <set>
 
+class AampLicensePrefetcher;
+
 #ifdef __APPLE__
 #define aamp_pthread_setname(tid,name) pthread_setname_np(name)
 #else
@@ -47,7 +52,13 @@
 #define MAX_URI_LENGTH (2048)           /**< Increasing size to include longer urls */
 #define AAMP_TRACK_COUNT 2              /**< internal use - audio+video track */
 #define AAMP_DRM_CURL_COUNT 2           /**< audio+video track DRMs */
-#define MAX_CURL_INSTANCE_COUNT (AAMP_TRACK_COUNT + AAMP_DRM_CURL_COUNT)    /**< Maximum number of CURL instances */
+#define AAMP_MAX_PREFETCH_FRAGMENTS 4    /**< Maximum fragments a track fetches in parallel */
+#define AAMP_PREFETCH_CURL_START (AAMP_TRACK_COUNT + AAMP_DRM_CURL_COUNT)      /**< First curl instance used for parallel fragment fetch */
+#define AAMP_PREFETCH_CURL_COUNT (AAMP_TRACK_COUNT * (AAMP_MAX_PREFETCH_FRAGMENTS - 1))    /**< Extra curl instances, track's own instance fetches the first fragment */
+#define AAMP_PLAYLIST_PREFETCH_CURL (AAMP_PREFETCH_CURL_START + AAMP_PREFETCH_CURL_COUNT)    /**< Curl instance for playlists fetched speculatively at tune, e.g. iframe playlist */
+#define AAMP_LICENSE_PREFETCH_CURL_START (AAMP_PLAYLIST_PREFETCH_CURL + 1)    /**< First curl instance used by license prefetch workers, one per worker */
+#define MAX_LICENSE_PREFETCH_CONCURRENCY 4    /**< Upper limit of license-prefetch-concurrency */
+#define MAX_CURL_INSTANCE_COUNT (AAMP_TRACK_COUNT + AAMP_DRM_CURL_COUNT + AAMP_PREFETCH_CURL_COUNT + 1 + MAX_LICENSE_PREFETCH_CONCURRENCY)    /**< Maximum number of CURL instances */
 #define AAMP_MAX_PIPE_DATA_SIZE 1024    /**< Max size of data send across pipe */
 #define AAMP_LIVE_OFFSET 15             /**< Live offset in seconds */
 #define AAMP_CDVR_LIVE_OFFSET 30 	/**< Live offset in seconds for CDVR hot recording */
@@ -76,6 +87,16 @@
 #define DEF_LICENSE_REQ_RETRY_WAIT_TIME 500			/**< Wait time in milliseconds before retrying for DRM license */
 
 #define DEFAULT_CACHED_FRAGMENTS_PER_TRACK  3       /**< Default cached fragements per track */
+#define DEFAULT_MAX_CONCURRENT_DOWNLOADS 6          /**< Default number of transfers run in parallel by download scheduler */
+#define DEFAULT_MAX_HOST_CONNECTIONS 4              /**< Default number of connections download scheduler opens to a host */
+#define DEFAULT_FRAGMENT_BUFFER_POOL_SIZE_MB 32      /**< Default size of free fragment buffers kept for reuse, 0 disables pool */
+#define DEFAULT_LOW_LATENCY_LIVE_OFFSET 3           /**< Default live offset in seconds for LL-HLS streams */
+#define MAX_CACHED_FRAGMENTS_PER_TRACK 32           /**< Depth of fragment cache ring when caching by buffer-target-duration */
+#define BUFFER_TARGET_RECHECK_INTERVAL_MS 200       /**< Interval to re-evaluate duration/memory based cache limits while waiting */
+#define MAX_BUFFER_TARGET_SECONDS 600               /**< Upper limit of buffer-target-duration */
+#define MAX_FRAGMENT_BUFFER_SIZE_MB 1024            /**< Upper limit of max-track-buffer-size and max-player-buffer-size */
+#define DEFAULT_DRM_SESSION_CACHE_SIZE 4            /**< Default number of DRM sessions kept for reuse across tunes */
+#define DEFAULT_LICENSE_PREFETCH_CONCURRENCY 2      /**< Default number of manifests processed in parallel by license prefetch */
 #define DEFAULT_BUFFER_HEALTH_MONITOR_DELAY 10
 #define DEFAULT_BUFFER_HEALTH_MONITOR_INTERVAL 5
 
@@ -86,6 +107,7 @@
 #define DEFAULT_REPORT_PROGRESS_INTERVAL (1000)     /**< Progress event reporting interval: 1sec */
 #define NOW_SYSTEM_TS_MS std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count()     /**< Getting current system clock in milliseconds */
 #define NOW_STEADY_TS_MS std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()     /**< Getting current steady clock in milliseconds */
+#define NOW_STEADY_TS_US std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()     /**< Getting current steady clock in microseconds */
 
 #define AAMP_SEEK_TO_LIVE_POSITION (-1)
 
@@ -103,6 +125,23 @@ struct GrowableBuffer
 	char *ptr;      /**< Pointer to buffer's memory location */
 	size_t len;     /**< Buffer size */
 	size_t avail;   /**< Available buffer size */
+	AampBufferPool *pool; /**< Pool owning ptr, NULL if allocated from heap */
+};
+
+/**
+ * @brief Reference counted fragment buffer
+ *
+ * Holds the memory downloaded by curl so that demuxer output and sink buffers
+ * can refer to slices of it instead of copying. Memory is released with
+ * g_free once the last reference is dropped.
+ */
+struct SharedFragmentBuffer
+{
+	char *ptr;      /**< Pointer to fragment data */
+	size_t len;     /**< Length of fragment data */
+	size_t avail;   /**< Allocated size of ptr */
+	AampBufferPool *pool; /**< Pool owning ptr, NULL if allocated from heap */
+	gint refCount;  /**< Number of references held, updated atomically */
 };
 
 /**
@@ -122,7 +161,8 @@ enum PlaybackErrorType
 {
 	eGST_ERROR_PTS,                 /**< PTS error from gstreamer */
 	eGST_ERROR_UNDERFLOW,           /**< Underflow error from gstreamer */
-	eDASH_ERROR_STARTTIME_RESET     /**< Start time reset of DASH */
+	eDASH_ERROR_STARTTIME_RESET,    /**< Start time reset of DASH */
+	eDASH_ERROR_AUDIO_CODEC_CHANGE  /**< Audio codec changed by mid stream language switch */
 };
 
 /**
@@ -419,6 +459,24 @@ public:
 	long iframeBitrate4K;                   /**< Default bitrate for iframe track selection for 4K assets*/
 	char *prLicenseServerURL;               /**< Playready License server URL*/
 	char *wvLicenseServerURL;               /**< Widevine License server URL*/
+	bool useDownloadScheduler;              /**< Run downloads through shared curl_multi scheduler*/
+	int maxConcurrentDownloads;             /**< Maximum transfers run in parallel by download scheduler*/
+	int maxHostConnections;                 /**< Maximum connections opened by download scheduler to a host*/
+	int hlsFragmentPrefetchCount;           /**< Fragments fetched in parallel by HLS tracks, 1 to fetch one at a time*/
+	int fragmentBufferPoolSizeMB;           /**< Free fragment buffers kept for reuse in MB, 0 to allocate from heap*/
+	bool hlsDeltaUpdate;                    /**< Request HLS delta playlist updates when server supports them*/
+	bool hlsLowLatency;                     /**< Fetch LL-HLS partial segments at live edge*/
+	int lowLatencyLiveOffset;               /**< Live offset used for LL-HLS streams*/
+	const char* tuneTraceDirectory;         /**< Directory to write tune time trace files, NULL to disable*/
+	int bufferTargetSeconds;                /**< Duration to buffer ahead of playhead per track, 0 to cap cache by fragment count only*/
+	int maxTrackBufferMB;                   /**< Memory ceiling of fragments cached per track in MB, 0 for no ceiling*/
+	int maxPlayerBufferMB;                  /**< Memory ceiling of fragments cached by all tracks of a player in MB, 0 for no ceiling*/
+	bool hlsStreamingDecrypt;               /**< Decrypt AES-128 HLS fragments while they are downloaded*/
+	int drmSessionCacheSize;                /**< DRM sessions kept for reuse across tunes, keyed by key ID*/
+	int drmSessionCacheExpirySeconds;       /**< Age after which a cached license is acquired again, 0 to reuse till evicted*/
+	int licensePrefetchConcurrency;         /**< Manifests processed in parallel by license prefetch, 0 to disable prefetch*/
+	bool useCurlShare;                      /**< Share DNS and TLS session caches between media and license curl handles*/
+	bool seamlessAudioSwitch;               /**< Switch audio language by re-pointing audio track only, without retune*/
 public:
 
 	/**
@@ -433,7 +491,7 @@ public:
 #endif
 		gPreservePipeline(0), gAampDemuxHLSAudioTsTrack(1), gAampMergeAudioTrack(1), forceEC3(0),
 		gAampDemuxHLSVideoTsTrack(1), demuxHLSVideoTsTrackTM(1), gThrottle(0), demuxedAudioBeforeVideo(0),
-		playlistsParallelFetch(false), prefetchIframePlaylist(false),
+		playlistsParallelFetch(true), prefetchIframePlaylist(false),
 		disableEC3(0), disableATMOS(0),abrOutlierDiffBytes(DEFAULT_ABR_OUTLIER),abrSkipDuration(DEFAULT_ABR_SKIP_DURATION),
 		liveOffset(AAMP_LIVE_OFFSET),cdvrliveOffset(AAMP_CDVR_LIVE_OFFSET), adPositionSec(0), adURL(0),abrNwConsistency(DEFAULT_ABR_NW_CONSISTENCY_CNT),
 		disablePlaylistIndexEvent(1), enableSubscribedTags(1), dashIgnoreBaseURLIfSlash(false),fragmentDLTimeout(CURL_FRAGMENT_DL_TIMEOUT),
@@ -446,7 +504,13 @@ public:
 		reportProgressInterval(DEFAULT_REPORT_PROGRESS_INTERVAL), mpdDiscontinuityHandling(true), mpdDiscontinuityHandlingCdvr(true),bForceHttp(false),
 		internalReTune(true), bAudioOnlyPlayback(false), gstreamerBufferingBeforePlay(true),licenseRetryWaitTime(DEF_LICENSE_REQ_RETRY_WAIT_TIME),
 		iframeBitrate(0), iframeBitrate4K(0),ptsErrorThreshold(MAX_PTS_ERRORS_THRESHOLD),
-		prLicenseServerURL(NULL), wvLicenseServerURL(NULL)
+		prLicenseServerURL(NULL), wvLicenseServerURL(NULL),
+		useDownloadScheduler(true), maxConcurrentDownloads(DEFAULT_MAX_CONCURRENT_DOWNLOADS), maxHostConnections(DEFAULT_MAX_HOST_CONNECTIONS),
+		hlsFragmentPrefetchCount(1), fragmentBufferPoolSizeMB(DEFAULT_FRAGMENT_BUFFER_POOL_SIZE_MB), hlsDeltaUpdate(true),
+		hlsLowLatency(false), lowLatencyLiveOffset(DEFAULT_LOW_LATENCY_LIVE_OFFSET), tuneTraceDirectory(NULL),
+		bufferTargetSeconds(0), maxTrackBufferMB(0), maxPlayerBufferMB(0), hlsStreamingDecrypt(true),
+		drmSessionCacheSize(DEFAULT_DRM_SESSION_CACHE_SIZE), drmSessionCacheExpirySeconds(0),
+		licensePrefetchConcurrency(DEFAULT_LICENSE_PREFETCH_CONCURRENCY), useCurlShare(true), seamlessAudioSwitch(true)
 	{
 		//XRE sends onStreamPlaying & onVideoInfo while receiving onTuned event.
 		//onVideoInfo depends on the metrics received from pipe. Hence, onTuned event should be sent only after the tune completion.
@@ -523,6 +587,13 @@ void aamp_ResolveURL(char *dst, const char *base, const char *uri);
  */
 long long aamp_GetCurrentTimeMS(void); //TODO: Use NOW_STEADY_TS_MS/NOW_SYSTEM_TS_MS instead
 
+/**
+ * @brief Get curl share object holding DNS and TLS session caches of all curl handles
+ *
+ * @return Share object, NULL if sharing is disabled or not available
+ */
+CURLSH *aamp_GetCurlShare(void);
+
 /**
  * @brief Log error
  *
@@ -565,6 +636,48 @@ void aamp_AppendNulTerminator(struct GrowableBuffer *buffer);
  */
 void aamp_Malloc(struct GrowableBuffer *buffer, size_t len);
 
+/**
+ * @brief Allocate GrowableBuffer memory from a buffer pool
+ *
+ * @param[in] pool - Buffer pool, heap is used if NULL
+ * @param[out] buffer - Allocated GrowableBuffer
+ * @param[in] len - Allocation size
+ * @return void
+ */
+void aamp_PoolMalloc(AampBufferPool *pool, struct GrowableBuffer *buffer, size_t len);
+
+/**
+ * @brief Free GrowableBuffer memory, returning it to its pool if pooled
+ *
+ * @param[in,out] buffer - GrowableBuffer to be freed, reset on return
+ * @return void
+ */
+void aamp_FreeBuffer(struct GrowableBuffer *buffer);
+
+/**
+ * @brief Move memory of a GrowableBuffer to a new reference counted buffer
+ *
+ * @param[in,out] buffer - GrowableBuffer whose memory is taken over, reset on return
+ * @return SharedFragmentBuffer holding one reference, NULL if buffer is empty
+ */
+struct SharedFragmentBuffer *aamp_CreateSharedBuffer(struct GrowableBuffer *buffer);
+
+/**
+ * @brief Take an additional reference on a shared buffer
+ *
+ * @param[in] buffer - Shared buffer
+ * @return buffer
+ */
+struct SharedFragmentBuffer *aamp_RetainSharedBuffer(struct SharedFragmentBuffer *buffer);
+
+/**
+ * @brief Drop a reference on a shared buffer, memory is freed with the last reference
+ *
+ * @param[in] buffer - Shared buffer
+ * @return void
+ */
+void aamp_ReleaseSharedBuffer(struct SharedFragmentBuffer *buffer);
+
 /**
  * @brief Get DRM system ID
  *
@@ -723,6 +836,8 @@ private:
 	long bandwidthBitsPerSecondVideo;       /**< Video bandwidth in bps */
 	long bandwidthBitsPerSecondAudio;       /**< Audio bandwidth in bps */
 	int drmErrorCode;                       /**< DRM error code */
+	int drmSessionCacheHits;                /**< DRM sessions reused without license request */
+	int drmSessionCacheMisses;              /**< DRM sessions that needed license request */
 	bool enabled;                           /**< Profiler started or not */
 
 	/**
@@ -740,6 +855,33 @@ private:
 #endif
 		return bucketDuration(id1) + bucketDuration(id2);
 	}
+
+	/**
+	 * @brief Find the completed dependency of a bucket which finished last, i.e. the one that gated its start
+	 *
+	 * @param[in] type - Bucket type
+	 * @return Gating bucket, PROFILE_BUCKET_TYPE_COUNT if bucket has no completed dependency
+	 */
+	ProfilerBucketType GetCriticalDependency(ProfilerBucketType type);
+
+	/**
+	 * @brief Walk dependency edges back from the last completed milestone of the tune
+	 *
+	 * @param[out] path - Buckets on critical path, in tune order
+	 * @return Number of buckets on critical path
+	 */
+	int GetCriticalPath(ProfilerBucketType path[PROFILE_BUCKET_TYPE_COUNT]);
+
+	/**
+	 * @brief Log critical path of the tune and write it along with all buckets as a chrome trace-event file
+	 *
+	 * @param[in] directory - Directory of trace file, NULL to only log critical path
+	 * @param[in] success - Tune status
+	 * @param[in] contentType - Content Type
+	 * @param[in] streamType - Stream Type
+	 * @return void
+	 */
+	void WriteTuneTrace(const char *directory, bool success, ContentType contentType, int streamType);
 public:
 
 	/**
@@ -801,6 +943,8 @@ public:
 		bandwidthBitsPerSecondVideo = 0;
 		bandwidthBitsPerSecondAudio = 0;
 		drmErrorCode = 0;
+		drmSessionCacheHits = 0;
+		drmSessionCacheMisses = 0;
 		enabled = true;
 	}
 
@@ -850,9 +994,10 @@ public:
 	 * @param[in] contentType - Content Type. Eg: LINEAR, VOD, etc
 	 * @param[in] streamType - Stream Type. Eg: HLS, DASH, etc
 	 * @param[in] firstTune - Is it a first tune after reboot/crash.
+	 * @param[in] traceDirectory - Directory to write tune trace file, NULL to disable
 	 * @return void
 	 */
-	void TuneEnd(bool success, ContentType contentType, int streamType, bool firstTune)
+	void TuneEnd(bool success, ContentType contentType, int streamType, bool firstTune, const char *traceDirectory = NULL)
 	{
 		if(!enabled )
 		{
@@ -903,6 +1048,11 @@ public:
 			buckets[PROFILE_BUCKET_FIRST_FRAME].tStart,  // gstFirstFrame: offset in ms from tunestart when first frame of video is decoded/presented
 			contentType, streamType, firstTune
 			);
+		if (drmSessionCacheHits || drmSessionCacheMisses)
+		{
+			logprintf("IP_AAMP_DRM_SESSION_CACHE:%d,%d\n", drmSessionCacheHits, drmSessionCacheMisses);
+		}
+		WriteTuneTrace(traceDirectory, success, contentType, streamType);
 		fflush(stdout);
 	}
 
@@ -1033,6 +1183,24 @@ public:
 		}
 	}
 
+	/**
+	 * @brief Count a DRM session lookup, reported along with tune metrics
+	 *
+	 * @param[in] hit - true if a cached session was reused without license request
+	 * @return void
+	 */
+	void ProfileDrmSessionLookup(bool hit)
+	{
+		if (hit)
+		{
+			drmSessionCacheHits++;
+		}
+		else
+		{
+			drmSessionCacheMisses++;
+		}
+	}
+
 	/**
 	 * @brief Method to mark the end of a bucket, for which beginning is not marked
 	 *
@@ -1081,6 +1249,33 @@ public:
  */
 typedef int(*IdleTask)(void* arg);
 
+/**
+ * @brief Decryptor fed by GetFile with the data received so far
+ *
+ * Lets a fragment be decrypted while the rest of it is still on the wire.
+ * Callbacks are made from the thread that requested the transfer, never from
+ * the download scheduler thread.
+ */
+class AampStreamDecryptor
+{
+public:
+	virtual ~AampStreamDecryptor() {}
+
+	/**
+	 * @brief Discard progress, called before each download attempt
+	 */
+	virtual void Restart() = 0;
+
+	/**
+	 * @brief Decrypt in place what can be decrypted of the data received so far
+	 *
+	 * @param[in,out] data - Start of the downloaded data
+	 * @param[in] len - Bytes downloaded so far
+	 * @return Number of bytes from start of data that are decrypted
+	 */
+	virtual size_t DecryptAvailable(unsigned char *data, size_t len) = 0;
+};
+
 /**
  * @brief To store Set Cookie: headers and X-Reason headers in HTTP Response
  */
@@ -1183,7 +1378,7 @@ public:
 	StreamOutputFormat mFormat;
 	StreamOutputFormat mAudioFormat;
 	pthread_cond_t mDownloadsDisabled;
-	bool mDownloadsEnabled;
+	std::atomic<bool> mDownloadsEnabled; /**< Read without mLock by curl callbacks on download scheduler thread*/
 	StreamSink* mStreamSink;
 
 	ProfileEventAAMP profiler;
@@ -1293,9 +1488,10 @@ public:
 	 * @param[in] curlInstance - Curl instance to be used
 	 * @param[in] resetBuffer - Flag to reset the out buffer
 	 * @param[in] fileType - File type
+	 * @param[in] decryptor - Decryptor to run on data as it is received, NULL for none
 	 * @return void
 	 */
-	bool GetFile(const char *remoteUrl, struct GrowableBuffer *buffer, char effectiveUrl[MAX_URI_LENGTH], long *http_error = NULL, const char *range = NULL,unsigned int curlInstance = 0, bool resetBuffer = true,MediaType fileType = eMEDIATYPE_MANIFEST);
+	bool GetFile(const char *remoteUrl, struct GrowableBuffer *buffer, char effectiveUrl[MAX_URI_LENGTH], long *http_error = NULL, const char *range = NULL,unsigned int curlInstance = 0, bool resetBuffer = true,MediaType fileType = eMEDIATYPE_MANIFEST, AampStreamDecryptor *decryptor = NULL);
 
 	/**
 	 * @brief get Media Type in string
@@ -1570,6 +1766,72 @@ public:
 	 */
 	void SendStream(MediaType mediaType, GrowableBuffer* buffer, double fpts, double fdts, double fDuration);
 
+	/**
+	 *   @brief  API to send a slice of a shared fragment buffer into the sink without copying.
+	 *
+	 *   @param[in]  mediaType - Type of the media.
+	 *   @param[in]  buffer - Shared buffer; caller keeps its reference
+	 *   @param[in]  offset - Offset of slice in buffer
+	 *   @param[in]  len - Length of slice
+	 *   @param[in]  fpts - Presentation Time Stamp.
+	 *   @param[in]  fdts - Decode Time Stamp
+	 *   @param[in]  fDuration - Buffer duration.
+	 *   @return void
+	 */
+	void SendStream(MediaType mediaType, SharedFragmentBuffer* buffer, size_t offset, size_t len, double fpts, double fdts, double fDuration);
+
+	/**
+	 *   @brief  Get pool used for fragment buffers
+	 *
+	 *   @return Buffer pool, NULL if fragment buffers are allocated from heap
+	 */
+	AampBufferPool* GetFragmentBufferPool()
+	{
+		return mFragmentBufferPool;
+	}
+
+	/**
+	 *   @brief  Account bytes of fragments entering or leaving track caches
+	 *
+	 *   @param[in] delta - Bytes added, negative if released
+	 *   @return void
+	 */
+	void UpdateCachedFragmentBytes(long long delta)
+	{
+		mCachedFragmentBytes += delta;
+	}
+
+	/**
+	 *   @brief  Get bytes held by fragments cached in all tracks
+	 *
+	 *   @return Cached bytes
+	 */
+	long long GetCachedFragmentBytes()
+	{
+		return mCachedFragmentBytes;
+	}
+
+	/**
+	 *   @brief  Run a blocking download job, e.g. a GetFile call, on a worker of the download scheduler
+	 *
+	 *   @param[in] job - Job to run, must stay valid till WaitForDownloadJob returns
+	 *   @return false if job can't be queued, caller is expected to run it inline
+	 */
+	bool SubmitDownloadJob(AampDownloadJob *job)
+	{
+		return mDownloadScheduler && mDownloadScheduler->SubmitJob(job);
+	}
+
+	/**
+	 *   @brief  Wait for completion of a job queued by SubmitDownloadJob
+	 *
+	 *   @param[in] job - Queued job
+	 */
+	void WaitForDownloadJob(AampDownloadJob *job)
+	{
+		mDownloadScheduler->WaitForJob(job);
+	}
+
 	/**
 	 * @brief Setting the stream sink
 	 *
@@ -1694,6 +1956,24 @@ public:
 	 */
 	void BlockUntilGstreamerWantsData(void(*cb)(void), int periodMs, int track);
 
+	/**
+	 *   @brief Get time injector of a track spent waiting for gstreamer to need data
+	 *
+	 *   @param[in] track - Track id
+	 *   @param[out] blockedMs - Total time blocked in milliseconds
+	 *   @param[out] blockCount - Number of times injector blocked
+	 *   @param[out] maxBlockedMs - Longest single wait in milliseconds
+	 *   @return void
+	 */
+	void GetBackpressureStats(int track, long long *blockedMs, int *blockCount, long long *maxBlockedMs);
+
+	/**
+	 *   @brief Log and reset backpressure statistics of all tracks
+	 *
+	 *   @return void
+	 */
+	void LogBackpressureStats(void);
+
 	/**
 	 *   @brief Notify the tune complete event
 	 *
@@ -1876,6 +2156,15 @@ public:
 	 */
 	bool Discontinuity(MediaType);
 
+	/**
+	 *   @brief Flush data of a track already sent to sink, other tracks keep playing.
+	 *   Called from StreamAbstractionAAMP to replace data of a track mid stream
+	 *
+	 *   @param[in] track - Media type
+	 *   @return true if sink flushed the track
+	 */
+	bool FlushTrack(MediaType);
+
 	/**
 	 *   @brief Set video zoom mode
 	 *
@@ -2006,6 +2295,14 @@ public:
 	 */
 	void SetPreferredDRM(DRMSystems drmType);
 
+	/**
+	 *   @brief Acquire licenses of manifests likely to be tuned next, in background
+	 *
+	 *   @param[in] manifestUrls - URLs of DASH manifests in order of likelihood
+	 *   @return void
+	 */
+	void PreacquireLicenses(const std::vector<std::string> &manifestUrls);
+
 	/**
 	 *   @brief Set anonymous request true or false
 	 *
@@ -2266,6 +2563,11 @@ private:
 	PrivAAMPState mState;
 	long long lastUnderFlowTimeMs[AAMP_TRACK_COUNT];
 	bool mbTrackDownloadsBlocked[AAMP_TRACK_COUNT];
+	pthread_mutex_t mNeedDataMutex;                         /**< Protects download blocked flags and backpressure stats, not recursive unlike mLock*/
+	pthread_cond_t mGstreamerWantsData[AAMP_TRACK_COUNT];   /**< Signalled when track is unblocked or downloads are disabled, uses monotonic clock*/
+	long long mBackpressureBlockedMs[AAMP_TRACK_COUNT];     /**< Time injector waited for need-data*/
+	int mBackpressureBlockCount[AAMP_TRACK_COUNT];          /**< Number of waits for need-data*/
+	long long mBackpressureMaxBlockedMs[AAMP_TRACK_COUNT];  /**< Longest wait for need-data*/
 	bool mIsDash;
 	DRMSystems mCurrentDrm;
 	int  mPersistedProfileIndex;
@@ -2279,6 +2581,10 @@ private:
 	std::unordered_map<std::string, std::pair<GrowableBuffer*, char*>> mPlaylistCache;
 	std::map<gint, bool> mPendingAsyncEvents;
 	std::unordered_map<std::string, std::vector<std::string>> mCustomHeaders;
+	AampDownloadScheduler *mDownloadScheduler;
+	AampBufferPool *mFragmentBufferPool;
+	AampLicensePrefetcher *mLicensePrefetcher;
+	std::atomic<long long> mCachedFragmentBytes;   /**< Bytes held by fragments cached in all tracks*/
 	bool mIsFirstRequestToFOG;
 	bool mIsLocalPlayback; /** indicates if the playback is from FOG(TSB/IP-DVR) */
 };
@@ -165,11 +165,16 @@ void MediaTrack::MonitorBufferHealth()
  */
 void MediaTrack::UpdateTSAfterInject()
 {
-	pthread_mutex_lock(&mutex);
-	aamp_Free(&cachedFragment[fragmentIdxToInject].fragment.ptr);
+	// Injector owns the read slot till the count is released, no lock needed
+	// fragment buffer may have been handed over to sink already, release what was accounted at fetch
+	size_t fragmentLen = cachedFragment[fragmentIdxToInject].cachedBytes;
+	cachedFragmentBytes -= fragmentLen;
+	cachedFragmentDurationMs -= (int)(cachedFragment[fragmentIdxToInject].duration * 1000);
+	aamp->UpdateCachedFragmentBytes(-(long long)fragmentLen);
+	aamp_FreeBuffer(&cachedFragment[fragmentIdxToInject].fragment);
 	memset(&cachedFragment[fragmentIdxToInject], 0, sizeof(CachedFragment));
 	fragmentIdxToInject++;
-	if (fragmentIdxToInject == gpGlobalConfig->maxCachedFragmentsPerTrack)
+	if (fragmentIdxToInject == maxCachedFragments)
 	{
 		fragmentIdxToInject = 0;
 	}
@@ -178,11 +183,27 @@ void MediaTrack::UpdateTSAfterInject()
 	if ((1 << type) & AAMP_DEBUG_FETCH_INJECT)
 	{
 		logprintf("%s:%d [%s] updated fragmentIdxToInject = %d numberOfFragmentsCached %d\n", __FUNCTION__, __LINE__,
-		        name, fragmentIdxToInject, numberOfFragmentsCached);
+		        name, fragmentIdxToInject, numberOfFragmentsCached.load());
 	}
 #endif
-	pthread_cond_signal(&fragmentInjected);
-	pthread_mutex_unlock(&mutex);
+	if (fetcherWaiting)
+	{ // fetcher found the ring full, lock only to avoid losing the wakeup
+		pthread_mutex_lock(&ringMutex);
+		pthread_cond_signal(&fragmentInjected);
+		pthread_mutex_unlock(&ringMutex);
+	}
+}
+
+
+/**
+ * @brief Get profile index of the fragment being fetched by this track
+ *
+ * Only video follows ABR profile of the context, other tracks keep their rendition.
+ * @retval profile index
+ */
+int MediaTrack::GetFetchProfileIndex()
+{
+	return (eTRACK_VIDEO == type) ? GetContext()->profileIdxForBandwidthNotification : 0;
 }
 
 
@@ -192,17 +213,31 @@ void MediaTrack::UpdateTSAfterInject()
 void MediaTrack::UpdateTSAfterFetch()
 {
 	bool notifyCacheCompleted = false;
-	pthread_mutex_lock(&mutex);
-	cachedFragment[fragmentIdxToFetch].profileIndex = GetContext()->profileIdxForBandwidthNotification;
+	// Fetcher owns the write slot till the count is released, no lock needed
+	cachedFragment[fragmentIdxToFetch].profileIndex = GetFetchProfileIndex();
 #ifdef AAMP_DEBUG_FETCH_INJECT
 	if ((1 << type) & AAMP_DEBUG_FETCH_INJECT)
 	{
 		logprintf("%s:%d [%s] before update fragmentIdxToFetch = %d numberOfFragmentsCached %d\n",
-		        __FUNCTION__, __LINE__, name, fragmentIdxToFetch, numberOfFragmentsCached);
+		        __FUNCTION__, __LINE__, name, fragmentIdxToFetch, numberOfFragmentsCached.load());
 	}
 #endif
 	totalFetchedDuration += cachedFragment[fragmentIdxToFetch].duration;
 	size_t fragmentLen = cachedFragment[fragmentIdxToFetch].fragment.len;
+	cachedFragment[fragmentIdxToFetch].cachedBytes = fragmentLen;
+	cachedFragmentBytes += fragmentLen;
+	cachedFragmentDurationMs += (int)(cachedFragment[fragmentIdxToFetch].duration * 1000);
+	aamp->UpdateCachedFragmentBytes(fragmentLen);
+	size_t &profileFragmentLen = mFragmentSizeByProfile[cachedFragment[fragmentIdxToFetch].profileIndex];
+	// Follow larger fragments immediately, decay slowly towards smaller ones
+	if (fragmentLen > profileFragmentLen)
+	{
+		profileFragmentLen = fragmentLen;
+	}
+	else
+	{
+		profileFragmentLen -= ((profileFragmentLen - fragmentLen) >> 3);
+	}
 	if (fetchBufferPreAllocLen < fragmentLen)
 	{
 		logprintf("%s:%d [%s] Update fetchBufferPreAllocLen[%u]->[%u]\n", __FUNCTION__, __LINE__,
@@ -232,7 +267,7 @@ void MediaTrack::UpdateTSAfterFetch()
 		}
 	}
 	fragmentIdxToFetch++;
-	if (fragmentIdxToFetch == gpGlobalConfig->maxCachedFragmentsPerTrack)
+	if (fragmentIdxToFetch == maxCachedFragments)
 	{
 		fragmentIdxToFetch = 0;
 	}
@@ -245,18 +280,23 @@ void MediaTrack::UpdateTSAfterFetch()
 		}
 	}
 #endif
-	numberOfFragmentsCached++;
-	assert(numberOfFragmentsCached <= gpGlobalConfig->maxCachedFragmentsPerTrack);
+	totalFragmentsDownloaded++;
+	// Publishes the slot to injector
+	int cached = ++numberOfFragmentsCached;
+	assert(cached <= maxCachedFragments);
 #ifdef AAMP_DEBUG_FETCH_INJECT
 	if ((1 << type) & AAMP_DEBUG_FETCH_INJECT)
 	{
 		logprintf("%s:%d [%s] updated fragmentIdxToFetch = %d numberOfFragmentsCached %d\n",
-			__FUNCTION__, __LINE__, name, fragmentIdxToFetch, numberOfFragmentsCached);
+			__FUNCTION__, __LINE__, name, fragmentIdxToFetch, cached);
 	}
 #endif
-	totalFragmentsDownloaded++;
-	pthread_cond_signal(&fragmentFetched);
-	pthread_mutex_unlock(&mutex);
+	if (injectorWaiting)
+	{ // injector found the ring empty, lock only to avoid losing the wakeup
+		pthread_mutex_lock(&ringMutex);
+		pthread_cond_signal(&fragmentFetched);
+		pthread_mutex_unlock(&ringMutex);
+	}
 	if(notifyCacheCompleted)
 	{
 		aamp->NotifyFragmentCachingComplete();
@@ -276,33 +316,45 @@ bool MediaTrack::WaitForFreeFragmentAvailable( int timeoutMs)
 	bool ret = true;
 	int pthreadReturnValue = 0;
 
-	pthread_mutex_lock(&mutex);
-	if(abort)
-	{
-		ret = false;
+	if (!abort && GetFreeFragmentCount() > 0)
+	{ // fast path, cache can take a fragment
+		return true;
 	}
-	else if (numberOfFragmentsCached == gpGlobalConfig->maxCachedFragmentsPerTrack)
+	long long deadlineMs = NOW_STEADY_TS_MS + timeoutMs;
+	pthread_mutex_lock(&ringMutex);
+	fetcherWaiting = true;
+	while (!abort && (GetFreeFragmentCount() == 0))
 	{
+		int waitMs = timeoutMs;
 		if (timeoutMs >= 0)
+		{
+			waitMs = (int)(deadlineMs - NOW_STEADY_TS_MS);
+			if (waitMs <= 0)
+			{
+				ret = false;
+				break;
+			}
+		}
+		if ((numberOfFragmentsCached < maxCachedFragments) && (waitMs < 0 || waitMs > BUFFER_TARGET_RECHECK_INTERVAL_MS))
+		{ // limited by buffer duration or memory, which also drain with playback and other tracks
+			waitMs = BUFFER_TARGET_RECHECK_INTERVAL_MS;
+		}
+		if (waitMs >= 0)
 		{
 			struct timespec tspec;
 			struct timeval tv;
 			gettimeofday(&tv, NULL);
-			tspec.tv_sec = time(NULL) + timeoutMs / 1000;
-			tspec.tv_nsec = (long)(tv.tv_usec * 1000 + 1000 * 1000 * (timeoutMs % 1000));
+			tspec.tv_sec = tv.tv_sec + waitMs / 1000;
+			tspec.tv_nsec = (long)(tv.tv_usec * 1000 + 1000 * 1000 * (waitMs % 1000));
 			tspec.tv_sec += tspec.tv_nsec / (1000 * 1000 * 1000);
 			tspec.tv_nsec %= (1000 * 1000 * 1000);
 
-			pthreadReturnValue = pthread_cond_timedwait(&fragmentInjected, &mutex, &tspec);
-
-			if (ETIMEDOUT == pthreadReturnValue)
-			{
-				ret = false;
-			}
-			else if (0 != pthreadReturnValue)
+			pthreadReturnValue = pthread_cond_timedwait(&fragmentInjected, &ringMutex, &tspec);
+			if ((0 != pthreadReturnValue) && (ETIMEDOUT != pthreadReturnValue))
 			{
 				logprintf("%s:%d [%s] pthread_cond_timedwait returned %s\n", __FUNCTION__, __LINE__, name, strerror(pthreadReturnValue));
 				ret = false;
+				break;
 			}
 		}
 		else
@@ -313,39 +365,34 @@ bool MediaTrack::WaitForFreeFragmentAvailable( int timeoutMs)
 				logprintf("%s:%d [%s] waiting for fragmentInjected condition\n", __FUNCTION__, __LINE__, name);
 			}
 #endif
-			pthreadReturnValue = pthread_cond_wait(&fragmentInjected, &mutex);
-
+			pthreadReturnValue = pthread_cond_wait(&fragmentInjected, &ringMutex);
 			if (0 != pthreadReturnValue)
 			{
 				logprintf("%s:%d [%s] pthread_cond_wait returned %s\n", __FUNCTION__, __LINE__, name, strerror(pthreadReturnValue));
 				ret = false;
+				break;
 			}
-#ifdef AAMP_DEBUG_FETCH_INJECT
-			if ((1 << type) & AAMP_DEBUG_FETCH_INJECT)
-			{
-				logprintf("%s:%d [%s] wait complete for fragmentInjected\n", __FUNCTION__, __LINE__, name);
-			}
-#endif
 		}
-		if(abort)
-		{
+	}
+	if(abort)
+	{
 #ifdef AAMP_DEBUG_FETCH_INJECT
-			if ((1 << type) & AAMP_DEBUG_FETCH_INJECT)
-			{
-				logprintf("%s:%d [%s] abort set, returning false\n", __FUNCTION__, __LINE__, name);
-			}
-#endif
-			ret = false;
+		if ((1 << type) & AAMP_DEBUG_FETCH_INJECT)
+		{
+			logprintf("%s:%d [%s] abort set, returning false\n", __FUNCTION__, __LINE__, name);
 		}
+#endif
+		ret = false;
 	}
 #ifdef AAMP_DEBUG_FETCH_INJECT
 	if ((1 << type) & AAMP_DEBUG_FETCH_INJECT)
 	{
 		logprintf("%s:%d [%s] fragmentIdxToFetch = %d numberOfFragmentsCached %d\n",
-			__FUNCTION__, __LINE__, name, fragmentIdxToFetch, numberOfFragmentsCached);
+			__FUNCTION__, __LINE__, name, fragmentIdxToFetch, numberOfFragmentsCached.load());
 	}
 #endif
-	pthread_mutex_unlock(&mutex);
+	fetcherWaiting = false;
+	pthread_mutex_unlock(&ringMutex);
 	return ret;
 }
 
@@ -356,7 +403,12 @@ bool MediaTrack::WaitForFreeFragmentAvailable( int timeoutMs)
 bool MediaTrack::WaitForCachedFragmentAvailable()
 {
 	bool ret;
-	pthread_mutex_lock(&mutex);
+	if (numberOfFragmentsCached > 0)
+	{ // fast path, fetched fragment is ready
+		return !abort;
+	}
+	pthread_mutex_lock(&ringMutex);
+	injectorWaiting = true;
 	if ((numberOfFragmentsCached == 0) && (!abort))
 	{
 #ifdef AAMP_DEBUG_FETCH_INJECT
@@ -367,18 +419,19 @@ bool MediaTrack::WaitForCachedFragmentAvailable()
 #endif
 		if (!eosReached)
 		{
-			pthread_cond_wait(&fragmentFetched, &mutex);
+			pthread_cond_wait(&fragmentFetched, &ringMutex);
 		}
 	}
 #ifdef AAMP_DEBUG_FETCH_INJECT
 	if ((1 << type) & AAMP_DEBUG_FETCH_INJECT)
 	{
 		logprintf("%s:%d [%s] fragmentIdxToInject = %d numberOfFragmentsCached %d\n",
-			__FUNCTION__, __LINE__, name, fragmentIdxToInject, numberOfFragmentsCached);
+			__FUNCTION__, __LINE__, name, fragmentIdxToInject, numberOfFragmentsCached.load());
 	}
 #endif
 	ret = !(abort || (numberOfFragmentsCached == 0));
-	pthread_mutex_unlock(&mutex);
+	injectorWaiting = false;
+	pthread_mutex_unlock(&ringMutex);
 	return ret;
 }
 
@@ -389,7 +442,7 @@ bool MediaTrack::WaitForCachedFragmentAvailable()
  */
 void MediaTrack::AbortWaitForCachedFragment( bool immediate)
 {
-	pthread_mutex_lock(&mutex);
+	pthread_mutex_lock(&ringMutex);
 	if (immediate)
 	{
 		abort = true;
@@ -402,7 +455,7 @@ void MediaTrack::AbortWaitForCachedFragment( bool immediate)
 		pthread_cond_signal(&fragmentInjected);
 	}
 	pthread_cond_signal(&fragmentFetched);
-	pthread_mutex_unlock(&mutex);
+	pthread_mutex_unlock(&ringMutex);
 }
 
 
@@ -557,11 +610,16 @@ static void *FragmentInjector(void *arg)
 
 /**
  * @brief Starts inject loop of track
+ * @param keepInjectedDuration keep injected duration, for audio rendition switch which sets it in FlushFragments
  */
-void MediaTrack::StartInjectLoop()
+void MediaTrack::StartInjectLoop(bool keepInjectedDuration)
 {
 	abort = false;
 	discontinuityProcessed = false;
+	if (!keepInjectedDuration)
+	{
+		totalInjectedDuration = 0;
+	}
 	assert(!fragmentInjectorThreadStarted);
 	if (0 == pthread_create(&fragmentInjectorThreadID, NULL, &FragmentInjector, this))
 	{
@@ -588,7 +646,6 @@ void MediaTrack::RunInjectLoop()
 		guint bufferMontiorSceduleTime = gpGlobalConfig->bufferHealthMonitorDelay - gpGlobalConfig->bufferHealthMonitorInterval;
 		bufferHealthMonitorIdleTaskId = g_timeout_add_seconds(bufferMontiorSceduleTime, BufferHealthMonitorSchedule, this);
 	}
-	totalInjectedDuration = 0;
 	while (aamp->DownloadsAreEnabled() && keepInjecting)
 	{
 		if (!InjectFragment())
@@ -661,12 +718,14 @@ bool MediaTrack::Enabled()
 /**
  * @brief Get buffer to fetch and cache next fragment.
  * @param[in] initialize true to initialize the fragment.
+ * @param[in] offset number of free slots to skip from write position.
  * @retval Pointer to fragment buffer.
  */
-CachedFragment* MediaTrack::GetFetchBuffer(bool initialize)
+CachedFragment* MediaTrack::GetFetchBuffer(bool initialize, int offset)
 {
 	/*Make sure fragmentDurationSeconds updated before invoking this*/
-	CachedFragment* cachedFragment = &this->cachedFragment[fragmentIdxToFetch];
+	/*Slots ahead of write position are not touched by injector till UpdateTSAfterFetch moves past them*/
+	CachedFragment* cachedFragment = &this->cachedFragment[(fragmentIdxToFetch + offset) % maxCachedFragments];
 	if(initialize)
 	{
 		if (cachedFragment->fragment.ptr)
@@ -684,12 +743,151 @@ CachedFragment* MediaTrack::GetFetchBuffer(bool initialize)
 		}
 		traceprintf ("%s:%d [%s] bandwidthBytesPerSecond %d fragmentDurationSeconds %f fetchBufferPreAllocLen %d, estimatedFragmentSizeFromBW %d\n",
 				__FUNCTION__, __LINE__, name, bandwidthBytesPerSecond, fragmentDurationSeconds, fetchBufferPreAllocLen, estimatedFragmentSizeFromBW);
-		aamp_Malloc(&cachedFragment->fragment, fetchBufferPreAllocLen);
+		size_t preAllocLen = fetchBufferPreAllocLen;
+		std::map<int, size_t>::iterator it = mFragmentSizeByProfile.find(GetFetchProfileIndex());
+		if (it != mFragmentSizeByProfile.end())
+		{
+			// size seen for the profile being fetched is tighter than the maximum across profiles
+			preAllocLen = it->second + (it->second >> 3);
+		}
+		aamp_PoolMalloc(aamp->GetFragmentBufferPool(), &cachedFragment->fragment, preAllocLen);
 	}
 	return cachedFragment;
 }
 
 
+/**
+ * @brief Get number of free fragment slots in cache
+ * @retval Number of fragments that can be fetched without waiting
+ */
+int MediaTrack::GetFreeFragmentCount()
+{
+	int cached = numberOfFragmentsCached;
+	int freeCount = maxCachedFragments - cached;
+	if (gpGlobalConfig->bufferTargetSeconds > 0 && aamp->rate == 1.0 && fragmentDurationSeconds > 0)
+	{
+		// fragments waiting in cache plus those injected but not yet played
+		double bufferedAhead = cachedFragmentDurationMs / 1000.0;
+		double injectedAhead = totalInjectedDuration - GetContext()->GetElapsedTime();
+		if (injectedAhead > 0)
+		{
+			bufferedAhead += injectedAhead;
+		}
+		int targetCount = (int)ceil((gpGlobalConfig->bufferTargetSeconds - bufferedAhead) / fragmentDurationSeconds);
+		freeCount = std::min(freeCount, targetCount);
+	}
+	else
+	{ // no duration bound, e.g. trickplay, keep configured depth in a ring grown for buffer target
+		freeCount = std::min(freeCount, gpGlobalConfig->maxCachedFragmentsPerTrack - cached);
+	}
+	if (fetchBufferPreAllocLen > 0)
+	{
+		if (gpGlobalConfig->maxTrackBufferMB > 0)
+		{
+			long long room = (long long)gpGlobalConfig->maxTrackBufferMB * 1024 * 1024 - cachedFragmentBytes;
+			freeCount = std::min(freeCount, (int)(room / (long long)fetchBufferPreAllocLen));
+		}
+		if (gpGlobalConfig->maxPlayerBufferMB > 0)
+		{
+			long long room = (long long)gpGlobalConfig->maxPlayerBufferMB * 1024 * 1024 - aamp->GetCachedFragmentBytes();
+			freeCount = std::min(freeCount, (int)(room / (long long)fetchBufferPreAllocLen));
+		}
+	}
+	if (cached == 0 && freeCount < 1)
+	{ // always keep one fragment in flight, otherwise the track starves
+		freeCount = 1;
+	}
+	return std::max(freeCount, 0);
+}
+
+
+/**
+ * @brief Drop fragments cached by track, injector loop should be stopped
+ * @retval Duration in seconds of dropped fragments ahead of playback position
+ */
+double MediaTrack::FlushFragments()
+{
+	// Injector is stopped, fetcher calling this owns all slots
+	aamp->UpdateCachedFragmentBytes(-cachedFragmentBytes.load());
+	for (int j = 0; j < maxCachedFragments; j++)
+	{
+		aamp_FreeBuffer(&cachedFragment[j].fragment);
+		memset(&cachedFragment[j], 0, sizeof(CachedFragment));
+	}
+	fragmentIdxToInject = 0;
+	fragmentIdxToFetch = 0;
+	numberOfFragmentsCached = 0;
+	cachedFragmentBytes = 0;
+	cachedFragmentDurationMs = 0;
+
+	// fetched and injected durations restart from playback position
+	double aheadOfPlayback = totalFetchedDuration - GetContext()->GetElapsedTime();
+	if (aheadOfPlayback < 0)
+	{
+		aheadOfPlayback = 0;
+	}
+	else if (aheadOfPlayback > totalFetchedDuration)
+	{
+		aheadOfPlayback = totalFetchedDuration;
+	}
+	totalFetchedDuration -= aheadOfPlayback;
+	totalInjectedDuration = totalFetchedDuration;
+	logprintf("%s:%d [%s] dropped %f seconds ahead of playback\n", __FUNCTION__, __LINE__, name, aheadOfPlayback);
+	return aheadOfPlayback;
+}
+
+
+/**
+ * @brief Request fetcher to re-point track to a new rendition
+ * @retval false if fetcher of track is already done
+ */
+bool MediaTrack::RequestRenditionSwitch()
+{
+	bool ret;
+	pthread_mutex_lock(&mutex);
+	ret = !fetchDone;
+	if (ret)
+	{
+		renditionSwitchPending = true;
+	}
+	pthread_mutex_unlock(&mutex);
+	return ret;
+}
+
+
+/**
+ * @brief Check and clear rendition switch request, called by fetcher
+ * @retval true if rendition switch was requested
+ */
+bool MediaTrack::TakeRenditionSwitchRequest()
+{
+	bool ret;
+	pthread_mutex_lock(&mutex);
+	ret = renditionSwitchPending;
+	renditionSwitchPending = false;
+	pthread_mutex_unlock(&mutex);
+	return ret;
+}
+
+
+/**
+ * @brief Mark fetcher of track done, unless a rendition switch is requested
+ * @retval true if fetcher can exit
+ */
+bool MediaTrack::FinishFetching()
+{
+	bool ret;
+	pthread_mutex_lock(&mutex);
+	ret = !renditionSwitchPending;
+	if (ret)
+	{
+		fetchDone = true;
+	}
+	pthread_mutex_unlock(&mutex);
+	return ret;
+}
+
+
 /**
  * @brief Set current bandwidth of track
  * @param bandwidthBps bandwidth in bits per second
@@ -722,18 +920,25 @@ MediaTrack::MediaTrack(TrackType type, PrivateInstanceAAMP* aamp, const char* na
 		notifiedCachingComplete(false), fragmentDurationSeconds(0), segDLFailCount(0),segDrmDecryptFailCount(0),mSegInjectFailCount(0),
 		bufferStatus(BUFFER_STATUS_GREEN), prevBufferStatus(BUFFER_STATUS_GREEN), bufferHealthMonitorIdleTaskId(0),
 		bandwidthBytesPerSecond(AAMP_DEFAULT_BANDWIDTH_BYTES_PREALLOC), totalFetchedDuration(0), fetchBufferPreAllocLen(0),
-		discontinuityProcessed(false), ptsError(false), cachedFragment(NULL)
+		discontinuityProcessed(false), renditionSwitchPending(false), fetchDone(false), ptsError(false), cachedFragment(NULL),
+		maxCachedFragments(gpGlobalConfig->maxCachedFragmentsPerTrack), fetcherWaiting(false), injectorWaiting(false),
+		cachedFragmentBytes(0), cachedFragmentDurationMs(0)
 {
 	this->type = type;
 	this->aamp = aamp;
 	this->name = name;
-	cachedFragment = new CachedFragment[gpGlobalConfig->maxCachedFragmentsPerTrack];
-	for(int X =0; X< gpGlobalConfig->maxCachedFragmentsPerTrack; ++X){
+	if (gpGlobalConfig->bufferTargetSeconds > 0 && maxCachedFragments < MAX_CACHED_FRAGMENTS_PER_TRACK)
+	{ // depth is then decided by GetFreeFragmentCount, ring only bounds it
+		maxCachedFragments = MAX_CACHED_FRAGMENTS_PER_TRACK;
+	}
+	cachedFragment = new CachedFragment[maxCachedFragments];
+	for(int X =0; X< maxCachedFragments; ++X){
 		memset(&cachedFragment[X], 0, sizeof(CachedFragment));
 	}
 	pthread_cond_init(&fragmentFetched, NULL);
 	pthread_cond_init(&fragmentInjected, NULL);
 	pthread_mutex_init(&mutex, NULL);
+	pthread_mutex_init(&ringMutex, NULL);
 }
 
 
@@ -742,9 +947,10 @@ MediaTrack::MediaTrack(TrackType type, PrivateInstanceAAMP* aamp, const char* na
  */
 MediaTrack::~MediaTrack()
 {
-	for (int j=0; j< gpGlobalConfig->maxCachedFragmentsPerTrack; j++)
+	aamp->UpdateCachedFragmentBytes(-cachedFragmentBytes.load());
+	for (int j=0; j< maxCachedFragments; j++)
 	{
-		aamp_Free(&cachedFragment[j].fragment.ptr);
+		aamp_FreeBuffer(&cachedFragment[j].fragment);
 	}
 	if(cachedFragment)
 	{
@@ -752,6 +958,7 @@ MediaTrack::~MediaTrack()
 		cachedFragment = NULL;
 	}
 	pthread_mutex_destroy(&mutex);
+	pthread_mutex_destroy(&ringMutex);
 	pthread_cond_destroy(&fragmentFetched);
 	pthread_cond_destroy(&fragmentInjected);
 }
@@ -782,6 +989,24 @@ void StreamAbstractionAAMP::ReassessAndResumeAudioTrack()
 }
 
 
+/**
+ *   @brief Stop injection of audio track and release its waits, for a rendition switch
+ */
+void StreamAbstractionAAMP::StopAudioInjection()
+{
+	MediaTrack *audio = GetMediaTrack(eTRACK_AUDIO);
+	// fetcher waiting on full cache and injector waiting on empty cache
+	audio->AbortWaitForCachedFragment(true);
+	// injector waiting for video to catch up
+	pthread_mutex_lock(&mLock);
+	pthread_cond_signal(&mCond);
+	pthread_mutex_unlock(&mLock);
+	// injector waiting for gstreamer need-data
+	aamp->ResumeTrackDownloads(eMEDIATYPE_AUDIO);
+	audio->StopInjectLoop();
+}
+
+
 /**
  *   @brief Waits track injection until caught up with video track.
  *   Used internally by injection logic
@@ -963,7 +1188,7 @@ int StreamAbstractionAAMP::GetDesiredProfileBasedOnCache(void)
 				currentBandwidth, networkBandwidth, nwConsistencyCnt);
 		if(currentProfileIndex != desiredProfileIndex)
 		{
-			logprintf("aamp::GetDesiredProfileBasedOnCache---> currbw[%ld] nwbw[%ld] currProf[%d] desiredProf[%d] vidCache[%d]\n",currentBandwidth,networkBandwidth,currentProfileIndex,desiredProfileIndex,video->numberOfFragmentsCached);
+			logprintf("aamp::GetDesiredProfileBasedOnCache---> currbw[%ld] nwbw[%ld] currProf[%d] desiredProf[%d] vidCache[%d]\n",currentBandwidth,networkBandwidth,currentProfileIndex,desiredProfileIndex,video->numberOfFragmentsCached.load());
 		}
 	}
 	// only for first call, consistency check is ignored
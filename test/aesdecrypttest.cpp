@@ -0,0 +1,273 @@
+/*
+ * If not stated otherwise in this file or this component's license file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2018 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * @file aesdecrypttest.cpp
+ * @brief Correctness test and throughput benchmark of AES-128 fragment decrypt
+ *
+ * Synthetic fragments are encrypted with AES-128-CBC and PKCS7 padding and
+ * decrypted by AesDec, as done after download, and by AesStreamDecryptor fed
+ * in download sized chunks. The key is served over HTTP from loopback, so the
+ * key acquisition path of the player is used as is.
+ */
+
+#include "StreamAbstractionAAMP.h"
+#include "aamp_aes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <vector>
+
+#define KEY_LEN 16                              /**< AES-128 key length*/
+#define STREAM_CHUNK_SIZE (64 * 1024)           /**< Bytes handed to stream decryptor per download callback*/
+#define KEY_WAIT_MS 5000                        /**< Time to wait for key acquisition*/
+#define BENCH_ROUNDS 5                          /**< Decrypts timed per fragment size*/
+#define CHECK_FRAGMENT_SIZE (2 * 1024 * 1024)   /**< Fragment size decrypted with --no-bench*/
+
+static const unsigned char gTestKey[KEY_LEN] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+static const size_t gFragmentSizes[] = { 2 * 1024 * 1024, 4 * 1024 * 1024, 8 * 1024 * 1024, 16 * 1024 * 1024, 25 * 1024 * 1024 };
+
+/**
+ * @brief Loopback HTTP server handing out the test key
+ */
+struct KeyServer
+{
+	int listenFd;           /**< Listening socket*/
+	int port;               /**< Port bound on 127.0.0.1*/
+	pthread_t threadId;     /**< Serving thread*/
+};
+
+/**
+ * @brief Get steady clock in microseconds
+ * @retval current time
+ */
+static long long NowUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Answer every request with the test key, till listening socket is shut down
+ * @param arg KeyServer
+ * @retval NULL
+ */
+static void *ServeKey(void *arg)
+{
+	KeyServer *server = (KeyServer *)arg;
+	int fd;
+	while ((fd = accept(server->listenFd, NULL, NULL)) >= 0)
+	{
+		char request[4096];
+		size_t received = 0;
+		ssize_t len;
+		while ((received < sizeof(request) - 1) && ((len = recv(fd, request + received, sizeof(request) - 1 - received, 0)) > 0))
+		{
+			received += len;
+			request[received] = 0;
+			if (strstr(request, "\r\n\r\n"))
+			{
+				break;
+			}
+		}
+		char response[256];
+		int headerLen = snprintf(response, sizeof(response),
+				"HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: %d\r\nConnection: close\r\n\r\n", KEY_LEN);
+		memcpy(response + headerLen, gTestKey, KEY_LEN);
+		send(fd, response, headerLen + KEY_LEN, MSG_NOSIGNAL);
+		close(fd);
+	}
+	return NULL;
+}
+
+/**
+ * @brief Start key server on an ephemeral loopback port
+ * @param server server to start
+ * @retval true on success
+ */
+static bool StartKeyServer(KeyServer &server)
+{
+	struct sockaddr_in addr;
+	socklen_t addrLen = sizeof(addr);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	server.listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	if ((server.listenFd < 0) || bind(server.listenFd, (struct sockaddr *)&addr, sizeof(addr)) || listen(server.listenFd, 4)
+			|| getsockname(server.listenFd, (struct sockaddr *)&addr, &addrLen))
+	{
+		printf("FAIL key server setup\n");
+		return false;
+	}
+	server.port = ntohs(addr.sin_port);
+	return (0 == pthread_create(&server.threadId, NULL, ServeKey, &server));
+}
+
+/**
+ * @brief Stop key server
+ * @param server server to stop
+ */
+static void StopKeyServer(KeyServer &server)
+{
+	shutdown(server.listenFd, SHUT_RDWR);
+	pthread_join(server.threadId, NULL);
+	close(server.listenFd);
+}
+
+/**
+ * @brief Encrypt random payload with AES-128-CBC and PKCS7 padding
+ * @param plain payload
+ * @param iv IV of fragment
+ * @param[out] encrypted encrypted fragment
+ * @retval true on success
+ */
+static bool EncryptFragment(const std::vector<unsigned char> &plain, const unsigned char *iv, std::vector<unsigned char> &encrypted)
+{
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	int len = 0;
+	int finalLen = 0;
+	encrypted.resize(plain.size() + KEY_LEN);
+	bool ok = EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), NULL, gTestKey, iv)
+			&& EVP_EncryptUpdate(ctx, encrypted.data(), &len, plain.data(), (int)plain.size())
+			&& EVP_EncryptFinal_ex(ctx, encrypted.data() + len, &finalLen);
+	EVP_CIPHER_CTX_free(ctx);
+	encrypted.resize(len + finalLen);
+	return ok;
+}
+
+/**
+ * @brief Decrypt fragments of a size with both decrypt paths and check the payload
+ * @param aamp player instance
+ * @param aesDec decryptor with key info set
+ * @param drmInfo key URI and IV
+ * @param fragmentSize payload size, not a multiple of block size so padding is partial
+ * @param rounds decrypts per path
+ * @param report print throughput
+ * @retval true on success
+ */
+static bool DecryptFragments(PrivateInstanceAAMP *aamp, AesDec &aesDec, const struct DrmInfo &drmInfo, size_t fragmentSize, int rounds, bool report)
+{
+	std::vector<unsigned char> plain(fragmentSize);
+	std::vector<unsigned char> encrypted;
+	for (size_t i = 0; i < plain.size(); i++)
+	{
+		plain[i] = (unsigned char)rand();
+	}
+	if (!EncryptFragment(plain, drmInfo.iv, encrypted))
+	{
+		printf("FAIL encrypt of %d byte fragment\n", (int)fragmentSize);
+		return false;
+	}
+	std::vector<unsigned char> buffer(encrypted.size());
+	long long decryptUs = 0;
+	long long streamUs = 0;
+	for (int round = 0; round < rounds; round++)
+	{
+		memcpy(buffer.data(), encrypted.data(), encrypted.size());
+		long long startUs = NowUs();
+		DrmReturn err = aesDec.Decrypt(PROFILE_BUCKET_DECRYPT_VIDEO, buffer.data(), buffer.size(), KEY_WAIT_MS);
+		decryptUs += NowUs() - startUs;
+		if ((eDRM_SUCCESS != err) || memcmp(buffer.data(), plain.data(), plain.size()))
+		{
+			printf("FAIL AesDec decrypt of %d byte fragment, err %d\n", (int)fragmentSize, (int)err);
+			return false;
+		}
+
+		AesStreamDecryptor decryptor;
+		memcpy(buffer.data(), encrypted.data(), encrypted.size());
+		startUs = NowUs();
+		decryptor.Init(aamp, &aesDec, &drmInfo);
+		for (size_t downloaded = STREAM_CHUNK_SIZE; downloaded < buffer.size(); downloaded += STREAM_CHUNK_SIZE)
+		{
+			decryptor.DecryptAvailable(buffer.data(), downloaded);
+		}
+		err = decryptor.Finish(PROFILE_BUCKET_DECRYPT_VIDEO, buffer.data(), buffer.size(), KEY_WAIT_MS);
+		streamUs += NowUs() - startUs;
+		if ((eDRM_SUCCESS != err) || memcmp(buffer.data(), plain.data(), plain.size()))
+		{
+			printf("FAIL AesStreamDecryptor decrypt of %d byte fragment, err %d\n", (int)fragmentSize, (int)err);
+			return false;
+		}
+	}
+	if (report)
+	{
+		double totalBytes = (double)encrypted.size() * rounds;
+		printf("%2d MB fragment: AesDec %.1f MB/s, AesStreamDecryptor %.1f MB/s\n", (int)(fragmentSize >> 20),
+				decryptUs ? (totalBytes / decryptUs) : 0.0, streamUs ? (totalBytes / streamUs) : 0.0);
+	}
+	return true;
+}
+
+/**
+ * @brief Run AES decrypt tests, benchmark is skipped with --no-bench
+ * @param argc number of arguments
+ * @param argv arguments
+ * @retval 0 on success
+ */
+int main(int argc, char **argv)
+{
+	bool runBenchmark = !(argc > 1 && 0 == strcmp(argv[1], "--no-bench"));
+	KeyServer server;
+	if (!StartKeyServer(server))
+	{
+		return 1;
+	}
+	PrivateInstanceAAMP *aamp = new PrivateInstanceAAMP();
+	aamp->CurlInit(AAMP_TRACK_COUNT, AAMP_DRM_CURL_COUNT);
+	bool ok;
+	{
+		char keyUri[64];
+		unsigned char iv[KEY_LEN];
+		snprintf(keyUri, sizeof(keyUri), "http://127.0.0.1:%d/key", server.port);
+		for (int i = 0; i < KEY_LEN; i++)
+		{
+			iv[i] = (unsigned char)i;
+		}
+		struct DrmInfo drmInfo;
+		memset(&drmInfo, 0, sizeof(drmInfo));
+		drmInfo.method = eMETHOD_AES_128;
+		drmInfo.iv = iv;
+		drmInfo.uri = keyUri;
+		AesDec aesDec(AAMP_TRACK_COUNT + eTRACK_VIDEO);
+		ok = (eDRM_SUCCESS == aesDec.SetDecryptInfo(aamp, &drmInfo));
+		ok = ok && DecryptFragments(aamp, aesDec, drmInfo, CHECK_FRAGMENT_SIZE + 5, 1, false);
+		if (ok)
+		{
+			printf("PASS AesDec and AesStreamDecryptor decrypt of %d byte fragment\n", CHECK_FRAGMENT_SIZE + 5);
+		}
+		if (ok && runBenchmark)
+		{
+			for (size_t i = 0; ok && (i < sizeof(gFragmentSizes) / sizeof(gFragmentSizes[0])); i++)
+			{
+				ok = DecryptFragments(aamp, aesDec, drmInfo, gFragmentSizes[i], BENCH_ROUNDS, true);
+			}
+		}
+		aesDec.Release();
+	}
+	AesDec::ClearKeyCache(aamp);
+	aamp->CurlTerm(AAMP_TRACK_COUNT, AAMP_DRM_CURL_COUNT);
+	delete aamp;
+	StopKeyServer(server);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,385 @@
+/*
+ * If not stated otherwise in this file or this component's license file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2018 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * @file fragmentcachetest.cpp
+ * @brief Stress test and handoff latency benchmark of the fragment cache ring of MediaTrack
+ *
+ * A fetcher thread and an injector thread drive the ring through the same
+ * calls used by fragment collectors and the inject loop. The stress test checks
+ * ordering and cache accounting under random interleavings and that abort
+ * releases both sides; the benchmark reports the delay between a fetched
+ * fragment being published and the blocked injector picking it up.
+ */
+
+#include "StreamAbstractionAAMP.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <algorithm>
+#include <vector>
+
+#define STRESS_ROUNDS 20                    /**< Tracks created by stress test*/
+#define STRESS_FRAGMENTS_PER_ROUND 20000    /**< Fragments passed through ring per track*/
+#define LATENCY_SAMPLES 20000               /**< Handoffs measured by benchmark*/
+#define ABORT_WAKEUP_LIMIT_MS 1000          /**< Upper bound for abort to release a blocked side*/
+
+/**
+ * @brief Payload of a test fragment
+ */
+struct FragmentStamp
+{
+	unsigned int seq;       /**< Sequence number of fragment*/
+	long long fetchedUs;    /**< Time at which fragment was published to ring*/
+};
+
+/**
+ * @brief Get steady clock in microseconds
+ * @retval current time
+ */
+static long long NowUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @class TestContext
+ * @brief Minimal stream abstraction, only profile index and elapsed time are used by the ring
+ */
+class TestContext : public StreamAbstractionAAMP
+{
+public:
+	TestContext(PrivateInstanceAAMP *aamp) : StreamAbstractionAAMP(aamp) {}
+	void DumpProfiles(void) {}
+	AAMPStatusType Init(TuneType tuneType) { return eAAMPSTATUS_OK; }
+	void Start() {}
+	void Stop(bool clearChannelData) {}
+	bool IsLive() { return false; }
+	void GetStreamFormat(StreamOutputFormat &primaryOutputFormat, StreamOutputFormat &audioOutputFormat)
+	{
+		primaryOutputFormat = FORMAT_NONE;
+		audioOutputFormat = FORMAT_NONE;
+	}
+	double GetStreamPosition() { return 0; }
+	double GetFirstPTS() { return 0; }
+	MediaTrack* GetMediaTrack(TrackType type) { return NULL; }
+	int GetBWIndex(long bandwidth) { return 0; }
+	std::vector<long> GetVideoBitrates(void) { return std::vector<long>(); }
+	std::vector<long> GetAudioBitrates(void) { return std::vector<long>(); }
+	StreamInfo* GetStreamInfo(int idx) { return NULL; }
+};
+
+/**
+ * @class TestTrack
+ * @brief Track exposing fetcher and injector sides of the ring to test threads
+ */
+class TestTrack : public MediaTrack
+{
+public:
+	TestTrack(PrivateInstanceAAMP *aamp, StreamAbstractionAAMP *context) : MediaTrack(eTRACK_AUDIO, aamp, "test"),
+			mContext(context), mReadIdx(0)
+	{
+		fragmentDurationSeconds = 2.0;
+	}
+	void ABRProfileChanged(void) {}
+	StreamAbstractionAAMP* GetContext() { return mContext; }
+	void InjectFragmentInternal(CachedFragment* cachedFragment, bool &fragmentDiscarded) { fragmentDiscarded = false; }
+
+	/**
+	 * @brief Cache a fragment, the way a fetcher does
+	 * @param seq sequence number to store in fragment
+	 * @retval false if aborted
+	 */
+	bool Fetch(unsigned int seq)
+	{
+		if (!WaitForFreeFragmentAvailable())
+		{
+			return false;
+		}
+		CachedFragment *fragment = GetFetchBuffer(true);
+		FragmentStamp stamp;
+		stamp.seq = seq;
+		fragment->duration = fragmentDurationSeconds;
+		stamp.fetchedUs = NowUs();
+		aamp_AppendBytes(&fragment->fragment, &stamp, sizeof(stamp));
+		UpdateTSAfterFetch();
+		return true;
+	}
+
+	/**
+	 * @brief Take oldest cached fragment, the way the inject loop does
+	 * @param[out] stamp payload of fragment
+	 * @retval false if aborted
+	 */
+	bool Inject(FragmentStamp &stamp)
+	{
+		if (!WaitForCachedFragmentAvailable())
+		{
+			return false;
+		}
+		CachedFragment *fragment = &cachedFragment[mReadIdx];
+		if (fragment->fragment.len != sizeof(stamp))
+		{
+			return false;
+		}
+		memcpy(&stamp, fragment->fragment.ptr, sizeof(stamp));
+		mReadIdx = (mReadIdx + 1) % maxCachedFragments;
+		UpdateTSAfterInject();
+		return true;
+	}
+
+	int GetRingDepth() { return maxCachedFragments; }
+
+private:
+	StreamAbstractionAAMP *mContext;
+	int mReadIdx;
+};
+
+/**
+ * @brief Arguments of fetcher thread
+ */
+struct FetcherArgs
+{
+	TestTrack *track;
+	unsigned int count;         /**< Fragments to fetch*/
+	bool randomDelay;           /**< Yield at random points to vary interleaving*/
+	std::atomic<unsigned int> *injected;    /**< If set, wait for each fragment to be injected before next*/
+	unsigned int fetched;       /**< Fragments fetched before returning*/
+};
+
+/**
+ * @brief Fetcher thread
+ * @param arg FetcherArgs pointer
+ * @retval NULL
+ */
+static void *FetcherThread(void *arg)
+{
+	FetcherArgs *args = (FetcherArgs *)arg;
+	unsigned int seed = 1;
+	for (args->fetched = 0; args->fetched < args->count; args->fetched++)
+	{
+		if (args->injected)
+		{
+			while (args->injected->load() < args->fetched)
+			{
+				sched_yield();
+			}
+			// let injector reach the empty ring wait
+			usleep(20);
+		}
+		if (args->randomDelay && (rand_r(&seed) % 64) == 0)
+		{
+			sched_yield();
+		}
+		if (!args->track->Fetch(args->fetched))
+		{
+			break;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Arguments of injector thread
+ */
+struct InjectorArgs
+{
+	TestTrack *track;
+	unsigned int count;         /**< Fragments to inject*/
+	unsigned int injected;      /**< Fragments injected before returning*/
+	bool outOfOrder;            /**< Set if a fragment arrived out of order*/
+};
+
+/**
+ * @brief Injector thread
+ * @param arg InjectorArgs pointer
+ * @retval NULL
+ */
+static void *InjectorThread(void *arg)
+{
+	InjectorArgs *args = (InjectorArgs *)arg;
+	FragmentStamp stamp;
+	for (args->injected = 0; args->injected < args->count; args->injected++)
+	{
+		if (!args->track->Inject(stamp))
+		{
+			break;
+		}
+		if (stamp.seq != args->injected)
+		{
+			args->outOfOrder = true;
+			break;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Pass fragments through ring with fetcher and injector on own threads
+ * @param aamp player instance
+ * @param context stream abstraction
+ * @retval true on success
+ */
+static bool TestOrderingUnderContention(PrivateInstanceAAMP *aamp, StreamAbstractionAAMP *context)
+{
+	bool ret = true;
+	long long startUs = NowUs();
+	for (int round = 0; round < STRESS_ROUNDS && ret; round++)
+	{
+		TestTrack track(aamp, context);
+		FetcherArgs fetcher = { &track, STRESS_FRAGMENTS_PER_ROUND, true, NULL, 0 };
+		InjectorArgs injector = { &track, STRESS_FRAGMENTS_PER_ROUND, 0, false };
+		pthread_t fetcherId, injectorId;
+		pthread_create(&injectorId, NULL, InjectorThread, &injector);
+		pthread_create(&fetcherId, NULL, FetcherThread, &fetcher);
+		pthread_join(fetcherId, NULL);
+		pthread_join(injectorId, NULL);
+		if (injector.outOfOrder || injector.injected != STRESS_FRAGMENTS_PER_ROUND || fetcher.fetched != STRESS_FRAGMENTS_PER_ROUND)
+		{
+			printf("FAIL ordering round %d fetched %u injected %u outOfOrder %d\n", round, fetcher.fetched, injector.injected, injector.outOfOrder);
+			ret = false;
+		}
+		else if (track.numberOfFragmentsCached != 0 || aamp->GetCachedFragmentBytes() != 0)
+		{
+			printf("FAIL accounting round %d cached %d bytes %lld\n", round, track.numberOfFragmentsCached.load(), aamp->GetCachedFragmentBytes());
+			ret = false;
+		}
+	}
+	if (ret)
+	{
+		long long elapsedUs = NowUs() - startUs;
+		printf("PASS ordering %d x %d fragments, %.0f fragments/s\n", STRESS_ROUNDS, STRESS_FRAGMENTS_PER_ROUND,
+				(double)STRESS_ROUNDS * STRESS_FRAGMENTS_PER_ROUND * 1000000 / (elapsedUs ? elapsedUs : 1));
+	}
+	return ret;
+}
+
+/**
+ * @brief Check that abort releases injector blocked on empty ring and fetcher blocked on full ring
+ * @param aamp player instance
+ * @param context stream abstraction
+ * @retval true on success
+ */
+static bool TestAbortReleasesWaiters(PrivateInstanceAAMP *aamp, StreamAbstractionAAMP *context)
+{
+	bool ret = true;
+	for (int round = 0; round < STRESS_ROUNDS && ret; round++)
+	{
+		pthread_t threadId;
+		long long abortUs;
+		long long injectorWakeupMs, fetcherWakeupMs;
+		{ // ring stays empty, injector blocks
+			TestTrack track(aamp, context);
+			InjectorArgs injector = { &track, 1, 0, false };
+			pthread_create(&threadId, NULL, InjectorThread, &injector);
+			usleep(1000 * (1 + round % 5));
+			abortUs = NowUs();
+			track.AbortWaitForCachedFragment(true);
+			pthread_join(threadId, NULL);
+			injectorWakeupMs = (NowUs() - abortUs) / 1000;
+			if (injector.injected != 0)
+			{
+				printf("FAIL abort round %d injected %u from empty ring\n", round, injector.injected);
+				ret = false;
+			}
+		}
+		{ // one more than ring depth, fetcher blocks on full ring
+			TestTrack track(aamp, context);
+			FetcherArgs fetcher = { &track, (unsigned int)track.GetRingDepth() + 1, false, NULL, 0 };
+			pthread_create(&threadId, NULL, FetcherThread, &fetcher);
+			usleep(1000 * (1 + round % 5));
+			abortUs = NowUs();
+			track.AbortWaitForCachedFragment(true);
+			pthread_join(threadId, NULL);
+			fetcherWakeupMs = (NowUs() - abortUs) / 1000;
+			if (fetcher.fetched == 0 || fetcher.fetched > (unsigned int)track.GetRingDepth())
+			{
+				printf("FAIL abort round %d fetched %u into ring of %d\n", round, fetcher.fetched, track.GetRingDepth());
+				ret = false;
+			}
+		}
+		if (injectorWakeupMs > ABORT_WAKEUP_LIMIT_MS || fetcherWakeupMs > ABORT_WAKEUP_LIMIT_MS)
+		{
+			printf("FAIL abort round %d wakeup injector %lld ms fetcher %lld ms\n", round, injectorWakeupMs, fetcherWakeupMs);
+			ret = false;
+		}
+	}
+	if (ret)
+	{
+		printf("PASS abort releases blocked fetcher and injector\n");
+	}
+	return ret;
+}
+
+/**
+ * @brief Measure delay from publishing a fragment to blocked injector taking it
+ * @param aamp player instance
+ * @param context stream abstraction
+ */
+static void BenchmarkHandoffLatency(PrivateInstanceAAMP *aamp, StreamAbstractionAAMP *context)
+{
+	TestTrack track(aamp, context);
+	std::atomic<unsigned int> injectedCount(0);
+	FetcherArgs fetcher = { &track, LATENCY_SAMPLES, false, &injectedCount, 0 };
+	pthread_t fetcherId;
+	std::vector<long long> samples;
+	samples.reserve(LATENCY_SAMPLES);
+	pthread_create(&fetcherId, NULL, FetcherThread, &fetcher);
+	FragmentStamp stamp;
+	for (unsigned int i = 0; i < LATENCY_SAMPLES; i++)
+	{
+		if (!track.Inject(stamp))
+		{
+			break;
+		}
+		samples.push_back(NowUs() - stamp.fetchedUs);
+		injectedCount = i + 1;
+	}
+	pthread_join(fetcherId, NULL);
+	if (!samples.empty())
+	{
+		std::sort(samples.begin(), samples.end());
+		printf("handoff latency us: samples %u median %lld p90 %lld p99 %lld max %lld\n", (unsigned int)samples.size(),
+				samples[samples.size() / 2], samples[samples.size() * 9 / 10], samples[samples.size() * 99 / 100], samples.back());
+	}
+}
+
+/**
+ * @brief Run fragment cache tests, benchmark is skipped with --no-bench
+ * @param argc number of arguments
+ * @param argv arguments
+ * @retval 0 on success
+ */
+int main(int argc, char **argv)
+{
+	bool runBenchmark = !(argc > 1 && 0 == strcmp(argv[1], "--no-bench"));
+	PrivateInstanceAAMP *aamp = new PrivateInstanceAAMP();
+	TestContext *context = new TestContext(aamp);
+	bool ok = TestOrderingUnderContention(aamp, context);
+	ok = TestAbortReleasesWaiters(aamp, context) && ok;
+	if (runBenchmark)
+	{
+		BenchmarkHandoffLatency(aamp, context);
+	}
+	delete context;
+	delete aamp;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+/*
+ * If not stated otherwise in this file or this component's license file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2018 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * @file playlistindextest.cpp
+ * @brief Correctness test and throughput benchmark of HLS media playlist indexing
+ *
+ * Synthetic DVR playlists of thousands of segments, with program date times,
+ * discontinuities and long URIs as served by CDNs, are indexed by TrackState.
+ * The index is checked segment by segment and indexing time is reported for
+ * a 6 hour and a 24 hour window.
+ */
+
+#include "fragmentcollector_hls.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#define FIRST_MEDIA_SEQUENCE 123456         /**< EXT-X-MEDIA-SEQUENCE of synthetic playlists*/
+#define CHECK_SEGMENT_COUNT 10800           /**< Segments of playlist checked with --no-bench, 6 hours of 2s segments*/
+#define BENCH_ROUNDS 20                     /**< Indexing passes timed per playlist*/
+
+static const int gBenchSegmentCounts[] = { 10800, 43200 };
+static const char *gSegmentDurations[] = { "2.002", "2.002", "1.969", "2.035" };
+
+/**
+ * @brief Get steady clock in microseconds
+ * @retval current time
+ */
+static long long NowUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Build a live media playlist into the playlist buffer of a track
+ * @param track track receiving the playlist
+ * @param segmentCount number of segments
+ * @param[out] completionTimes expected completion time of each segment
+ */
+static void BuildPlaylist(TrackState *track, int segmentCount, std::vector<double> &completionTimes)
+{
+	char line[512];
+	double totalDuration = 0;
+	aamp_Free(&track->playlist.ptr);
+	memset(&track->playlist, 0, sizeof(track->playlist));
+	int len = snprintf(line, sizeof(line), "#EXTM3U\n#EXT-X-VERSION:6\n#EXT-X-TARGETDURATION:3\n#EXT-X-MEDIA-SEQUENCE:%d\n", FIRST_MEDIA_SEQUENCE);
+	aamp_AppendBytes(&track->playlist, line, len);
+	completionTimes.clear();
+	for (int i = 0; i < segmentCount; i++)
+	{
+		if (i && (i % 1800 == 0))
+		{
+			aamp_AppendBytes(&track->playlist, "#EXT-X-DISCONTINUITY\n", 21);
+		}
+		if (i % 15 == 0)
+		{
+			len = snprintf(line, sizeof(line), "#EXT-X-PROGRAM-DATE-TIME:2020-01-01T%02d:%02d:%02d.000Z\n", (i / 1800) % 24, (i / 30) % 60, (i * 2) % 60);
+			aamp_AppendBytes(&track->playlist, line, len);
+		}
+		const char *duration = gSegmentDurations[i % (sizeof(gSegmentDurations) / sizeof(gSegmentDurations[0]))];
+		len = snprintf(line, sizeof(line), "#EXTINF:%s,\n"
+				"https://cdn.example.com/live/channel/1080p/seg-%d.ts?token=exp=1577836800~acl=/live/channel/*~hmac=0123456789abcdef0123456789abcdef\n",
+				duration, FIRST_MEDIA_SEQUENCE + i);
+		aamp_AppendBytes(&track->playlist, line, len);
+		totalDuration += atof(duration);
+		completionTimes.push_back(totalDuration);
+	}
+	aamp_AppendNulTerminator(&track->playlist);
+}
+
+/**
+ * @brief Check index of a playlist against the segments it was built from
+ * @param track track with indexed playlist
+ * @param completionTimes expected completion time of each segment
+ * @param duration duration returned by indexing
+ * @retval true on success
+ */
+static bool CheckIndex(TrackState *track, const std::vector<double> &completionTimes, double duration)
+{
+	const IndexNode *node = (const IndexNode *)track->index.ptr;
+	if ((track->indexCount != (int)completionTimes.size()) || (duration != completionTimes.back())
+			|| (track->indexFirstMediaSequenceNumber != FIRST_MEDIA_SEQUENCE))
+	{
+		printf("FAIL index of %d segments: indexCount %d duration %f media sequence %lld\n", (int)completionTimes.size(),
+				track->indexCount, duration, track->indexFirstMediaSequenceNumber);
+		return false;
+	}
+	for (int i = 0; i < track->indexCount; i++)
+	{
+		char uri[64];
+		snprintf(uri, sizeof(uri), "/seg-%d.ts?", FIRST_MEDIA_SEQUENCE + i);
+		const char *uriLine = strchr(node[i].pFragmentInfo, '\n');
+		const char *uriLineEnd = uriLine ? strchr(uriLine + 1, '\n') : NULL;
+		const char *uriMatch = uriLine ? strstr(uriLine, uri) : NULL;
+		if ((node[i].completionTimeSecondsFromStart != completionTimes[i]) || (0 != strncmp(node[i].pFragmentInfo, "#EXTINF:", 8))
+				|| !uriMatch || (uriLineEnd && (uriMatch > uriLineEnd)) || (-1 != node[i].drmMetadataIdx))
+		{
+			printf("FAIL index node %d: completion time %f expected %f\n", i, node[i].completionTimeSecondsFromStart, completionTimes[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Index a playlist of CHECK_SEGMENT_COUNT segments twice and check the index
+ * @param track track to index
+ * @retval true on success
+ */
+static bool TestIndexMatchesPlaylist(TrackState *track)
+{
+	std::vector<double> completionTimes;
+	BuildPlaylist(track, CHECK_SEGMENT_COUNT, completionTimes);
+	for (int pass = 0; pass < 2; pass++)
+	{ // second pass reindexes over the previous index, as a playlist refresh does
+		double duration = track->IndexPlaylist();
+		if (!CheckIndex(track, completionTimes, duration))
+		{
+			return false;
+		}
+	}
+	printf("PASS index of %d segment playlist\n", CHECK_SEGMENT_COUNT);
+	return true;
+}
+
+/**
+ * @brief Time indexing of large playlists
+ * @param track track to index
+ * @retval true if every index is correct
+ */
+static bool BenchmarkIndexing(TrackState *track)
+{
+	for (size_t n = 0; n < sizeof(gBenchSegmentCounts) / sizeof(gBenchSegmentCounts[0]); n++)
+	{
+		std::vector<double> completionTimes;
+		BuildPlaylist(track, gBenchSegmentCounts[n], completionTimes);
+		double duration = 0;
+		long long startUs = NowUs();
+		for (int round = 0; round < BENCH_ROUNDS; round++)
+		{
+			duration = track->IndexPlaylist();
+		}
+		long long elapsedUs = NowUs() - startUs;
+		if (!CheckIndex(track, completionTimes, duration))
+		{
+			return false;
+		}
+		printf("%d segments (%.1f MB playlist): %.2f ms per index, %.1f MB/s\n", gBenchSegmentCounts[n], track->playlist.len / 1e6,
+				elapsedUs / 1000.0 / BENCH_ROUNDS, elapsedUs ? ((double)track->playlist.len * BENCH_ROUNDS / elapsedUs) : 0.0);
+	}
+	return true;
+}
+
+/**
+ * @brief Run playlist indexing tests, benchmark is skipped with --no-bench
+ * @param argc number of arguments
+ * @param argv arguments
+ * @retval 0 on success
+ */
+int main(int argc, char **argv)
+{
+	bool runBenchmark = !(argc > 1 && 0 == strcmp(argv[1], "--no-bench"));
+	PrivateInstanceAAMP *aamp = new PrivateInstanceAAMP();
+	StreamAbstractionAAMP_HLS *context = new StreamAbstractionAAMP_HLS(aamp, 0, 1.0, false);
+	TrackState *track = new TrackState(eTRACK_VIDEO, context, aamp, "video");
+	bool ok = TestIndexMatchesPlaylist(track);
+	if (ok && runBenchmark)
+	{
+		ok = BenchmarkIndexing(track);
+	}
+	delete track;
+	delete context;
+	delete aamp;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+/*
+ * If not stated otherwise in this file or this component's license file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2018 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * @file timelineseektest.cpp
+ * @brief Correctness test and seek latency benchmark of SegmentTimelineIndex
+ *
+ * A synthetic 4 hour DVR SegmentTimeline with thousands of S elements, repeat
+ * runs and gaps is indexed. Lookups of random media times are checked against
+ * the S element and repeat walk the collector did before the index, and both
+ * are timed.
+ */
+
+#include "SegmentTimelineIndex.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#define TIMELINE_TIMESCALE 90000            /**< Ticks per second of synthetic timeline*/
+#define TIMELINE_SECONDS (4 * 3600)         /**< Length of synthetic DVR window*/
+#define TIMELINE_START_NUMBER 1000          /**< @startNumber of synthetic timeline*/
+#define CHECK_LOOKUPS 200000                /**< Random times checked against linear walk*/
+#define BENCH_LOOKUPS 20000                 /**< Random times timed per lookup method*/
+
+/**
+ * @brief S element of synthetic timeline
+ */
+struct TimelineElement
+{
+	uint64_t t;     /**< @t, 0 if absent*/
+	uint64_t d;     /**< @d*/
+	uint32_t r;     /**< @r*/
+};
+
+/**
+ * @brief Segment located for a media time
+ */
+struct SegmentPosition
+{
+	int index;          /**< S element index, element count if time is past the timeline*/
+	uint32_t repeat;    /**< Repeat within S element*/
+	uint64_t number;    /**< $Number$ of segment*/
+	uint64_t time;      /**< $Time$ of segment*/
+};
+
+/**
+ * @brief Get steady clock in nanoseconds
+ * @retval current time
+ */
+static long long NowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Build a timeline of alternating segment durations, with repeat runs and gaps
+ * @param[out] elements S elements
+ * @retval end time of timeline
+ */
+static uint64_t BuildTimeline(std::vector<TimelineElement> &elements)
+{
+	uint64_t time = 10 * TIMELINE_TIMESCALE;
+	uint64_t end = time + (uint64_t)TIMELINE_SECONDS * TIMELINE_TIMESCALE;
+	bool explicitTime = true;
+	for (int i = 0; time < end; i++)
+	{
+		TimelineElement element;
+		element.t = explicitTime ? time : 0;
+		explicitTime = false;
+		if (i % 50 == 49)
+		{ // run of regular segments
+			element.d = 2 * TIMELINE_TIMESCALE;
+			element.r = 4;
+		}
+		else
+		{ // 29.97 fps cadence alternates segment durations
+			element.d = (i & 1) ? 180180 : 179820;
+			element.r = 0;
+		}
+		elements.push_back(element);
+		time += (uint64_t)(element.r + 1) * element.d;
+		if (i % 500 == 499)
+		{ // encoder gap, next element carries @t
+			time += TIMELINE_TIMESCALE / 2;
+			explicitTime = true;
+		}
+	}
+	return time;
+}
+
+/**
+ * @brief Locate segment by walking S elements and repeats, as done before the index
+ * @param elements S elements
+ * @param time media time
+ * @retval segment position
+ */
+static SegmentPosition FindLinear(const std::vector<TimelineElement> &elements, uint64_t time)
+{
+	SegmentPosition position = { (int)elements.size(), 0, TIMELINE_START_NUMBER, 0 };
+	uint64_t startTime = 0;
+	for (int i = 0; i < (int)elements.size(); i++)
+	{
+		if (elements[i].t)
+		{
+			startTime = elements[i].t;
+		}
+		for (uint32_t repeat = 0; repeat <= elements[i].r; repeat++)
+		{
+			if (time < startTime + elements[i].d)
+			{
+				position.index = i;
+				position.repeat = repeat;
+				position.time = startTime;
+				return position;
+			}
+			startTime += elements[i].d;
+			position.number++;
+		}
+	}
+	position.time = startTime;
+	return position;
+}
+
+/**
+ * @brief Locate segment through the index, as PushNextFragment and SkipFragments do
+ * @param timelineIndex index of the timeline
+ * @param elements S elements, for durations
+ * @param time media time
+ * @retval segment position
+ */
+static SegmentPosition FindIndexed(const SegmentTimelineIndex &timelineIndex, const std::vector<TimelineElement> &elements, uint64_t time)
+{
+	SegmentPosition position;
+	position.index = timelineIndex.FindEntry(time, 0);
+	position.repeat = 0;
+	if (position.index < timelineIndex.Size())
+	{
+		uint64_t startTime = timelineIndex.GetStartTime(position.index);
+		if (time > startTime)
+		{
+			position.repeat = (uint32_t)((time - startTime) / elements[position.index].d);
+		}
+		position.time = startTime + (uint64_t)position.repeat * elements[position.index].d;
+	}
+	else
+	{
+		const TimelineElement &last = elements.back();
+		position.time = timelineIndex.GetStartTime(position.index - 1) + (uint64_t)(last.r + 1) * last.d;
+	}
+	position.number = TIMELINE_START_NUMBER + timelineIndex.GetSegmentOffset(position.index) + position.repeat;
+	return position;
+}
+
+/**
+ * @brief Compare indexed lookups with linear walk for random times, including gaps and past the end
+ * @param timelineIndex index of the timeline
+ * @param elements S elements
+ * @param endTime end of timeline
+ * @retval true on success
+ */
+static bool TestLookupsMatchLinearWalk(const SegmentTimelineIndex &timelineIndex, const std::vector<TimelineElement> &elements, uint64_t endTime)
+{
+	srand(1);
+	for (int i = 0; i < CHECK_LOOKUPS; i++)
+	{
+		uint64_t time = ((((uint64_t)rand() << 31) | rand()) % (endTime + TIMELINE_TIMESCALE));
+		SegmentPosition expected = FindLinear(elements, time);
+		SegmentPosition actual = FindIndexed(timelineIndex, elements, time);
+		if (expected.index != actual.index || expected.repeat != actual.repeat || expected.number != actual.number || expected.time != actual.time)
+		{
+			printf("FAIL lookup of %llu: expected S %d r %u number %llu time %llu, got S %d r %u number %llu time %llu\n",
+					(unsigned long long)time, expected.index, expected.repeat, (unsigned long long)expected.number, (unsigned long long)expected.time,
+					actual.index, actual.repeat, (unsigned long long)actual.number, (unsigned long long)actual.time);
+			return false;
+		}
+	}
+	printf("PASS %d lookups match linear walk over %d S elements\n", CHECK_LOOKUPS, (int)elements.size());
+	return true;
+}
+
+/**
+ * @brief Time index build and seek lookups against linear walk
+ * @param elements S elements
+ * @param endTime end of timeline
+ */
+static void BenchmarkSeekLatency(const std::vector<TimelineElement> &elements, uint64_t endTime)
+{
+	std::vector<uint64_t> times;
+	for (int i = 0; i < BENCH_LOOKUPS; i++)
+	{
+		times.push_back((((uint64_t)rand() << 31) | rand()) % endTime);
+	}
+	SegmentTimelineIndex timelineIndex;
+	long long startNs = NowNs();
+	timelineIndex.Reset(elements.size());
+	for (size_t i = 0; i < elements.size(); i++)
+	{
+		timelineIndex.AddEntry(elements[i].t, elements[i].d, elements[i].r);
+	}
+	long long buildNs = NowNs() - startNs;
+
+	uint64_t checksum = 0;
+	startNs = NowNs();
+	for (int i = 0; i < BENCH_LOOKUPS; i++)
+	{
+		checksum += FindIndexed(timelineIndex, elements, times[i]).number;
+	}
+	long long indexedNs = NowNs() - startNs;
+	startNs = NowNs();
+	for (int i = 0; i < BENCH_LOOKUPS; i++)
+	{
+		checksum -= FindLinear(elements, times[i]).number;
+	}
+	long long linearNs = NowNs() - startNs;
+	printf("timeline of %d S elements, %llu segments: index build %lld us\n", (int)elements.size(),
+			(unsigned long long)timelineIndex.GetSegmentOffset(timelineIndex.Size()), buildNs / 1000);
+	printf("seek lookup ns: indexed %lld linear %lld (checksum %llu)\n", indexedNs / BENCH_LOOKUPS, linearNs / BENCH_LOOKUPS,
+			(unsigned long long)checksum);
+}
+
+/**
+ * @brief Run timeline index tests, benchmark is skipped with --no-bench
+ * @param argc number of arguments
+ * @param argv arguments
+ * @retval 0 on success
+ */
+int main(int argc, char **argv)
+{
+	bool runBenchmark = !(argc > 1 && 0 == strcmp(argv[1], "--no-bench"));
+	std::vector<TimelineElement> elements;
+	uint64_t endTime = BuildTimeline(elements);
+	SegmentTimelineIndex timelineIndex;
+	for (size_t i = 0; i < elements.size(); i++)
+	{
+		timelineIndex.AddEntry(elements[i].t, elements[i].d, elements[i].r);
+	}
+	bool ok = TestLookupsMatchLinearWalk(timelineIndex, elements, endTime);
+	if (runBenchmark)
+	{
+		BenchmarkSeekLatency(elements, endTime);
+	}
+	return ok ? 0 : 1;
+}
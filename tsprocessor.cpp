@@ -155,6 +155,7 @@ private:
 	int pes_header_ext_read;
 	GrowableBuffer pes_header;
 	GrowableBuffer es;
+	size_t es_size_hint;
 	double position;
 	double duration;
 	unsigned long long base_pts;
@@ -196,7 +197,9 @@ private:
 			}
 			DEBUG_DEMUX("Send : pts %f dts %f\n", pts, dts);
 			DEBUG_DEMUX("position %f base_pts %llu current_pts %llu diff %f seconds length %d\n", position, base_pts, current_pts, (double)(current_pts - base_pts) / 90000, (int)es.len );
-			aamp->SendStream(type, es.ptr, es.len, pts, dts, duration);
+			// ES memory is handed over to sink, next ES is assembled in a fresh buffer sized from this one
+			es_size_hint = es.len;
+			aamp->SendStream(type, &es, pts, dts, duration);
 #ifdef DEBUG_DEMUX_TRACK
 			sentESCount++;
 #endif
@@ -214,6 +217,7 @@ public:
 	{
 		this->aamp = aamp;
 		this->type = type;
+		this->es_size_hint = 0;
 		init(0, 0, false, true);
 	}
 
@@ -521,6 +525,10 @@ public:
 					case PES_STATE_GETTING_ES:
 						/*Handle padding?*/
 						TRACE1("PES_STATE_GETTING_ES bytes_to_read = %d\n", size);
+						if (!es.ptr && es_size_hint)
+						{
+							aamp_Malloc(&es, es_size_hint + (es_size_hint >> 2));
+						}
 						aamp_AppendBytes(&es, data, size);
 						size = 0;
 						break;
@@ -757,6 +765,7 @@ TSProcessor::TSProcessor(class PrivateInstanceAAMP *aamp,StreamOperation streamO
 		m_demux = true;
 	}
 	m_queuedSegment = NULL;
+	m_queuedSharedSegment = NULL;
 	m_queuedSegmentLen = 0;
 
 	int compBufLen = MAX_PIDS*sizeof(RecordingComponent);
@@ -824,11 +833,7 @@ TSProcessor::~TSProcessor()
 		delete m_audDemuxer;
 	}
 
-	if (m_queuedSegment)
-	{
-		free(m_queuedSegment);
-		m_queuedSegment = NULL;
-	}
+	freeQueuedSegment();
 
 	pthread_mutex_destroy(&m_mutex);
 	pthread_cond_destroy(&m_throttleCond);
@@ -2120,8 +2125,7 @@ void TSProcessor::sendQueuedSegment(long long basepts, double updatedStartPosito
 		}
 		if (eStreamOp_QUEUE_AUDIO == m_streamOperation)
 		{
-			aamp->SendStream((MediaType) m_track, m_queuedSegment, m_queuedSegmentLen, m_queuedSegmentPos,
-			        m_queuedSegmentPos, m_queuedSegmentDuration);
+			sendSegmentSlice(m_queuedSharedSegment, m_queuedSegment, m_queuedSegmentLen, m_queuedSegmentPos, m_queuedSegmentDuration);
 		}
 		else if (eStreamOp_DEMUX_AUDIO == m_streamOperation)
 		{
@@ -2135,8 +2139,7 @@ void TSProcessor::sendQueuedSegment(long long basepts, double updatedStartPosito
 		{
 			ERROR("sendQueuedSegment invoked in Invalid stream operation\n");
 		}
-		free(m_queuedSegment);
-		m_queuedSegment = NULL;
+		freeQueuedSegment();
 	}
 	else
 	{
@@ -2168,6 +2171,43 @@ void TSProcessor::setBasePTS(double position, long long pts)
 	pthread_mutex_unlock(&m_mutex);
 }
 
+/**
+ * @brief Free queued segment, releasing shared fragment buffer if it refers to one
+ */
+void TSProcessor::freeQueuedSegment()
+{
+	if (m_queuedSharedSegment)
+	{
+		aamp_ReleaseSharedBuffer(m_queuedSharedSegment);
+		m_queuedSharedSegment = NULL;
+	}
+	else if (m_queuedSegment)
+	{
+		free(m_queuedSegment);
+	}
+	m_queuedSegment = NULL;
+}
+
+/**
+ * @brief Inject part of a segment to sink, without copy when segment is held in a shared buffer
+ * @param[in] sharedSegment shared buffer holding ptr, NULL if segment memory is not shared
+ * @param[in] ptr start of data to be injected
+ * @param[in] len length of data
+ * @param[in] position position of data in seconds
+ * @param[in] duration duration of data in seconds
+ */
+void TSProcessor::sendSegmentSlice(SharedFragmentBuffer *sharedSegment, unsigned char *ptr, size_t len, double position, double duration)
+{
+	if (sharedSegment)
+	{
+		aamp->SendStream((MediaType)m_track, sharedSegment, (char *)ptr - sharedSegment->ptr, len, position, position, duration);
+	}
+	else
+	{
+		aamp->SendStream((MediaType)m_track, ptr, len, position, position, duration);
+	}
+}
+
 /**
  * @brief Does configured operation on the segment and injects data to sink
  * @param[in] segment Buffer containing the data segment
@@ -2176,9 +2216,10 @@ void TSProcessor::setBasePTS(double position, long long pts)
  * @param[in] duration Duration of the segment in seconds
  * @param[in] discontinuous true if fragment is discontinuous
  * @param[out] true on PTS error
+ * @param[in] sharedSegment shared buffer holding segment, if set passthrough data is injected without copy
  * @retval true on success
  */
-bool TSProcessor::sendSegment(char *segment, size_t& size, double position, double duration, bool discontinuous, bool &ptsError)
+bool TSProcessor::sendSegment(char *segment, size_t& size, double position, double duration, bool discontinuous, bool &ptsError, SharedFragmentBuffer *sharedSegment)
 {
 	bool insPatPmt;
 	unsigned char * packetStart;
@@ -2304,16 +2345,16 @@ bool TSProcessor::sendSegment(char *segment, size_t& size, double position, doub
 			if (m_packetStartAfterFirstPTS != -1)
 			{
 
-				aamp->SendStream((MediaType)m_track, packetStart, m_packetStartAfterFirstPTS, position, position, duration);
+				sendSegmentSlice(sharedSegment, packetStart, m_packetStartAfterFirstPTS, position, duration);
 				m_peerTSProcessor->sendQueuedSegment();
-				aamp->SendStream((MediaType)m_track, packetStart + m_packetStartAfterFirstPTS,
-				len - m_packetStartAfterFirstPTS, position, position, duration);
+				sendSegmentSlice(sharedSegment, packetStart + m_packetStartAfterFirstPTS,
+				len - m_packetStartAfterFirstPTS, position, duration);
 			}
 			else
 			{
 				ERROR("m_packetStartAfterFirstPTS Not updated\n");
-				aamp->SendStream((MediaType)m_track, packetStart + m_packetStartAfterFirstPTS,
-				len - m_packetStartAfterFirstPTS, position, position, duration);
+				sendSegmentSlice(sharedSegment, packetStart + m_packetStartAfterFirstPTS,
+				len - m_packetStartAfterFirstPTS, position, duration);
 			}
 		}
 		else if (eStreamOp_QUEUE_AUDIO == m_streamOperation)
@@ -2322,16 +2363,27 @@ bool TSProcessor::sendSegment(char *segment, size_t& size, double position, doub
 			if (m_queuedSegment)
 			{
 				ERROR("Queued buffer not NULL\n");
-				free(m_queuedSegment);
+				freeQueuedSegment();
+			}
+			if (sharedSegment)
+			{
+				m_queuedSharedSegment = aamp_RetainSharedBuffer(sharedSegment);
+				m_queuedSegment = packetStart;
+			}
+			else
+			{
+				m_queuedSegment = (unsigned char *)malloc(len);
+				if (m_queuedSegment)
+				{
+					memcpy(m_queuedSegment, packetStart, len);
+				}
 			}
-			m_queuedSegment = (unsigned char *)malloc(len);
 			if (!m_queuedSegment)
 			{
 				ERROR("Failed to allocate memory\n");
 			}
 			else
 			{
-				memcpy(m_queuedSegment, packetStart, len);
 				m_queuedSegmentLen = len;
 				m_queuedSegmentPos = position;
 				m_queuedSegmentDuration = duration;
@@ -2341,7 +2393,7 @@ bool TSProcessor::sendSegment(char *segment, size_t& size, double position, doub
 		}
 		else
 		{
-			aamp->SendStream((MediaType)m_track, packetStart, len, position, position, duration);
+			sendSegmentSlice(sharedSegment, packetStart, len, position, duration);
 		}
 	}
 	if (-1 != duration)
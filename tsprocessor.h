@@ -32,6 +32,8 @@
 
 #define MAX_PIDS (8) //PMT Parsing
 
+struct SharedFragmentBuffer;
+
 /**
 * @struct RecordingComponent
 * @brief Stores information of a audio/video component.
@@ -124,7 +126,7 @@ class TSProcessor
    public:
       TSProcessor(class PrivateInstanceAAMP *aamp, StreamOperation streamOperation, int track = 0, TSProcessor* peerTSProcessor = NULL);
       ~TSProcessor();
-      bool sendSegment( char *segment, size_t& size, double position, double duration, bool discontinuous, bool &ptsError);
+      bool sendSegment( char *segment, size_t& size, double position, double duration, bool discontinuous, bool &ptsError, SharedFragmentBuffer *sharedSegment = NULL);
       void setRate(double rate, PlayMode mode);
       void setThrottleEnable(bool enable);
 
@@ -275,6 +277,8 @@ class TSProcessor
       long long getCurrentTime();
       bool throttle(); 
       void sendDiscontinuity(double position);
+      void sendSegmentSlice(SharedFragmentBuffer *sharedSegment, unsigned char *ptr, size_t len, double position, double duration);
+      void freeQueuedSegment();
       void setupThrottle(int segmentDurationMs);
       bool demuxAndSend(const void *ptr, size_t len, double fTimestamp, double fDuration, bool discontinuous, TrackToDemux trackToDemux = ePC_Track_Both);
       bool msleep(long long throttleDiff);
@@ -320,6 +324,7 @@ class TSProcessor
       TSProcessor* m_peerTSProcessor;
       int m_packetStartAfterFirstPTS;
       unsigned char * m_queuedSegment;
+      SharedFragmentBuffer *m_queuedSharedSegment; //!< Set when m_queuedSegment points into a shared fragment buffer
       double m_queuedSegmentPos;
       double m_queuedSegmentDuration;
       size_t m_queuedSegmentLen;